@@ -1,9 +1,21 @@
 #include "camera.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
 #include <iostream>
 
+namespace {
+    const std::chrono::milliseconds StatusInterval(500);
+}
+
 Camera::Camera(sf::RenderWindow& window)
     : m_window(window)
 {
+    if (!m_font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
+        std::cerr << "Failed to load font" << std::endl;
+    }
+
     m_background = sf::RectangleShape(sf::Vector2f(m_window.getSize().x, m_window.getSize().y));
     m_background.setFillColor(sf::Color::Blue);
 
@@ -12,6 +24,26 @@ Camera::Camera(sf::RenderWindow& window)
     m_exitButton.setFillColor(sf::Color::White);
     m_exitButton.setOutlineThickness(2);
     m_exitButton.setOutlineColor(sf::Color::Black);
+
+    m_recordButton = sf::CircleShape(25);
+    m_recordButton.setPosition(70, 10);
+    m_recordButton.setFillColor(sf::Color(120, 0, 0));
+    m_recordButton.setOutlineThickness(2);
+    m_recordButton.setOutlineColor(sf::Color::Black);
+
+    m_regionShape.setFillColor(sf::Color::Transparent);
+    m_regionShape.setOutlineThickness(2);
+    m_regionShape.setOutlineColor(sf::Color::Red);
+
+    m_motionText.setFont(m_font);
+    m_motionText.setCharacterSize(16);
+    m_motionText.setFillColor(sf::Color::White);
+    m_motionText.setPosition(130, 25);
+
+    m_status.setFont(m_font);
+    m_status.setCharacterSize(16);
+    m_status.setFillColor(sf::Color::White);
+    m_status.setPosition(10, m_window.getSize().y - 30.f);
 }
 
 void Camera::handleEvent(const sf::Event& event) {
@@ -21,13 +53,194 @@ void Camera::handleEvent(const sf::Event& event) {
 
             if (m_exitButton.getGlobalBounds().contains(mousePos)) {
                 // Exit camera app
+                stopCapture();
                 m_shouldExit = true;
+            } else if (m_recordButton.getGlobalBounds().contains(mousePos)) {
+                toggleRecording();
             }
         }
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::R) {
+        toggleRecording();
     }
 }
 
 void Camera::draw(sf::RenderWindow& window) {
+    if (!m_captureStarted) {
+        startCapture();
+    }
+
+    // Upload only when a new frame arrived; the textures were sized in startCapture()
+    if (const Frame* frame = m_pipeline.latest()) {
+        m_currentTexture = (m_currentTexture + 1) % m_textures.size();
+        m_textures[m_currentTexture].update(frame->pixels.data());
+        m_sprite.setTexture(m_textures[m_currentTexture]);
+        m_hasFrame = true;
+        m_pipeline.presented(*frame);
+    }
+
     m_window.draw(m_background);
+    if (m_hasFrame) {
+        m_window.draw(m_sprite);
+        drawMotion();
+    }
     m_window.draw(m_exitButton);
-}
\ No newline at end of file
+    m_window.draw(m_recordButton);
+
+    if (std::chrono::steady_clock::now() - m_lastStatus >= StatusInterval) {
+        updateStatus();
+    }
+    m_window.draw(m_status);
+    m_window.draw(m_motionText);
+}
+
+void Camera::applyPowerProfile(const PowerProfile& profile) {
+    m_powerProfile = profile;
+    m_pipeline.setMaxFrameRate(profile.cameraFrameRate);
+    m_pipeline.setConvertThreads(profile.workerThreads);
+    m_detector.setMaxFrameRate(profile.motionFrameRate);
+    m_detector.setThreadCount(profile.workerThreads);
+}
+
+void Camera::onSuspend() {
+    stopCapture();
+    m_pipeline.releaseBuffers();
+    m_detector.release();
+    for (sf::Texture& texture : m_textures) {
+        texture = sf::Texture();
+    }
+    m_hasFrame = false;
+}
+
+AppMemory Camera::memoryUsage() const {
+    AppMemory memory;
+    memory.cpuBytes = m_pipeline.bufferBytes() + m_detector.bufferBytes();
+    for (const sf::Texture& texture : m_textures) {
+        memory.gpuBytes += appmemory::textureBytes(texture);
+    }
+    return memory;
+}
+
+void Camera::startCapture() {
+    m_captureStarted = true;
+    m_hasFrame = false;
+    if (!m_pipeline.start(createFrameSource(defaultFrameSource()))) {
+        m_status.setString("No camera available (set CAMERA_SOURCE to a device, image, directory or \"pattern\")");
+        return;
+    }
+
+    const unsigned int width = m_pipeline.width();
+    const unsigned int height = m_pipeline.height();
+    for (sf::Texture& texture : m_textures) {
+        if (!texture.create(width, height)) {
+            std::cerr << "Camera: cannot create a " << width << "x" << height << " texture" << std::endl;
+            m_pipeline.stop();
+            return;
+        }
+    }
+
+    // Fit the frame below the exit button, keeping its aspect ratio
+    const float areaWidth = static_cast<float>(m_window.getSize().x) - 20.f;
+    const float areaHeight = static_cast<float>(m_window.getSize().y) - 110.f;
+    const float scale = std::min(areaWidth / width, areaHeight / height);
+    m_sprite.setScale(scale, scale);
+    m_sprite.setPosition(10.f + (areaWidth - width * scale) / 2, 70.f + (areaHeight - height * scale) / 2);
+    m_sprite.setTextureRect(sf::IntRect(0, 0, static_cast<int>(width), static_cast<int>(height)));
+
+    MotionDetector::Options motionOptions;
+    motionOptions.threads = m_powerProfile.workerThreads;
+    m_detector.configure(width, height, motionOptions);
+    m_detector.start();
+    m_pipeline.addSink(&m_detector);
+}
+
+void Camera::stopCapture() {
+    stopRecording();
+    m_pipeline.removeSink(&m_detector);
+    m_detector.stop();
+    m_pipeline.stop();
+    m_captureStarted = false;
+}
+
+void Camera::toggleRecording() {
+    if (m_recorder.isRecording()) {
+        stopRecording();
+        return;
+    }
+    if (!m_pipeline.isRunning()) return;
+
+    // CAMERA_RECORD_FORMAT picks raw, png or mjpeg
+    FrameRecorder::Options options;
+    options.encoderThreads = m_powerProfile.workerThreads;
+    const char* format = std::getenv("CAMERA_RECORD_FORMAT");
+    if (format && !FrameRecorder::parseFormat(format, options.format)) {
+        std::cerr << "Camera: unknown CAMERA_RECORD_FORMAT " << format << ", recording mjpeg" << std::endl;
+    }
+
+    std::time_t now = std::time(nullptr);
+    char name[32];
+    std::strftime(name, sizeof(name), "%Y%m%d-%H%M%S", std::localtime(&now));
+    if (!m_recorder.start(std::string("recordings/") + name, m_pipeline.width(), m_pipeline.height(), options)) {
+        std::cerr << "Camera: cannot record: " << m_recorder.error() << std::endl;
+        return;
+    }
+    m_pipeline.addSink(&m_recorder);
+    m_recordButton.setFillColor(sf::Color::Red);
+    updateStatus();
+}
+
+void Camera::stopRecording() {
+    if (!m_recorder.isRecording()) return;
+    m_pipeline.removeSink(&m_recorder);
+    m_recorder.stop();
+    m_recordButton.setFillColor(sf::Color(120, 0, 0));
+    updateStatus();
+}
+
+void Camera::drawMotion() {
+    if (!m_detector.isRunning()) return;
+
+    // Regions are in frame pixels; map them through the sprite's placement
+    m_detector.latest(m_motion);
+    const sf::Vector2f origin = m_sprite.getPosition();
+    const float scale = m_sprite.getScale().x;
+    for (const MotionDetector::Region& region : m_motion.regions) {
+        m_regionShape.setPosition(origin.x + region.x * scale, origin.y + region.y * scale);
+        m_regionShape.setSize(sf::Vector2f(region.width * scale, region.height * scale));
+        m_window.draw(m_regionShape);
+    }
+    m_motionText.setFillColor(m_motion.inEvent ? sf::Color::Red : sf::Color::White);
+}
+
+void Camera::updateStatus() {
+    m_lastStatus = std::chrono::steady_clock::now();
+    if (!m_pipeline.isRunning()) {
+        std::string error = m_pipeline.error();
+        if (!error.empty()) m_status.setString("Capture stopped: " + error);
+        return;
+    }
+
+    CapturePipeline::Stats stats = m_pipeline.stats();
+    char text[160];
+    std::snprintf(text, sizeof(text), "%ux%u | %llu captured, %llu shown, %llu dropped (%llu by source) | latency %.1f ms avg, %.1f ms p99",
+                  m_pipeline.width(), m_pipeline.height(),
+                  static_cast<unsigned long long>(stats.captured), static_cast<unsigned long long>(stats.displayed),
+                  static_cast<unsigned long long>(stats.dropped), static_cast<unsigned long long>(stats.sourceDropped),
+                  stats.averageLatencyMilliseconds, stats.p99LatencyMilliseconds);
+    std::string status = text;
+    if (m_recorder.isRecording()) {
+        FrameRecorder::Stats recording = m_recorder.stats();
+        std::snprintf(text, sizeof(text), " | REC %.1f MB/s, queue %zu/%zu, quality %d, %llu dropped",
+                      recording.megabytesPerSecond, recording.queueDepth, FrameRecorder::QueueFrames,
+                      recording.quality, static_cast<unsigned long long>(recording.dropped));
+        status += text;
+    }
+    m_status.setString(status);
+
+    MotionDetector::Stats motion = m_detector.stats();
+    m_detector.latest(m_motion);
+    std::snprintf(text, sizeof(text), "%s | %llu events | %.2f ms/frame (p99 %.2f), %llu skipped, %llu throttled",
+                  m_motion.inEvent ? "MOTION" : "No motion", static_cast<unsigned long long>(motion.events),
+                  motion.averageMilliseconds, motion.p99Milliseconds, static_cast<unsigned long long>(motion.skipped),
+                  static_cast<unsigned long long>(motion.throttled));
+    m_motionText.setString(text);
+}
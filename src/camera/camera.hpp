@@ -1,18 +1,66 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include "capturepipeline.hpp"
+#include "framerecorder.hpp"
+#include "motiondetector.hpp"
+#include "../ui/app.hpp"
+#include "../utils/powergovernor.hpp"
+#include <array>
+#include <chrono>
+#include <cstddef>
 
-class Camera {
+class Camera : public App {
 public:
     Camera(sf::RenderWindow& window);
-    void handleEvent(const sf::Event& event);
-    void draw(sf::RenderWindow& window);
-    void resetShouldExit() { m_shouldExit = false; }
-    bool shouldReturnToMain() const { return m_shouldExit; }
+    const char* name() const override { return "Camera"; }
+    void handleEvent(const sf::Event& event) override;
+    void draw(sf::RenderWindow& window) override;
+    void resetShouldExit() override { m_shouldExit = false; }
+    bool shouldReturnToMain() const override { return m_shouldExit; }
+    // Frees the frame buffers, analysis buffers and textures; the next
+    // draw() starts capture and allocates them again
+    void onSuspend() override;
+    AppMemory memoryUsage() const override;
+    // Capture and motion analysis rates and worker threads; a recording
+    // picks up the encoder thread count when it starts
+    void applyPowerProfile(const PowerProfile& profile);
 
 private:
     sf::RenderWindow& m_window;
+    sf::Font m_font;
     sf::RectangleShape m_background;
     sf::RectangleShape m_exitButton;
+    sf::CircleShape m_recordButton;
     bool m_shouldExit = false;
-};
\ No newline at end of file
+    PowerProfile m_powerProfile;
+
+    // Declared first so the pipeline, which may still hand them frames, goes away before them
+    FrameRecorder m_recorder;
+    MotionDetector m_detector;
+    // Capture runs only while the app is shown
+    CapturePipeline m_pipeline;
+    bool m_captureStarted = false;
+
+    // Uploads rotate through three textures, so a new frame never goes into
+    // the texture the GPU may still be drawing from
+    std::array<sf::Texture, 3> m_textures;
+    std::size_t m_currentTexture = 0;
+    bool m_hasFrame = false;
+    sf::Sprite m_sprite;
+
+    // Motion regions are outlined over the preview
+    sf::RectangleShape m_regionShape;
+    sf::Text m_motionText;
+    MotionDetector::Result m_motion; // refilled from the detector each frame
+
+    sf::Text m_status;
+    std::chrono::steady_clock::time_point m_lastStatus;
+
+    void startCapture();
+    void stopCapture();
+    void toggleRecording();
+    void stopRecording();
+    void drawMotion();
+    void updateStatus();
+};
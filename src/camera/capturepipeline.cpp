@@ -0,0 +1,172 @@
+#include "capturepipeline.hpp"
+#include <algorithm>
+#include <iostream>
+
+namespace {
+    // How long a read may block before the thread checks whether to stop
+    const std::chrono::milliseconds ReadTimeout(100);
+}
+
+CapturePipeline::~CapturePipeline() {
+    stop();
+}
+
+bool CapturePipeline::start(std::unique_ptr<FrameSource> source) {
+    stop();
+    if (!source) return false;
+
+    m_source = std::move(source);
+    m_width = m_source->width();
+    m_height = m_source->height();
+    for (Frame& slot : m_slots) {
+        slot.pixels.assign(static_cast<std::size_t>(m_width) * m_height * 4, 0);
+        slot.width = m_width;
+        slot.height = m_height;
+    }
+    m_back = 0;
+    m_middle = 1;
+    m_front = 2;
+    m_captured = 0;
+    m_dropped = 0;
+    m_sourceDropped = 0;
+    m_displayed = 0;
+    m_latencyCount = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_errorMutex);
+        m_error.clear();
+    }
+
+    m_stopping = false;
+    m_running = true;
+    m_thread = std::thread(&CapturePipeline::captureLoop, this);
+    return true;
+}
+
+void CapturePipeline::stop() {
+    m_stopping = true;
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+    m_running = false;
+    m_source.reset();
+}
+
+void CapturePipeline::releaseBuffers() {
+    if (m_thread.joinable()) return;
+    for (Frame& slot : m_slots) {
+        std::vector<std::uint8_t>().swap(slot.pixels);
+    }
+    // No frame left for latest() to hand out
+    m_middle = 1;
+}
+
+std::size_t CapturePipeline::bufferBytes() const {
+    std::size_t bytes = 0;
+    for (const Frame& slot : m_slots) {
+        bytes += slot.pixels.capacity();
+    }
+    return bytes;
+}
+
+std::string CapturePipeline::error() const {
+    std::lock_guard<std::mutex> lock(m_errorMutex);
+    return m_error;
+}
+
+const Frame* CapturePipeline::latest() {
+    if (!(m_middle.load(std::memory_order_acquire) & Fresh)) return nullptr;
+    m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & ~Fresh;
+    return &m_slots[m_front];
+}
+
+void CapturePipeline::presented(const Frame& frame) {
+    double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frame.captured).count();
+    m_latencies[m_displayed % LatencySamples] = milliseconds;
+    m_latencyCount = std::min(m_latencyCount + 1, static_cast<std::size_t>(LatencySamples));
+    ++m_displayed;
+}
+
+CapturePipeline::Stats CapturePipeline::stats() const {
+    Stats stats;
+    stats.captured = m_captured;
+    stats.displayed = m_displayed;
+    stats.dropped = m_dropped;
+    stats.sourceDropped = m_sourceDropped;
+    if (m_latencyCount == 0) return stats;
+
+    std::array<double, LatencySamples> sorted = m_latencies;
+    double* end = sorted.data() + m_latencyCount;
+    double total = 0.0;
+    for (double* value = sorted.data(); value != end; ++value) {
+        total += *value;
+    }
+    stats.averageLatencyMilliseconds = total / static_cast<double>(m_latencyCount);
+    std::size_t p99 = m_latencyCount * 99 / 100;
+    std::nth_element(sorted.data(), sorted.data() + p99, end);
+    stats.p99LatencyMilliseconds = sorted[p99];
+    stats.maxLatencyMilliseconds = *std::max_element(sorted.data(), end);
+    return stats;
+}
+
+void CapturePipeline::addSink(FrameSink* sink) {
+    std::lock_guard<std::mutex> lock(m_sinksMutex);
+    if (std::find(m_sinks.begin(), m_sinks.end(), sink) == m_sinks.end()) m_sinks.push_back(sink);
+}
+
+void CapturePipeline::removeSink(FrameSink* sink) {
+    std::lock_guard<std::mutex> lock(m_sinksMutex);
+    m_sinks.erase(std::remove(m_sinks.begin(), m_sinks.end(), sink), m_sinks.end());
+}
+
+bool CapturePipeline::waitForFrameSlot(std::chrono::steady_clock::time_point lastRead) {
+    for (;;) {
+        if (m_stopping) return false;
+        unsigned int rate = m_maxFrameRate;
+        if (rate == 0) return true;
+        std::chrono::steady_clock::time_point due = lastRead + std::chrono::microseconds(1000000 / rate);
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        if (now >= due) return true;
+        // In slices, so stop() and a raised cap are noticed
+        std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, ReadTimeout));
+    }
+}
+
+void CapturePipeline::captureLoop() {
+    bool haveSequence = false;
+    std::uint64_t lastSequence = 0;
+    std::chrono::steady_clock::time_point lastRead;
+    while (!m_stopping) {
+        // A capped rate leaves the source to drop what comes in meanwhile,
+        // so no frame is converted or handed to sinks only to be skipped
+        if (!waitForFrameSlot(lastRead)) break;
+        Frame& frame = m_slots[m_back];
+        m_source->setConvertThreads(m_convertThreads);
+        if (!m_source->read(frame, ReadTimeout)) {
+            if (!m_source->error().empty()) {
+                std::lock_guard<std::mutex> lock(m_errorMutex);
+                m_error = m_source->error();
+                std::cerr << "Camera: capture stopped: " << m_error << std::endl;
+                break;
+            }
+            continue;
+        }
+
+        if (haveSequence && frame.sequence > lastSequence + 1) {
+            m_sourceDropped += frame.sequence - lastSequence - 1;
+        }
+        haveSequence = true;
+        lastSequence = frame.sequence;
+        lastRead = std::chrono::steady_clock::now();
+        ++m_captured;
+        {
+            // Sinks only copy the frame, so the lock is held briefly
+            std::lock_guard<std::mutex> lock(m_sinksMutex);
+            for (FrameSink* sink : m_sinks) sink->submit(frame);
+        }
+
+        unsigned int previous = m_middle.exchange(m_back | Fresh, std::memory_order_acq_rel);
+        if (previous & Fresh) ++m_dropped;
+        m_back = previous & ~Fresh;
+    }
+    m_running = false;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include "framesource.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs a FrameSource on its own thread and hands the newest frame to the
+// renderer.
+//
+// Frames pass through a triple buffer: the capture thread fills the back
+// slot and swaps it with the middle one, and the renderer swaps the middle
+// slot into the front when it holds a newer frame. Neither side ever waits
+// for the other, and a frame replaced before the renderer took it counts as
+// dropped. The three slots are allocated once in start(), so nothing is
+// allocated per frame.
+//
+// Sinks added with addSink() (the recorder, the motion detector) get every
+// captured frame, not only the displayed ones, straight from the capture
+// thread.
+//
+// latest(), presented() and stats() belong to the rendering thread.
+class CapturePipeline {
+public:
+    static const std::size_t LatencySamples = 256;
+
+    struct Stats {
+        std::uint64_t captured = 0;
+        std::uint64_t displayed = 0;
+        std::uint64_t dropped = 0;       // captured but replaced before being displayed
+        std::uint64_t sourceDropped = 0; // lost by the source (gaps in its numbering), which
+                                         // includes frames it produced while a rate cap held reads back
+        // Capture to display, over the last LatencySamples displayed frames
+        double averageLatencyMilliseconds = 0.0;
+        double p99LatencyMilliseconds = 0.0;
+        double maxLatencyMilliseconds = 0.0;
+    };
+
+    CapturePipeline() = default;
+    ~CapturePipeline();
+
+    CapturePipeline(const CapturePipeline&) = delete;
+    CapturePipeline& operator=(const CapturePipeline&) = delete;
+
+    bool start(std::unique_ptr<FrameSource> source);
+    void stop();
+    // Frees the frame slots of a stopped pipeline; start() allocates them again
+    void releaseBuffers();
+    std::size_t bufferBytes() const;
+    bool isRunning() const { return m_running; }
+    unsigned int width() const { return m_width; }
+    unsigned int height() const { return m_height; }
+    // Set when the source failed and capture ended by itself
+    std::string error() const;
+
+    // The newest frame the renderer has not seen yet, or nullptr. It stays
+    // valid and untouched until the next call.
+    const Frame* latest();
+    // Records the latency of a frame from latest() once it is on screen
+    void presented(const Frame& frame);
+    Stats stats() const;
+
+    // Reads at most `framesPerSecond` frames a second (0: as fast as the
+    // source delivers them). Can be changed while capture runs.
+    void setMaxFrameRate(unsigned int framesPerSecond) { m_maxFrameRate = framesPerSecond; }
+    // Caps the bands the source converts a frame in (see
+    // FrameSource::setConvertThreads()). Can be changed while capture runs.
+    void setConvertThreads(unsigned int threads) { m_convertThreads = threads; }
+
+    // Frames go to `sink` until it is removed, which must happen before
+    // the sink is stopped or destroyed
+    void addSink(FrameSink* sink);
+    void removeSink(FrameSink* sink);
+
+private:
+    static const unsigned int Fresh = 4; // set in m_middle when it holds an unseen frame
+
+    std::unique_ptr<FrameSource> m_source;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<unsigned int> m_maxFrameRate{0};
+    std::atomic<unsigned int> m_convertThreads{0};
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+
+    std::array<Frame, 3> m_slots;
+    unsigned int m_back = 0;              // capture thread only
+    std::atomic<unsigned int> m_middle{1};
+    unsigned int m_front = 2;             // renderer only
+
+    std::atomic<std::uint64_t> m_captured{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<std::uint64_t> m_sourceDropped{0};
+
+    std::mutex m_sinksMutex;
+    std::vector<FrameSink*> m_sinks;
+
+    mutable std::mutex m_errorMutex;
+    std::string m_error;
+
+    // Renderer side
+    std::uint64_t m_displayed = 0;
+    std::array<double, LatencySamples> m_latencies{};
+    std::size_t m_latencyCount = 0;
+
+    void captureLoop();
+    // Sleeps until the rate cap allows the read after the one at
+    // `lastRead`; false if capture is stopping
+    bool waitForFrameSlot(std::chrono::steady_clock::time_point lastRead);
+};
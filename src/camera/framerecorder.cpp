@@ -0,0 +1,303 @@
+#include "framerecorder.hpp"
+#include "../utils/imageencoder.hpp"
+#include <gdal_priv.h>
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+
+namespace {
+    const int DefaultPngLevel = 6;
+    const int FastestPngLevel = 1;
+    const int JpegQualityStep = 10;
+
+    // How long the queue has to stay short before quality goes back up
+    const std::chrono::milliseconds RaiseQualityAfter(1000);
+    const std::chrono::milliseconds LowerQualityEvery(250);
+    const std::chrono::milliseconds IdleWait(2);
+}
+
+FrameRecorder::~FrameRecorder() {
+    stop();
+}
+
+const char* FrameRecorder::formatName(Format format) {
+    switch (format) {
+    case Format::Raw: return "raw";
+    case Format::Png: return "png";
+    case Format::Mjpeg: return "mjpeg";
+    }
+    return "?";
+}
+
+bool FrameRecorder::parseFormat(const std::string& name, Format& format) {
+    for (Format candidate : {Format::Raw, Format::Png, Format::Mjpeg}) {
+        if (name == formatName(candidate)) {
+            format = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool FrameRecorder::start(const std::string& directory, unsigned int width, unsigned int height, const Options& options) {
+    stop();
+    m_options = options;
+    m_directory = directory;
+    m_error.clear();
+    m_width = width;
+    m_height = height;
+
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        m_error = "cannot create " + directory + ": " + error.message();
+        return false;
+    }
+    m_index = std::fopen((std::filesystem::path(directory) / "frames.csv").string().c_str(), "wb");
+    if (m_options.format != Format::Png) {
+        const char* name = m_options.format == Format::Raw ? "video.rgba" : "video.mjpeg";
+        m_video = std::fopen((std::filesystem::path(directory) / name).string().c_str(), "wb");
+    }
+    if (!m_index || (m_options.format != Format::Png && !m_video)) {
+        m_error = "cannot write to " + directory;
+        closeFiles();
+        return false;
+    }
+    std::fputs("sequence,captured_ms,offset,bytes,quality\n", m_index);
+    if (m_options.format != Format::Raw) {
+        GDALAllRegister();
+    }
+
+    m_slots.reset(new Slot[QueueFrames]);
+    m_filled.consume_all([](std::size_t) {});
+    m_free.consume_all([](std::size_t) {});
+    for (std::size_t i = 0; i < QueueFrames; ++i) {
+        m_slots[i].pixels.assign(static_cast<std::size_t>(width) * height * 4, 0);
+        m_free.push(i);
+    }
+    m_inFlight.clear();
+    m_toEncode.clear();
+    m_encoding = 0;
+    m_offset = 0;
+    m_quality = m_options.format == Format::Png ? DefaultPngLevel : m_options.format == Format::Mjpeg ? MaxJpegQuality : 0;
+    m_currentQuality = m_quality;
+    m_submitted = 0;
+    m_written = 0;
+    m_dropped = 0;
+    m_failed = 0;
+    m_bytesWritten = 0;
+    m_queueDepth = 0;
+    m_maxQueueDepth = 0;
+    m_megabytesPerSecond = 0.0;
+    m_started = Clock::now();
+    m_rateWindowStart = m_started;
+    m_rateWindowBytes = 0;
+    m_lastQualityChange = m_started;
+    m_shortSince = Clock::time_point::max();
+
+    m_encoders = CancellationToken();
+    m_stopping = false;
+    m_recording = true;
+    m_writer = std::thread(&FrameRecorder::writerLoop, this);
+    std::cout << "Recording " << width << "x" << height << " " << formatName(m_options.format) << " to " << directory << std::endl;
+    return true;
+}
+
+void FrameRecorder::stop() {
+    if (!m_writer.joinable()) return;
+    m_recording = false;
+    m_stopping = true;
+    m_writer.join();
+    // The writer saw every frame encoded; this waits for the tasks to return
+    m_encoders.wait();
+    closeFiles();
+
+    Stats summary = stats();
+    std::cout << "Recorded " << summary.written << " frames (" << summary.bytesWritten / (1024 * 1024) << " MB, "
+              << summary.averageMegabytesPerSecond << " MB/s), dropped " << summary.dropped << ", max queue depth "
+              << summary.maxQueueDepth << "/" << QueueFrames << std::endl;
+}
+
+bool FrameRecorder::submit(const Frame& frame) {
+    if (!m_recording || frame.width != m_width || frame.height != m_height) return false;
+    ++m_submitted;
+
+    std::size_t index;
+    if (!m_free.pop(index)) {
+        ++m_dropped;
+        return false;
+    }
+    Slot& slot = m_slots[index];
+    std::memcpy(slot.pixels.data(), frame.pixels.data(), slot.pixels.size());
+    slot.sequence = frame.sequence;
+    slot.captured = frame.captured;
+
+    std::size_t depth = ++m_queueDepth;
+    if (depth > m_maxQueueDepth) m_maxQueueDepth = depth;
+    m_filled.push(index);
+    return true;
+}
+
+FrameRecorder::Stats FrameRecorder::stats() const {
+    Stats stats;
+    stats.submitted = m_submitted;
+    stats.written = m_written;
+    stats.dropped = m_dropped;
+    stats.failed = m_failed;
+    stats.bytesWritten = m_bytesWritten;
+    stats.megabytesPerSecond = m_megabytesPerSecond;
+    double seconds = std::chrono::duration<double>(Clock::now() - m_started).count();
+    stats.averageMegabytesPerSecond = seconds > 0.0 ? stats.bytesWritten / (1024.0 * 1024.0) / seconds : 0.0;
+    stats.queueDepth = m_queueDepth;
+    stats.maxQueueDepth = m_maxQueueDepth;
+    stats.quality = m_currentQuality;
+    return stats;
+}
+
+void FrameRecorder::writerLoop() {
+    for (;;) {
+        // Start encoding what arrived, keeping capture order
+        std::size_t index;
+        while (m_filled.pop(index)) {
+            Slot& slot = m_slots[index];
+            slot.quality = m_quality;
+            slot.done = false;
+            m_inFlight.push_back(index);
+            if (m_options.format == Format::Raw) {
+                slot.done = true;
+            } else {
+                m_toEncode.push_back(index);
+            }
+        }
+        const unsigned int maxEncoding = m_options.encoderThreads;
+        while (!m_toEncode.empty() && (maxEncoding == 0 || m_encoding < maxEncoding)) {
+            Slot& slot = m_slots[m_toEncode.front()];
+            m_toEncode.pop_front();
+            ++m_encoding;
+            TaskScheduler::instance().submit(TaskScheduler::Priority::Normal, m_encoders, [this, &slot] { encode(slot); });
+        }
+
+        // Write whatever is finished at the front, in order
+        bool wrote = false;
+        while (!m_inFlight.empty() && m_slots[m_inFlight.front()].done) {
+            std::size_t front = m_inFlight.front();
+            m_inFlight.pop_front();
+            if (write(m_slots[front])) {
+                ++m_written;
+            } else {
+                ++m_failed;
+            }
+            --m_queueDepth;
+            m_free.push(front);
+            wrote = true;
+        }
+
+        if (m_options.backpressure == Backpressure::LowerQuality) {
+            adjustQuality();
+        }
+        if (m_stopping && m_inFlight.empty() && m_filled.empty()) break;
+
+        if (!wrote) {
+            std::unique_lock<std::mutex> lock(m_encodedMutex);
+            m_encodedSignal.wait_for(lock, IdleWait, [this] {
+                return !m_inFlight.empty() && m_slots[m_inFlight.front()].done;
+            });
+        }
+    }
+}
+
+void FrameRecorder::encode(Slot& slot) {
+    slot.encoded.clear();
+    slot.ok = m_options.format == Format::Png
+                  ? imageencoder::encodePng(slot.pixels.data(), m_width, m_height, slot.encoded, slot.quality)
+                  : imageencoder::encodeJpeg(slot.pixels.data(), m_width, m_height, slot.quality, slot.encoded);
+    {
+        std::lock_guard<std::mutex> lock(m_encodedMutex);
+        --m_encoding;
+        slot.done = true;
+    }
+    m_encodedSignal.notify_one();
+}
+
+bool FrameRecorder::write(Slot& slot) {
+    const bool raw = m_options.format == Format::Raw;
+    if (!raw && !slot.ok) return false;
+    const std::uint8_t* data = raw ? slot.pixels.data() : slot.encoded.data();
+    const std::size_t size = raw ? slot.pixels.size() : slot.encoded.size();
+
+    std::uint64_t offset = 0;
+    bool ok;
+    if (m_options.format == Format::Png) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "frame_%06llu.png", static_cast<unsigned long long>(m_written.load()));
+        std::FILE* file = std::fopen((std::filesystem::path(m_directory) / name).string().c_str(), "wb");
+        ok = file && std::fwrite(data, 1, size, file) == size;
+        if (file) ok = std::fclose(file) == 0 && ok;
+    } else {
+        offset = m_offset;
+        ok = std::fwrite(data, 1, size, m_video) == size;
+        m_offset += size;
+    }
+    if (!ok) {
+        std::cerr << "Recording: write failed in " << m_directory << std::endl;
+        return false;
+    }
+
+    double capturedMilliseconds = std::chrono::duration<double, std::milli>(slot.captured - m_started).count();
+    std::fprintf(m_index, "%llu,%.3f,%llu,%llu,%d\n", static_cast<unsigned long long>(slot.sequence), capturedMilliseconds,
+                 static_cast<unsigned long long>(offset), static_cast<unsigned long long>(size), raw ? 0 : slot.quality);
+    m_bytesWritten += size;
+    m_rateWindowBytes += size;
+
+    Clock::time_point now = Clock::now();
+    double windowSeconds = std::chrono::duration<double>(now - m_rateWindowStart).count();
+    if (windowSeconds >= 1.0) {
+        m_megabytesPerSecond = m_rateWindowBytes / (1024.0 * 1024.0) / windowSeconds;
+        m_rateWindowStart = now;
+        m_rateWindowBytes = 0;
+    }
+
+    // Stand-in for a slow disk: wait until the average rate is back under the cap
+    if (m_options.maxMegabytesPerSecond > 0.0) {
+        double due = m_bytesWritten / (1024.0 * 1024.0) / m_options.maxMegabytesPerSecond;
+        std::this_thread::sleep_until(m_started + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(due)));
+    }
+    return true;
+}
+
+void FrameRecorder::adjustQuality() {
+    if (m_options.format == Format::Raw) return;
+
+    // Decided on the queue depth: above three quarters the encoders or the
+    // disk are behind, at a quarter or less they have room to spare
+    Clock::time_point now = Clock::now();
+    std::size_t depth = m_queueDepth;
+    const bool png = m_options.format == Format::Png;
+    const int lowest = png ? FastestPngLevel : MinJpegQuality;
+    const int highest = png ? DefaultPngLevel : MaxJpegQuality;
+
+    if (depth > QueueFrames * 3 / 4) {
+        if (m_quality > lowest && now - m_lastQualityChange >= LowerQualityEvery) {
+            m_quality = png ? lowest : std::max(lowest, m_quality - JpegQualityStep);
+            m_lastQualityChange = now;
+        }
+        m_shortSince = Clock::time_point::max();
+    } else if (depth <= QueueFrames / 4) {
+        if (m_shortSince == Clock::time_point::max()) m_shortSince = now;
+        if (m_quality < highest && now - m_shortSince >= RaiseQualityAfter && now - m_lastQualityChange >= RaiseQualityAfter) {
+            m_quality = png ? highest : std::min(highest, m_quality + JpegQualityStep / 2);
+            m_lastQualityChange = now;
+        }
+    } else {
+        m_shortSince = Clock::time_point::max();
+    }
+    m_currentQuality = m_quality;
+}
+
+void FrameRecorder::closeFiles() {
+    if (m_video) std::fclose(m_video);
+    if (m_index) std::fclose(m_index);
+    m_video = nullptr;
+    m_index = nullptr;
+}
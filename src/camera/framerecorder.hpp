@@ -0,0 +1,150 @@
+#pragma once
+
+#include "framesource.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Writes captured frames to disk without ever making the caller wait.
+//
+// submit() copies a frame into one of QueueFrames preallocated slots and
+// passes the slot through a lock-free queue to the writer thread. Slots
+// come back through a second queue, so the caller never allocates or
+// blocks. When all slots are taken, the frame is dropped and counted.
+//
+// The writer hands frames to the TaskScheduler for encoding, at Normal
+// priority, and writes the results in order; only the file writes have a
+// thread of their own. With Backpressure::LowerQuality, a queue that keeps
+// filling lowers the JPEG quality (or the PNG compression effort) before
+// any frame has to be dropped, and raises it again once the disk keeps up.
+//
+// Output goes into one directory:
+//   Raw    video.rgba, frames back to back (width * height * 4 bytes each)
+//   Png    frame_000000.png, ...
+//   Mjpeg  video.mjpeg, concatenated JPEG images (plays with ffplay -f mjpeg)
+// plus frames.csv with the sequence number, capture time, file offset, size
+// and quality of every frame.
+class FrameRecorder : public FrameSink {
+public:
+    enum class Format { Raw, Png, Mjpeg };
+    enum class Backpressure { DropFrames, LowerQuality };
+
+    static const std::size_t QueueFrames = 16;
+    static const int MaxJpegQuality = 90;
+    static const int MinJpegQuality = 40;
+
+    struct Options {
+        Format format = Format::Mjpeg;
+        Backpressure backpressure = Backpressure::LowerQuality;
+        unsigned int encoderThreads = 0; // frames encoding at once, 0: no cap beyond the scheduler's workers
+        // Caps the write rate, to try backpressure without a slow disk; 0 is unlimited
+        double maxMegabytesPerSecond = 0.0;
+    };
+
+    struct Stats {
+        std::uint64_t submitted = 0;
+        std::uint64_t written = 0;
+        std::uint64_t dropped = 0;   // no free slot when submitted
+        std::uint64_t failed = 0;    // encoding or writing failed
+        std::uint64_t bytesWritten = 0;
+        double megabytesPerSecond = 0.0;        // over the last second
+        double averageMegabytesPerSecond = 0.0; // since start()
+        std::size_t queueDepth = 0;             // frames waiting or being encoded
+        std::size_t maxQueueDepth = 0;
+        int quality = 0;                        // JPEG quality or PNG zlib level now in use
+    };
+
+    FrameRecorder() = default;
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    // Creates `directory` and allocates the slots for frames of this size
+    bool start(const std::string& directory, unsigned int width, unsigned int height, const Options& options);
+    // Writes what is queued, then closes the files
+    void stop();
+    bool isRecording() const { return m_recording; }
+    const std::string& directory() const { return m_directory; }
+    const std::string& error() const { return m_error; }
+
+    // Never blocks. Returns false if the frame was dropped.
+    bool submit(const Frame& frame) override;
+    Stats stats() const;
+
+    static const char* formatName(Format format);
+    // "raw", "png" or "mjpeg"; false for anything else
+    static bool parseFormat(const std::string& name, Format& format);
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Slot {
+        std::vector<std::uint8_t> pixels;
+        std::vector<std::uint8_t> encoded;
+        std::uint64_t sequence = 0;
+        Clock::time_point captured;
+        int quality = 0;
+        bool ok = false;
+        std::atomic<bool> done{false};
+    };
+
+    Options m_options;
+    std::string m_directory;
+    std::string m_error;
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    std::atomic<bool> m_recording{false};
+    std::atomic<bool> m_stopping{false};
+    Clock::time_point m_started;
+
+    std::unique_ptr<Slot[]> m_slots;
+    // Caller -> writer: filled slots; writer -> caller: free slots
+    boost::lockfree::spsc_queue<std::size_t, boost::lockfree::capacity<QueueFrames + 1>> m_filled;
+    boost::lockfree::spsc_queue<std::size_t, boost::lockfree::capacity<QueueFrames + 1>> m_free;
+
+    std::thread m_writer;
+    CancellationToken m_encoders; // encode tasks, waited for by stop()
+    std::atomic<unsigned int> m_encoding{0};
+    std::mutex m_encodedMutex;
+    std::condition_variable m_encodedSignal;
+
+    // Writer thread only
+    std::deque<std::size_t> m_inFlight; // in capture order
+    std::deque<std::size_t> m_toEncode; // not handed to the scheduler yet
+    std::FILE* m_video = nullptr;
+    std::FILE* m_index = nullptr;
+    std::uint64_t m_offset = 0;
+    int m_quality = 0;
+    Clock::time_point m_lastQualityChange;
+    Clock::time_point m_shortSince; // queue short since then; max() while it is not
+    Clock::time_point m_rateWindowStart;
+    std::uint64_t m_rateWindowBytes = 0;
+
+    std::atomic<std::uint64_t> m_submitted{0};
+    std::atomic<std::uint64_t> m_written{0};
+    std::atomic<std::uint64_t> m_dropped{0};
+    std::atomic<std::uint64_t> m_failed{0};
+    std::atomic<std::uint64_t> m_bytesWritten{0};
+    std::atomic<std::size_t> m_queueDepth{0};
+    std::atomic<std::size_t> m_maxQueueDepth{0};
+    std::atomic<int> m_currentQuality{0};
+    std::atomic<double> m_megabytesPerSecond{0.0};
+
+    void writerLoop();
+    void encode(Slot& slot);
+    bool write(Slot& slot);
+    void adjustQuality();
+    void closeFiles();
+};
@@ -0,0 +1,161 @@
+#include "framesource.hpp"
+#include "v4l2source.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const unsigned int DefaultWidth = 640;
+    const unsigned int DefaultHeight = 480;
+    const double DefaultFramesPerSecond = 30.0;
+
+    Clock::duration frameInterval(double framesPerSecond) {
+        return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / std::max(1.0, framesPerSecond)));
+    }
+
+    // Sleeps until `next` unless that is past the timeout; keeps the rate steady
+    bool waitForFrame(Clock::time_point& next, Clock::duration interval, std::chrono::milliseconds timeout) {
+        Clock::time_point now = Clock::now();
+        if (next > now + timeout) {
+            std::this_thread::sleep_for(timeout);
+            return false;
+        }
+        std::this_thread::sleep_until(next);
+        // After a stall, restart the schedule rather than catching up with a burst
+        next = std::max(next + interval, Clock::now());
+        return true;
+    }
+
+    // "pattern:640x480@30"; missing parts keep their defaults
+    void parsePatternSpec(const std::string& spec, unsigned int& width, unsigned int& height, double& framesPerSecond) {
+        std::size_t colon = spec.find(':');
+        if (colon == std::string::npos) return;
+        unsigned int w = 0, h = 0;
+        double fps = 0.0;
+        const char* text = spec.c_str() + colon + 1;
+        char* end = nullptr;
+        w = static_cast<unsigned int>(std::strtoul(text, &end, 10));
+        if (*end == 'x') h = static_cast<unsigned int>(std::strtoul(end + 1, &end, 10));
+        if (*end == '@') fps = std::strtod(end + 1, &end);
+        if (w >= 2 && h >= 1) {
+            width = w & ~1u;
+            height = h;
+        }
+        if (fps > 0.0) framesPerSecond = fps;
+    }
+}
+
+PatternSource::PatternSource(unsigned int width, unsigned int height, double framesPerSecond)
+    : m_interval(frameInterval(framesPerSecond)),
+      m_next(Clock::now())
+{
+    m_width = width;
+    m_height = height;
+    m_name = "pattern " + std::to_string(width) + "x" + std::to_string(height);
+}
+
+bool PatternSource::read(Frame& frame, std::chrono::milliseconds timeout) {
+    if (!waitForFrame(m_next, m_interval, timeout)) return false;
+
+    // Diagonal colour bands that drift with the frame number, and a white
+    // bar sweeping across so that tearing or stale frames are easy to spot
+    const unsigned int shift = static_cast<unsigned int>(m_sequence * 4);
+    const unsigned int bar = static_cast<unsigned int>(m_sequence * 8 % m_width);
+    std::uint8_t* out = frame.pixels.data();
+    for (unsigned int y = 0; y < m_height; ++y) {
+        for (unsigned int x = 0; x < m_width; ++x, out += 4) {
+            unsigned int band = x + y + shift;
+            bool onBar = x >= bar && x < bar + 16;
+            out[0] = onBar ? 255 : static_cast<std::uint8_t>(band);
+            out[1] = onBar ? 255 : static_cast<std::uint8_t>(band * 2 + 85);
+            out[2] = onBar ? 255 : static_cast<std::uint8_t>(255 - band);
+            out[3] = 255;
+        }
+    }
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.sequence = m_sequence++;
+    frame.captured = Clock::now();
+    return true;
+}
+
+ImageSource::ImageSource(const std::string& path, double framesPerSecond)
+    : m_interval(frameInterval(framesPerSecond)),
+      m_next(Clock::now())
+{
+    m_name = path;
+
+    std::vector<std::string> files;
+    std::error_code error;
+    if (std::filesystem::is_directory(path, error)) {
+        for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+            if (entry.is_regular_file(error)) files.push_back(entry.path().string());
+        }
+        std::sort(files.begin(), files.end());
+    } else {
+        files.push_back(path);
+    }
+
+    for (const std::string& file : files) {
+        sf::Image image;
+        if (!image.loadFromFile(file)) continue;
+        if (m_images.empty()) {
+            m_width = image.getSize().x;
+            m_height = image.getSize().y;
+        } else if (image.getSize().x != m_width || image.getSize().y != m_height) {
+            std::cerr << "Camera: skipping " << file << ", its size differs from the first image" << std::endl;
+            continue;
+        }
+        const std::uint8_t* pixels = image.getPixelsPtr();
+        m_images.emplace_back(pixels, pixels + static_cast<std::size_t>(m_width) * m_height * 4);
+    }
+    if (m_images.empty()) {
+        m_error = path + ": no readable images";
+    }
+}
+
+bool ImageSource::read(Frame& frame, std::chrono::milliseconds timeout) {
+    if (m_images.empty() || !waitForFrame(m_next, m_interval, timeout)) return false;
+
+    const std::vector<std::uint8_t>& image = m_images[m_sequence % m_images.size()];
+    std::memcpy(frame.pixels.data(), image.data(), image.size());
+    frame.width = m_width;
+    frame.height = m_height;
+    frame.sequence = m_sequence++;
+    frame.captured = Clock::now();
+    return true;
+}
+
+std::unique_ptr<FrameSource> createFrameSource(const std::string& spec) {
+    std::unique_ptr<FrameSource> source;
+    if (spec.compare(0, 7, "pattern") == 0) {
+        unsigned int width = DefaultWidth;
+        unsigned int height = DefaultHeight;
+        double framesPerSecond = DefaultFramesPerSecond;
+        parsePatternSpec(spec, width, height, framesPerSecond);
+        source = std::make_unique<PatternSource>(width, height, framesPerSecond);
+    } else if (spec.compare(0, 5, "/dev/") == 0) {
+        source = std::make_unique<V4L2Source>(spec, DefaultWidth, DefaultHeight);
+    } else {
+        source = std::make_unique<ImageSource>(spec, DefaultFramesPerSecond);
+    }
+
+    if (!source->error().empty() || source->width() == 0 || source->height() == 0) {
+        std::cerr << "Camera: cannot open " << spec << (source->error().empty() ? "" : ": " + source->error()) << std::endl;
+        return nullptr;
+    }
+    return source;
+}
+
+std::string defaultFrameSource() {
+    const char* source = std::getenv("CAMERA_SOURCE");
+    if (source && *source) return source;
+    std::error_code error;
+    return std::filesystem::exists("/dev/video0", error) ? "/dev/video0" : "pattern";
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// One captured image as packed RGBA8 rows (width * 4 bytes each).
+struct Frame {
+    // Sized once when capture starts; sources write into it in place
+    std::vector<std::uint8_t> pixels;
+    unsigned int width = 0;
+    unsigned int height = 0;
+    // Numbered by the source; a gap means the source itself lost frames
+    std::uint64_t sequence = 0;
+    std::chrono::steady_clock::time_point captured;
+};
+
+// Receives every captured frame on the capture thread (see
+// CapturePipeline::addSink). submit() must not block; a sink that cannot
+// take the frame right away drops it and returns false.
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+    virtual bool submit(const Frame& frame) = 0;
+};
+
+// Produces frames on the capture thread. Sources are opened by
+// createFrameSource() and report their size before the first read().
+class FrameSource {
+public:
+    virtual ~FrameSource() = default;
+
+    // Waits up to `timeout` for the next frame and writes it into `frame`,
+    // whose pixels already hold width() * height() * 4 bytes. Returns false
+    // if no frame arrived; error() is set if none ever will.
+    virtual bool read(Frame& frame, std::chrono::milliseconds timeout) = 0;
+
+    unsigned int width() const { return m_width; }
+    unsigned int height() const { return m_height; }
+    const std::string& name() const { return m_name; }
+    const std::string& error() const { return m_error; }
+
+    // Bands a source that converts pixels splits each frame into, 0: one
+    // per active scheduler worker. Set on the capture thread.
+    void setConvertThreads(unsigned int threads) { m_convertThreads = threads; }
+
+protected:
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    unsigned int m_convertThreads = 0;
+    std::string m_name;
+    std::string m_error;
+};
+
+// Moving colour bars at a fixed rate, for running without a camera.
+class PatternSource : public FrameSource {
+public:
+    PatternSource(unsigned int width, unsigned int height, double framesPerSecond);
+    bool read(Frame& frame, std::chrono::milliseconds timeout) override;
+
+private:
+    std::chrono::steady_clock::duration m_interval;
+    std::chrono::steady_clock::time_point m_next;
+    std::uint64_t m_sequence = 0;
+};
+
+// Replays an image file, or every image in a directory in name order, at a
+// fixed rate. Images are decoded up front and must all have the same size.
+class ImageSource : public FrameSource {
+public:
+    ImageSource(const std::string& path, double framesPerSecond);
+    bool read(Frame& frame, std::chrono::milliseconds timeout) override;
+
+private:
+    std::vector<std::vector<std::uint8_t>> m_images;
+    std::chrono::steady_clock::duration m_interval;
+    std::chrono::steady_clock::time_point m_next;
+    std::uint64_t m_sequence = 0;
+};
+
+// Picks the backend from `spec`:
+//   "pattern" or "pattern:640x480@30"  synthetic frames
+//   "/dev/videoN"                      V4L2 device (Linux)
+//   anything else                      image file or directory of images
+// Returns nullptr (and logs why) if the source cannot be opened.
+std::unique_ptr<FrameSource> createFrameSource(const std::string& spec);
+
+// CAMERA_SOURCE if set, else /dev/video0 if it exists, else "pattern"
+std::string defaultFrameSource();
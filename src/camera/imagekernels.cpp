@@ -0,0 +1,718 @@
+#include "imagekernels.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define IMAGEKERNELS_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang compile each SIMD function for its own instruction set, so the
+// rest of the program does not need -mavx2; MSVC accepts the intrinsics as is
+#if defined(__GNUC__) || defined(__clang__)
+#define KERNEL_TARGET(isa) __attribute__((target(isa)))
+#else
+#define KERNEL_TARGET(isa)
+#endif
+
+namespace imagekernels {
+namespace {
+    // Bands smaller than this cost more to hand out than they save
+    const unsigned int MinBandRows = 16;
+
+    // Runs function(firstRow, endRow) over [0, rows), split into bands
+    template <typename Function>
+    void forEachBand(const Bands& bands, unsigned int rows, const Function& function) {
+        unsigned int count = 1;
+        if (bands.scheduler) {
+            count = std::min(bands.limit ? bands.limit : bands.scheduler->activeWorkers(), rows / MinBandRows);
+        }
+        if (count < 2) {
+            function(0u, rows);
+            return;
+        }
+
+        bands.scheduler->parallelFor(bands.priority, count, [&](std::size_t band) {
+            unsigned int begin = static_cast<unsigned int>(static_cast<std::uint64_t>(rows) * band / count);
+            unsigned int end = static_cast<unsigned int>(static_cast<std::uint64_t>(rows) * (band + 1) / count);
+            function(begin, end);
+        });
+    }
+
+    // Scalar reference. The YUV arithmetic mirrors the 16-bit vector lanes
+    // step by step, saturation included, so every path agrees exactly:
+    // 6-bit fixed point coefficients (1.164, 1.596, 0.391, 0.813, 2.018).
+
+    inline int saturate16(int value) {
+        return value < -32768 ? -32768 : (value > 32767 ? 32767 : value);
+    }
+
+    inline std::uint8_t clampByte(int value) {
+        return static_cast<std::uint8_t>(value < 0 ? 0 : (value > 255 ? 255 : value));
+    }
+
+    inline void yuvToRgba(int y, int u, int v, std::uint8_t* out) {
+        int luma = (y - 16) * 74;
+        u -= 128;
+        v -= 128;
+        out[0] = clampByte(saturate16(saturate16(luma + v * 102) + 32) >> 6);
+        out[1] = clampByte(saturate16(saturate16(saturate16(luma - u * 25) - v * 52) + 32) >> 6);
+        out[2] = clampByte(saturate16(saturate16(luma + u * 129) + 32) >> 6);
+        out[3] = 255;
+    }
+
+    void yuyvRowScalar(const std::uint8_t* in, std::uint8_t* out, unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x + 1 < width; x += 2) {
+            const std::uint8_t* pair = in + x * 2;
+            yuvToRgba(pair[0], pair[1], pair[3], out + x * 4);
+            yuvToRgba(pair[2], pair[1], pair[3], out + x * 4 + 4);
+        }
+    }
+
+    void nv12RowScalar(const std::uint8_t* luma, const std::uint8_t* chroma, std::uint8_t* out, unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x < width; ++x) {
+            const std::uint8_t* uv = chroma + (x & ~1u);
+            yuvToRgba(luma[x], uv[0], uv[1], out + x * 4);
+        }
+    }
+
+    void grayRowScalar(const std::uint8_t* in, std::uint8_t* out, unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x < width; ++x) {
+            const std::uint8_t* pixel = in + x * 4;
+            out[x] = static_cast<std::uint8_t>((77 * pixel[0] + 150 * pixel[1] + 29 * pixel[2] + 128) >> 8);
+        }
+    }
+
+    // Background in 12.4 fixed point, so a slow learning rate still moves it.
+    // The shift is arithmetic, as in the vector lanes.
+    void backgroundRowScalar(const std::uint8_t* gray, std::uint16_t* background, std::uint8_t* difference,
+                             unsigned int shift, unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x < width; ++x) {
+            int delta = (gray[x] << 4) - background[x];
+            difference[x] = clampByte(((delta < 0 ? -delta : delta) + 8) >> 4);
+            background[x] = static_cast<std::uint16_t>(background[x] + (delta >> shift));
+        }
+    }
+
+    // Vertical pass of the scaler: two source rows blended into 16-bit sums
+    void blendRowsScalar(const std::uint8_t* top, const std::uint8_t* bottom, unsigned int weight, std::uint16_t* out,
+                         unsigned int begin, unsigned int count) {
+        for (unsigned int i = begin; i < count; ++i) {
+            out[i] = static_cast<std::uint16_t>(top[i] * (256 - weight) + bottom[i] * weight);
+        }
+    }
+
+    struct Tap {
+        unsigned int left;  // byte offset of the left source pixel
+        unsigned int right;
+        unsigned int weight; // of the right pixel, out of 256
+    };
+
+    // Horizontal pass: pick and blend two pixels of the 16-bit row
+    void filterRowScalar(const std::uint16_t* row, const Tap* taps, std::uint8_t* out, unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x < width; ++x) {
+            const Tap& tap = taps[x];
+            for (unsigned int c = 0; c < 4; ++c) {
+                std::uint32_t sum = row[tap.left + c] * (256 - tap.weight) + row[tap.right + c] * tap.weight;
+                out[x * 4 + c] = static_cast<std::uint8_t>((sum + 32768) >> 16);
+            }
+        }
+    }
+
+    // Grid sampling stays in float and always computes a + (b - a) * weight
+    // in this order, which keeps the paths identical
+    inline float lerp(float a, float b, float weight) {
+        return a + (b - a) * weight;
+    }
+
+    struct GridTaps {
+        std::vector<std::int32_t> left;  // cell index, or the NaN past the end of the row when off the grid
+        std::vector<std::int32_t> right;
+        std::vector<float> weight;       // of the right cell
+    };
+
+    inline std::uint32_t rampColor(float value, const ColorRamp& ramp, float scale) {
+        if (value != value) return 0;
+        float index = std::min(std::max((value - ramp.minValue) * scale, 0.f), 255.f);
+        return ramp.colors[static_cast<int>(index)];
+    }
+
+    void blendGridRowsScalar(const float* top, const float* bottom, float weight, float* out, unsigned int begin, unsigned int count) {
+        for (unsigned int i = begin; i < count; ++i) {
+            out[i] = lerp(top[i], bottom[i], weight);
+        }
+    }
+
+    void colorGridRowScalar(const float* row, const GridTaps& taps, const ColorRamp& ramp, float scale, std::uint8_t* out,
+                            unsigned int begin, unsigned int width) {
+        for (unsigned int x = begin; x < width; ++x) {
+            std::uint32_t color = rampColor(lerp(row[taps.left[x]], row[taps.right[x]], taps.weight[x]), ramp, scale);
+            std::memcpy(out + x * 4, &color, 4);
+        }
+    }
+
+#ifdef IMAGEKERNELS_X86
+    // SSE4.1: eight pixels per step. y16 holds Y as 16-bit lanes and
+    // uv16 the U V pairs that go with them (U0 V0 U1 V1 ...).
+
+    KERNEL_TARGET("sse4.1") inline void yuvToRgba8(__m128i y16, __m128i uv16, std::uint8_t* out) {
+        const __m128i uShuffle = _mm_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+        const __m128i vShuffle = _mm_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+        const __m128i round = _mm_set1_epi16(32);
+        __m128i luma = _mm_mullo_epi16(_mm_sub_epi16(y16, _mm_set1_epi16(16)), _mm_set1_epi16(74));
+        __m128i u = _mm_sub_epi16(_mm_shuffle_epi8(uv16, uShuffle), _mm_set1_epi16(128));
+        __m128i v = _mm_sub_epi16(_mm_shuffle_epi8(uv16, vShuffle), _mm_set1_epi16(128));
+
+        __m128i r = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(v, _mm_set1_epi16(102))), round), 6);
+        __m128i g = _mm_srai_epi16(_mm_adds_epi16(_mm_subs_epi16(_mm_subs_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(25))),
+                                                                 _mm_mullo_epi16(v, _mm_set1_epi16(52))), round), 6);
+        __m128i b = _mm_srai_epi16(_mm_adds_epi16(_mm_adds_epi16(luma, _mm_mullo_epi16(u, _mm_set1_epi16(129))), round), 6);
+
+        __m128i rg = _mm_unpacklo_epi8(_mm_packus_epi16(r, r), _mm_packus_epi16(g, g));
+        __m128i ba = _mm_unpacklo_epi8(_mm_packus_epi16(b, b), _mm_set1_epi8(-1));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out), _mm_unpacklo_epi16(rg, ba));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + 16), _mm_unpackhi_epi16(rg, ba));
+    }
+
+    KERNEL_TARGET("sse4.1") void yuyvRowSse41(const std::uint8_t* in, std::uint8_t* out, unsigned int width) {
+        const __m128i lowBytes = _mm_set1_epi16(0x00FF);
+        unsigned int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i pixels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 2));
+            yuvToRgba8(_mm_and_si128(pixels, lowBytes), _mm_srli_epi16(pixels, 8), out + x * 4);
+        }
+        yuyvRowScalar(in, out, x, width);
+    }
+
+    KERNEL_TARGET("sse4.1") void nv12RowSse41(const std::uint8_t* luma, const std::uint8_t* chroma, std::uint8_t* out, unsigned int width) {
+        unsigned int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i y16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(luma + x)));
+            __m128i uv16 = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(chroma + x)));
+            yuvToRgba8(y16, uv16, out + x * 4);
+        }
+        nv12RowScalar(luma, chroma, out, x, width);
+    }
+
+    // 16-bit arithmetic wraps, but no weighted sum exceeds 65535, so the
+    // unsigned results are exact
+    KERNEL_TARGET("sse4.1") inline __m128i graySums4(__m128i pixels, __m128i weights) {
+        __m128i low = _mm_mullo_epi16(_mm_cvtepu8_epi16(pixels), weights);
+        __m128i high = _mm_mullo_epi16(_mm_unpackhi_epi8(pixels, _mm_setzero_si128()), weights);
+        return _mm_hadd_epi16(low, high); // two partial sums per pixel
+    }
+
+    KERNEL_TARGET("sse4.1") void grayRowSse41(const std::uint8_t* in, std::uint8_t* out, unsigned int width) {
+        const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+        const __m128i round = _mm_set1_epi16(128);
+        unsigned int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i first = graySums4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 4)), weights);
+            __m128i second = graySums4(_mm_loadu_si128(reinterpret_cast<const __m128i*>(in + x * 4 + 16)), weights);
+            __m128i sums = _mm_srli_epi16(_mm_add_epi16(_mm_hadd_epi16(first, second), round), 8);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x), _mm_packus_epi16(sums, sums));
+        }
+        grayRowScalar(in, out, x, width);
+    }
+
+    KERNEL_TARGET("sse4.1") void backgroundRowSse41(const std::uint8_t* gray, std::uint16_t* background, std::uint8_t* difference,
+                                                    unsigned int shift, unsigned int width) {
+        const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+        const __m128i round = _mm_set1_epi16(8);
+        unsigned int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m128i pixels = _mm_slli_epi16(_mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(gray + x))), 4);
+            __m128i model = _mm_loadu_si128(reinterpret_cast<const __m128i*>(background + x));
+            __m128i delta = _mm_sub_epi16(pixels, model);
+            __m128i absolute = _mm_srli_epi16(_mm_add_epi16(_mm_abs_epi16(delta), round), 4);
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(difference + x), _mm_packus_epi16(absolute, absolute));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(background + x), _mm_add_epi16(model, _mm_sra_epi16(delta, count)));
+        }
+        backgroundRowScalar(gray, background, difference, shift, x, width);
+    }
+
+    KERNEL_TARGET("sse4.1") void blendRowsSse41(const std::uint8_t* top, const std::uint8_t* bottom, unsigned int weight,
+                                                std::uint16_t* out, unsigned int count) {
+        const __m128i topWeight = _mm_set1_epi16(static_cast<short>(256 - weight));
+        const __m128i bottomWeight = _mm_set1_epi16(static_cast<short>(weight));
+        unsigned int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(top + i)));
+            __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(bottom + i)));
+            __m128i sum = _mm_add_epi16(_mm_mullo_epi16(a, topWeight), _mm_mullo_epi16(b, bottomWeight));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), sum);
+        }
+        blendRowsScalar(top, bottom, weight, out, i, count);
+    }
+
+    KERNEL_TARGET("sse4.1") void filterRowSse41(const std::uint16_t* row, const Tap* taps, std::uint8_t* out, unsigned int width) {
+        const __m128i round = _mm_set1_epi32(32768);
+        for (unsigned int x = 0; x < width; ++x) {
+            const Tap& tap = taps[x];
+            __m128i left = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + tap.left)));
+            __m128i right = _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + tap.right)));
+            __m128i sum = _mm_add_epi32(_mm_mullo_epi32(left, _mm_set1_epi32(static_cast<int>(256 - tap.weight))),
+                                        _mm_mullo_epi32(right, _mm_set1_epi32(static_cast<int>(tap.weight))));
+            __m128i pixel = _mm_srli_epi32(_mm_add_epi32(sum, round), 16);
+            pixel = _mm_packus_epi16(_mm_packus_epi32(pixel, pixel), pixel);
+            int value = _mm_cvtsi128_si32(pixel);
+            std::memcpy(out + x * 4, &value, 4);
+        }
+    }
+
+    KERNEL_TARGET("sse4.1") void blendGridRowsSse41(const float* top, const float* bottom, float weight, float* out, unsigned int count) {
+        const __m128 factor = _mm_set1_ps(weight);
+        unsigned int i = 0;
+        for (; i + 4 <= count; i += 4) {
+            __m128 a = _mm_loadu_ps(top + i);
+            __m128 b = _mm_loadu_ps(bottom + i);
+            _mm_storeu_ps(out + i, _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), factor)));
+        }
+        blendGridRowsScalar(top, bottom, weight, out, i, count);
+    }
+
+    KERNEL_TARGET("sse4.1") void colorGridRowSse41(const float* row, const GridTaps& taps, const ColorRamp& ramp, float scale,
+                                                   std::uint8_t* out, unsigned int width) {
+        const std::int32_t* left = taps.left.data();
+        const std::int32_t* right = taps.right.data();
+        const __m128 minimum = _mm_set1_ps(ramp.minValue);
+        const __m128 factor = _mm_set1_ps(scale);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 last = _mm_set1_ps(255.f);
+        const int* colors = reinterpret_cast<const int*>(ramp.colors);
+        unsigned int x = 0;
+        for (; x + 4 <= width; x += 4) {
+            __m128 a = _mm_setr_ps(row[left[x]], row[left[x + 1]], row[left[x + 2]], row[left[x + 3]]);
+            __m128 b = _mm_setr_ps(row[right[x]], row[right[x + 1]], row[right[x + 2]], row[right[x + 3]]);
+            __m128 value = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_loadu_ps(taps.weight.data() + x)));
+            // max() returns its second operand for NaN, so no-data lanes read entry 0 and are masked out below
+            __m128i index = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(value, minimum), factor), zero), last));
+            __m128i color = _mm_setr_epi32(colors[_mm_extract_epi32(index, 0)], colors[_mm_extract_epi32(index, 1)],
+                                           colors[_mm_extract_epi32(index, 2)], colors[_mm_extract_epi32(index, 3)]);
+            color = _mm_and_si128(color, _mm_castps_si128(_mm_cmpord_ps(value, value)));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 4), color);
+        }
+        colorGridRowScalar(row, taps, ramp, scale, out, x, width);
+    }
+
+    // AVX2: the same lane arithmetic on sixteen pixels. Shuffles and packs
+    // stay within 128-bit halves, so each half converts eight pixels and
+    // the halves are put back in order on the way out.
+
+    KERNEL_TARGET("avx2") inline void yuvToRgba16(__m256i y16, __m256i uv16, std::uint8_t* out) {
+        const __m256i uShuffle = _mm256_setr_epi8(0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13,
+                                                  0, 1, 0, 1, 4, 5, 4, 5, 8, 9, 8, 9, 12, 13, 12, 13);
+        const __m256i vShuffle = _mm256_setr_epi8(2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15,
+                                                  2, 3, 2, 3, 6, 7, 6, 7, 10, 11, 10, 11, 14, 15, 14, 15);
+        const __m256i round = _mm256_set1_epi16(32);
+        __m256i luma = _mm256_mullo_epi16(_mm256_sub_epi16(y16, _mm256_set1_epi16(16)), _mm256_set1_epi16(74));
+        __m256i u = _mm256_sub_epi16(_mm256_shuffle_epi8(uv16, uShuffle), _mm256_set1_epi16(128));
+        __m256i v = _mm256_sub_epi16(_mm256_shuffle_epi8(uv16, vShuffle), _mm256_set1_epi16(128));
+
+        __m256i r = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(luma, _mm256_mullo_epi16(v, _mm256_set1_epi16(102))), round), 6);
+        __m256i g = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_subs_epi16(_mm256_subs_epi16(luma, _mm256_mullo_epi16(u, _mm256_set1_epi16(25))),
+                                                                          _mm256_mullo_epi16(v, _mm256_set1_epi16(52))), round), 6);
+        __m256i b = _mm256_srai_epi16(_mm256_adds_epi16(_mm256_adds_epi16(luma, _mm256_mullo_epi16(u, _mm256_set1_epi16(129))), round), 6);
+
+        __m256i rg = _mm256_unpacklo_epi8(_mm256_packus_epi16(r, r), _mm256_packus_epi16(g, g));
+        __m256i ba = _mm256_unpacklo_epi8(_mm256_packus_epi16(b, b), _mm256_set1_epi8(-1));
+        __m256i low = _mm256_unpacklo_epi16(rg, ba);  // pixels 0-3 | 8-11
+        __m256i high = _mm256_unpackhi_epi16(rg, ba); // pixels 4-7 | 12-15
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_permute2x128_si256(low, high, 0x20));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 32), _mm256_permute2x128_si256(low, high, 0x31));
+    }
+
+    KERNEL_TARGET("avx2") void yuyvRowAvx2(const std::uint8_t* in, std::uint8_t* out, unsigned int width) {
+        const __m256i lowBytes = _mm256_set1_epi16(0x00FF);
+        unsigned int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x * 2));
+            yuvToRgba16(_mm256_and_si256(pixels, lowBytes), _mm256_srli_epi16(pixels, 8), out + x * 4);
+        }
+        yuyvRowScalar(in, out, x, width);
+    }
+
+    KERNEL_TARGET("avx2") void nv12RowAvx2(const std::uint8_t* luma, const std::uint8_t* chroma, std::uint8_t* out, unsigned int width) {
+        unsigned int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i y16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(luma + x)));
+            __m256i uv16 = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(chroma + x)));
+            yuvToRgba16(y16, uv16, out + x * 4);
+        }
+        nv12RowScalar(luma, chroma, out, x, width);
+    }
+
+    KERNEL_TARGET("avx2") inline __m256i graySums8(__m256i pixels, __m256i weights) {
+        __m256i low = _mm256_mullo_epi16(_mm256_unpacklo_epi8(pixels, _mm256_setzero_si256()), weights);
+        __m256i high = _mm256_mullo_epi16(_mm256_unpackhi_epi8(pixels, _mm256_setzero_si256()), weights);
+        return _mm256_hadd_epi16(low, high);
+    }
+
+    KERNEL_TARGET("avx2") void grayRowAvx2(const std::uint8_t* in, std::uint8_t* out, unsigned int width) {
+        const __m256i weights = _mm256_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0, 77, 150, 29, 0);
+        const __m256i round = _mm256_set1_epi16(128);
+        unsigned int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i first = graySums8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x * 4)), weights);
+            __m256i second = graySums8(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(in + x * 4 + 32)), weights);
+            // Halves hold pixels 0-3, 8-11 | 4-7, 12-15; reorder to 0-7 | 8-15
+            __m256i sums = _mm256_permute4x64_epi64(_mm256_hadd_epi16(first, second), 0xD8);
+            sums = _mm256_srli_epi16(_mm256_add_epi16(sums, round), 8);
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sums, sums), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x), _mm256_castsi256_si128(packed));
+        }
+        grayRowScalar(in, out, x, width);
+    }
+
+    KERNEL_TARGET("avx2") void backgroundRowAvx2(const std::uint8_t* gray, std::uint16_t* background, std::uint8_t* difference,
+                                                 unsigned int shift, unsigned int width) {
+        const __m128i count = _mm_cvtsi32_si128(static_cast<int>(shift));
+        const __m256i round = _mm256_set1_epi16(8);
+        unsigned int x = 0;
+        for (; x + 16 <= width; x += 16) {
+            __m256i pixels = _mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(gray + x))), 4);
+            __m256i model = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(background + x));
+            __m256i delta = _mm256_sub_epi16(pixels, model);
+            __m256i absolute = _mm256_srli_epi16(_mm256_add_epi16(_mm256_abs_epi16(delta), round), 4);
+            __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(absolute), _mm256_extracti128_si256(absolute, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(difference + x), packed);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(background + x), _mm256_add_epi16(model, _mm256_sra_epi16(delta, count)));
+        }
+        backgroundRowScalar(gray, background, difference, shift, x, width);
+    }
+
+    KERNEL_TARGET("avx2") void blendRowsAvx2(const std::uint8_t* top, const std::uint8_t* bottom, unsigned int weight,
+                                             std::uint16_t* out, unsigned int count) {
+        const __m256i topWeight = _mm256_set1_epi16(static_cast<short>(256 - weight));
+        const __m256i bottomWeight = _mm256_set1_epi16(static_cast<short>(weight));
+        unsigned int i = 0;
+        for (; i + 16 <= count; i += 16) {
+            __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(top + i)));
+            __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i*>(bottom + i)));
+            __m256i sum = _mm256_add_epi16(_mm256_mullo_epi16(a, topWeight), _mm256_mullo_epi16(b, bottomWeight));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), sum);
+        }
+        blendRowsScalar(top, bottom, weight, out, i, count);
+    }
+
+    KERNEL_TARGET("avx2") void filterRowAvx2(const std::uint16_t* row, const Tap* taps, std::uint8_t* out, unsigned int width) {
+        const __m256i round = _mm256_set1_epi32(32768);
+        unsigned int x = 0;
+        for (; x + 2 <= width; x += 2) {
+            const Tap& first = taps[x];
+            const Tap& second = taps[x + 1];
+            __m256i left = _mm256_cvtepu16_epi32(_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + first.left)),
+                                                                    _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + second.left))));
+            __m256i right = _mm256_cvtepu16_epi32(_mm_unpacklo_epi64(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + first.right)),
+                                                                     _mm_loadl_epi64(reinterpret_cast<const __m128i*>(row + second.right))));
+            int w1 = static_cast<int>(first.weight);
+            int w2 = static_cast<int>(second.weight);
+            __m256i leftWeight = _mm256_setr_epi32(256 - w1, 256 - w1, 256 - w1, 256 - w1, 256 - w2, 256 - w2, 256 - w2, 256 - w2);
+            __m256i rightWeight = _mm256_setr_epi32(w1, w1, w1, w1, w2, w2, w2, w2);
+            __m256i sum = _mm256_add_epi32(_mm256_mullo_epi32(left, leftWeight), _mm256_mullo_epi32(right, rightWeight));
+            __m256i pixels = _mm256_srli_epi32(_mm256_add_epi32(sum, round), 16);
+            // 32 -> 16 -> 8 bits within each half, then one pixel from each half
+            pixels = _mm256_packus_epi16(_mm256_packus_epi32(pixels, pixels), pixels);
+            __m128i pair = _mm_unpacklo_epi32(_mm256_castsi256_si128(pixels), _mm256_extracti128_si256(pixels, 1));
+            _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 4), pair);
+        }
+        filterRowScalar(row, taps, out, x, width);
+    }
+
+    KERNEL_TARGET("avx2") void blendGridRowsAvx2(const float* top, const float* bottom, float weight, float* out, unsigned int count) {
+        const __m256 factor = _mm256_set1_ps(weight);
+        unsigned int i = 0;
+        for (; i + 8 <= count; i += 8) {
+            __m256 a = _mm256_loadu_ps(top + i);
+            __m256 b = _mm256_loadu_ps(bottom + i);
+            _mm256_storeu_ps(out + i, _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), factor)));
+        }
+        blendGridRowsScalar(top, bottom, weight, out, i, count);
+    }
+
+    KERNEL_TARGET("avx2") void colorGridRowAvx2(const float* row, const GridTaps& taps, const ColorRamp& ramp, float scale,
+                                                std::uint8_t* out, unsigned int width) {
+        const __m256 minimum = _mm256_set1_ps(ramp.minValue);
+        const __m256 factor = _mm256_set1_ps(scale);
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 last = _mm256_set1_ps(255.f);
+        const int* colors = reinterpret_cast<const int*>(ramp.colors);
+        unsigned int x = 0;
+        for (; x + 8 <= width; x += 8) {
+            __m256i left = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.left.data() + x));
+            __m256i right = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(taps.right.data() + x));
+            __m256 a = _mm256_i32gather_ps(row, left, 4);
+            __m256 b = _mm256_i32gather_ps(row, right, 4);
+            __m256 value = _mm256_add_ps(a, _mm256_mul_ps(_mm256_sub_ps(b, a), _mm256_loadu_ps(taps.weight.data() + x)));
+            __m256i index = _mm256_cvttps_epi32(_mm256_min_ps(_mm256_max_ps(_mm256_mul_ps(_mm256_sub_ps(value, minimum), factor), zero), last));
+            __m256i color = _mm256_i32gather_epi32(colors, index, 4);
+            color = _mm256_and_si256(color, _mm256_castps_si256(_mm256_cmp_ps(value, value, _CMP_ORD_Q)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), color);
+        }
+        colorGridRowScalar(row, taps, ramp, scale, out, x, width);
+    }
+
+    bool cpuSupports(Path path) {
+#if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 1);
+        bool sse41 = (info[2] & (1 << 19)) != 0;
+        bool osSavesAvx = (info[2] & (1 << 27)) != 0 && (info[2] & (1 << 28)) != 0 && (_xgetbv(0) & 6) == 6;
+        __cpuidex(info, 7, 0);
+        bool avx2 = osSavesAvx && (info[1] & (1 << 5)) != 0;
+#else
+        __builtin_cpu_init();
+        bool sse41 = __builtin_cpu_supports("sse4.1");
+        bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+        return path == Path::Sse41 ? sse41 : (path == Path::Avx2 ? avx2 : true);
+    }
+#else
+    bool cpuSupports(Path path) {
+        return path == Path::Scalar;
+    }
+#endif
+
+    Path resolve(Path path) {
+        if (path == Path::Auto || !isSupported(path)) return bestPath();
+        return path;
+    }
+
+    // Source pixel pairs and weights for every output column, in byte
+    // offsets into a row of four-channel pixels (16.16 fixed point centres)
+    void buildTaps(unsigned int width, unsigned int scaledWidth, std::vector<Tap>& taps) {
+        taps.resize(scaledWidth);
+        for (unsigned int x = 0; x < scaledWidth; ++x) {
+            std::int64_t position = ((2 * static_cast<std::int64_t>(x) + 1) * width * 65536) / (2 * static_cast<std::int64_t>(scaledWidth)) - 32768;
+            if (position < 0) position = 0;
+            unsigned int left = static_cast<unsigned int>(position >> 16);
+            unsigned int weight = static_cast<unsigned int>((position >> 8) & 255);
+            if (left >= width - 1) {
+                left = width - 1;
+                weight = 0;
+            }
+            taps[x].left = left * 4;
+            taps[x].right = std::min(left + 1, width - 1) * 4;
+            taps[x].weight = weight;
+        }
+    }
+    // Cell pairs and weights for every output column of sampleGrid
+    void buildGridTaps(unsigned int gridWidth, bool wrap, double column, double step, unsigned int width, GridTaps& taps) {
+        taps.left.resize(width);
+        taps.right.resize(width);
+        taps.weight.resize(width);
+        const double cells = gridWidth;
+        const std::int32_t lastCell = static_cast<std::int32_t>(gridWidth) - 1;
+        for (unsigned int x = 0; x < width; ++x) {
+            double position = column + x * step;
+            std::int32_t left = static_cast<std::int32_t>(gridWidth);
+            std::int32_t right = left;
+            float weight = 0.f;
+            if (wrap) {
+                position -= std::floor(position / cells) * cells;
+                left = std::min(static_cast<std::int32_t>(position), lastCell);
+                weight = static_cast<float>(position - left);
+                right = left < lastCell ? left + 1 : 0;
+            } else if (position >= -0.5 && position <= cells - 0.5) {
+                // Half a cell past the outer centres repeats the edge
+                position = std::min(std::max(position, 0.0), cells - 1.0);
+                left = static_cast<std::int32_t>(position);
+                weight = static_cast<float>(position - left);
+                right = std::min(left + 1, lastCell);
+            }
+            taps.left[x] = left;
+            taps.right[x] = right;
+            taps.weight[x] = weight;
+        }
+    }
+}
+
+Path bestPath() {
+    static const Path best = cpuSupports(Path::Avx2) ? Path::Avx2 : (cpuSupports(Path::Sse41) ? Path::Sse41 : Path::Scalar);
+    return best;
+}
+
+bool isSupported(Path path) {
+    return path == Path::Auto || path == Path::Scalar || cpuSupports(path);
+}
+
+const char* pathName(Path path) {
+    switch (path) {
+    case Path::Auto: return "auto";
+    case Path::Scalar: return "scalar";
+    case Path::Sse41: return "sse4.1";
+    case Path::Avx2: return "avx2";
+    }
+    return "?";
+}
+
+void yuyvToRgba(const std::uint8_t* yuyv, std::size_t yuyvStride, unsigned int width, unsigned int height,
+                std::uint8_t* rgba, std::size_t rgbaStride, const Bands& bands, Path path) {
+    path = resolve(path);
+    forEachBand(bands, height, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            const std::uint8_t* in = yuyv + y * yuyvStride;
+            std::uint8_t* out = rgba + y * rgbaStride;
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) { yuyvRowAvx2(in, out, width); continue; }
+            if (path == Path::Sse41) { yuyvRowSse41(in, out, width); continue; }
+#endif
+            yuyvRowScalar(in, out, 0, width);
+        }
+    });
+}
+
+void nv12ToRgba(const std::uint8_t* luma, std::size_t lumaStride, const std::uint8_t* chroma, std::size_t chromaStride,
+                unsigned int width, unsigned int height, std::uint8_t* rgba, std::size_t rgbaStride, const Bands& bands, Path path) {
+    path = resolve(path);
+    forEachBand(bands, height, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            const std::uint8_t* lumaRow = luma + y * lumaStride;
+            const std::uint8_t* chromaRow = chroma + (y / 2) * chromaStride;
+            std::uint8_t* out = rgba + y * rgbaStride;
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) { nv12RowAvx2(lumaRow, chromaRow, out, width); continue; }
+            if (path == Path::Sse41) { nv12RowSse41(lumaRow, chromaRow, out, width); continue; }
+#endif
+            nv12RowScalar(lumaRow, chromaRow, out, 0, width);
+        }
+    });
+}
+
+void rgbaToGray(const std::uint8_t* rgba, std::size_t rgbaStride, unsigned int width, unsigned int height,
+                std::uint8_t* gray, std::size_t grayStride, const Bands& bands, Path path) {
+    path = resolve(path);
+    forEachBand(bands, height, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            const std::uint8_t* in = rgba + y * rgbaStride;
+            std::uint8_t* out = gray + y * grayStride;
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) { grayRowAvx2(in, out, width); continue; }
+            if (path == Path::Sse41) { grayRowSse41(in, out, width); continue; }
+#endif
+            grayRowScalar(in, out, 0, width);
+        }
+    });
+}
+
+void updateBackground(const std::uint8_t* gray, std::size_t grayStride, unsigned int width, unsigned int height,
+                      std::uint16_t* background, std::size_t backgroundStride, std::uint8_t* difference, std::size_t differenceStride,
+                      unsigned int learningShift, const Bands& bands, Path path) {
+    path = resolve(path);
+    learningShift = std::min(learningShift, 15u);
+    forEachBand(bands, height, [&](unsigned int begin, unsigned int end) {
+        for (unsigned int y = begin; y < end; ++y) {
+            const std::uint8_t* in = gray + y * grayStride;
+            std::uint16_t* model = reinterpret_cast<std::uint16_t*>(reinterpret_cast<std::uint8_t*>(background) + y * backgroundStride);
+            std::uint8_t* out = difference + y * differenceStride;
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) { backgroundRowAvx2(in, model, out, learningShift, width); continue; }
+            if (path == Path::Sse41) { backgroundRowSse41(in, model, out, learningShift, width); continue; }
+#endif
+            backgroundRowScalar(in, model, out, learningShift, 0, width);
+        }
+    });
+}
+
+void scaleBilinear(const std::uint8_t* rgba, std::size_t rgbaStride, unsigned int width, unsigned int height,
+                   std::uint8_t* scaled, std::size_t scaledStride, unsigned int scaledWidth, unsigned int scaledHeight,
+                   const Bands& bands, Path path) {
+    if (width == 0 || height == 0 || scaledWidth == 0 || scaledHeight == 0) return;
+    path = resolve(path);
+
+    // Reused between calls, so scaling every frame does not allocate
+    thread_local std::vector<Tap> taps;
+    buildTaps(width, scaledWidth, taps);
+    const Tap* tapData = taps.data();
+
+    forEachBand(bands, scaledHeight, [&](unsigned int begin, unsigned int end) {
+        thread_local std::vector<std::uint16_t> row;
+        row.resize(static_cast<std::size_t>(width) * 4);
+        for (unsigned int y = begin; y < end; ++y) {
+            std::int64_t position = ((2 * static_cast<std::int64_t>(y) + 1) * height * 65536) / (2 * static_cast<std::int64_t>(scaledHeight)) - 32768;
+            if (position < 0) position = 0;
+            unsigned int top = static_cast<unsigned int>(position >> 16);
+            unsigned int weight = static_cast<unsigned int>((position >> 8) & 255);
+            if (top >= height - 1) {
+                top = height - 1;
+                weight = 0;
+            }
+            const std::uint8_t* topRow = rgba + top * rgbaStride;
+            const std::uint8_t* bottomRow = rgba + std::min(top + 1, height - 1) * rgbaStride;
+            std::uint8_t* out = scaled + y * scaledStride;
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) {
+                blendRowsAvx2(topRow, bottomRow, weight, row.data(), width * 4);
+                filterRowAvx2(row.data(), tapData, out, scaledWidth);
+                continue;
+            }
+            if (path == Path::Sse41) {
+                blendRowsSse41(topRow, bottomRow, weight, row.data(), width * 4);
+                filterRowSse41(row.data(), tapData, out, scaledWidth);
+                continue;
+            }
+#endif
+            blendRowsScalar(topRow, bottomRow, weight, row.data(), 0, width * 4);
+            filterRowScalar(row.data(), tapData, out, 0, scaledWidth);
+        }
+    });
+}
+
+void sampleGrid(const float* grid, std::size_t gridStride, unsigned int gridWidth, unsigned int gridHeight, bool wrap,
+                const GridPlacement& placement, const ColorRamp& ramp, std::uint8_t* rgba, std::size_t rgbaStride,
+                unsigned int width, unsigned int height, const Bands& bands, Path path) {
+    if (width == 0 || height == 0) return;
+    if (gridWidth == 0 || gridHeight == 0) {
+        for (unsigned int y = 0; y < height; ++y) std::memset(rgba + y * rgbaStride, 0, static_cast<std::size_t>(width) * 4);
+        return;
+    }
+    path = resolve(path);
+
+    thread_local GridTaps taps;
+    buildGridTaps(gridWidth, wrap, placement.column, placement.columnStep, width, taps);
+    const GridTaps* columnTaps = &taps;
+    const float scale = ramp.maxValue > ramp.minValue ? 256.f / (ramp.maxValue - ramp.minValue) : 0.f;
+    const double cells = gridHeight;
+
+    forEachBand(bands, height, [&](unsigned int begin, unsigned int end) {
+        // One extra NaN cell that off-grid columns read
+        thread_local std::vector<float> row;
+        row.resize(static_cast<std::size_t>(gridWidth) + 1);
+        row[gridWidth] = std::numeric_limits<float>::quiet_NaN();
+        for (unsigned int y = begin; y < end; ++y) {
+            std::uint8_t* out = rgba + y * rgbaStride;
+            double position = placement.row + y * placement.rowStep;
+            if (position < -0.5 || position > cells - 0.5) {
+                std::memset(out, 0, static_cast<std::size_t>(width) * 4);
+                continue;
+            }
+            position = std::min(std::max(position, 0.0), cells - 1.0);
+            unsigned int top = static_cast<unsigned int>(position);
+            float weight = static_cast<float>(position - top);
+            const float* topRow = reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(grid) + top * gridStride);
+            const float* bottomRow = reinterpret_cast<const float*>(reinterpret_cast<const std::uint8_t*>(grid) +
+                                                                    std::min(top + 1, gridHeight - 1) * gridStride);
+#ifdef IMAGEKERNELS_X86
+            if (path == Path::Avx2) {
+                blendGridRowsAvx2(topRow, bottomRow, weight, row.data(), gridWidth);
+                colorGridRowAvx2(row.data(), *columnTaps, ramp, scale, out, width);
+                continue;
+            }
+            if (path == Path::Sse41) {
+                blendGridRowsSse41(topRow, bottomRow, weight, row.data(), gridWidth);
+                colorGridRowSse41(row.data(), *columnTaps, ramp, scale, out, width);
+                continue;
+            }
+#endif
+            blendGridRowsScalar(topRow, bottomRow, weight, row.data(), 0, gridWidth);
+            colorGridRowScalar(row.data(), *columnTaps, ramp, scale, out, 0, width);
+        }
+    });
+}
+}
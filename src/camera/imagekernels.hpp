@@ -0,0 +1,86 @@
+#pragma once
+
+#include "../utils/taskscheduler.hpp"
+#include <cstddef>
+#include <cstdint>
+
+// Pixel format conversion and scaling for camera frames, and the colour
+// mapped grid sampling behind the map's weather overlay.
+//
+// Every kernel has a scalar reference and SSE4.1 and AVX2 versions that
+// give bit-identical results (the arithmetic is defined by what the 16-bit
+// vector lanes compute, or done in float in a fixed order), picked at run
+// time from what the CPU supports.
+// Given a scheduler, a kernel splits its rows into bands and runs them as
+// tasks, returning once all are done.
+//
+// Strides are in bytes. YUV input is BT.601 limited range.
+namespace imagekernels {
+    enum class Path { Auto, Scalar, Sse41, Avx2 };
+
+    // Where a kernel's rows run: without a scheduler all on the calling
+    // thread, otherwise in up to `limit` bands (0: one per active worker) at
+    // `priority`, the calling thread taking its share
+    struct Bands {
+        TaskScheduler* scheduler = nullptr;
+        TaskScheduler::Priority priority = TaskScheduler::Priority::Normal;
+        unsigned int limit = 0;
+    };
+
+    // The fastest path this CPU supports
+    Path bestPath();
+    bool isSupported(Path path);
+    const char* pathName(Path path);
+
+    // Packed 4:2:2, Y0 U Y1 V; width must be even
+    void yuyvToRgba(const std::uint8_t* yuyv, std::size_t yuyvStride, unsigned int width, unsigned int height,
+                    std::uint8_t* rgba, std::size_t rgbaStride, const Bands& bands = Bands(), Path path = Path::Auto);
+
+    // Full-resolution Y plane followed by a half-resolution plane of interleaved U V pairs
+    void nv12ToRgba(const std::uint8_t* luma, std::size_t lumaStride, const std::uint8_t* chroma, std::size_t chromaStride,
+                    unsigned int width, unsigned int height, std::uint8_t* rgba, std::size_t rgbaStride,
+                    const Bands& bands = Bands(), Path path = Path::Auto);
+
+    // One byte per pixel, BT.601 weights
+    void rgbaToGray(const std::uint8_t* rgba, std::size_t rgbaStride, unsigned int width, unsigned int height,
+                    std::uint8_t* gray, std::size_t grayStride, const Bands& bands = Bands(), Path path = Path::Auto);
+
+    // Running-average background for motion detection. `background` holds
+    // gray levels times 16 (start it at gray << 4). Writes |gray - background|
+    // to `difference`, then moves the background 1/2^learningShift of the
+    // way towards gray.
+    void updateBackground(const std::uint8_t* gray, std::size_t grayStride, unsigned int width, unsigned int height,
+                          std::uint16_t* background, std::size_t backgroundStride, std::uint8_t* difference, std::size_t differenceStride,
+                          unsigned int learningShift, const Bands& bands = Bands(), Path path = Path::Auto);
+
+    // Two-tap bilinear filter with 8-bit weights. Shrinking by more than
+    // half skips source pixels, so downscale in steps for large factors.
+    void scaleBilinear(const std::uint8_t* rgba, std::size_t rgbaStride, unsigned int width, unsigned int height,
+                       std::uint8_t* scaled, std::size_t scaledStride, unsigned int scaledWidth, unsigned int scaledHeight,
+                       const Bands& bands = Bands(), Path path = Path::Auto);
+
+    // Colours for sampleGrid: minValue..maxValue spread evenly over the 256
+    // entries and clamped at both ends. Entries are RGBA bytes in memory order.
+    struct ColorRamp {
+        std::uint32_t colors[256];
+        float minValue = 0.f;
+        float maxValue = 1.f;
+    };
+
+    // Output pixel (x, y) samples the grid at (column + x * columnStep,
+    // row + y * rowStep), in cells counted from the centre of the first one
+    struct GridPlacement {
+        double column = 0.0;
+        double columnStep = 1.0;
+        double row = 0.0;
+        double rowStep = 1.0;
+    };
+
+    // Bilinear samples of a grid of floats, coloured through `ramp`. NaN
+    // cells (no data) and positions off the grid come out transparent.
+    // `wrap` joins the last column to the first, for grids that go around
+    // the globe.
+    void sampleGrid(const float* grid, std::size_t gridStride, unsigned int gridWidth, unsigned int gridHeight, bool wrap,
+                    const GridPlacement& placement, const ColorRamp& ramp, std::uint8_t* rgba, std::size_t rgbaStride,
+                    unsigned int width, unsigned int height, const Bands& bands = Bands(), Path path = Path::Auto);
+}
@@ -0,0 +1,321 @@
+#include "motiondetector.hpp"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    // Local wall-clock time of a steady_clock time point, to the millisecond
+    std::string wallClock(std::chrono::steady_clock::time_point time) {
+        std::chrono::system_clock::time_point wall = std::chrono::system_clock::now() -
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::steady_clock::now() - time);
+        std::time_t seconds = std::chrono::system_clock::to_time_t(wall);
+        long long milliseconds = std::chrono::duration_cast<std::chrono::milliseconds>(wall.time_since_epoch()).count() % 1000;
+        std::stringstream ss;
+        ss << std::put_time(std::localtime(&seconds), "%Y-%m-%d %H:%M:%S") << "." << std::setfill('0') << std::setw(3) << milliseconds;
+        return ss.str();
+    }
+}
+
+MotionDetector::~MotionDetector() {
+    stop();
+}
+
+void MotionDetector::configure(unsigned int width, unsigned int height, const Options& options) {
+    stop();
+    m_options = options;
+    m_width = width;
+    m_height = height;
+    m_analysisWidth = std::max(1u, std::min(static_cast<unsigned int>(AnalysisWidth), width));
+    m_analysisHeight = std::max(1u, static_cast<unsigned int>(static_cast<std::uint64_t>(height) * m_analysisWidth / std::max(1u, width)));
+    m_blocksAcross = (m_analysisWidth + BlockSize - 1) / BlockSize;
+    m_blocksDown = (m_analysisHeight + BlockSize - 1) / BlockSize;
+    m_threads = options.threads;
+
+    // The first halving step is the largest; later ones reuse its buffers
+    const std::size_t halvedSize = static_cast<std::size_t>(width / 2) * std::max(1u, height / 2) * 4;
+    m_halved[0].assign(halvedSize, 0);
+    m_halved[1].assign(halvedSize, 0);
+    const std::size_t pixels = static_cast<std::size_t>(m_analysisWidth) * m_analysisHeight;
+    m_scaled.assign(pixels * 4, 0);
+    m_gray.assign(pixels, 0);
+    m_background.assign(pixels, 0);
+    m_difference.assign(pixels, 0);
+    m_changed.assign(static_cast<std::size_t>(m_blocksAcross) * m_blocksDown, 0);
+    m_active.assign(m_changed.size(), 0);
+    m_stack.clear();
+    m_stack.reserve(m_changed.size());
+    m_hasBackground = false;
+    m_inEvent = false;
+
+    m_input.pixels.assign(static_cast<std::size_t>(width) * height * 4, 0);
+    m_input.width = width;
+    m_input.height = height;
+    m_result = Result();
+    {
+        std::lock_guard<std::mutex> lock(m_resultMutex);
+        m_published = Result();
+        m_processed = 0;
+        m_events = 0;
+    }
+    m_skipped = 0;
+    m_throttled = 0;
+    m_lastAccepted = Clock::time_point();
+}
+
+void MotionDetector::release() {
+    stop();
+    for (auto& halved : m_halved) {
+        std::vector<std::uint8_t>().swap(halved);
+    }
+    std::vector<std::uint8_t>().swap(m_scaled);
+    std::vector<std::uint8_t>().swap(m_gray);
+    std::vector<std::uint16_t>().swap(m_background);
+    std::vector<std::uint8_t>().swap(m_difference);
+    std::vector<std::uint32_t>().swap(m_changed);
+    std::vector<std::uint8_t>().swap(m_active);
+    std::vector<unsigned int>().swap(m_stack);
+    std::vector<std::uint8_t>().swap(m_input.pixels);
+    m_hasBackground = false;
+    m_inEvent = false;
+    m_result = Result();
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    m_published = Result();
+}
+
+std::size_t MotionDetector::bufferBytes() const {
+    return m_halved[0].capacity() + m_halved[1].capacity() + m_scaled.capacity() + m_gray.capacity() +
+           m_background.capacity() * sizeof(std::uint16_t) + m_difference.capacity() +
+           m_changed.capacity() * sizeof(std::uint32_t) + m_active.capacity() +
+           m_stack.capacity() * sizeof(unsigned int) + m_input.pixels.capacity();
+}
+
+void MotionDetector::start() {
+    stop();
+    m_token = CancellationToken();
+    m_running = true;
+    m_busy = false;
+}
+
+void MotionDetector::stop() {
+    // Until start(), submit() finds the detector busy and skips
+    m_busy = true;
+    if (!m_running) return;
+    m_token.cancel();
+    m_token.wait();
+    // A task that finished meanwhile cleared it
+    m_busy = true;
+    m_running = false;
+}
+
+bool MotionDetector::submit(const Frame& frame) {
+    if (frame.width != m_width || frame.height != m_height) return false;
+    if (unsigned int rate = m_maxFrameRate) {
+        if (frame.captured - m_lastAccepted < std::chrono::microseconds(1000000 / rate)) {
+            ++m_throttled;
+            return false;
+        }
+    }
+    if (m_busy.exchange(true)) {
+        ++m_skipped;
+        return false;
+    }
+    m_lastAccepted = frame.captured;
+    std::memcpy(m_input.pixels.data(), frame.pixels.data(), m_input.pixels.size());
+    m_input.sequence = frame.sequence;
+    m_input.captured = frame.captured;
+    TaskScheduler::instance().submit(TaskScheduler::Priority::Normal, m_token, [this] {
+        process(m_input);
+        m_busy = false;
+    });
+    return true;
+}
+
+imagekernels::Bands MotionDetector::bands() const {
+    imagekernels::Bands bands;
+    bands.scheduler = &TaskScheduler::instance();
+    bands.priority = TaskScheduler::Priority::Normal;
+    bands.limit = m_threads;
+    return bands;
+}
+
+const MotionDetector::Result& MotionDetector::process(const Frame& frame) {
+    Clock::time_point start = Clock::now();
+    const unsigned int width = m_analysisWidth;
+    const unsigned int height = m_analysisHeight;
+
+    downscale(frame);
+    imagekernels::rgbaToGray(m_scaled.data(), width * 4, width, height, m_gray.data(), width, bands());
+
+    m_result.sequence = frame.sequence;
+    m_result.captured = frame.captured;
+    m_result.regions.clear();
+    m_result.activeBlocks = 0;
+    if (!m_hasBackground) {
+        // The first frame becomes the background
+        for (std::size_t i = 0; i < m_gray.size(); ++i) {
+            m_background[i] = static_cast<std::uint16_t>(m_gray[i] << 4);
+        }
+        m_hasBackground = true;
+        m_result.motion = false;
+    } else {
+        imagekernels::updateBackground(m_gray.data(), width, width, height, m_background.data(), width * sizeof(std::uint16_t),
+                                       m_difference.data(), width, m_options.learningShift, bands());
+
+        // Count changed pixels per block
+        std::fill(m_changed.begin(), m_changed.end(), 0);
+        const std::uint8_t threshold = static_cast<std::uint8_t>(std::min(m_options.pixelThreshold, 255u));
+        for (unsigned int y = 0; y < height; ++y) {
+            const std::uint8_t* row = m_difference.data() + static_cast<std::size_t>(y) * width;
+            std::uint32_t* blocks = m_changed.data() + static_cast<std::size_t>(y / BlockSize) * m_blocksAcross;
+            for (unsigned int block = 0; block < m_blocksAcross; ++block) {
+                const unsigned int end = std::min(width, (block + 1) * BlockSize);
+                std::uint32_t count = 0;
+                for (unsigned int x = block * BlockSize; x < end; ++x) {
+                    count += row[x] > threshold;
+                }
+                blocks[block] += count;
+            }
+        }
+        findRegions();
+        m_result.motion = m_result.activeBlocks >= std::max(1u, m_options.minBlocks);
+    }
+    updateEvent(frame);
+
+    double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    m_published = m_result;
+    m_timings[m_processed % TimingSamples] = milliseconds;
+    ++m_processed;
+    return m_result;
+}
+
+void MotionDetector::downscale(const Frame& frame) {
+    // Halve until within a factor of two of the analysis size, since the
+    // bilinear scaler skips pixels when shrinking further in one go
+    const std::uint8_t* source = frame.pixels.data();
+    unsigned int width = frame.width;
+    unsigned int height = frame.height;
+    unsigned int step = 0;
+    while (width > 2 * m_analysisWidth) {
+        unsigned int halfWidth = width / 2;
+        unsigned int halfHeight = std::max(1u, height / 2);
+        std::uint8_t* target = m_halved[step % 2].data();
+        imagekernels::scaleBilinear(source, width * 4, width, height, target, halfWidth * 4, halfWidth, halfHeight, bands());
+        source = target;
+        width = halfWidth;
+        height = halfHeight;
+        ++step;
+    }
+    imagekernels::scaleBilinear(source, width * 4, width, height, m_scaled.data(), m_analysisWidth * 4,
+                                m_analysisWidth, m_analysisHeight, bands());
+}
+
+void MotionDetector::findRegions() {
+    const unsigned int across = m_blocksAcross;
+    const unsigned int down = m_blocksDown;
+    for (unsigned int by = 0; by < down; ++by) {
+        for (unsigned int bx = 0; bx < across; ++bx) {
+            // Edge blocks may be partial
+            unsigned int pixels = (std::min(m_analysisWidth, (bx + 1) * BlockSize) - bx * BlockSize) *
+                                  (std::min(m_analysisHeight, (by + 1) * BlockSize) - by * BlockSize);
+            std::size_t index = static_cast<std::size_t>(by) * across + bx;
+            m_active[index] = m_changed[index] > m_options.blockFraction * pixels ? 1 : 0;
+        }
+    }
+
+    // Flood fill over the block grid, eight neighbours; visited blocks are set to 2
+    for (std::size_t seed = 0; seed < m_active.size(); ++seed) {
+        if (m_active[seed] != 1) continue;
+        unsigned int left = across, top = down, right = 0, bottom = 0, blocks = 0;
+        m_active[seed] = 2;
+        m_stack.push_back(static_cast<unsigned int>(seed));
+        while (!m_stack.empty()) {
+            unsigned int index = m_stack.back();
+            m_stack.pop_back();
+            unsigned int bx = index % across;
+            unsigned int by = index / across;
+            left = std::min(left, bx);
+            right = std::max(right, bx);
+            top = std::min(top, by);
+            bottom = std::max(bottom, by);
+            ++blocks;
+            for (unsigned int ny = by > 0 ? by - 1 : 0; ny <= std::min(by + 1, down - 1); ++ny) {
+                for (unsigned int nx = bx > 0 ? bx - 1 : 0; nx <= std::min(bx + 1, across - 1); ++nx) {
+                    std::size_t neighbour = static_cast<std::size_t>(ny) * across + nx;
+                    if (m_active[neighbour] == 1) {
+                        m_active[neighbour] = 2;
+                        m_stack.push_back(static_cast<unsigned int>(neighbour));
+                    }
+                }
+            }
+        }
+
+        // Back to frame pixels
+        Region region;
+        region.x = static_cast<unsigned int>(static_cast<std::uint64_t>(left * BlockSize) * m_width / m_analysisWidth);
+        region.y = static_cast<unsigned int>(static_cast<std::uint64_t>(top * BlockSize) * m_height / m_analysisHeight);
+        unsigned int endX = static_cast<unsigned int>(std::min<std::uint64_t>(m_width, static_cast<std::uint64_t>((right + 1) * BlockSize) * m_width / m_analysisWidth));
+        unsigned int endY = static_cast<unsigned int>(std::min<std::uint64_t>(m_height, static_cast<std::uint64_t>((bottom + 1) * BlockSize) * m_height / m_analysisHeight));
+        region.width = endX - region.x;
+        region.height = endY - region.y;
+        region.blocks = blocks;
+        m_result.regions.push_back(region);
+        m_result.activeBlocks += blocks;
+    }
+}
+
+void MotionDetector::updateEvent(const Frame& frame) {
+    if (m_result.motion) {
+        if (!m_inEvent) {
+            m_inEvent = true;
+            m_eventStarted = frame.captured;
+            m_peakBlocks = 0;
+            {
+                std::lock_guard<std::mutex> lock(m_resultMutex);
+                ++m_events;
+            }
+            std::cout << "Motion: started at " << wallClock(frame.captured) << " (frame " << frame.sequence << ", "
+                      << m_result.activeBlocks << " blocks)" << std::endl;
+        }
+        m_lastMotion = frame.captured;
+        m_peakBlocks = std::max(m_peakBlocks, m_result.activeBlocks);
+    } else if (m_inEvent && frame.captured - m_lastMotion >= m_options.hold) {
+        m_inEvent = false;
+        double seconds = std::chrono::duration<double>(m_lastMotion - m_eventStarted).count();
+        std::cout << "Motion: ended at " << wallClock(m_lastMotion) << " after " << std::fixed << std::setprecision(1) << seconds
+                  << std::defaultfloat << " s (peak " << m_peakBlocks << " blocks)" << std::endl;
+    }
+    m_result.inEvent = m_inEvent;
+}
+
+void MotionDetector::latest(Result& out) const {
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    out = m_published;
+}
+
+MotionDetector::Stats MotionDetector::stats() const {
+    Stats stats;
+    stats.skipped = m_skipped;
+    stats.throttled = m_throttled;
+    std::lock_guard<std::mutex> lock(m_resultMutex);
+    stats.processed = m_processed;
+    stats.events = m_events;
+    std::size_t count = static_cast<std::size_t>(std::min(m_processed, static_cast<std::uint64_t>(TimingSamples)));
+    if (count == 0) return stats;
+
+    std::array<double, TimingSamples> sorted = m_timings;
+    double* end = sorted.data() + count;
+    double total = 0.0;
+    for (double* value = sorted.data(); value != end; ++value) {
+        total += *value;
+    }
+    stats.averageMilliseconds = total / static_cast<double>(count);
+    std::size_t p99 = count * 99 / 100;
+    std::nth_element(sorted.data(), sorted.data() + p99, end);
+    stats.p99Milliseconds = sorted[p99];
+    stats.maxMilliseconds = *std::max_element(sorted.data(), end);
+    return stats;
+}
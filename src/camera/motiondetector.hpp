@@ -0,0 +1,157 @@
+#pragma once
+
+#include "framesource.hpp"
+#include "imagekernels.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Flags motion in camera frames.
+//
+// Each frame is shrunk to at most AnalysisWidth pixels across, turned to
+// gray and compared with a background model that slowly follows the scene
+// (each frame moves it 1/2^learningShift of the way). A pixel has changed
+// when it differs from the background by more than pixelThreshold; a block
+// of BlockSize x BlockSize analysis pixels is active when more than
+// blockFraction of its pixels changed, and touching active blocks merge
+// into regions. Motion starts an event, which ends once the scene has been
+// quiet for `hold`; both ends are logged with a timestamp.
+//
+// process() runs on the calling thread. After start(), submit() copies each
+// frame and hands it to the TaskScheduler at Normal priority, without
+// waiting: a frame that arrives while the previous one is still being
+// processed is skipped and counted, and so is one that arrives sooner than
+// a rate cap set with setMaxFrameRate() allows. The kernels split their
+// rows over the scheduler's workers as well.
+class MotionDetector : public FrameSink {
+public:
+    static const unsigned int AnalysisWidth = 320;
+    static const unsigned int BlockSize = 8;
+    static const std::size_t TimingSamples = 256;
+
+    struct Options {
+        unsigned int pixelThreshold = 24;
+        double blockFraction = 0.25;
+        unsigned int learningShift = 5;
+        unsigned int minBlocks = 2; // active blocks that count as motion
+        std::chrono::milliseconds hold{1000};
+        unsigned int threads = 0;   // kernel bands, 0: one per active scheduler worker
+    };
+
+    // In frame pixels
+    struct Region {
+        unsigned int x = 0;
+        unsigned int y = 0;
+        unsigned int width = 0;
+        unsigned int height = 0;
+        unsigned int blocks = 0;
+    };
+
+    struct Result {
+        std::uint64_t sequence = 0;
+        std::chrono::steady_clock::time_point captured;
+        std::vector<Region> regions;
+        unsigned int activeBlocks = 0;
+        bool motion = false;   // this frame
+        bool inEvent = false;  // motion now or within `hold`
+    };
+
+    struct Stats {
+        std::uint64_t processed = 0;
+        std::uint64_t skipped = 0;   // arrived while the previous frame was processed
+        std::uint64_t throttled = 0; // arrived too soon for the rate cap
+        std::uint64_t events = 0;
+        // Per processed frame, over the last TimingSamples frames
+        double averageMilliseconds = 0.0;
+        double p99Milliseconds = 0.0;
+        double maxMilliseconds = 0.0;
+    };
+
+    MotionDetector() = default;
+    ~MotionDetector() override;
+
+    MotionDetector(const MotionDetector&) = delete;
+    MotionDetector& operator=(const MotionDetector&) = delete;
+
+    // Sizes the buffers for frames of this size and forgets the background.
+    // Stops the detector if it runs.
+    void configure(unsigned int width, unsigned int height, const Options& options);
+    void start();
+    // Drops a queued frame and waits for one being processed
+    void stop();
+    bool isRunning() const { return m_running; }
+    // Stops and frees the buffers; configure() sets them up again
+    void release();
+    std::size_t bufferBytes() const;
+
+    // Analyses at most `framesPerSecond` submitted frames a second (0: all
+    // the detector keeps up with). Can be changed while it runs.
+    void setMaxFrameRate(unsigned int framesPerSecond) { m_maxFrameRate = framesPerSecond; }
+    // Caps the bands the analysis kernels split into, also while running
+    void setThreadCount(unsigned int threads) { m_threads = threads; }
+
+    bool submit(const Frame& frame) override;
+    // Frames must come in capture order, and not while the detector runs
+    const Result& process(const Frame& frame);
+
+    // Copies the last published result into `out`, reusing its capacity, so
+    // polling every frame does not allocate
+    void latest(Result& out) const;
+    Stats stats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    Options m_options;
+    unsigned int m_width = 0;
+    unsigned int m_height = 0;
+    unsigned int m_analysisWidth = 0;
+    unsigned int m_analysisHeight = 0;
+    unsigned int m_blocksAcross = 0;
+    unsigned int m_blocksDown = 0;
+    std::atomic<unsigned int> m_threads{0};
+
+    // Analysis buffers, allocated in configure()
+    std::vector<std::uint8_t> m_halved[2]; // downscaling steps
+    std::vector<std::uint8_t> m_scaled;
+    std::vector<std::uint8_t> m_gray;
+    std::vector<std::uint16_t> m_background;
+    std::vector<std::uint8_t> m_difference;
+    std::vector<std::uint32_t> m_changed; // per block
+    std::vector<std::uint8_t> m_active;
+    std::vector<unsigned int> m_stack;
+    bool m_hasBackground = false;
+
+    // Event state, processing thread only
+    bool m_inEvent = false;
+    Clock::time_point m_eventStarted;
+    Clock::time_point m_lastMotion;
+    unsigned int m_peakBlocks = 0;
+
+    Result m_result;
+    mutable std::mutex m_resultMutex;
+    Result m_published;
+    std::array<double, TimingSamples> m_timings{};
+    std::uint64_t m_processed = 0;
+    std::uint64_t m_events = 0;
+
+    // Frames handed to the scheduler; m_busy while one is queued or processed
+    CancellationToken m_token;
+    bool m_running = false;
+    Frame m_input;
+    std::atomic<bool> m_busy{true};
+    std::atomic<std::uint64_t> m_skipped{0};
+    std::atomic<std::uint64_t> m_throttled{0};
+    std::atomic<unsigned int> m_maxFrameRate{0};
+    Clock::time_point m_lastAccepted; // capture time of the last frame submit() took
+
+    imagekernels::Bands bands() const;
+    void downscale(const Frame& frame);
+    void findRegions();
+    void updateEvent(const Frame& frame);
+};
@@ -0,0 +1,205 @@
+#include "v4l2source.hpp"
+#include "imagekernels.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace {
+#ifdef __linux__
+    int xioctl(int fd, unsigned long request, void* argument) {
+        int result;
+        do {
+            result = ioctl(fd, request, argument);
+        } while (result < 0 && errno == EINTR);
+        return result;
+    }
+#endif
+}
+
+V4L2Source::V4L2Source(const std::string& device, unsigned int width, unsigned int height) {
+    m_name = device;
+#ifdef __linux__
+    m_fd = ::open(device.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+    if (m_fd < 0) {
+        fail("cannot open");
+        return;
+    }
+
+    v4l2_capability capability{};
+    if (xioctl(m_fd, VIDIOC_QUERYCAP, &capability) < 0) {
+        fail("not a V4L2 device");
+        return;
+    }
+    if (!(capability.device_caps & V4L2_CAP_VIDEO_CAPTURE) || !(capability.device_caps & V4L2_CAP_STREAMING)) {
+        fail("cannot stream video");
+        return;
+    }
+
+    v4l2_format format{};
+    for (std::uint32_t pixelFormat : {V4L2_PIX_FMT_YUYV, V4L2_PIX_FMT_NV12}) {
+        format = v4l2_format{};
+        format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        format.fmt.pix.width = width;
+        format.fmt.pix.height = height;
+        format.fmt.pix.pixelformat = pixelFormat;
+        format.fmt.pix.field = V4L2_FIELD_NONE;
+        if (xioctl(m_fd, VIDIOC_S_FMT, &format) == 0 && format.fmt.pix.pixelformat == pixelFormat) {
+            m_pixelFormat = pixelFormat;
+            break;
+        }
+    }
+    if (m_pixelFormat == 0) {
+        fail("offers neither YUYV nor NV12");
+        return;
+    }
+    // The driver picks the nearest size it supports
+    m_width = format.fmt.pix.width & ~1u;
+    m_height = format.fmt.pix.height & ~1u;
+    m_bytesPerLine = std::max(format.fmt.pix.bytesperline, m_pixelFormat == V4L2_PIX_FMT_YUYV ? m_width * 2 : m_width);
+
+    v4l2_requestbuffers request{};
+    request.count = BufferCount;
+    request.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(m_fd, VIDIOC_REQBUFS, &request) < 0 || request.count < 2) {
+        fail("cannot allocate buffers");
+        return;
+    }
+
+    m_buffers.resize(request.count);
+    for (unsigned int i = 0; i < request.count; ++i) {
+        v4l2_buffer buffer{};
+        buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buffer.memory = V4L2_MEMORY_MMAP;
+        buffer.index = i;
+        if (xioctl(m_fd, VIDIOC_QUERYBUF, &buffer) < 0) {
+            fail("cannot query buffer");
+            return;
+        }
+        void* start = mmap(nullptr, buffer.length, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, buffer.m.offset);
+        if (start == MAP_FAILED) {
+            fail("cannot map buffer");
+            return;
+        }
+        m_buffers[i].start = start;
+        m_buffers[i].length = buffer.length;
+        if (xioctl(m_fd, VIDIOC_QBUF, &buffer) < 0) {
+            fail("cannot queue buffer");
+            return;
+        }
+    }
+
+    v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(m_fd, VIDIOC_STREAMON, &type) < 0) {
+        fail("cannot start streaming");
+        return;
+    }
+    m_streaming = true;
+    std::cout << "Camera: " << device << " (" << capability.card << ") " << m_width << "x" << m_height
+              << (m_pixelFormat == V4L2_PIX_FMT_YUYV ? " YUYV, " : " NV12, ") << m_buffers.size() << " buffers, "
+              << imagekernels::pathName(imagekernels::bestPath()) << " conversion" << std::endl;
+#else
+    (void)width;
+    (void)height;
+    m_error = device + ": V4L2 is only available on Linux";
+#endif
+}
+
+V4L2Source::~V4L2Source() {
+    close();
+}
+
+bool V4L2Source::read(Frame& frame, std::chrono::milliseconds timeout) {
+#ifdef __linux__
+    if (m_fd < 0) return false;
+
+    pollfd descriptor{};
+    descriptor.fd = m_fd;
+    descriptor.events = POLLIN;
+    int ready = poll(&descriptor, 1, static_cast<int>(timeout.count()));
+    if (ready < 0 && errno != EINTR) return fail("poll failed");
+    if (ready <= 0) return false;
+
+    v4l2_buffer buffer{};
+    buffer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buffer.memory = V4L2_MEMORY_MMAP;
+    if (xioctl(m_fd, VIDIOC_DQBUF, &buffer) < 0) {
+        return errno == EAGAIN ? false : fail("cannot dequeue buffer");
+    }
+    // If we fell behind, skip to the newest filled buffer and give the older ones back
+    v4l2_buffer newer{};
+    newer.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    newer.memory = V4L2_MEMORY_MMAP;
+    while (xioctl(m_fd, VIDIOC_DQBUF, &newer) == 0) {
+        xioctl(m_fd, VIDIOC_QBUF, &buffer);
+        buffer = newer;
+    }
+
+    // NV12 puts a half-height plane of U V pairs after the Y plane
+    const std::size_t imageSize = m_pixelFormat == V4L2_PIX_FMT_YUYV ? static_cast<std::size_t>(m_bytesPerLine) * m_height
+                                                                      : static_cast<std::size_t>(m_bytesPerLine) * m_height * 3 / 2;
+    bool complete = !(buffer.flags & V4L2_BUF_FLAG_ERROR) && buffer.bytesused >= imageSize;
+    if (complete) {
+        const std::uint8_t* data = static_cast<const std::uint8_t*>(m_buffers[buffer.index].start);
+        imagekernels::Bands bands;
+        bands.scheduler = &TaskScheduler::instance();
+        bands.priority = TaskScheduler::Priority::High;
+        bands.limit = m_convertThreads;
+        if (m_pixelFormat == V4L2_PIX_FMT_YUYV) {
+            imagekernels::yuyvToRgba(data, m_bytesPerLine, m_width, m_height, frame.pixels.data(), m_width * 4, bands);
+        } else {
+            imagekernels::nv12ToRgba(data, m_bytesPerLine, data + static_cast<std::size_t>(m_bytesPerLine) * m_height, m_bytesPerLine,
+                                     m_width, m_height, frame.pixels.data(), m_width * 4, bands);
+        }
+        frame.width = m_width;
+        frame.height = m_height;
+        frame.sequence = buffer.sequence;
+        if ((buffer.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+            // CLOCK_MONOTONIC, the clock steady_clock uses on Linux
+            frame.captured = std::chrono::steady_clock::time_point(std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::seconds(buffer.timestamp.tv_sec) + std::chrono::microseconds(buffer.timestamp.tv_usec)));
+        } else {
+            frame.captured = std::chrono::steady_clock::now();
+        }
+    }
+    if (xioctl(m_fd, VIDIOC_QBUF, &buffer) < 0) return fail("cannot queue buffer");
+    return complete;
+#else
+    (void)frame;
+    (void)timeout;
+    return false;
+#endif
+}
+
+bool V4L2Source::fail(const std::string& what) {
+    m_error = m_name + ": " + what + " (" + std::strerror(errno) + ")";
+    close();
+    return false;
+}
+
+void V4L2Source::close() {
+#ifdef __linux__
+    if (m_fd < 0) return;
+    if (m_streaming) {
+        v4l2_buf_type type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(m_fd, VIDIOC_STREAMOFF, &type);
+        m_streaming = false;
+    }
+    for (const Buffer& buffer : m_buffers) {
+        if (buffer.start) munmap(buffer.start, buffer.length);
+    }
+    m_buffers.clear();
+    ::close(m_fd);
+    m_fd = -1;
+#endif
+}
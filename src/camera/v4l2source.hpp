@@ -0,0 +1,44 @@
+#pragma once
+
+#include "framesource.hpp"
+#include <cstddef>
+#include <vector>
+
+// Video4Linux2 capture from a device such as /dev/video0.
+//
+// The driver fills a small ring of buffers that are mmap'd into this
+// process; read() dequeues the newest one, converts its pixels straight into
+// the caller's frame with the image kernels (split over the TaskScheduler's
+// workers at High priority, since the preview waits for it) and hands the
+// buffer back, so the image is never copied in between.
+// Timestamps come from the driver, so latency includes the time a frame
+// waited in the ring. YUYV is preferred, NV12 is the fallback. On other
+// platforms opening always fails.
+class V4L2Source : public FrameSource {
+public:
+    static const unsigned int BufferCount = 4;
+
+    V4L2Source(const std::string& device, unsigned int width, unsigned int height);
+    ~V4L2Source() override;
+
+    V4L2Source(const V4L2Source&) = delete;
+    V4L2Source& operator=(const V4L2Source&) = delete;
+
+    bool isOpen() const { return m_fd >= 0; }
+    bool read(Frame& frame, std::chrono::milliseconds timeout) override;
+
+private:
+    struct Buffer {
+        void* start = nullptr;
+        std::size_t length = 0;
+    };
+
+    int m_fd = -1;
+    std::vector<Buffer> m_buffers;
+    std::uint32_t m_pixelFormat = 0;
+    unsigned int m_bytesPerLine = 0;
+    bool m_streaming = false;
+
+    bool fail(const std::string& what);
+    void close();
+};
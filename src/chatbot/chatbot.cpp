@@ -1,8 +1,15 @@
 #include "chatbot.hpp"
 #include <iostream>
 
+namespace {
+    const char* const DocumentIndexPath = "chatbot_index.bin";
+    const std::size_t ContextPassages = 3;
+}
+
 Chatbot::Chatbot(sf::RenderWindow& window)
-    : m_window(window)
+    : m_window(window),
+      m_input(m_font, 24),
+      m_chatView(m_history, m_font)
 {
     if (!m_font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
        // Handle font loading error
@@ -15,16 +22,23 @@ Chatbot::Chatbot(sf::RenderWindow& window)
     m_inputBox.setOutlineThickness(2);
     m_inputBox.setOutlineColor(sf::Color::Black);
 
-    m_inputText.setFont(m_font);
-    m_inputText.setCharacterSize(24);
-    m_inputText.setFillColor(sf::Color::Black);
-    m_inputText.setPosition(15, m_window.getSize().y - 55);
+    m_input.setArea(sf::FloatRect(15, m_window.getSize().y - 55, m_window.getSize().x - 30, 40));
 
     m_exitButton = sf::RectangleShape(sf::Vector2f(50, 50));
     m_exitButton.setPosition(10, 10);
     m_exitButton.setFillColor(sf::Color::White);
     m_exitButton.setOutlineThickness(2);
     m_exitButton.setOutlineColor(sf::Color::Black);
+
+    m_history.open("chat_history.db");
+    m_chatView.setArea(sf::FloatRect(15, 70, m_window.getSize().x - 25, m_window.getSize().y - 140));
+
+    m_responseEngine = std::make_unique<ResponseEngine>(ResponseEngine::defaultEndpoint());
+    std::cout << "Chatbot model endpoint: " << m_responseEngine->endpoint() << std::endl;
+
+    // The previous index answers queries right away while changed documents are re-read
+    m_documents.open(DocumentIndexPath);
+    m_documents.updateAsync(DocumentIndex::defaultDocsDirectory(), DocumentIndexPath);
 }
 
 void Chatbot::handleEvent(const sf::Event& event) {
@@ -34,63 +48,129 @@ void Chatbot::handleEvent(const sf::Event& event) {
 
             if (m_exitButton.getGlobalBounds().contains(mousePos)) {
                 // Exit chatbot app
+                m_responseEngine->cancel();
                 m_shouldExit = true;
+                return;
             }
         }
-    } else if (event.type == sf::Event::TextEntered) {
-        if (event.text.unicode == 13) { // Enter key
-            sendMessage();
-        } else if (event.text.unicode == 8) { // Backspace
-            if (!m_inputText.getString().isEmpty()) {
-                m_inputText.setString(m_inputText.getString().substring(0, m_inputText.getString().getSize() - 1));
-            }
-        } else if (event.text.unicode < 128) {
-            m_inputText.setString(m_inputText.getString() + static_cast<char>(event.text.unicode));
-        }
+        m_input.handleEvent(event);
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape) {
+        // Stop the answer that is streaming in
+        m_responseEngine->cancel();
+    } else if (event.type == sf::Event::MouseWheelScrolled) {
+        m_chatView.scroll(event.mouseWheelScroll.delta * 60.f);
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::PageUp) {
+        m_chatView.scroll(m_chatView.pageHeight() * 0.9f);
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::PageDown) {
+        m_chatView.scroll(-m_chatView.pageHeight() * 0.9f);
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::End && event.key.control) {
+        // Plain End moves the input cursor
+        m_chatView.scrollToBottom();
+    } else if (event.type == sf::Event::TextEntered && event.text.unicode == 13) { // Enter key
+        sendMessage();
+    } else {
+        m_input.handleEvent(event);
     }
 }
 
 void Chatbot::draw(sf::RenderWindow& window) {
+    drainResponses();
+
     m_window.clear(sf::Color::White);  // Clear the window with a white background
     m_window.draw(m_inputBox);
-    m_window.draw(m_inputText);
+    m_input.draw(m_window);
     m_window.draw(m_exitButton);
+    m_chatView.draw(m_window);
+}
 
-    for (const auto& message : m_chatHistory) {
-        m_window.draw(message);
-    }
+void Chatbot::onSuspend() {
+    m_chatView.releaseLayouts();
+    m_history.releasePages();
+}
+
+AppMemory Chatbot::memoryUsage() const {
+    AppMemory memory;
+    memory.cpuBytes = m_history.memoryBytes() + m_chatView.memoryBytes() + m_streamedResponse.capacity();
+    return memory;
 }
 
 void Chatbot::sendMessage() {
-    std::string userMessage = m_inputText.getString();
+    std::string userMessage = m_input.toUtf8();
     if (!userMessage.empty()) {
+        if (m_activeRequest != 0) {
+            // send() cancels the reply still streaming; keep what arrived of it
+            m_streamedResponse += " [cancelled]";
+            m_history.setText(m_streamingIndex, m_streamedResponse);
+            m_history.commit(m_streamingIndex);
+            m_activeRequest = 0;
+        }
         addMessageToChatHistory(userMessage, true);
-        m_inputText.setString("");
+        m_input.clear();
 
-        // Chatbot response
-        addMessageToChatHistory("Hello world!", false);
+        // The reply streams into this entry as tokens arrive
+        m_streamingIndex = addMessageToChatHistory("", false);
+        m_chatView.scrollToBottom();
+        m_streamedResponse.clear();
+        m_context = m_documents.search(userMessage, ContextPassages);
+        m_activeRequest = m_responseEngine->send(buildPrompt(userMessage));
     }
 }
 
-void Chatbot::addMessageToChatHistory(const std::string& message, bool isUser) {
-    sf::Text chatMessage;
-    chatMessage.setFont(m_font);
-    chatMessage.setCharacterSize(20);
-    chatMessage.setFillColor(isUser ? sf::Color::Blue : sf::Color::Green);
-    chatMessage.setString(isUser ? "You: " + message : "Chatbot: " + message);
+std::string Chatbot::buildPrompt(const std::string& question) const {
+    if (m_context.empty()) return question;
 
-    float yPos = m_window.getSize().y - 120 - (m_chatHistory.size() * 30);
-    chatMessage.setPosition(15, yPos);
+    std::string prompt = "Answer the question using the following excerpts from local documents where they are relevant.\n\n";
+    for (std::size_t i = 0; i < m_context.size(); ++i) {
+        prompt += "[" + std::to_string(i + 1) + "] " + m_context[i].path + "\n" + m_context[i].text + "\n\n";
+    }
+    return prompt + "Question: " + question;
+}
 
-    m_chatHistory.push_back(chatMessage);
+void Chatbot::drainResponses() {
+    ResponseEngine::Event event;
+    while (m_responseEngine->poll(event)) {
+        // Events of replaced requests may still be queued
+        if (event.requestId != m_activeRequest) continue;
 
-    // Limit chat history to last 10 messages
-    if (m_chatHistory.size() > 10) {
-        m_chatHistory.erase(m_chatHistory.begin());
-    }
+        switch (event.type) {
+            case ResponseEngine::Event::Type::Token:
+                m_streamedResponse += event.text;
+                break;
+            case ResponseEngine::Event::Type::Done:
+                std::cout << "Response: " << event.tokenCount << " tokens, first token after " << event.timeToFirstToken
+                          << " ms, " << event.tokensPerSecond << " tokens/s" << std::endl;
+                if (!m_context.empty()) {
+                    m_streamedResponse += "\nSources:";
+                    for (const DocumentIndex::Passage& passage : m_context) {
+                        m_streamedResponse += " " + passage.path;
+                    }
+                }
+                m_activeRequest = 0;
+                break;
+            case ResponseEngine::Event::Type::Cancelled:
+                m_streamedResponse += " [cancelled]";
+                m_activeRequest = 0;
+                break;
+            case ResponseEngine::Event::Type::Error:
+                std::cerr << "Chatbot request failed: " << event.text << std::endl;
+                m_streamedResponse += "[no response: " + event.text + "]";
+                if (!m_context.empty()) {
+                    // Still show what the local documents say
+                    m_streamedResponse += "\nFrom " + m_context.front().path + ":\n" + m_context.front().text;
+                }
+                m_activeRequest = 0;
+                break;
+        }
 
-    // Adjust positions of existing messages
-    for (size_t i = 0; i < m_chatHistory.size(); ++i) {
-        m_chatHistory[i].setPosition(15, m_window.getSize().y - 120 - ((m_chatHistory.size() - i) * 30));
+        m_history.setText(m_streamingIndex, m_streamedResponse);
+        if (m_activeRequest == 0) {
+            // Only the finished reply is written to disk, not every token
+            m_history.commit(m_streamingIndex);
+        }
     }
-}
\ No newline at end of file
+}
+
+std::size_t Chatbot::addMessageToChatHistory(const std::string& message, bool isUser) {
+    // The view adds the "You: " / "Chatbot: " prefix and wraps long messages
+    return m_history.append(isUser, message);
+}
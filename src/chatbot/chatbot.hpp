@@ -1,27 +1,51 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include "chathistory.hpp"
+#include "chatview.hpp"
+#include "documentindex.hpp"
+#include "responseengine.hpp"
+#include "../ui/app.hpp"
+#include "../ui/textinput.hpp"
+#include <cstdint>
+#include <memory>
 #include <string>
 #include <vector>
 
-class Chatbot {
+class Chatbot : public App {
 public:
     Chatbot(sf::RenderWindow& window);
-    void handleEvent(const sf::Event& event);
-    void draw(sf::RenderWindow& window);
-    void resetShouldExit() { m_shouldExit = false; }
-    bool shouldReturnToMain() const { return m_shouldExit; }
+    const char* name() const override { return "Chatbot"; }
+    void handleEvent(const sf::Event& event) override;
+    void draw(sf::RenderWindow& window) override;
+    void resetShouldExit() override { m_shouldExit = false; }
+    bool shouldReturnToMain() const override { return m_shouldExit; }
+    // Drops message layouts and old history pages; the recent messages stay,
+    // a reply still streaming included
+    void onSuspend() override;
+    AppMemory memoryUsage() const override;
 
 private:
     sf::RenderWindow& m_window;
     sf::Font m_font;
-    sf::Text m_inputText;
+    TextInput m_input;
     sf::RectangleShape m_inputBox;
     sf::RectangleShape m_exitButton;
 
-    std::vector<sf::Text> m_chatHistory;
+    ChatHistory m_history;
+    ChatView m_chatView; // after m_font and m_history, which it references
+
+    std::unique_ptr<ResponseEngine> m_responseEngine;
+    std::uint64_t m_activeRequest = 0; // streams into m_streamingIndex
+    std::size_t m_streamingIndex = 0;
+    std::string m_streamedResponse;
+
+    DocumentIndex m_documents;
+    std::vector<DocumentIndex::Passage> m_context; // passages the active request was grounded on
 
     void sendMessage();
-    void addMessageToChatHistory(const std::string& message, bool isUser);
+    std::size_t addMessageToChatHistory(const std::string& message, bool isUser);
+    void drainResponses();
+    std::string buildPrompt(const std::string& question) const;
     bool m_shouldExit = false;
 };
\ No newline at end of file
@@ -0,0 +1,193 @@
+#include "chathistory.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <iostream>
+
+ChatHistory::ChatHistory()
+    : m_ring(RingCapacity)
+{
+}
+
+ChatHistory::~ChatHistory() {
+    close();
+}
+
+void ChatHistory::close() {
+    sqlite3_finalize(m_insert);
+    sqlite3_finalize(m_update);
+    sqlite3_finalize(m_selectPage);
+    m_insert = m_update = m_selectPage = nullptr;
+    if (m_db) {
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    }
+}
+
+bool ChatHistory::open(const std::string& path) {
+    close();
+    m_size = 0;
+    m_pages.clear();
+    m_pageOrder.clear();
+
+    if (sqlite3_open(path.c_str(), &m_db) != SQLITE_OK) {
+        std::cerr << "Failed to open chat history " << path << ": " << sqlite3_errmsg(m_db) << std::endl;
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return false;
+    }
+
+    const char* schema =
+        "PRAGMA journal_mode=WAL;"
+        "PRAGMA synchronous=NORMAL;"
+        "CREATE TABLE IF NOT EXISTS messages (id INTEGER PRIMARY KEY, is_user INTEGER NOT NULL, text TEXT NOT NULL);";
+    char* error = nullptr;
+    if (sqlite3_exec(m_db, schema, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::cerr << "Failed to create chat history schema: " << error << std::endl;
+        sqlite3_free(error);
+        close();
+        return false;
+    }
+
+    sqlite3_prepare_v2(m_db, "INSERT INTO messages (is_user, text) VALUES (?, ?)", -1, &m_insert, nullptr);
+    sqlite3_prepare_v2(m_db, "UPDATE messages SET text = ? WHERE id = ?", -1, &m_update, nullptr);
+    sqlite3_prepare_v2(m_db, "SELECT is_user, text FROM messages WHERE id >= ? ORDER BY id LIMIT ?", -1, &m_selectPage, nullptr);
+
+    // Messages are never deleted, so ids are dense from the first one
+    sqlite3_stmt* stmt = nullptr;
+    if (sqlite3_prepare_v2(m_db, "SELECT MIN(id), COUNT(*) FROM messages", -1, &stmt, nullptr) == SQLITE_OK &&
+        sqlite3_step(stmt) == SQLITE_ROW) {
+        m_firstRowId = sqlite3_column_type(stmt, 0) == SQLITE_NULL ? 1 : sqlite3_column_int64(stmt, 0);
+        m_size = static_cast<std::size_t>(sqlite3_column_int64(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+
+    loadTail();
+    std::cout << "Chat history: " << m_size << " messages in " << path << std::endl;
+    return true;
+}
+
+void ChatHistory::loadTail() {
+    std::size_t start = ringStart();
+    sqlite3_reset(m_selectPage);
+    sqlite3_bind_int64(m_selectPage, 1, m_firstRowId + static_cast<std::int64_t>(start));
+    sqlite3_bind_int64(m_selectPage, 2, static_cast<std::int64_t>(m_size - start));
+    for (std::size_t i = start; sqlite3_step(m_selectPage) == SQLITE_ROW; ++i) {
+        Message& message = m_ring[i % RingCapacity];
+        message.isUser = sqlite3_column_int(m_selectPage, 0) != 0;
+        const unsigned char* text = sqlite3_column_text(m_selectPage, 1);
+        message.text = text ? reinterpret_cast<const char*>(text) : "";
+        ++message.version;
+    }
+}
+
+const ChatHistory::Message& ChatHistory::at(std::size_t index) {
+    if (index >= m_size) return m_missing;
+    if (index >= ringStart()) return m_ring[index % RingCapacity];
+
+    const std::vector<Message>& messages = page(index / PageSize);
+    std::size_t offset = index % PageSize;
+    return offset < messages.size() ? messages[offset] : m_missing;
+}
+
+const std::vector<ChatHistory::Message>& ChatHistory::page(std::size_t pageIndex) {
+    auto it = m_pages.find(pageIndex);
+    if (it != m_pages.end()) {
+        m_pageOrder.splice(m_pageOrder.begin(), m_pageOrder, it->second.second);
+        return it->second.first;
+    }
+
+    if (m_pages.size() >= MaxCachedPages) {
+        m_pages.erase(m_pageOrder.back());
+        m_pageOrder.pop_back();
+    }
+
+    std::vector<Message> messages;
+    if (m_db) {
+        messages.reserve(PageSize);
+        sqlite3_reset(m_selectPage);
+        sqlite3_bind_int64(m_selectPage, 1, m_firstRowId + static_cast<std::int64_t>(pageIndex * PageSize));
+        sqlite3_bind_int64(m_selectPage, 2, static_cast<std::int64_t>(PageSize));
+        while (sqlite3_step(m_selectPage) == SQLITE_ROW) {
+            Message message;
+            message.isUser = sqlite3_column_int(m_selectPage, 0) != 0;
+            const unsigned char* text = sqlite3_column_text(m_selectPage, 1);
+            message.text = text ? reinterpret_cast<const char*>(text) : "";
+            messages.push_back(std::move(message));
+        }
+    }
+
+    m_pageOrder.push_front(pageIndex);
+    auto inserted = m_pages.emplace(pageIndex, std::make_pair(std::move(messages), m_pageOrder.begin()));
+    return inserted.first->second.first;
+}
+
+std::size_t ChatHistory::append(bool isUser, const std::string& text) {
+    std::size_t index = m_size++;
+    Message& message = m_ring[index % RingCapacity];
+    message.isUser = isUser;
+    message.text = text;
+    ++message.version;
+
+    if (m_insert) {
+        sqlite3_reset(m_insert);
+        sqlite3_bind_int(m_insert, 1, isUser ? 1 : 0);
+        sqlite3_bind_text(m_insert, 2, text.c_str(), static_cast<int>(text.size()), SQLITE_TRANSIENT);
+        if (sqlite3_step(m_insert) != SQLITE_DONE) {
+            std::cerr << "Failed to save chat message: " << sqlite3_errmsg(m_db) << std::endl;
+        }
+    }
+    return index;
+}
+
+void ChatHistory::setText(std::size_t index, const std::string& text) {
+    if (index >= m_size || index < ringStart()) return;
+    Message& message = m_ring[index % RingCapacity];
+    message.text = text;
+    ++message.version;
+}
+
+void ChatHistory::commit(std::size_t index) {
+    if (!m_update || index >= m_size || index < ringStart()) return;
+    const Message& message = m_ring[index % RingCapacity];
+    sqlite3_reset(m_update);
+    sqlite3_bind_text(m_update, 1, message.text.c_str(), static_cast<int>(message.text.size()), SQLITE_TRANSIENT);
+    sqlite3_bind_int64(m_update, 2, m_firstRowId + static_cast<std::int64_t>(index));
+    if (sqlite3_step(m_update) != SQLITE_DONE) {
+        std::cerr << "Failed to save chat message: " << sqlite3_errmsg(m_db) << std::endl;
+    }
+}
+
+void ChatHistory::appendBulk(const std::vector<Message>& messages) {
+    if (m_db) sqlite3_exec(m_db, "BEGIN", nullptr, nullptr, nullptr);
+    for (const Message& message : messages) {
+        append(message.isUser, message.text);
+    }
+    if (m_db) sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr);
+}
+
+std::size_t ChatHistory::residentMessages() const {
+    std::size_t count = std::min(m_size, RingCapacity);
+    for (const auto& entry : m_pages) {
+        count += entry.second.first.size();
+    }
+    return count;
+}
+
+void ChatHistory::releasePages() {
+    m_pages.clear();
+    m_pageOrder.clear();
+}
+
+std::size_t ChatHistory::memoryBytes() const {
+    std::size_t bytes = m_ring.capacity() * sizeof(Message);
+    for (const Message& message : m_ring) {
+        bytes += message.text.capacity();
+    }
+    for (const auto& entry : m_pages) {
+        bytes += entry.second.first.capacity() * sizeof(Message);
+        for (const Message& message : entry.second.first) {
+            bytes += message.text.capacity();
+        }
+    }
+    return bytes;
+}
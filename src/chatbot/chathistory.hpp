@@ -0,0 +1,77 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Unbounded conversation log persisted to SQLite.
+//
+// The newest messages live in a fixed-size ring buffer; older ones are read
+// back from the database in pages when scrolled to, with a small LRU of
+// pages, so memory stays flat however long the history gets. Messages are
+// addressed by index, 0 being the oldest.
+class ChatHistory {
+public:
+    struct Message {
+        bool isUser = false;
+        std::string text;
+        std::uint32_t version = 0; // bumped on every edit, for layout caches
+    };
+
+    ChatHistory();
+    ~ChatHistory();
+
+    ChatHistory(const ChatHistory&) = delete;
+    ChatHistory& operator=(const ChatHistory&) = delete;
+
+    // Loads the existing log from `path` (created if missing). Without a
+    // database the history still works, in memory only.
+    bool open(const std::string& path);
+
+    std::size_t size() const { return m_size; }
+    // The reference is only valid until the next call that changes the history or reads old pages
+    const Message& at(std::size_t index);
+
+    std::size_t append(bool isUser, const std::string& text);
+    // Edits only the in-memory copy of a recent message (e.g. a reply that
+    // is still streaming in); commit() writes it to the database
+    void setText(std::size_t index, const std::string& text);
+    void commit(std::size_t index);
+
+    // Appends many messages in one transaction (imports, benchmarks)
+    void appendBulk(const std::vector<Message>& messages);
+
+    std::size_t residentMessages() const;
+    // Drops the cached pages of old messages; they are read back when scrolled to
+    void releasePages();
+    std::size_t memoryBytes() const;
+
+private:
+    static constexpr std::size_t RingCapacity = 1024;
+    static const std::size_t PageSize = 256;
+    static const std::size_t MaxCachedPages = 8;
+
+    sqlite3* m_db = nullptr;
+    sqlite3_stmt* m_insert = nullptr;
+    sqlite3_stmt* m_update = nullptr;
+    sqlite3_stmt* m_selectPage = nullptr;
+    std::int64_t m_firstRowId = 1; // row id of message 0
+
+    std::size_t m_size = 0;
+    std::vector<Message> m_ring; // message i is at m_ring[i % RingCapacity] if i >= ringStart()
+
+    std::list<std::size_t> m_pageOrder; // most recently used first
+    std::unordered_map<std::size_t, std::pair<std::vector<Message>, std::list<std::size_t>::iterator>> m_pages;
+    Message m_missing;
+
+    std::size_t ringStart() const { return m_size > RingCapacity ? m_size - RingCapacity : 0; }
+    void close();
+    void loadTail();
+    const std::vector<Message>& page(std::size_t pageIndex);
+};
@@ -0,0 +1,219 @@
+#include "chatview.hpp"
+#include "../ui/app.hpp"
+#include <algorithm>
+
+namespace {
+    const unsigned int CharacterSize = 20;
+    const float MessageSpacing = 8.f;
+    const float ScrollbarWidth = 6.f;
+    const std::size_t MaxCachedLayouts = 512;
+}
+
+ChatView::ChatView(ChatHistory& history, const sf::Font& font)
+    : m_history(history),
+      m_font(font)
+{
+    m_scrollThumb.setFillColor(sf::Color(160, 160, 160));
+}
+
+void ChatView::setArea(const sf::FloatRect& area) {
+    if (area.width != m_area.width) {
+        // Wrapping depends on the width
+        m_layouts.clear();
+    }
+    m_area = area;
+}
+
+void ChatView::scrollToBottom() {
+    m_followBottom = true;
+    m_atTop = false;
+}
+
+void ChatView::scroll(float pixels) {
+    if (m_history.size() == 0 || pixels == 0.f) return;
+
+    if (m_followBottom) {
+        m_anchor = m_history.size() - 1;
+        m_anchorOffset = layout(m_anchor).height;
+        m_followBottom = false;
+    }
+
+    m_anchorOffset -= pixels;
+    m_atTop = false;
+    // Towards older messages
+    while (m_anchorOffset <= 0.f && m_anchor > 0) {
+        --m_anchor;
+        m_anchorOffset += layout(m_anchor).height;
+    }
+    // Towards newer messages
+    while (m_anchorOffset > layout(m_anchor).height && m_anchor + 1 < m_history.size()) {
+        m_anchorOffset -= layout(m_anchor).height;
+        ++m_anchor;
+    }
+
+    if (m_anchor + 1 == m_history.size() && m_anchorOffset >= layout(m_anchor).height) {
+        m_followBottom = true;
+        return;
+    }
+    clampToTop();
+}
+
+void ChatView::clampToTop() {
+    // Do not scroll past the point where the oldest message touches the top edge
+    float above = m_anchorOffset;
+    for (std::size_t i = m_anchor; i > 0 && above < m_area.height; --i) {
+        above += layout(i - 1).height;
+    }
+    if (above >= m_area.height) return;
+
+    m_atTop = true;
+    m_anchorOffset += m_area.height - above;
+    while (m_anchorOffset > layout(m_anchor).height && m_anchor + 1 < m_history.size()) {
+        m_anchorOffset -= layout(m_anchor).height;
+        ++m_anchor;
+    }
+    if (m_anchor + 1 == m_history.size()) {
+        m_followBottom = true;
+    }
+}
+
+void ChatView::draw(sf::RenderTarget& target) {
+    ++m_frame;
+    if (m_history.size() == 0) return;
+
+    if (m_followBottom) {
+        m_anchor = m_history.size() - 1;
+        m_anchorOffset = layout(m_anchor).height;
+    }
+
+    // Walk upwards from the anchor until the top edge is reached
+    float bottom = m_area.top + m_area.height;
+    float top = bottom - m_anchorOffset;
+    std::size_t index = m_anchor;
+    for (;;) {
+        Layout& current = layout(index);
+        float lineHeight = m_font.getLineSpacing(CharacterSize);
+        for (std::size_t line = 0; line < current.lines.size(); ++line) {
+            float y = top + line * lineHeight;
+            // Lines cut off at either edge are left out rather than clipped
+            if (y < m_area.top || y + lineHeight > bottom) continue;
+            current.lines[line].setPosition(m_area.left, y);
+            target.draw(current.lines[line]);
+        }
+
+        if (index == 0 || top <= m_area.top) break;
+        --index;
+        top -= layout(index).height;
+    }
+
+    // Approximate thumb: message position rather than pixel position
+    float fraction = m_history.size() > 1 ? static_cast<float>(m_anchor) / (m_history.size() - 1) : 1.f;
+    float thumbHeight = std::max(20.f, m_area.height / std::max<std::size_t>(1, m_history.size() / 20));
+    thumbHeight = std::min(thumbHeight, m_area.height);
+    m_scrollThumb.setSize(sf::Vector2f(ScrollbarWidth, thumbHeight));
+    m_scrollThumb.setPosition(m_area.left + m_area.width - ScrollbarWidth, m_area.top + fraction * (m_area.height - thumbHeight));
+    target.draw(m_scrollThumb);
+
+    evictLayouts();
+}
+
+ChatView::Layout& ChatView::layout(std::size_t index) {
+    const ChatHistory::Message& message = m_history.at(index);
+    Layout& cached = m_layouts[index];
+    cached.lastUsed = m_frame;
+    if (cached.version == message.version && !cached.lines.empty()) return cached;
+
+    std::string prefixed = (message.isUser ? "You: " : "Chatbot: ") + message.text;
+    sf::String text = sf::String::fromUtf8(prefixed.begin(), prefixed.end());
+    std::vector<sf::String> lines;
+    wrap(text, m_area.width - ScrollbarWidth - 4.f, lines);
+
+    cached.version = message.version;
+    cached.lines.clear();
+    cached.lines.reserve(lines.size());
+    for (const sf::String& line : lines) {
+        sf::Text lineText(line, m_font, CharacterSize);
+        lineText.setFillColor(message.isUser ? sf::Color::Blue : sf::Color::Green);
+        cached.lines.push_back(lineText);
+    }
+    cached.height = lines.size() * m_font.getLineSpacing(CharacterSize) + MessageSpacing;
+    return cached;
+}
+
+void ChatView::wrap(const sf::String& text, float width, std::vector<sf::String>& lines) const {
+    lines.clear();
+    sf::String line;
+    float lineWidth = 0.f;
+    std::size_t lastSpace = sf::String::InvalidPos; // in `line`
+    float widthAtSpace = 0.f;
+    sf::Uint32 previous = 0;
+
+    for (std::size_t i = 0; i < text.getSize(); ++i) {
+        sf::Uint32 c = text[i];
+        if (c == '\n') {
+            lines.push_back(line);
+            line.clear();
+            lineWidth = 0.f;
+            lastSpace = sf::String::InvalidPos;
+            previous = 0;
+            continue;
+        }
+
+        float advance = m_font.getGlyph(c, CharacterSize, false).advance + (previous ? m_font.getKerning(previous, c, CharacterSize) : 0.f);
+        if (lineWidth + advance > width && !line.isEmpty() && c != ' ') {
+            if (lastSpace != sf::String::InvalidPos) {
+                // Break after the last space and carry the partial word over
+                lines.push_back(line.substring(0, lastSpace));
+                line = line.substring(lastSpace + 1);
+                lineWidth -= widthAtSpace;
+            } else {
+                // A single word wider than the view is broken anywhere
+                lines.push_back(line);
+                line.clear();
+                lineWidth = 0.f;
+                advance = m_font.getGlyph(c, CharacterSize, false).advance;
+            }
+            lastSpace = sf::String::InvalidPos;
+        }
+
+        if (c == ' ') {
+            lastSpace = line.getSize();
+            widthAtSpace = lineWidth + advance;
+        }
+        line += c;
+        lineWidth += advance;
+        previous = c;
+    }
+    lines.push_back(line);
+}
+
+void ChatView::releaseLayouts() {
+    std::unordered_map<std::size_t, Layout>().swap(m_layouts);
+}
+
+std::size_t ChatView::memoryBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : m_layouts) {
+        bytes += sizeof(Layout);
+        for (const sf::Text& line : entry.second.lines) {
+            bytes += appmemory::textBytes(line);
+        }
+    }
+    return bytes;
+}
+
+void ChatView::evictLayouts() {
+    if (m_layouts.size() <= MaxCachedLayouts) return;
+
+    // Drop the least recently used layouts
+    std::vector<std::pair<std::uint64_t, std::size_t>> byAge;
+    byAge.reserve(m_layouts.size());
+    for (const auto& entry : m_layouts) {
+        byAge.emplace_back(entry.second.lastUsed, entry.first);
+    }
+    std::sort(byAge.begin(), byAge.end());
+    std::size_t excess = m_layouts.size() - MaxCachedLayouts;
+    for (std::size_t i = 0; i < excess; ++i) {
+        m_layouts.erase(byAge[i].second);
+    }
+}
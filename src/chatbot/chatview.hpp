@@ -0,0 +1,62 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "chathistory.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+// Scrollable, word-wrapped view of a ChatHistory.
+//
+// Only the messages that intersect the viewport are ever laid out; their
+// wrapped lines are cached per message (and message version) so a frame
+// without changes does no text measuring at all. The scroll position is
+// kept as "message under the bottom edge + offset into it" rather than as
+// an absolute pixel offset, so nothing ever needs the height of the whole
+// history. While scrolled to the bottom the view follows new messages.
+class ChatView {
+public:
+    ChatView(ChatHistory& history, const sf::Font& font);
+
+    void setArea(const sf::FloatRect& area);
+    // Positive values scroll towards older messages
+    void scroll(float pixels);
+    void scrollToBottom();
+    bool isAtBottom() const { return m_followBottom; }
+    bool isAtTop() const { return m_atTop; }
+    float pageHeight() const { return m_area.height; }
+
+    void draw(sf::RenderTarget& target);
+
+    std::size_t cachedLayouts() const { return m_layouts.size(); }
+    // Forgets every layout; the visible messages are wrapped again on the next draw
+    void releaseLayouts();
+    std::size_t memoryBytes() const;
+
+private:
+    struct Layout {
+        std::uint32_t version = 0;
+        std::vector<sf::Text> lines;
+        float height = 0.f; // including the spacing below the message
+        std::uint64_t lastUsed = 0;
+    };
+
+    ChatHistory& m_history;
+    const sf::Font& m_font;
+    sf::FloatRect m_area;
+
+    // The viewport's bottom edge is m_anchorOffset pixels below the top of message m_anchor
+    std::size_t m_anchor = 0;
+    float m_anchorOffset = 0.f;
+    bool m_followBottom = true;
+    bool m_atTop = false;
+
+    std::unordered_map<std::size_t, Layout> m_layouts;
+    std::uint64_t m_frame = 0;
+    sf::RectangleShape m_scrollThumb;
+
+    Layout& layout(std::size_t index);
+    void wrap(const sf::String& text, float width, std::vector<sf::String>& lines) const;
+    void clampToTop();
+    void evictLayouts();
+};
@@ -0,0 +1,718 @@
+#include "documentindex.hpp"
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+namespace bip = boost::interprocess;
+
+namespace {
+    const char Magic[8] = {'B', 'M', '2', '5', 'I', 'D', 'X', '1'};
+    const std::uint32_t FormatVersion = 1;
+    const char* const DefaultDocsDirectory = "resources/docs";
+
+    // Passage sizes in indexed words
+    const std::size_t MinPassageWords = 60;
+    const std::size_t MaxPassageWords = 200;
+    const std::size_t MaxTermLength = 32;
+    // Postings per skip entry
+    const std::uint32_t BlockSize = 128;
+
+    const float K1 = 1.2f;
+    const float B = 0.75f;
+
+    typedef std::chrono::steady_clock Clock;
+
+    // On-disk layout: Header, FileEntry[], PassageEntry[], TermEntry[] sorted
+    // by term, SkipEntry[], postings, string pool. The fixed-size sections
+    // are 8-byte aligned except SkipEntry[], which only needs 4.
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t fileCount;
+        std::uint32_t passageCount;
+        std::uint32_t termCount;
+        std::uint32_t skipCount;
+        std::uint32_t reserved;
+        double averageLength;
+        std::uint64_t filesOffset;
+        std::uint64_t passagesOffset;
+        std::uint64_t termsOffset;
+        std::uint64_t skipsOffset;
+        std::uint64_t postingsOffset;
+        std::uint64_t stringsOffset;
+        std::uint64_t totalSize;
+    };
+
+    struct FileEntry {
+        std::int64_t modified;
+        std::uint64_t size;
+        std::uint32_t firstPassage;
+        std::uint32_t passageCount;
+        std::uint32_t pathOffset;
+        std::uint32_t pathLength;
+    };
+
+    struct PassageEntry {
+        std::uint64_t offset; // bytes into the source file
+        std::uint32_t file;
+        std::uint32_t length;
+        std::uint32_t tokens;
+        std::uint32_t reserved;
+    };
+
+    struct TermEntry {
+        std::uint64_t postingsOffset; // relative to the postings section
+        std::uint32_t stringOffset;
+        std::uint32_t stringLength;
+        std::uint32_t documentFrequency;
+        std::uint32_t firstSkip; // one SkipEntry per BlockSize postings
+    };
+
+    struct SkipEntry {
+        std::uint32_t lastPassage;
+        std::uint32_t offset;  // of the block, relative to the term's postings
+        float maxWeight;       // best BM25 term weight in the block, before idf
+    };
+
+    struct Posting {
+        std::uint32_t passage;
+        std::uint32_t frequency;
+    };
+
+    bool isStopWord(const std::string& token) {
+        static const std::unordered_set<std::string> words = {
+            "a", "an", "and", "are", "as", "at", "be", "but", "by", "for", "from", "has", "have", "he", "her",
+            "his", "how", "i", "if", "in", "into", "is", "it", "its", "me", "my", "no", "not", "of", "on", "or",
+            "our", "she", "so", "that", "the", "their", "them", "then", "there", "these", "they", "this", "to",
+            "was", "we", "were", "what", "when", "where", "which", "who", "why", "will", "with", "you", "your"};
+        return words.count(token) != 0;
+    }
+
+    // Lower-cased runs of letters and digits. Bytes above 127 count as
+    // letters so UTF-8 words stay whole.
+    template <typename Callback>
+    void tokenize(const char* begin, const char* end, Callback&& callback) {
+        std::string token;
+        for (const char* p = begin;; ++p) {
+            unsigned char c = p < end ? static_cast<unsigned char>(*p) : ' ';
+            if (std::isalnum(c) || c >= 128) {
+                if (token.size() < MaxTermLength) token += static_cast<char>(std::tolower(c));
+            } else if (!token.empty()) {
+                if (token.size() > 1 && !isStopWord(token)) callback(token);
+                token.clear();
+            }
+            if (p >= end) break;
+        }
+    }
+
+    void writeVarint(std::string& out, std::uint32_t value) {
+        while (value >= 0x80) {
+            out += static_cast<char>((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    std::uint32_t readVarint(const unsigned char*& p) {
+        std::uint32_t value = 0;
+        int shift = 0;
+        while (*p & 0x80) {
+            value |= static_cast<std::uint32_t>(*p++ & 0x7f) << shift;
+            shift += 7;
+        }
+        value |= static_cast<std::uint32_t>(*p++) << shift;
+        return value;
+    }
+
+    // BM25 weight of a term occurring `frequency` times, without the idf factor
+    float termWeight(float frequency, float length, float averageLength) {
+        return frequency * (K1 + 1.f) / (frequency + K1 * (1.f - B + B * length / averageLength));
+    }
+
+    // Walks the postings of one term, skipping whole blocks where it can
+    class PostingCursor {
+    public:
+        static const std::uint32_t End = 0xffffffffu;
+
+        PostingCursor(const unsigned char* postings, const SkipEntry* skips, std::uint32_t count, float idf)
+            : m_postings(postings),
+              m_skips(skips),
+              m_blocks((count + BlockSize - 1) / BlockSize),
+              m_count(count),
+              m_idf(idf)
+        {
+            for (std::uint32_t block = 0; block < m_blocks; ++block) {
+                m_upperBound = std::max(m_upperBound, skips[block].maxWeight);
+            }
+            m_upperBound *= idf;
+            if (m_blocks == 0) return;
+            enterBlock(0);
+            next();
+        }
+
+        std::uint32_t passage() const { return m_passage; }
+        std::uint32_t frequency() const { return m_frequency; }
+        float idf() const { return m_idf; }
+        float upperBound() const { return m_upperBound; }
+
+        // Bound on the score contribution to any passage from passage() up to blockEnd()
+        float blockBound() const { return m_passage == End ? 0.f : m_idf * m_skips[m_block].maxWeight; }
+        std::uint32_t blockEnd() const { return m_passage == End ? End : m_skips[m_block].lastPassage; }
+
+        void next() {
+            if (m_left == 0) {
+                if (m_block + 1 >= m_blocks) {
+                    m_passage = End;
+                    return;
+                }
+                enterBlock(m_block + 1);
+            }
+            m_passage += readVarint(m_p);
+            m_frequency = readVarint(m_p);
+            --m_left;
+        }
+
+        // Moves to the first passage >= target
+        void seek(std::uint32_t target) {
+            if (m_passage >= target) return;
+            if (m_skips[m_block].lastPassage < target) {
+                const SkipEntry* block = std::partition_point(m_skips + m_block + 1, m_skips + m_blocks,
+                                                              [target](const SkipEntry& skip) { return skip.lastPassage < target; });
+                if (block == m_skips + m_blocks) {
+                    m_passage = End;
+                    return;
+                }
+                enterBlock(static_cast<std::uint32_t>(block - m_skips));
+                next();
+            }
+            while (m_passage < target) next();
+        }
+
+    private:
+        const unsigned char* m_postings;
+        const SkipEntry* m_skips;
+        std::uint32_t m_blocks;
+        std::uint32_t m_count;
+        float m_idf;
+        float m_upperBound = 0.f;
+
+        std::uint32_t m_block = 0;
+        std::uint32_t m_left = 0; // undecoded postings in the block
+        const unsigned char* m_p = nullptr;
+        std::uint32_t m_passage = End;
+        std::uint32_t m_frequency = 0;
+
+        void enterBlock(std::uint32_t block) {
+            m_block = block;
+            m_p = m_postings + m_skips[block].offset;
+            // Deltas continue from the previous block
+            m_passage = block ? m_skips[block - 1].lastPassage : 0;
+            m_left = std::min(BlockSize, m_count - block * BlockSize);
+        }
+    };
+
+    bool isDocument(const fs::path& path) {
+        std::string extension = path.extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return std::tolower(c); });
+        return extension == ".txt" || extension == ".md" || extension == ".markdown";
+    }
+}
+
+struct DocumentIndex::Mapping {
+    bip::file_mapping file;
+    bip::mapped_region region;
+    const Header* header = nullptr;
+    const FileEntry* files = nullptr;
+    const PassageEntry* passages = nullptr;
+    const TermEntry* terms = nullptr;
+    const SkipEntry* skips = nullptr;
+    const unsigned char* postings = nullptr;
+    const char* strings = nullptr;
+
+    std::string_view string(std::uint32_t offset, std::uint32_t length) const {
+        return std::string_view(strings + offset, length);
+    }
+
+    const TermEntry* find(std::string_view term) const {
+        const TermEntry* end = terms + header->termCount;
+        const TermEntry* it = std::lower_bound(terms, end, term, [this](const TermEntry& entry, std::string_view value) {
+            return string(entry.stringOffset, entry.stringLength) < value;
+        });
+        return it != end && string(it->stringOffset, it->stringLength) == term ? it : nullptr;
+    }
+
+    static std::shared_ptr<const Mapping> load(const std::string& path) {
+        std::error_code error;
+        if (!fs::is_regular_file(path, error) || fs::file_size(path, error) < sizeof(Header)) return nullptr;
+
+        auto mapping = std::make_shared<Mapping>();
+        try {
+            mapping->file = bip::file_mapping(path.c_str(), bip::read_only);
+            mapping->region = bip::mapped_region(mapping->file, bip::read_only);
+        } catch (const bip::interprocess_exception& e) {
+            std::cerr << "Failed to map document index " << path << ": " << e.what() << std::endl;
+            return nullptr;
+        }
+
+        const char* base = static_cast<const char*>(mapping->region.get_address());
+        const Header* header = reinterpret_cast<const Header*>(base);
+        if (std::memcmp(header->magic, Magic, sizeof(Magic)) != 0 || header->version != FormatVersion ||
+            header->totalSize != mapping->region.get_size() || header->stringsOffset > header->totalSize ||
+            header->postingsOffset > header->stringsOffset ||
+            header->skipsOffset + std::uint64_t(header->skipCount) * sizeof(SkipEntry) > header->postingsOffset ||
+            header->termsOffset + std::uint64_t(header->termCount) * sizeof(TermEntry) > header->skipsOffset ||
+            header->passagesOffset + std::uint64_t(header->passageCount) * sizeof(PassageEntry) > header->termsOffset ||
+            header->filesOffset + std::uint64_t(header->fileCount) * sizeof(FileEntry) > header->passagesOffset) {
+            std::cerr << "Ignoring invalid or outdated document index " << path << std::endl;
+            return nullptr;
+        }
+
+        mapping->header = header;
+        mapping->files = reinterpret_cast<const FileEntry*>(base + header->filesOffset);
+        mapping->passages = reinterpret_cast<const PassageEntry*>(base + header->passagesOffset);
+        mapping->terms = reinterpret_cast<const TermEntry*>(base + header->termsOffset);
+        mapping->skips = reinterpret_cast<const SkipEntry*>(base + header->skipsOffset);
+        mapping->postings = reinterpret_cast<const unsigned char*>(base + header->postingsOffset);
+        mapping->strings = base + header->stringsOffset;
+        return mapping;
+    }
+};
+
+// Passages and per-term postings of one tokenized file, with passage ids local to the file
+struct DocumentIndex::FileResult {
+    std::vector<PassageEntry> passages;
+    std::unordered_map<std::string, std::vector<Posting>> terms;
+
+    void tokenizeFile(const std::string& path) {
+        std::ifstream in(path, std::ios::binary);
+        std::string text((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        // Passages are runs of paragraphs; a Markdown heading always starts a new one
+        std::size_t passageStart = std::string::npos;
+        std::size_t passageEnd = 0;
+        std::uint32_t words = 0;
+        std::unordered_map<std::string, std::uint32_t> counts;
+
+        auto flush = [&]() {
+            if (passageStart != std::string::npos && words > 0) {
+                std::uint32_t local = static_cast<std::uint32_t>(passages.size());
+                passages.push_back({passageStart, 0, static_cast<std::uint32_t>(passageEnd - passageStart), words, 0});
+                for (const auto& count : counts) {
+                    terms[count.first].push_back({local, count.second});
+                }
+            }
+            passageStart = std::string::npos;
+            words = 0;
+            counts.clear();
+        };
+
+        for (std::size_t pos = 0; pos < text.size();) {
+            std::size_t lineEnd = std::min(text.find('\n', pos), text.size());
+            std::size_t first = text.find_first_not_of(" \t\r", pos);
+            bool blank = first == std::string::npos || first >= lineEnd;
+
+            if (blank) {
+                if (words >= MinPassageWords) flush();
+            } else {
+                if (text[first] == '#') flush();
+                if (passageStart == std::string::npos) passageStart = pos;
+                passageEnd = lineEnd;
+                tokenize(text.data() + pos, text.data() + lineEnd, [&](const std::string& token) {
+                    ++counts[token];
+                    ++words;
+                });
+                if (words >= MaxPassageWords) flush();
+            }
+            pos = lineEnd + 1;
+        }
+        flush();
+    }
+};
+
+DocumentIndex::DocumentIndex() = default;
+
+DocumentIndex::~DocumentIndex() {
+    m_stopping = true;
+    m_update.cancel();
+    m_update.wait();
+}
+
+std::string DocumentIndex::defaultDocsDirectory() {
+    const char* directory = std::getenv("CHATBOT_DOCS");
+    return directory && *directory ? directory : DefaultDocsDirectory;
+}
+
+std::shared_ptr<const DocumentIndex::Mapping> DocumentIndex::mapping() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_mapping;
+}
+
+bool DocumentIndex::open(const std::string& indexPath) {
+    std::shared_ptr<const Mapping> mapped = Mapping::load(indexPath);
+    if (!mapped) return false;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_mapping = mapped;
+    return true;
+}
+
+std::size_t DocumentIndex::passageCount() const {
+    std::shared_ptr<const Mapping> index = mapping();
+    return index ? index->header->passageCount : 0;
+}
+
+void DocumentIndex::updateAsync(const std::string& docsDirectory, const std::string& indexPath) {
+    m_update.wait();
+    TaskScheduler::instance().submit(TaskScheduler::Priority::Low, m_update, [this, docsDirectory, indexPath] {
+        BuildStats stats;
+        if (update(docsDirectory, indexPath, 0, &stats)) {
+            std::cout << "Document index: " << stats.passages << " passages from " << stats.files << " files ("
+                      << stats.filesTokenized << " re-read) in " << stats.seconds << " s" << std::endl;
+        }
+    });
+}
+
+bool DocumentIndex::update(const std::string& docsDirectory, const std::string& indexPath, unsigned int threadCount, BuildStats* stats) {
+    Clock::time_point start = Clock::now();
+    std::error_code error;
+    if (!fs::is_directory(docsDirectory, error)) {
+        std::cerr << "Document directory " << docsDirectory << " not found" << std::endl;
+        return false;
+    }
+
+    struct SourceFile {
+        std::string path;
+        std::int64_t modified;
+        std::uint64_t size;
+    };
+    std::vector<SourceFile> sources;
+    for (fs::recursive_directory_iterator it(docsDirectory, fs::directory_options::skip_permission_denied, error), end;
+         !error && it != end; it.increment(error)) {
+        std::error_code fileError;
+        if (!it->is_regular_file(fileError) || !isDocument(it->path())) continue;
+        SourceFile source;
+        source.path = it->path().generic_string();
+        source.modified = static_cast<std::int64_t>(it->last_write_time(fileError).time_since_epoch().count());
+        source.size = it->file_size(fileError);
+        if (!fileError) sources.push_back(std::move(source));
+    }
+    std::sort(sources.begin(), sources.end(), [](const SourceFile& a, const SourceFile& b) { return a.path < b.path; });
+
+    // Files with the same size and time as in the current index keep their passages and postings
+    std::shared_ptr<const Mapping> previous = Mapping::load(indexPath);
+    std::vector<std::int64_t> reused(sources.size(), -1);
+    if (previous) {
+        std::unordered_map<std::string_view, std::uint32_t> previousFiles;
+        for (std::uint32_t i = 0; i < previous->header->fileCount; ++i) {
+            previousFiles.emplace(previous->string(previous->files[i].pathOffset, previous->files[i].pathLength), i);
+        }
+        for (std::size_t i = 0; i < sources.size(); ++i) {
+            auto it = previousFiles.find(sources[i].path);
+            if (it != previousFiles.end() && previous->files[it->second].modified == sources[i].modified &&
+                previous->files[it->second].size == sources[i].size) {
+                reused[i] = it->second;
+            }
+        }
+    }
+
+    std::vector<FileResult> results(sources.size());
+    std::vector<std::size_t> changed;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        if (reused[i] < 0) changed.push_back(i);
+    }
+    const std::size_t tokenized = changed.size();
+    // Each lane tokenizes files until none is left, so at most threadCount run at once
+    const std::size_t lanes = threadCount ? std::min<std::size_t>(threadCount, tokenized) : tokenized;
+    std::atomic<std::size_t> next{0};
+    TaskScheduler::instance().parallelFor(TaskScheduler::Priority::Low, lanes, [&](std::size_t) {
+        for (std::size_t k = next++; k < tokenized && !m_stopping; k = next++) {
+            results[changed[k]].tokenizeFile(sources[changed[k]].path);
+        }
+    });
+    if (m_stopping) return false;
+
+    // Passage ids follow file order
+    std::vector<FileEntry> files(sources.size());
+    std::vector<PassageEntry> passages;
+    std::vector<std::uint32_t> remap; // previous passage id -> new id + 1, 0 if dropped
+    if (previous) remap.assign(previous->header->passageCount, 0);
+    std::string strings;
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        FileEntry& entry = files[i];
+        entry.modified = sources[i].modified;
+        entry.size = sources[i].size;
+        entry.firstPassage = static_cast<std::uint32_t>(passages.size());
+        entry.pathOffset = static_cast<std::uint32_t>(strings.size());
+        entry.pathLength = static_cast<std::uint32_t>(sources[i].path.size());
+        strings += sources[i].path;
+
+        if (reused[i] >= 0) {
+            const FileEntry& old = previous->files[reused[i]];
+            for (std::uint32_t p = 0; p < old.passageCount; ++p) {
+                remap[old.firstPassage + p] = static_cast<std::uint32_t>(passages.size()) + 1;
+                passages.push_back(previous->passages[old.firstPassage + p]);
+                passages.back().file = static_cast<std::uint32_t>(i);
+            }
+        } else {
+            for (PassageEntry passage : results[i].passages) {
+                passage.file = static_cast<std::uint32_t>(i);
+                passages.push_back(passage);
+            }
+        }
+        entry.passageCount = static_cast<std::uint32_t>(passages.size()) - entry.firstPassage;
+    }
+
+    std::unordered_map<std::string, std::vector<Posting>> postings;
+    if (previous) {
+        for (std::uint32_t t = 0; t < previous->header->termCount; ++t) {
+            const TermEntry& term = previous->terms[t];
+            std::vector<Posting>* target = nullptr;
+            const unsigned char* p = previous->postings + term.postingsOffset;
+            std::uint32_t passage = 0;
+            for (std::uint32_t k = 0; k < term.documentFrequency; ++k) {
+                passage += readVarint(p);
+                std::uint32_t frequency = readVarint(p);
+                if (remap[passage] == 0) continue;
+                if (!target) target = &postings[std::string(previous->string(term.stringOffset, term.stringLength))];
+                target->push_back({remap[passage] - 1, frequency});
+            }
+        }
+    }
+    for (std::size_t i = 0; i < sources.size(); ++i) {
+        if (reused[i] >= 0) continue;
+        for (auto& term : results[i].terms) {
+            std::vector<Posting>& target = postings[term.first];
+            for (const Posting& posting : term.second) {
+                target.push_back({files[i].firstPassage + posting.passage, posting.frequency});
+            }
+        }
+        results[i] = FileResult();
+    }
+
+    std::vector<const std::pair<const std::string, std::vector<Posting>>*> sortedTerms;
+    sortedTerms.reserve(postings.size());
+    for (auto& term : postings) {
+        // Carried over and new postings interleave
+        std::sort(term.second.begin(), term.second.end(), [](const Posting& a, const Posting& b) { return a.passage < b.passage; });
+        sortedTerms.push_back(&term);
+    }
+    std::sort(sortedTerms.begin(), sortedTerms.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+
+    double totalTokens = 0.0;
+    for (const PassageEntry& passage : passages) {
+        totalTokens += passage.tokens;
+    }
+    const double averageLength = passages.empty() ? 0.0 : totalTokens / passages.size();
+    const float weightAverage = static_cast<float>(std::max(averageLength, 1.0));
+
+    std::vector<TermEntry> terms;
+    terms.reserve(sortedTerms.size());
+    std::vector<SkipEntry> skips;
+    std::string encoded;
+    for (const auto* term : sortedTerms) {
+        TermEntry entry;
+        entry.postingsOffset = encoded.size();
+        entry.stringOffset = static_cast<std::uint32_t>(strings.size());
+        entry.stringLength = static_cast<std::uint32_t>(term->first.size());
+        entry.documentFrequency = static_cast<std::uint32_t>(term->second.size());
+        entry.firstSkip = static_cast<std::uint32_t>(skips.size());
+        strings += term->first;
+
+        // Deltas run on across blocks; a block is entered with the previous block's last passage
+        std::uint32_t last = 0;
+        for (std::size_t k = 0; k < term->second.size(); ++k) {
+            const Posting& posting = term->second[k];
+            if (k % BlockSize == 0) {
+                skips.push_back({0, static_cast<std::uint32_t>(encoded.size() - entry.postingsOffset), 0.f});
+            }
+            writeVarint(encoded, posting.passage - last);
+            writeVarint(encoded, posting.frequency);
+            last = posting.passage;
+            SkipEntry& skip = skips.back();
+            skip.lastPassage = posting.passage;
+            skip.maxWeight = std::max(skip.maxWeight, termWeight(static_cast<float>(posting.frequency),
+                                                                 static_cast<float>(passages[posting.passage].tokens), weightAverage));
+        }
+        terms.push_back(entry);
+    }
+    postings.clear();
+
+    Header header;
+    std::memcpy(header.magic, Magic, sizeof(Magic));
+    header.version = FormatVersion;
+    header.fileCount = static_cast<std::uint32_t>(files.size());
+    header.passageCount = static_cast<std::uint32_t>(passages.size());
+    header.termCount = static_cast<std::uint32_t>(terms.size());
+    header.skipCount = static_cast<std::uint32_t>(skips.size());
+    header.reserved = 0;
+    header.averageLength = averageLength;
+    header.filesOffset = sizeof(Header);
+    header.passagesOffset = header.filesOffset + files.size() * sizeof(FileEntry);
+    header.termsOffset = header.passagesOffset + passages.size() * sizeof(PassageEntry);
+    header.skipsOffset = header.termsOffset + terms.size() * sizeof(TermEntry);
+    header.postingsOffset = header.skipsOffset + skips.size() * sizeof(SkipEntry);
+    header.stringsOffset = header.postingsOffset + encoded.size();
+    header.totalSize = header.stringsOffset + strings.size();
+
+    const std::string temporaryPath = indexPath + ".tmp";
+    {
+        std::ofstream out(temporaryPath, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(reinterpret_cast<const char*>(files.data()), files.size() * sizeof(FileEntry));
+        out.write(reinterpret_cast<const char*>(passages.data()), passages.size() * sizeof(PassageEntry));
+        out.write(reinterpret_cast<const char*>(terms.data()), terms.size() * sizeof(TermEntry));
+        out.write(reinterpret_cast<const char*>(skips.data()), skips.size() * sizeof(SkipEntry));
+        out.write(encoded.data(), encoded.size());
+        out.write(strings.data(), strings.size());
+        if (!out) {
+            std::cerr << "Failed to write document index " << temporaryPath << std::endl;
+            return false;
+        }
+    }
+
+    // Windows cannot replace a file that is still mapped
+    previous.reset();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_mapping.reset();
+    }
+    fs::rename(temporaryPath, indexPath, error);
+    for (int attempt = 0; error && attempt < 100; ++attempt) {
+        // A search() on another thread may still hold the old mapping for a moment
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        fs::rename(temporaryPath, indexPath, error);
+    }
+    if (error) {
+        std::cerr << "Failed to replace document index " << indexPath << ": " << error.message() << std::endl;
+    }
+    bool opened = open(indexPath);
+
+    if (stats) {
+        stats->files = files.size();
+        stats->filesTokenized = tokenized;
+        stats->passages = passages.size();
+        stats->terms = terms.size();
+        stats->indexBytes = header.totalSize;
+        stats->seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+    return opened && !error;
+}
+
+std::vector<DocumentIndex::Passage> DocumentIndex::search(const std::string& query, std::size_t limit) const {
+    std::vector<Passage> found;
+    std::shared_ptr<const Mapping> index = mapping();
+    if (!index || limit == 0 || index->header->passageCount == 0) return found;
+
+    std::vector<std::string> terms;
+    tokenize(query.data(), query.data() + query.size(), [&terms](const std::string& token) {
+        if (std::find(terms.begin(), terms.end(), token) == terms.end()) terms.push_back(token);
+    });
+
+    const float passageCount = static_cast<float>(index->header->passageCount);
+    std::vector<PostingCursor> cursors;
+    for (const std::string& term : terms) {
+        const TermEntry* entry = index->find(term);
+        if (!entry) continue;
+        float frequency = static_cast<float>(entry->documentFrequency);
+        float idf = std::log(1.f + (passageCount - frequency + 0.5f) / (frequency + 0.5f));
+        cursors.emplace_back(index->postings + entry->postingsOffset, index->skips + entry->firstSkip, entry->documentFrequency, idf);
+    }
+
+    // MaxScore: with cursors ordered by upper bound, a prefix whose bounds
+    // add up to no more than the current k-th best score cannot bring a new
+    // passage into the results on its own. Those cursors are only consulted
+    // for candidates found by the others, by seeking; the rest are walked.
+    std::sort(cursors.begin(), cursors.end(), [](const PostingCursor& a, const PostingCursor& b) { return a.upperBound() < b.upperBound(); });
+    std::vector<float> prefixBound(cursors.size());
+    float bound = 0.f;
+    for (std::size_t i = 0; i < cursors.size(); ++i) {
+        bound += cursors[i].upperBound();
+        prefixBound[i] = bound;
+    }
+
+    typedef std::pair<float, std::uint32_t> Scored;
+    // Higher score first, then lower passage id; the heap keeps the worst result on top
+    auto better = [](const Scored& a, const Scored& b) { return a.first > b.first || (a.first == b.first && a.second < b.second); };
+    std::vector<Scored> results;
+    float threshold = 0.f;
+    std::size_t firstEssential = 0;
+    const float averageLength = static_cast<float>(std::max(index->header->averageLength, 1.0));
+
+    for (;;) {
+        std::uint32_t candidate = PostingCursor::End;
+        for (std::size_t i = firstEssential; i < cursors.size(); ++i) {
+            candidate = std::min(candidate, cursors[i].passage());
+        }
+        if (candidate == PostingCursor::End) break;
+
+        const float nonEssential = firstEssential ? prefixBound[firstEssential - 1] : 0.f;
+        if (results.size() == limit) {
+            // Skip ahead when no passage up to the nearest block end can beat the threshold
+            float blockBound = nonEssential;
+            std::uint32_t blockEnd = PostingCursor::End;
+            for (std::size_t i = firstEssential; i < cursors.size(); ++i) {
+                blockBound += cursors[i].blockBound();
+                blockEnd = std::min(blockEnd, cursors[i].blockEnd());
+            }
+            if (blockBound <= threshold) {
+                for (std::size_t i = firstEssential; i < cursors.size(); ++i) {
+                    cursors[i].seek(blockEnd + 1);
+                }
+                continue;
+            }
+        }
+
+        float length = static_cast<float>(index->passages[candidate].tokens);
+        float score = 0.f;
+        for (std::size_t i = firstEssential; i < cursors.size(); ++i) {
+            if (cursors[i].passage() != candidate) continue;
+            score += cursors[i].idf() * termWeight(static_cast<float>(cursors[i].frequency()), length, averageLength);
+            cursors[i].next();
+        }
+        for (std::size_t i = firstEssential; i-- > 0;) {
+            if (score + prefixBound[i] <= threshold) break;
+            cursors[i].seek(candidate);
+            if (cursors[i].passage() == candidate) {
+                score += cursors[i].idf() * termWeight(static_cast<float>(cursors[i].frequency()), length, averageLength);
+            }
+        }
+
+        if (results.size() == limit && score <= threshold) continue;
+        results.emplace_back(score, candidate);
+        std::push_heap(results.begin(), results.end(), better);
+        if (results.size() > limit) {
+            std::pop_heap(results.begin(), results.end(), better);
+            results.pop_back();
+        }
+        if (results.size() == limit) {
+            threshold = results.front().first;
+            while (firstEssential < cursors.size() && prefixBound[firstEssential] <= threshold) ++firstEssential;
+        }
+    }
+    std::sort_heap(results.begin(), results.end(), better);
+
+    for (const Scored& result : results) {
+        const PassageEntry& entry = index->passages[result.second];
+        Passage passage;
+        passage.path = std::string(index->string(index->files[entry.file].pathOffset, index->files[entry.file].pathLength));
+        passage.score = result.first;
+        passage.text.resize(entry.length);
+        std::ifstream in(passage.path, std::ios::binary);
+        if (!in.seekg(static_cast<std::streamoff>(entry.offset)) || !in.read(&passage.text[0], entry.length)) {
+            continue; // the file changed or went away since the last update
+        }
+        found.push_back(std::move(passage));
+    }
+    return found;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include "../utils/taskscheduler.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// BM25 full-text index over a directory of text and Markdown files, used
+// to ground chatbot answers in local documents.
+//
+// Files are split into passages of a few paragraphs. The index is a single
+// file with a sorted term dictionary and delta + varint coded postings; it
+// is memory-mapped, so opening it costs nothing and queries only touch the
+// postings of the query terms. Passage text is not stored but read back
+// from the source file for the few passages returned.
+//
+// Rebuilding tokenizes only files whose size or modification time changed
+// (in parallel, as Low priority TaskScheduler tasks); postings of unchanged files are carried over from the
+// current index.
+class DocumentIndex {
+public:
+    struct Passage {
+        std::string path;
+        std::string text;
+        float score = 0.f;
+    };
+
+    struct BuildStats {
+        std::size_t files = 0;
+        std::size_t filesTokenized = 0;
+        std::size_t passages = 0;
+        std::size_t terms = 0;
+        std::uint64_t indexBytes = 0;
+        double seconds = 0.0;
+    };
+
+    DocumentIndex();
+    ~DocumentIndex();
+
+    DocumentIndex(const DocumentIndex&) = delete;
+    DocumentIndex& operator=(const DocumentIndex&) = delete;
+
+    // $CHATBOT_DOCS, or resources/docs
+    static std::string defaultDocsDirectory();
+
+    // Maps an existing index; returns false if there is none or it is invalid
+    bool open(const std::string& indexPath);
+
+    // Brings the index at `indexPath` up to date with `docsDirectory` and
+    // maps the result. Blocks; files are tokenized on up to threadCount
+    // scheduler workers at once, 0: all of them.
+    bool update(const std::string& docsDirectory, const std::string& indexPath, unsigned int threadCount = 0, BuildStats* stats = nullptr);
+    // Runs update() as a Low priority task; search() keeps using the old index meanwhile
+    void updateAsync(const std::string& docsDirectory, const std::string& indexPath);
+
+    // Best passages for `query`, highest score first. Thread safe.
+    std::vector<Passage> search(const std::string& query, std::size_t limit) const;
+
+    std::size_t passageCount() const;
+
+private:
+    struct Mapping;
+    struct FileResult;
+
+    std::shared_ptr<const Mapping> m_mapping;
+    mutable std::mutex m_mutex; // guards m_mapping
+    CancellationToken m_update;
+    std::atomic<bool> m_stopping{false};
+
+    std::shared_ptr<const Mapping> mapping() const;
+};
@@ -0,0 +1,246 @@
+#include "responseengine.hpp"
+#include "../utils/json.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+namespace {
+    const char* const DefaultEndpoint = "http://127.0.0.1:8081/generate";
+    const long ConnectTimeoutMs = 3000;
+
+    typedef std::chrono::steady_clock Clock;
+}
+
+// Per-request state shared with the curl callbacks
+struct ResponseEngine::Transfer {
+    ResponseEngine* engine;
+    std::uint64_t requestId;
+    Clock::time_point start;
+    Clock::time_point firstToken;
+    std::size_t tokenCount = 0;
+    std::string pending; // incomplete line
+    bool plainText = false;
+    bool formatKnown = false;
+    bool done = false;
+
+    void emit(const std::string& text) {
+        if (text.empty()) return;
+        if (tokenCount == 0) firstToken = Clock::now();
+        ++tokenCount;
+
+        Event event;
+        event.type = Event::Type::Token;
+        event.requestId = requestId;
+        event.text = text;
+        engine->publish(std::move(event));
+    }
+
+    void handleLine(std::string line) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty()) return;
+
+        // Server-sent events
+        if (line.compare(0, 5, "data:") == 0) {
+            line.erase(0, line.find_first_not_of(' ', 5));
+            if (line == "[DONE]") {
+                done = true;
+                return;
+            }
+        }
+
+        std::string token;
+        if (json::findString(line, "response", token) || json::findString(line, "content", token) ||
+            json::findString(line, "token", token)) {
+            emit(token);
+        }
+        bool finished = false;
+        if (json::findBool(line, "done", finished) && finished) {
+            done = true;
+        }
+    }
+
+    void receive(const char* data, std::size_t size) {
+        if (!formatKnown) {
+            // Decide on the first bytes whether the reply is structured
+            std::size_t first = 0;
+            while (first < size && std::isspace(static_cast<unsigned char>(data[first]))) ++first;
+            if (first == size) return;
+            plainText = data[first] != '{' && std::string(data + first, std::min<std::size_t>(size - first, 5)) != "data:";
+            formatKnown = true;
+        }
+
+        if (plainText) {
+            emit(std::string(data, size));
+            return;
+        }
+
+        pending.append(data, size);
+        std::size_t lineStart = 0;
+        std::size_t newline;
+        while (!done && (newline = pending.find('\n', lineStart)) != std::string::npos) {
+            handleLine(pending.substr(lineStart, newline - lineStart));
+            lineStart = newline + 1;
+        }
+        pending.erase(0, lineStart);
+    }
+
+    static std::size_t onWrite(char* data, std::size_t size, std::size_t count, void* user) {
+        Transfer* transfer = static_cast<Transfer*>(user);
+        if (transfer->engine->isCancelled(transfer->requestId)) return 0; // aborts the transfer
+        transfer->receive(data, size * count);
+        return size * count;
+    }
+
+    static int onProgress(void* user, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+        // Also called while waiting for the first byte, so a cancel is noticed promptly
+        Transfer* transfer = static_cast<Transfer*>(user);
+        return transfer->engine->isCancelled(transfer->requestId) || transfer->engine->m_stopping ? 1 : 0;
+    }
+};
+
+ResponseEngine::ResponseEngine(const std::string& endpoint)
+    : m_endpoint(endpoint)
+{
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    m_worker = std::thread(&ResponseEngine::workerLoop, this);
+}
+
+ResponseEngine::~ResponseEngine() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_cancelledUpTo = m_nextId.load();
+    m_requestAvailable.notify_all();
+    m_worker.join();
+    curl_global_cleanup();
+}
+
+std::string ResponseEngine::defaultEndpoint() {
+    const char* endpoint = std::getenv("CHATBOT_ENDPOINT");
+    return endpoint && *endpoint ? endpoint : DefaultEndpoint;
+}
+
+std::uint64_t ResponseEngine::send(const std::string& prompt) {
+    std::uint64_t id = m_nextId++;
+    m_cancelledUpTo = id - 1;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingPrompt = prompt;
+        m_pendingId = id;
+    }
+    m_busy = true;
+    m_requestAvailable.notify_one();
+    return id;
+}
+
+void ResponseEngine::cancel() {
+    m_cancelledUpTo = m_nextId - 1;
+}
+
+bool ResponseEngine::poll(Event& event) {
+    return m_events.pop(event);
+}
+
+void ResponseEngine::publish(Event&& event) {
+    while (!m_events.push(event)) {
+        // The UI has not drained the queue yet; tokens of a cancelled request can go
+        if (m_stopping || (event.type == Event::Type::Token && isCancelled(event.requestId))) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+void ResponseEngine::workerLoop() {
+    for (;;) {
+        std::string prompt;
+        std::uint64_t id;
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_requestAvailable.wait(lock, [this] { return m_stopping || m_pendingId != 0; });
+            if (m_stopping) return;
+            prompt.swap(m_pendingPrompt);
+            id = m_pendingId;
+            m_pendingId = 0;
+        }
+
+        run(id, prompt);
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pendingId == 0) m_busy = false;
+    }
+}
+
+void ResponseEngine::run(std::uint64_t requestId, const std::string& prompt) {
+    Transfer transfer;
+    transfer.engine = this;
+    transfer.requestId = requestId;
+    transfer.start = Clock::now();
+
+    Event result;
+    result.requestId = requestId;
+
+    if (isCancelled(requestId)) {
+        result.type = Event::Type::Cancelled;
+        publish(std::move(result));
+        return;
+    }
+
+    CURL* curl = curl_easy_init();
+    if (!curl) {
+        result.type = Event::Type::Error;
+        result.text = "curl_easy_init failed";
+        publish(std::move(result));
+        return;
+    }
+
+    std::string body = "{\"prompt\":\"" + json::escape(prompt) + "\",\"stream\":true}";
+    curl_slist* headers = curl_slist_append(nullptr, "Content-Type: application/json");
+
+    curl_easy_setopt(curl, CURLOPT_URL, m_endpoint.c_str());
+    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, body.c_str());
+    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, static_cast<long>(body.size()));
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &Transfer::onWrite);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &transfer);
+    curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+    curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &Transfer::onProgress);
+    curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &transfer);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, ConnectTimeoutMs);
+    curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1L);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+
+    CURLcode code = curl_easy_perform(curl);
+    long status = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+    curl_slist_free_all(headers);
+    curl_easy_cleanup(curl);
+
+    if (!transfer.pending.empty() && !transfer.done && !isCancelled(requestId)) {
+        transfer.handleLine(transfer.pending);
+    }
+
+    if (isCancelled(requestId)) {
+        result.type = Event::Type::Cancelled;
+    } else if (code != CURLE_OK) {
+        result.type = Event::Type::Error;
+        result.text = curl_easy_strerror(code);
+    } else if (status >= 400) {
+        result.type = Event::Type::Error;
+        result.text = "HTTP " + std::to_string(status);
+    } else {
+        result.type = Event::Type::Done;
+    }
+
+    result.tokenCount = transfer.tokenCount;
+    if (transfer.tokenCount > 0) {
+        Clock::time_point end = Clock::now();
+        result.timeToFirstToken = std::chrono::duration<double, std::milli>(transfer.firstToken - transfer.start).count();
+        // Rate of the stream itself, excluding the wait for the first token
+        double streamSeconds = std::chrono::duration<double>(end - transfer.firstToken).count();
+        result.tokensPerSecond = transfer.tokenCount > 1 && streamSeconds > 0.0 ? (transfer.tokenCount - 1) / streamSeconds : 0.0;
+    }
+    publish(std::move(result));
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Sends chat prompts to a local HTTP model endpoint and streams the reply
+// back without blocking the UI.
+//
+// Requests run on one worker thread through libcurl. Tokens are pushed into
+// a single-producer/single-consumer lock-free queue that the UI thread
+// drains with poll() once per frame. Sending a new prompt or calling
+// cancel() aborts the request in flight.
+//
+// The endpoint receives {"prompt": "...", "stream": true} and may answer
+// with newline-delimited JSON ({"response": "..."} or {"content": "..."},
+// optionally "done": true), server-sent events ("data: ...") or plain text.
+class ResponseEngine {
+public:
+    struct Event {
+        enum class Type {
+            Token,
+            Done,
+            Cancelled,
+            Error
+        };
+
+        Type type = Type::Token;
+        std::uint64_t requestId = 0;
+        std::string text; // token text, or the error message
+
+        // Set on Done
+        double timeToFirstToken = 0.0; // milliseconds
+        double tokensPerSecond = 0.0;
+        std::size_t tokenCount = 0;
+    };
+
+    explicit ResponseEngine(const std::string& endpoint);
+    ~ResponseEngine();
+
+    ResponseEngine(const ResponseEngine&) = delete;
+    ResponseEngine& operator=(const ResponseEngine&) = delete;
+
+    // Queues `prompt`, cancelling any request still in flight. Returns the id
+    // that the events for this request will carry.
+    std::uint64_t send(const std::string& prompt);
+    void cancel();
+
+    // UI thread only: takes the next event, if any
+    bool poll(Event& event);
+
+    bool isBusy() const { return m_busy; }
+    const std::string& endpoint() const { return m_endpoint; }
+
+    // Endpoint from $CHATBOT_ENDPOINT, or a local default
+    static std::string defaultEndpoint();
+
+private:
+    std::string m_endpoint;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_requestAvailable;
+    std::string m_pendingPrompt;
+    std::uint64_t m_pendingId = 0;
+    std::atomic<bool> m_stopping{false};
+
+    std::atomic<std::uint64_t> m_nextId{1};
+    // Every request with an id up to this one is cancelled
+    std::atomic<std::uint64_t> m_cancelledUpTo{0};
+    std::atomic<bool> m_busy{false};
+
+    boost::lockfree::spsc_queue<Event, boost::lockfree::capacity<1024>> m_events;
+
+    struct Transfer;
+    friend struct Transfer;
+
+    void workerLoop();
+    void run(std::uint64_t requestId, const std::string& prompt);
+    bool isCancelled(std::uint64_t requestId) const { return requestId <= m_cancelledUpTo; }
+    // Blocks while the queue is full unless the request gets cancelled
+    void publish(Event&& event);
+};
@@ -0,0 +1,55 @@
+#include "stubmodel.hpp"
+#include "../utils/json.hpp"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+StubModel::StubModel(int firstTokenDelayMs, double tokensPerSecond, int tokenCount)
+    : m_firstTokenDelayMs(firstTokenDelayMs),
+      m_tokensPerSecond(tokensPerSecond),
+      m_tokenCount(tokenCount)
+{
+}
+
+void StubModel::handle(const HttpRequest& request, HttpResponse& response) const {
+    if (request.method != "POST") {
+        response.status = 405;
+        response.body = "POST a JSON body with a \"prompt\"";
+        return;
+    }
+
+    std::string prompt;
+    json::findString(request.body, "prompt", prompt);
+
+    // Echo the prompt's words, then filler, one token per word
+    auto words = std::make_shared<std::vector<std::string>>();
+    std::istringstream stream("You said: " + prompt);
+    std::string word;
+    while (std::getline(stream, word, ' ')) {
+        if (!word.empty()) words->push_back(word);
+    }
+    for (std::size_t i = 0; words->size() < static_cast<std::size_t>(m_tokenCount); ++i) {
+        words->push_back("token" + std::to_string(i));
+    }
+    words->resize(static_cast<std::size_t>(m_tokenCount));
+
+    auto next = std::make_shared<std::size_t>(0);
+    auto interval = std::chrono::microseconds(static_cast<long long>(1e6 / std::max(m_tokensPerSecond, 1e-3)));
+    auto firstDelay = std::chrono::milliseconds(m_firstTokenDelayMs);
+
+    response.contentType = "application/x-ndjson";
+    response.stream = [words, next, interval, firstDelay](std::string& chunk) {
+        std::this_thread::sleep_for(*next == 0 ? std::chrono::duration_cast<std::chrono::microseconds>(firstDelay) : interval);
+        if (*next >= words->size()) {
+            chunk = "{\"response\":\"\",\"done\":true}\n";
+            return false;
+        }
+        std::string token = (*next > 0 ? " " : "") + (*words)[*next];
+        ++*next;
+        chunk = "{\"response\":\"" + json::escape(token) + "\",\"done\":false}\n";
+        return true;
+    };
+}
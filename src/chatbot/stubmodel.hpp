@@ -0,0 +1,20 @@
+#pragma once
+
+#include "../net/httpserver.hpp"
+
+// Stand-in for a local language model server, used to exercise the
+// ResponseEngine without a real model. Answers any POST with a streamed
+// newline-delimited JSON reply ({"response": "<token>"} per line, then
+// {"done": true}) at a fixed pace.
+class StubModel {
+public:
+    StubModel(int firstTokenDelayMs, double tokensPerSecond, int tokenCount);
+
+    // HttpServer handler; blocks a server thread while streaming
+    void handle(const HttpRequest& request, HttpResponse& response) const;
+
+private:
+    int m_firstTokenDelayMs;
+    double m_tokensPerSecond;
+    int m_tokenCount;
+};
@@ -0,0 +1,61 @@
+#include "commands.hpp"
+#include "../camera/capturepipeline.hpp"
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+// Runs the capture pipeline headless against any frame source while a
+// stand-in renderer takes the newest frame at --fps and copies it the way a
+// texture upload would, then prints captured, displayed and dropped frames
+// and capture-to-display latency.
+int runBenchCapture(const CommandLine& args) {
+    const std::string spec = args.getString("source", "pattern:1280x720@60");
+    const int seconds = args.getInt("seconds", 10);
+    const int fps = args.getInt("fps", 60);
+    if (seconds <= 0 || fps <= 0) {
+        std::cerr << "bench-capture: --seconds and --fps must be positive" << std::endl;
+        return 1;
+    }
+
+    CapturePipeline pipeline;
+    if (!pipeline.start(createFrameSource(spec))) return 1;
+    std::vector<std::uint8_t> upload(static_cast<std::size_t>(pipeline.width()) * pipeline.height() * 4);
+
+    typedef std::chrono::steady_clock Clock;
+    const Clock::duration interval = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+    Clock::time_point end = Clock::now() + std::chrono::seconds(seconds);
+    Clock::time_point nextFrame = Clock::now();
+    Clock::time_point nextReport = Clock::now() + std::chrono::seconds(1);
+    std::cout << std::fixed << std::setprecision(2);
+    while (Clock::now() < end && pipeline.isRunning()) {
+        std::this_thread::sleep_until(nextFrame);
+        nextFrame += interval;
+        if (const Frame* frame = pipeline.latest()) {
+            std::memcpy(upload.data(), frame->pixels.data(), upload.size());
+            pipeline.presented(*frame);
+        }
+
+        if (Clock::now() >= nextReport) {
+            nextReport += std::chrono::seconds(1);
+            CapturePipeline::Stats stats = pipeline.stats();
+            std::cout << stats.captured << " captured, " << stats.displayed << " displayed, " << stats.dropped << " dropped, "
+                      << stats.sourceDropped << " lost by source | latency avg " << stats.averageLatencyMilliseconds
+                      << " ms  p99 " << stats.p99LatencyMilliseconds << " ms  max " << stats.maxLatencyMilliseconds << " ms" << std::endl;
+        }
+    }
+
+    if (!pipeline.error().empty()) {
+        std::cerr << "bench-capture: " << pipeline.error() << std::endl;
+        return 1;
+    }
+    CapturePipeline::Stats stats = pipeline.stats();
+    pipeline.stop();
+    std::cout << pipeline.width() << "x" << pipeline.height() << " from " << spec << ": " << stats.captured << " frames captured, "
+              << stats.displayed << " displayed, " << stats.dropped << " dropped before display, " << stats.sourceDropped
+              << " lost by the source; latency avg " << stats.averageLatencyMilliseconds << " ms, p99 "
+              << stats.p99LatencyMilliseconds << " ms, max " << stats.maxLatencyMilliseconds << " ms" << std::endl;
+    return 0;
+}
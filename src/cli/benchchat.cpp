@@ -0,0 +1,139 @@
+#include "commands.hpp"
+#include "../chatbot/responseengine.hpp"
+#include "../chatbot/stubmodel.hpp"
+#include "../net/httpserver.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // Drains events like the UI does, once per simulated 60 Hz frame
+    const std::chrono::milliseconds FrameTime(16);
+    // Allowed on top of the stub's own delay before the first token shows:
+    // a couple of frames of polling plus the request itself
+    const double FirstTokenSlackMs = 100.0;
+    // A cancelled reply must stop within a few frames
+    const double DefaultMaxCancelMs = 100.0;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+}
+
+// Measures time to first token and streaming rate of the ResponseEngine, and
+// checks that cancelling a streaming reply takes effect promptly. Without
+// --endpoint an in-process StubModel on a free localhost port is used, and
+// the p99 time to first token must stay close to the stub's delay; against
+// a real endpoint it is only checked if --max-first-token-ms is given.
+// Exits nonzero if a request fails or a check does not hold.
+int runBenchChat(const CommandLine& args) {
+    const int requests = args.getInt("requests", 20);
+    if (requests <= 0) {
+        std::cerr << "bench-chat: --requests must be positive" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<StubModel> model;
+    std::unique_ptr<HttpServer> server;
+    std::string endpoint = args.getString("endpoint");
+    double maxFirstTokenMs = args.getDouble("max-first-token-ms", 0.0);
+    const double maxCancelMs = args.getDouble("max-cancel-ms", DefaultMaxCancelMs);
+    if (endpoint.empty()) {
+        const int firstTokenMs = args.getInt("first-token-ms", 50);
+        if (maxFirstTokenMs <= 0.0) maxFirstTokenMs = firstTokenMs + FirstTokenSlackMs;
+        model = std::make_unique<StubModel>(firstTokenMs, args.getDouble("tokens-per-second", 200.0), args.getInt("tokens", 64));
+        server = std::make_unique<HttpServer>([&model](const HttpRequest& request, HttpResponse& response) {
+            model->handle(request, response);
+        });
+        if (!server->start("127.0.0.1", 0, 2)) return 1;
+        endpoint = "http://127.0.0.1:" + std::to_string(server->port()) + "/generate";
+        std::cout << "Started in-process stub model on " << endpoint << std::endl;
+    }
+
+    ResponseEngine engine(endpoint);
+    std::vector<double> firstTokenTimes;
+    std::vector<double> tokenRates;
+    int errors = 0;
+
+    for (int i = 0; i < requests; ++i) {
+        std::uint64_t id = engine.send("benchmark prompt " + std::to_string(i));
+        bool finished = false;
+        while (!finished) {
+            std::this_thread::sleep_for(FrameTime);
+            ResponseEngine::Event event;
+            while (engine.poll(event)) {
+                if (event.requestId != id) continue;
+                if (event.type == ResponseEngine::Event::Type::Done) {
+                    firstTokenTimes.push_back(event.timeToFirstToken);
+                    tokenRates.push_back(event.tokensPerSecond);
+                    finished = true;
+                } else if (event.type != ResponseEngine::Event::Type::Token) {
+                    std::cerr << "Request " << i << " failed: " << event.text << std::endl;
+                    ++errors;
+                    finished = true;
+                }
+            }
+        }
+    }
+
+    // Cancel a reply right after its first token and time how long until the engine confirms
+    double cancelLatency = -1.0;
+    std::uint64_t id = engine.send("please cancel me");
+    bool cancelled = false;
+    Clock::time_point cancelTime;
+    Clock::time_point deadline = Clock::now() + std::chrono::seconds(10);
+    while (Clock::now() < deadline && cancelLatency < 0.0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        ResponseEngine::Event event;
+        while (engine.poll(event)) {
+            if (event.requestId != id) continue;
+            if (event.type == ResponseEngine::Event::Type::Token && !cancelled) {
+                engine.cancel();
+                cancelled = true;
+                cancelTime = Clock::now();
+            } else if (event.type == ResponseEngine::Event::Type::Cancelled) {
+                cancelLatency = std::chrono::duration<double, std::milli>(Clock::now() - cancelTime).count();
+            } else if (event.type != ResponseEngine::Event::Type::Token) {
+                std::cerr << "Cancelled request ended with " << (event.type == ResponseEngine::Event::Type::Done ? "Done" : event.text) << std::endl;
+                ++errors;
+                cancelLatency = 0.0;
+            }
+        }
+    }
+
+    double meanRate = tokenRates.empty() ? 0.0 : std::accumulate(tokenRates.begin(), tokenRates.end(), 0.0) / tokenRates.size();
+    const double firstTokenP99 = percentile(firstTokenTimes, 0.99);
+    std::cout << std::fixed << std::setprecision(1)
+              << firstTokenTimes.size() << " replies, time to first token p50 " << percentile(firstTokenTimes, 0.5)
+              << " ms, p99 " << firstTokenP99 << " ms, " << meanRate << " tokens/s" << std::endl;
+
+    bool ok = errors == 0 && !firstTokenTimes.empty();
+    if (maxFirstTokenMs > 0.0 && firstTokenP99 > maxFirstTokenMs) {
+        std::cerr << "Time to first token p99 " << firstTokenP99 << " ms is over " << maxFirstTokenMs << " ms" << std::endl;
+        ok = false;
+    }
+    if (cancelLatency >= 0.0 && cancelled) {
+        std::cout << "Cancel took effect after " << cancelLatency << " ms" << std::endl;
+        if (cancelLatency > maxCancelMs) {
+            std::cerr << "Cancel took over " << maxCancelMs << " ms" << std::endl;
+            ok = false;
+        }
+    } else {
+        std::cerr << "Cancel was not confirmed" << std::endl;
+        ok = false;
+    }
+
+    if (server) server->stop();
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#include "commands.hpp"
+#include "../chatbot/chathistory.hpp"
+#include "../chatbot/chatview.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    std::string syntheticMessage(std::size_t i) {
+        // Mix of one-liners and paragraphs that wrap over several lines
+        static const char* const Words[] = {"map", "tile", "layer", "feature", "street", "river", "zoom", "query",
+                                            "raster", "vector", "chat", "model", "token", "stream", "cache", "index"};
+        std::string text;
+        std::size_t words = 3 + (i * 7919) % 60;
+        for (std::size_t w = 0; w < words; ++w) {
+            if (w) text += ' ';
+            text += Words[(i + w * 31) % 16];
+        }
+        return text;
+    }
+
+    void report(const char* phase, const std::vector<double>& frameTimes, ChatHistory& history, ChatView& view) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(10) << phase << ": " << std::setw(6) << frameTimes.size() << " frames  "
+                  << "p50 " << std::setw(6) << percentile(frameTimes, 0.50) << " ms  "
+                  << "p99 " << std::setw(6) << percentile(frameTimes, 0.99) << " ms  "
+                  << "max " << std::setw(6) << percentile(frameTimes, 1.0) << " ms  "
+                  << "resident messages " << history.residentMessages() << ", cached layouts " << view.cachedLayouts() << std::endl;
+    }
+}
+
+// Scrolls a ChatView through a long history, one page per frame, from the
+// newest message to the oldest and back, and reports frame times together
+// with how many messages and layouts are held in memory. The database is
+// kept, so later runs skip filling it.
+int runBenchChatHistory(const CommandLine& args) {
+    const int messages = args.getInt("messages", 100000);
+    const std::string dbPath = args.getString("db", "bench_chat_history.db");
+    if (messages <= 0) {
+        std::cerr << "bench-chat-history: --messages must be positive" << std::endl;
+        return 1;
+    }
+
+    sf::Font font;
+    if (!font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
+        std::cerr << "Failed to load font" << std::endl;
+        return 1;
+    }
+
+    ChatHistory history;
+    if (!history.open(dbPath)) return 1;
+    if (history.size() < static_cast<std::size_t>(messages)) {
+        Clock::time_point start = Clock::now();
+        std::vector<ChatHistory::Message> batch;
+        batch.reserve(messages - history.size());
+        for (std::size_t i = history.size(); i < static_cast<std::size_t>(messages); ++i) {
+            ChatHistory::Message message;
+            message.isUser = i % 2 == 0;
+            message.text = syntheticMessage(i);
+            batch.push_back(std::move(message));
+        }
+        history.appendBulk(batch);
+        std::cout << "Added " << batch.size() << " messages in "
+                  << std::chrono::duration<double>(Clock::now() - start).count() << " s" << std::endl;
+    }
+
+    sf::RenderTexture target;
+    if (!target.create(800, 600)) {
+        std::cerr << "Failed to create render texture" << std::endl;
+        return 1;
+    }
+
+    ChatView view(history, font);
+    view.setArea(sf::FloatRect(15, 10, 770, 580));
+    const float page = view.pageHeight();
+
+    auto frame = [&](std::vector<double>& frameTimes) {
+        Clock::time_point start = Clock::now();
+        target.clear(sf::Color::White);
+        view.draw(target);
+        target.display();
+        frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    };
+
+    std::vector<double> upTimes;
+    frame(upTimes);
+    while (!view.isAtTop()) {
+        view.scroll(page);
+        frame(upTimes);
+    }
+    report("to top", upTimes, history, view);
+
+    std::vector<double> downTimes;
+    while (!view.isAtBottom()) {
+        view.scroll(-page);
+        frame(downTimes);
+    }
+    report("to bottom", downTimes, history, view);
+    return 0;
+}
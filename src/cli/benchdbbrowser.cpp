@@ -0,0 +1,220 @@
+#include "commands.hpp"
+#include "../database/queryworker.hpp"
+#include "../database/resultgrid.hpp"
+#include "../database/resultpager.hpp"
+#include "../database/statementcache.hpp"
+#include <SFML/Graphics.hpp>
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    bool execute(sqlite3* db, const char* sql) {
+        char* error = nullptr;
+        if (sqlite3_exec(db, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+            std::cerr << "bench-db-browser: " << (error ? error : "unknown error") << std::endl;
+            sqlite3_free(error);
+            return false;
+        }
+        return true;
+    }
+
+    // Adds rows to the `items` table until it has `rows`
+    bool fillTable(sqlite3* db, sqlite3_int64 rows) {
+        if (!execute(db, "CREATE TABLE IF NOT EXISTS items(id INTEGER PRIMARY KEY, name TEXT, category TEXT, value REAL, created TEXT)")) return false;
+
+        sqlite3_int64 existing = 0;
+        sqlite3_stmt* statement = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT ifnull(max(rowid), 0) FROM items", -1, &statement, nullptr) == SQLITE_OK &&
+            sqlite3_step(statement) == SQLITE_ROW) {
+            existing = sqlite3_column_int64(statement, 0);
+        }
+        sqlite3_finalize(statement);
+        if (existing >= rows) return true;
+
+        std::cout << "Adding " << rows - existing << " rows..." << std::endl;
+        Clock::time_point start = Clock::now();
+        execute(db, "PRAGMA journal_mode=OFF");
+        execute(db, "PRAGMA synchronous=OFF");
+        statement = nullptr;
+        bool ok = sqlite3_prepare_v2(db,
+            "INSERT INTO items(id, name, category, value, created) "
+            "WITH RECURSIVE n(i) AS (SELECT ?1 UNION ALL SELECT i + 1 FROM n WHERE i < ?2) "
+            "SELECT i, 'item ' || i, 'category ' || (i % 97), (i * 7919 % 100000) / 100.0, datetime(1600000000 + i, 'unixepoch') FROM n",
+            -1, &statement, nullptr) == SQLITE_OK;
+        if (ok) {
+            sqlite3_bind_int64(statement, 1, existing + 1);
+            sqlite3_bind_int64(statement, 2, rows);
+            ok = execute(db, "BEGIN") && sqlite3_step(statement) == SQLITE_DONE && execute(db, "COMMIT");
+        }
+        if (!ok) std::cerr << "bench-db-browser: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_finalize(statement);
+        std::cout << "Filled in " << std::chrono::duration<double>(Clock::now() - start).count() << " s" << std::endl;
+        return ok;
+    }
+
+    void report(const char* phase, const std::vector<double>& frameTimes, const ResultPager& pager, const StatementCache& statements) {
+        std::cout << std::fixed << std::setprecision(2)
+                  << std::setw(10) << phase << ": " << std::setw(6) << frameTimes.size() << " frames  "
+                  << "p50 " << std::setw(6) << percentile(frameTimes, 0.50) << " ms  "
+                  << "p99 " << std::setw(6) << percentile(frameTimes, 0.99) << " ms  "
+                  << "max " << std::setw(7) << percentile(frameTimes, 1.0) << " ms  "
+                  << "resident rows " << pager.residentRows() << ", pages loaded " << pager.pagesLoaded()
+                  << ", statements " << statements.hits() << " hits / " << statements.misses() << " misses" << std::endl;
+    }
+}
+
+// Browses a large table the way the Database app does: opens it, scrolls
+// through it a page per frame, jumps to random positions, pages through a
+// filtering query and cancels a slow aggregate, rendering every frame off
+// screen. Reports frame times and how many rows are held in memory. The
+// database is kept, so later runs skip filling it.
+int runBenchDbBrowser(const CommandLine& args) {
+    const int rows = args.getInt("rows", 50000000);
+    const int frames = args.getInt("frames", 2000);
+    const std::string dbPath = args.getString("db", "bench_browser.db");
+    if (rows <= 0 || frames <= 0) {
+        std::cerr << "bench-db-browser: --rows and --frames must be positive" << std::endl;
+        return 1;
+    }
+
+    sf::Font font;
+    if (!font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
+        std::cerr << "Failed to load font" << std::endl;
+        return 1;
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open(dbPath.c_str(), &db) != SQLITE_OK) {
+        std::cerr << "bench-db-browser: cannot open " << dbPath << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+    if (!fillTable(db, rows)) {
+        sqlite3_close(db);
+        return 1;
+    }
+
+    sf::RenderTexture target;
+    if (!target.create(1024, 768)) {
+        std::cerr << "Failed to create render texture" << std::endl;
+        sqlite3_close(db);
+        return 1;
+    }
+
+    int result = 0;
+    {
+        StatementCache statements(db);
+        QueryWorker worker(dbPath);
+        ResultPager pager(statements, worker);
+        ResultGrid grid(pager, font);
+        grid.setArea(sf::FloatRect(210, 110, 804, 618));
+
+        auto frame = [&](std::vector<double>& frameTimes, Clock::time_point start) {
+            target.clear(sf::Color::White);
+            grid.draw(target);
+            target.display();
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        };
+
+        std::vector<double> openTimes;
+        Clock::time_point start = Clock::now();
+        if (!pager.openTable("items")) {
+            std::cerr << "bench-db-browser: " << pager.error() << std::endl;
+            result = 1;
+        } else {
+            grid.reset();
+            frame(openTimes, start);
+            report("open", openTimes, pager, statements);
+
+            std::vector<double> scrollTimes;
+            for (int i = 0; i < frames; ++i) {
+                start = Clock::now();
+                grid.scrollRows(static_cast<long long>(grid.visibleRows()));
+                frame(scrollTimes, start);
+            }
+            report("scroll", scrollTimes, pager, statements);
+
+            std::vector<double> jumpTimes;
+            std::mt19937_64 random(42);
+            std::uniform_int_distribution<std::size_t> position(0, pager.rowCount() - 1);
+            for (int i = 0; i < frames; ++i) {
+                start = Clock::now();
+                grid.scrollToRow(position(random));
+                frame(jumpTimes, start);
+            }
+            report("jump", jumpTimes, pager, statements);
+        }
+
+        // Query pages come from the worker; frames keep going while they are on their way
+        std::vector<double> queryTimes;
+        if (result == 0) {
+            pager.openQuery("SELECT id, name, value FROM items WHERE category = 'category 5' ORDER BY value");
+            grid.reset();
+            int pagesScrolled = 0;
+            while (pagesScrolled < frames && pager.error().empty()) {
+                start = Clock::now();
+                if (pager.update()) grid.reset();
+                std::size_t lastVisible = grid.firstRow() + grid.visibleRows() - 1;
+                if (pager.isRowCountExact() && lastVisible + 1 >= pager.rowCount()) break;
+                if (pager.rowCount() > 0 && pager.row(lastVisible)) {
+                    grid.scrollRows(static_cast<long long>(grid.visibleRows()));
+                    ++pagesScrolled;
+                }
+                frame(queryTimes, start);
+            }
+            if (!pager.error().empty()) {
+                std::cerr << "bench-db-browser: " << pager.error() << std::endl;
+                result = 1;
+            } else {
+                report("query", queryTimes, pager, statements);
+            }
+        }
+
+        // A statement that needs the whole table before its first row, cancelled after a second
+        std::vector<double> runningTimes;
+        if (result == 0) {
+            pager.openQuery("SELECT category, count(*), avg(length(name)) FROM items GROUP BY category ORDER BY avg(value)");
+            grid.reset();
+            Clock::time_point started = Clock::now();
+            Clock::time_point cancelled;
+            bool cancelSent = false;
+            for (;;) {
+                start = Clock::now();
+                // Checked before update() so the events of a statement that just stopped are still taken in
+                bool running = pager.isRunning();
+                if (pager.update()) grid.reset();
+                if (!cancelSent && start - started >= std::chrono::seconds(1)) {
+                    pager.cancel();
+                    cancelled = Clock::now();
+                    cancelSent = true;
+                }
+                frame(runningTimes, start);
+                if (!running) break;
+            }
+            report("running", runningTimes, pager, statements);
+            if (pager.isCancelled()) {
+                std::cout << "Cancelled after " << pager.rowsRead() << " rows read; stopped "
+                          << std::chrono::duration<double, std::milli>(Clock::now() - cancelled).count() << " ms after cancel()" << std::endl;
+            } else {
+                std::cout << "Finished in " << pager.milliseconds() << " ms before it could be cancelled" << std::endl;
+            }
+        }
+        std::cout << "Rows laid out: " << grid.layoutCount() << std::endl;
+    }
+    sqlite3_close(db);
+    return result;
+}
@@ -0,0 +1,113 @@
+#include "commands.hpp"
+#include "../database/connectionpool.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    // Rows with a few hundred bytes of payload, like GeoPackage features
+    bool createDatabase(const std::string& path, int rows) {
+        sqlite3* db = nullptr;
+        std::string sql =
+            "PRAGMA journal_mode = WAL;"
+            "CREATE TABLE features(fid INTEGER PRIMARY KEY, name TEXT, geom BLOB);"
+            "WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < " + std::to_string(rows) + ") "
+            "INSERT INTO features SELECT i, 'feature ' || i, randomblob(256) FROM n;";
+        bool ok = sqlite3_open(path.c_str(), &db) == SQLITE_OK &&
+                  sqlite3_exec(db, sql.c_str(), nullptr, nullptr, nullptr) == SQLITE_OK;
+        if (!ok) std::cerr << "bench-db-pool: " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return ok;
+    }
+
+    // Every query leases a connection, the way tile reads do
+    void runReaders(ConnectionPool& pool, const std::string& path, int threads, int queries, int rows) {
+        std::vector<std::vector<double>> latencies(threads);
+        std::atomic<int> failures(0);
+        std::vector<std::thread> readers;
+        Clock::time_point start = Clock::now();
+        for (int t = 0; t < threads; ++t) {
+            readers.emplace_back([&, t] {
+                std::mt19937 random(static_cast<unsigned int>(t) + 1);
+                std::uniform_int_distribution<int> fid(1, rows);
+                latencies[t].reserve(static_cast<std::size_t>(queries));
+                for (int q = 0; q < queries; ++q) {
+                    Clock::time_point queryStart = Clock::now();
+                    ConnectionPool::Lease connection = pool.acquire(path);
+                    sqlite3_stmt* select = connection ? connection.statements().acquire("SELECT name, length(geom) FROM features WHERE fid = ?1") : nullptr;
+                    if (!select) {
+                        ++failures;
+                        continue;
+                    }
+                    sqlite3_bind_int(select, 1, fid(random));
+                    if (sqlite3_step(select) != SQLITE_ROW) ++failures;
+                    sqlite3_reset(select);
+                    connection.release();
+                    latencies[t].push_back(std::chrono::duration<double, std::milli>(Clock::now() - queryStart).count());
+                }
+            });
+        }
+        for (auto& reader : readers) {
+            reader.join();
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::vector<double> all;
+        for (const auto& values : latencies) {
+            all.insert(all.end(), values.begin(), values.end());
+        }
+        ConnectionPool::Stats stats = pool.stats();
+        std::cout << std::fixed << std::setprecision(0)
+                  << std::setw(3) << pool.maxConnectionsPerFile() << " connections, " << std::setw(3) << threads << " threads: "
+                  << std::setw(9) << all.size() / seconds << " queries/s  " << std::setprecision(3)
+                  << "p50 " << percentile(all, 0.50) << " ms  p99 " << percentile(all, 0.99) << " ms  "
+                  << "waits " << stats.waits << "/" << stats.acquisitions
+                  << " (p99 <= " << stats.p99WaitMilliseconds << " ms, max " << stats.maxWaitMilliseconds << " ms)"
+                  << (failures > 0 ? "  failures " + std::to_string(failures.load()) : "") << std::endl;
+    }
+}
+
+// Point lookups on a generated table from 1, 2, 4, ... --threads reader
+// threads, once through a pool limited to a single connection (what one
+// shared handle amounts to) and once through a pool with a connection per
+// thread, printing throughput, latency and pool wait times.
+int runBenchDbPool(const CommandLine& args) {
+    const int rows = args.getInt("rows", 1000000);
+    const int maxThreads = args.getInt("threads", 8);
+    const int queries = args.getInt("queries", 100000);
+    const std::string path = args.getString("db", "bench_pool.db");
+    if (rows <= 0 || maxThreads <= 0 || queries <= 0) {
+        std::cerr << "bench-db-pool: --rows, --threads and --queries must be positive" << std::endl;
+        return 1;
+    }
+
+    if (!std::filesystem::exists(path)) {
+        std::cout << "Writing " << rows << " rows to " << path << "..." << std::endl;
+        if (!createDatabase(path, rows)) return 1;
+    }
+
+    for (std::size_t connections : {std::size_t(1), static_cast<std::size_t>(maxThreads)}) {
+        for (int threads = 1; threads <= maxThreads; threads *= 2) {
+            ConnectionPool pool(connections);
+            // Per-thread query count, so every run does the same total work
+            runReaders(pool, path, threads, std::max(1, queries / threads), rows);
+        }
+    }
+    return 0;
+}
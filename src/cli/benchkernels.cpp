@@ -0,0 +1,200 @@
+#include "commands.hpp"
+#include "../camera/imagekernels.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+    using imagekernels::Bands;
+    using imagekernels::Path;
+
+    const Path Paths[] = {Path::Scalar, Path::Sse41, Path::Avx2};
+
+    // Runs a kernel into a buffer that starts out filled with garbage
+    typedef std::function<void(std::vector<std::uint8_t>& out, const Bands& bands, Path path)> Kernel;
+
+    struct Case {
+        const char* name;
+        std::size_t outputSize;
+        Kernel kernel;
+    };
+
+    std::vector<std::uint8_t> randomBytes(std::size_t size, std::mt19937& random) {
+        std::vector<std::uint8_t> bytes(size);
+        std::uniform_int_distribution<int> byte(0, 255);
+        for (std::uint8_t& value : bytes) value = static_cast<std::uint8_t>(byte(random));
+        return bytes;
+    }
+
+    // Temperatures in -50..50 with a few no-data cells
+    std::vector<std::uint8_t> randomGrid(std::size_t floats, std::mt19937& random) {
+        std::vector<float> values(floats);
+        std::uniform_real_distribution<float> value(-50.f, 50.f);
+        std::uniform_int_distribution<int> percent(0, 99);
+        for (float& cell : values) cell = percent(random) < 2 ? std::numeric_limits<float>::quiet_NaN() : value(random);
+        std::vector<std::uint8_t> bytes(floats * sizeof(float));
+        std::memcpy(bytes.data(), values.data(), bytes.size());
+        return bytes;
+    }
+
+    // Odd sizes and padded strides exercise the scalar tails of the vector loops
+    std::vector<Case> makeCases(unsigned int width, unsigned int height, std::mt19937& random,
+                                std::vector<std::vector<std::uint8_t>>& inputs) {
+        const std::size_t pad = 24;
+        const std::size_t yuyvStride = width * 2 + pad;
+        const std::size_t rgbaStride = width * 4 + pad;
+        const std::size_t grayStride = width + pad;
+        const std::size_t backgroundStride = width * 2 + pad;
+        const std::size_t chromaStride = ((width + 1) & ~1u) + pad;
+        const unsigned int scaledWidth = width * 2 / 3 + 1;
+        const unsigned int scaledHeight = height * 2 / 3 + 1;
+
+        inputs.push_back(randomBytes(yuyvStride * height, random));
+        inputs.push_back(randomBytes((width + pad) * height, random));
+        inputs.push_back(randomBytes(chromaStride * ((height + 1) / 2), random));
+        inputs.push_back(randomBytes(rgbaStride * height, random));
+        inputs.push_back(randomBytes(grayStride * height, random));
+        inputs.push_back(randomBytes(backgroundStride * height, random));
+        const std::uint8_t* yuyv = inputs[0].data();
+        const std::uint8_t* luma = inputs[1].data();
+        const std::uint8_t* chroma = inputs[2].data();
+        const std::uint8_t* rgba = inputs[3].data();
+        const std::uint8_t* gray = inputs[4].data();
+        const std::uint8_t* background = inputs[5].data();
+        const unsigned int evenWidth = width & ~1u;
+
+        std::vector<Case> cases;
+        cases.push_back({"yuyv->rgba", rgbaStride * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::yuyvToRgba(yuyv, yuyvStride, evenWidth, height, out.data(), rgbaStride, bands, path);
+        }});
+        cases.push_back({"nv12->rgba", rgbaStride * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::nv12ToRgba(luma, width + pad, chroma, chromaStride, width, height, out.data(), rgbaStride, bands, path);
+        }});
+        cases.push_back({"rgba->gray", (width + pad) * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::rgbaToGray(rgba, rgbaStride, width, height, out.data(), width + pad, bands, path);
+        }});
+        cases.push_back({"scale 2/3", (scaledWidth * 4 + pad) * scaledHeight, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::scaleBilinear(rgba, rgbaStride, width, height, out.data(), scaledWidth * 4 + pad, scaledWidth, scaledHeight, bands, path);
+        }});
+        // Difference image followed by the updated background, which starts from random 12-bit values
+        for (std::size_t i = 0; i + 1 < inputs[5].size(); i += 2) inputs[5][i + 1] &= 0x0F;
+        const std::size_t differenceSize = (grayStride * height + 1) & ~static_cast<std::size_t>(1); // keeps the background aligned
+        cases.push_back({"background", differenceSize + backgroundStride * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            std::uint8_t* model = out.data() + differenceSize;
+            std::memcpy(model, background, backgroundStride * height);
+            imagekernels::updateBackground(gray, grayStride, width, height, reinterpret_cast<std::uint16_t*>(model), backgroundStride,
+                                           out.data(), grayStride, 5, bands, path);
+        }});
+
+        // A forecast grid at about half the output resolution, placed so a
+        // margin of output falls off it on every side; once more wrapping
+        // around, as a global grid would
+        const unsigned int gridWidth = width / 2 + 3;
+        const unsigned int gridHeight = height / 2 + 2;
+        const std::size_t gridStride = gridWidth * sizeof(float) + pad;
+        inputs.push_back(randomGrid(gridStride / sizeof(float) * gridHeight, random));
+        const float* grid = reinterpret_cast<const float*>(inputs.back().data());
+        auto ramp = std::make_shared<imagekernels::ColorRamp>();
+        std::uniform_int_distribution<std::uint32_t> color;
+        for (std::uint32_t& entry : ramp->colors) entry = color(random);
+        ramp->minValue = -40.f;
+        ramp->maxValue = 45.f;
+        imagekernels::GridPlacement placement;
+        placement.column = -1.3;
+        placement.columnStep = (gridWidth + 2.0) / width;
+        placement.row = -0.9;
+        placement.rowStep = (gridHeight + 1.5) / height;
+        cases.push_back({"grid", rgbaStride * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::sampleGrid(grid, gridStride, gridWidth, gridHeight, false, placement, *ramp, out.data(), rgbaStride,
+                                     width, height, bands, path);
+        }});
+        cases.push_back({"grid wrap", rgbaStride * height, [=](std::vector<std::uint8_t>& out, const Bands& bands, Path path) {
+            imagekernels::GridPlacement around = placement;
+            around.column = -0.7 * gridWidth;
+            around.columnStep = 2.4 * gridWidth / width;
+            imagekernels::sampleGrid(grid, gridStride, gridWidth, gridHeight, true, around, *ramp, out.data(), rgbaStride,
+                                     width, height, bands, path);
+        }});
+        return cases;
+    }
+
+    // Every supported path, with and without the scheduler, must match the scalar reference byte for byte
+    bool verify(const Bands& threaded) {
+        std::mt19937 random(7);
+        const unsigned int sizes[][2] = {{1, 1}, {2, 3}, {17, 5}, {33, 31}, {64, 48}, {250, 97}, {641, 479}};
+        bool ok = true;
+        for (const auto& size : sizes) {
+            std::vector<std::vector<std::uint8_t>> inputs;
+            for (const Case& test : makeCases(size[0], size[1], random, inputs)) {
+                std::vector<std::uint8_t> expected(test.outputSize, 0xAB);
+                test.kernel(expected, Bands(), Path::Scalar);
+                for (Path path : Paths) {
+                    if (!imagekernels::isSupported(path)) continue;
+                    for (const Bands& threads : {Bands(), threaded}) {
+                        std::vector<std::uint8_t> actual(test.outputSize, 0xAB);
+                        test.kernel(actual, threads, path);
+                        auto mismatch = std::mismatch(expected.begin(), expected.end(), actual.begin());
+                        if (mismatch.first != expected.end()) {
+                            std::cerr << "MISMATCH " << test.name << " " << size[0] << "x" << size[1] << " " << imagekernels::pathName(path)
+                                      << (threads.scheduler ? " threaded" : "") << " at byte " << (mismatch.first - expected.begin())
+                                      << ": " << int(*mismatch.first) << " != " << int(*mismatch.second) << std::endl;
+                            ok = false;
+                        }
+                    }
+                }
+            }
+        }
+        std::cout << (ok ? "All paths match the scalar reference" : "Paths disagree with the scalar reference") << std::endl;
+        return ok;
+    }
+}
+
+// Checks every kernel path against the scalar reference, then times each
+// kernel on a --width x --height frame, single-threaded and split across
+// the scheduler's workers.
+int runBenchKernels(const CommandLine& args) {
+    const unsigned int width = static_cast<unsigned int>(std::max(2, args.getInt("width", 1920)));
+    const unsigned int height = static_cast<unsigned int>(std::max(1, args.getInt("height", 1080)));
+    const int iterations = std::max(1, args.getInt("iterations", 200));
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, args.getInt("threads", 0))));
+    Bands threaded;
+    threaded.scheduler = &scheduler;
+    threaded.priority = TaskScheduler::Priority::High;
+
+    std::cout << "CPU: best path " << imagekernels::pathName(imagekernels::bestPath()) << ", " << scheduler.threadCount() << " threads" << std::endl;
+    if (!verify(threaded)) return 1;
+
+    std::mt19937 random(1);
+    std::vector<std::vector<std::uint8_t>> inputs;
+    std::cout << std::fixed << std::setprecision(3);
+    for (const Case& test : makeCases(width, height, random, inputs)) {
+        std::vector<std::uint8_t> out(test.outputSize);
+        double scalarMilliseconds = 0.0;
+        for (Path path : Paths) {
+            if (!imagekernels::isSupported(path)) continue;
+            for (const Bands& threads : {Bands(), threaded}) {
+                test.kernel(out, threads, path); // warm up
+                Clock::time_point start = Clock::now();
+                for (int i = 0; i < iterations; ++i) {
+                    test.kernel(out, threads, path);
+                }
+                double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+                if (path == Path::Scalar && !threads.scheduler) scalarMilliseconds = milliseconds;
+                std::cout << std::left << std::setw(11) << test.name << std::setw(7) << imagekernels::pathName(path)
+                          << std::setw(9) << (threads.scheduler ? "threaded" : "1 thread") << std::right
+                          << std::setw(9) << milliseconds << " ms/frame  " << std::setprecision(1)
+                          << std::setw(7) << scalarMilliseconds / milliseconds << "x scalar" << std::setprecision(3) << std::endl;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,378 @@
+#include "commands.hpp"
+#include "../database/connectionpool.hpp"
+#include "../map/geometrystore.hpp"
+#include "../map/mappatch.hpp"
+#include "../map/mapstyle.hpp"
+#include "../map/syntheticmap.hpp"
+#include "../map/vectorshapes.hpp"
+#include "../mainwindow/applifecycle.hpp"
+#include "../utils/allocationtracker.hpp"
+#include <gdal_priv.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const int ChartWidth = 50;
+    const int SearchRepeats = 20;
+
+    struct Result {
+        std::uint64_t features = 0;
+        double loadMs = 0.0;
+        double storeMb = 0.0;
+        double shapesMb = 0.0;
+        double residentMb = 0.0;  // growth of the process while loading
+        std::size_t drawCalls = 0;
+        double frameP50Ms[3] = {0.0, 0.0, 0.0};
+        double frameP99Ms[3] = {0.0, 0.0, 0.0};
+        double nameSearchMs = 0.0;
+        double viewportQueryMs = 0.0;
+        std::size_t searchHits = 0;
+        // Per loaded feature, in the ingest, index and shape building phases
+        double allocationsPerFeature[3] = {0.0, 0.0, 0.0};
+        double peakAllocatedMb = 0.0;  // largest phase peak
+        // A hot reload of 1% of the features: diff and read, then swap in
+        std::size_t editedFeatures = 0;
+        double patchReadMs = 0.0;
+        double patchApplyMs = 0.0;
+    };
+
+    const char* const LoadPhases[3] = {"map.ingest", "map.index", "map.shapes"};
+
+    // The zoom levels frames are timed at: the whole world, a region, a city
+    const float Zooms[3] = {1.f, 8.f, 64.f};
+
+    // One feature in this many is edited for the patch measurement
+    const int EditStride = 100;
+
+    double milliseconds(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * (values.size() - 1));
+        return values[index];
+    }
+
+    double megabytes(std::size_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    std::vector<std::uint64_t> parseSizes(const std::string& list) {
+        std::vector<std::uint64_t> sizes;
+        std::stringstream stream(list);
+        std::string item;
+        while (std::getline(stream, item, ',')) {
+            try {
+                double value = std::stod(item);
+                if (value >= 1.0) sizes.push_back(static_cast<std::uint64_t>(value));
+            } catch (const std::exception&) {
+                std::cerr << "Ignoring size " << item << std::endl;
+            }
+        }
+        return sizes;
+    }
+
+    // Share of a full load that patching in the 1% edit took
+    double patchFraction(const Result& r) {
+        return r.loadMs > 0.0 ? (r.patchReadMs + r.patchApplyMs) / r.loadMs : 0.0;
+    }
+
+    void chart(const std::vector<Result>& results, const char* title, const char* unit, double (*value)(const Result&)) {
+        double largest = 0.0;
+        for (const Result& result : results) largest = std::max(largest, value(result));
+        std::cout << std::endl << title << " (" << unit << ")" << std::endl;
+        for (const Result& result : results) {
+            int length = largest > 0.0 ? static_cast<int>(value(result) / largest * ChartWidth + 0.5) : 0;
+            std::cout << std::setw(12) << result.features << " |" << std::string(length, '#')
+                      << std::string(ChartWidth - length, ' ') << "| " << value(result) << std::endl;
+        }
+    }
+
+    // Renames every EditStride-th feature, or moves it onto its centroid if
+    // the layer has no names, so the change tracker sees it
+    std::size_t editLayer(GDALDataset* dataset, OGRLayer* layer) {
+        const int nameField = layer->GetLayerDefn()->GetFieldIndex("name");
+        std::size_t edited = 0;
+        std::uint64_t index = 0;
+        bool inTransaction = dataset->StartTransaction() == OGRERR_NONE;
+        layer->ResetReading();
+        while (OGRFeature* feature = layer->GetNextFeature()) {
+            if (index++ % EditStride == 0) {
+                if (nameField >= 0) {
+                    std::string name = std::string(feature->GetFieldAsString(nameField)) + " (edited)";
+                    feature->SetField(nameField, name.c_str());
+                } else if (OGRGeometry* geometry = feature->GetGeometryRef()) {
+                    OGRPoint* centroid = new OGRPoint();
+                    geometry->Centroid(centroid);
+                    feature->SetGeometryDirectly(centroid);
+                }
+                if (layer->SetFeature(feature) == OGRERR_NONE) ++edited;
+            }
+            OGRFeature::DestroyFeature(feature);
+        }
+        if (inTransaction) dataset->CommitTransaction();
+        return edited;
+    }
+
+    // Edits 1% of a copy of the map and patches it into the loaded store and
+    // shapes as Map does on a hot reload, to set against the full load
+    bool measurePatch(const std::string& path, GeometryStore& geometry, std::vector<sf::VertexArray>& shapes,
+                      const MapStyle& style, sf::Vector2f worldSize, Result& result) {
+        const std::filesystem::path source(path);
+        const std::string scratch = (source.parent_path() / (source.stem().string() + "-edit.gpkg")).string();
+        std::error_code error;
+        std::filesystem::copy_file(source, scratch, std::filesystem::copy_options::overwrite_existing, error);
+        if (error) {
+            std::cerr << "Could not copy " << path << ": " << error.message() << std::endl;
+            return false;
+        }
+        // The copy of an earlier run may still be open in the pool
+        ConnectionPool::instance().invalidate(scratch);
+
+        MapPatch patch;
+        if (!patch.changes.snapshot(scratch)) {
+            std::cerr << "Could not snapshot " << scratch << std::endl;
+            return false;
+        }
+        std::vector<std::string> layerNames;
+        {
+            std::unique_ptr<GDALDataset> dataset(static_cast<GDALDataset*>(
+                GDALOpenEx(scratch.c_str(), GDAL_OF_VECTOR | GDAL_OF_UPDATE, nullptr, nullptr, nullptr)));
+            if (!dataset) {
+                std::cerr << "Could not open " << scratch << " for writing" << std::endl;
+                return false;
+            }
+            for (int i = 0; i < dataset->GetLayerCount(); ++i) {
+                OGRLayer* layer = dataset->GetLayer(i);
+                layerNames.push_back(layer->GetName());
+                result.editedFeatures += editLayer(dataset.get(), layer);
+            }
+        }
+
+        Clock::time_point start = Clock::now();
+        readMapPatch(patch, scratch, layerNames, style, worldSize);
+        result.patchReadMs = milliseconds(start);
+        const bool patched = patch.outcome == MapPatch::Outcome::Patched;
+        if (patched) {
+            start = Clock::now();
+            GeometryStore::PatchResult applied = geometry.applyPatch(patch.geometry);
+            if (applied.renumbered) {
+                shapes = buildVectorShapes(geometry, style, worldSize);
+            } else {
+                for (std::uint32_t part : applied.removedParts) shapes[part] = sf::VertexArray();
+                shapes.insert(shapes.end(), std::make_move_iterator(patch.shapes.begin()), std::make_move_iterator(patch.shapes.end()));
+            }
+            result.patchApplyMs = milliseconds(start);
+        } else {
+            std::cerr << "Could not patch " << scratch << (patch.message.empty() ? ": no changes found" : ": " + patch.message) << std::endl;
+        }
+
+        patch.dataset.reset();
+        ConnectionPool::instance().invalidate(scratch);
+        std::filesystem::remove(scratch, error);
+        return patched;
+    }
+
+    bool measure(const std::string& path, sf::RenderTexture& target, int frames, Result& result) {
+        const sf::Vector2f worldSize(static_cast<float>(target.getSize().x), static_cast<float>(target.getSize().y));
+        MapStyle style;
+
+        // The same steps as Map::readMapData
+        AllocationTracker::Sink allocations;
+        std::size_t residentBefore = AppLifecycle::residentBytes();
+        Clock::time_point start = Clock::now();
+        std::unique_ptr<GDALDataset> dataset;
+        GeometryStore geometry;
+        std::vector<sf::VertexArray> shapes;
+        {
+            AllocationTracker::Scope sinkScope(allocations);
+            dataset.reset(static_cast<GDALDataset*>(
+                GDALOpenEx(path.c_str(), GDAL_OF_VECTOR | GDAL_OF_RASTER, nullptr, nullptr, nullptr)));
+            if (!dataset) {
+                std::cerr << "Could not open " << path << std::endl;
+                return false;
+            }
+            geometry.load(dataset.get());
+            shapes = buildVectorShapes(geometry, style, worldSize);
+        }
+        result.loadMs = milliseconds(start);
+        std::size_t residentAfter = AppLifecycle::residentBytes();
+
+        std::size_t shapeBytes = 0;
+        for (const sf::VertexArray& shape : shapes) shapeBytes += shape.getVertexCount() * sizeof(sf::Vertex);
+        result.storeMb = megabytes(geometry.memoryBytes());
+        result.shapesMb = megabytes(shapeBytes);
+        result.residentMb = residentAfter > residentBefore ? megabytes(residentAfter - residentBefore) : 0.0;
+        // Points leave an empty array that is never drawn
+        result.drawCalls = static_cast<std::size_t>(std::count_if(shapes.begin(), shapes.end(),
+            [](const sf::VertexArray& shape) { return shape.getVertexCount() > 0; }));
+        const double features = static_cast<double>(std::max<std::size_t>(1, geometry.features().size()));
+        for (int phase = 0; phase < 3; ++phase) {
+            AllocationTracker::Stats stats = allocations.stats(LoadPhases[phase]);
+            result.allocationsPerFeature[phase] = stats.allocations / features;
+            result.peakAllocatedMb = std::max(result.peakAllocatedMb, megabytes(static_cast<std::size_t>(std::max<std::int64_t>(0, stats.peakBytes))));
+        }
+        std::cout << allocations.report("map.");
+
+        // Frames as Map::draw renders the vectors, panning across each zoom level
+        for (int zoom = 0; zoom < 3; ++zoom) {
+            sf::View view(sf::Vector2f(worldSize.x / 2.f, worldSize.y / 2.f), worldSize / Zooms[zoom]);
+            std::vector<double> times;
+            for (int frame = 0; frame < frames; ++frame) {
+                view.setCenter(worldSize.x * (frame + 0.5f) / frames, worldSize.y / 2.f);
+                Clock::time_point frameStart = Clock::now();
+                target.clear(style.background);
+                target.setView(view);
+                for (const sf::VertexArray& shape : shapes) {
+                    target.draw(shape);
+                }
+                target.display();
+                times.push_back(milliseconds(frameStart));
+            }
+            result.frameP50Ms[zoom] = percentile(times, 0.5);
+            result.frameP99Ms[zoom] = percentile(times, 0.99);
+        }
+
+        // Searching: the map has no search index yet, so a name lookup is a
+        // scan over every feature, and a viewport query uses the grid index
+        std::mt19937 random(1);
+        std::size_t matches = 0;
+        start = Clock::now();
+        for (int i = 0; i < SearchRepeats; ++i) {
+            const std::string name = "Feature " + std::to_string(random() % 1000);
+            for (const GeometryStore::Feature& feature : geometry.features()) {
+                if (feature.name == name) ++matches;
+            }
+        }
+        result.nameSearchMs = milliseconds(start) / SearchRepeats;
+
+        std::vector<std::uint32_t> hits;
+        std::uniform_real_distribution<double> lon(-170.0, 160.0);
+        std::uniform_real_distribution<double> lat(-75.0, 65.0);
+        start = Clock::now();
+        for (int i = 0; i < SearchRepeats; ++i) {
+            GeometryStore::Bounds area;
+            area.expand(GeometryStore::Coordinate{lon(random), lat(random)});
+            area.expand(GeometryStore::Coordinate{area.minLon + 360.0 / Zooms[1], area.minLat + 180.0 / Zooms[1]});
+            hits.clear();
+            geometry.query(area, hits);
+            matches += hits.size();
+        }
+        result.viewportQueryMs = milliseconds(start) / SearchRepeats;
+        result.searchHits = matches;
+        return measurePatch(path, geometry, shapes, style, worldSize, result);
+    }
+}
+
+// Generates synthetic GeoPackages of growing size (kept in --dir for the
+// next run) and measures how the map's own loading, rendering and lookups
+// scale with them. Prints a table and charts against feature count, and
+// with --csv writes the numbers for plotting elsewhere.
+int runBenchMap(const CommandLine& args) {
+    GDALAllRegister();
+    std::vector<std::uint64_t> sizes = parseSizes(args.getString("sizes", "1000,10000,100000"));
+    if (sizes.empty()) {
+        std::cerr << "No sizes to run" << std::endl;
+        return 1;
+    }
+    const std::filesystem::path directory(args.getString("dir", "bench_maps"));
+    const int frames = std::max(1, args.getInt("frames", 30));
+
+    SyntheticMapOptions options;
+    if (args.has("types") && !options.parseTypes(args.getString("types"))) {
+        std::cerr << "Unknown --types " << args.getString("types") << std::endl;
+        return 1;
+    }
+    options.rasterWidth = static_cast<unsigned int>(std::max(0, args.getInt("raster", 0)));
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+
+    sf::RenderTexture target;
+    if (!target.create(1024, 768)) {
+        std::cerr << "Could not create a render target" << std::endl;
+        return 1;
+    }
+
+    std::vector<Result> results;
+    for (std::uint64_t size : sizes) {
+        const std::string path = (directory / ("synthetic-" + std::to_string(size) + ".gpkg")).string();
+        if (args.has("regenerate") || !std::filesystem::exists(path)) {
+            options.features = size;
+            std::string message;
+            if (!writeSyntheticMap(path, options, message)) {
+                std::cerr << "Could not write " << path << ": " << message << std::endl;
+                return 1;
+            }
+        }
+
+        Result result;
+        result.features = size;
+        if (!measure(path, target, frames, result)) return 1;
+        results.push_back(result);
+        std::cout << size << " features measured, " << result.searchHits << " search hits" << std::endl;
+    }
+
+    std::cout << std::endl << std::fixed << std::setprecision(2)
+              << std::setw(12) << "features" << std::setw(11) << "load ms" << std::setw(10) << "store MB"
+              << std::setw(11) << "shapes MB" << std::setw(8) << "RSS MB" << std::setw(8) << "draws"
+              << std::setw(18) << "frame p50/p99 1x" << std::setw(18) << "8x" << std::setw(18) << "64x"
+              << std::setw(10) << "name ms" << std::setw(10) << "query ms" << std::setw(22) << "allocs/feature i/x/s"
+              << std::setw(17) << "1% edit read/apply" << std::setw(11) << "edit/load" << std::endl;
+    for (const Result& r : results) {
+        std::cout << std::setw(12) << r.features << std::setw(11) << r.loadMs << std::setw(10) << r.storeMb
+                  << std::setw(11) << r.shapesMb << std::setw(8) << r.residentMb << std::setw(8) << r.drawCalls;
+        for (int zoom = 0; zoom < 3; ++zoom) {
+            std::ostringstream frame;
+            frame << std::fixed << std::setprecision(2) << r.frameP50Ms[zoom] << "/" << r.frameP99Ms[zoom];
+            std::cout << std::setw(18) << frame.str();
+        }
+        std::ostringstream allocations;
+        allocations << std::fixed << std::setprecision(2) << r.allocationsPerFeature[0] << "/" << r.allocationsPerFeature[1]
+                    << "/" << r.allocationsPerFeature[2];
+        std::ostringstream patch;
+        patch << std::fixed << std::setprecision(2) << r.patchReadMs << "/" << r.patchApplyMs;
+        std::cout << std::setw(10) << r.nameSearchMs << std::setw(10) << r.viewportQueryMs << std::setw(22) << allocations.str()
+                  << std::setw(17) << patch.str() << std::setw(10) << patchFraction(r) * 100.0 << "%" << std::endl;
+    }
+
+    chart(results, "Load time", "ms", [](const Result& r) { return r.loadMs; });
+    chart(results, "Memory, store and shapes", "MB", [](const Result& r) { return r.storeMb + r.shapesMb; });
+    chart(results, "Frame time p99, whole world", "ms", [](const Result& r) { return r.frameP99Ms[0]; });
+    chart(results, "Hot reload of 1% of the features", "% of load time", [](const Result& r) { return patchFraction(r) * 100.0; });
+    chart(results, "Allocations per feature while loading", "count", [](const Result& r) {
+        return r.allocationsPerFeature[0] + r.allocationsPerFeature[1] + r.allocationsPerFeature[2];
+    });
+
+    const std::string csvPath = args.getString("csv");
+    if (!csvPath.empty()) {
+        std::ofstream csv(csvPath);
+        csv << "features,load_ms,store_mb,shapes_mb,rss_mb,draw_calls,frame_p50_1x,frame_p99_1x,frame_p50_8x,frame_p99_8x,"
+               "frame_p50_64x,frame_p99_64x,name_search_ms,viewport_query_ms,allocs_per_feature_ingest,allocs_per_feature_index,"
+               "allocs_per_feature_shapes,peak_allocated_mb,edited_features,patch_read_ms,patch_apply_ms\n";
+        for (const Result& r : results) {
+            csv << r.features << ',' << r.loadMs << ',' << r.storeMb << ',' << r.shapesMb << ',' << r.residentMb << ',' << r.drawCalls;
+            for (int zoom = 0; zoom < 3; ++zoom) csv << ',' << r.frameP50Ms[zoom] << ',' << r.frameP99Ms[zoom];
+            csv << ',' << r.nameSearchMs << ',' << r.viewportQueryMs;
+            for (int phase = 0; phase < 3; ++phase) csv << ',' << r.allocationsPerFeature[phase];
+            csv << ',' << r.peakAllocatedMb << ',' << r.editedFeatures << ',' << r.patchReadMs << ',' << r.patchApplyMs << '\n';
+        }
+        if (!csv) {
+            std::cerr << "Could not write " << csvPath << std::endl;
+            return 1;
+        }
+        std::cout << std::endl << "Wrote " << csvPath << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "commands.hpp"
+#include "../map/weatheroverlay.hpp"
+#include <gdal_priv.h>
+#include <ogr_spatialref.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::chrono::milliseconds FrameTime(16);
+    const float NoData = -9999.f;
+
+    // A global half degree temperature forecast in kelvin, one band per
+    // step: a warm belt and a wave drifting east, with a patch of no data
+    bool writeSyntheticForecast(const std::string& path, int steps) {
+        const int width = 720;
+        const int height = 360;
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GTiff");
+        if (!driver) return false;
+        std::unique_ptr<GDALDataset> dataset(driver->Create(path.c_str(), width, height, steps, GDT_Float32, nullptr));
+        if (!dataset) return false;
+
+        double geoTransform[6] = {-180.0, 360.0 / width, 0.0, 90.0, 0.0, -180.0 / height};
+        dataset->SetGeoTransform(geoTransform);
+        OGRSpatialReference wgs84;
+        wgs84.SetWellKnownGeogCS("WGS84");
+        dataset->SetSpatialRef(&wgs84);
+
+        std::vector<float> values(static_cast<std::size_t>(width) * height);
+        for (int step = 0; step < steps; ++step) {
+            for (int y = 0; y < height; ++y) {
+                double lat = 90.0 - (y + 0.5) * 180.0 / height;
+                for (int x = 0; x < width; ++x) {
+                    double lon = -180.0 + (x + 0.5) * 360.0 / width;
+                    double wave = 8.0 * std::sin((lon + step * 6.0) * 3.0 * 3.14159265 / 180.0) * std::cos(lat * 3.14159265 / 180.0);
+                    bool missing = lat > 20.0 && lat < 30.0 && lon > 40.0 && lon < 60.0;
+                    values[static_cast<std::size_t>(y) * width + x] = missing ? NoData : static_cast<float>(303.0 - 0.6 * std::abs(lat) + wave);
+                }
+            }
+            GDALRasterBand* band = dataset->GetRasterBand(step + 1);
+            band->SetUnitType("K");
+            band->SetNoDataValue(NoData);
+            if (band->RasterIO(GF_Write, 0, 0, width, height, values.data(), width, height, GDT_Float32, 0, 0) != CE_None) return false;
+        }
+        return true;
+    }
+}
+
+// Plays a forecast through the map's weather overlay the way the UI does,
+// one update per 16 ms frame, while panning so every frame resamples.
+// Passes if playback reached every step without waiting for a decode.
+// Without --file it writes a synthetic global forecast to a temporary file.
+int runBenchOverlay(const CommandLine& args) {
+    GDALAllRegister();
+    const int steps = std::max(2, args.getInt("steps", 24));
+    std::string path = args.getString("file");
+    std::string scratch;
+    if (path.empty()) {
+        scratch = (std::filesystem::temp_directory_path() / "bench-overlay-forecast.tif").string();
+        std::cout << "Writing a synthetic " << steps << " step forecast to " << scratch << std::endl;
+        if (!writeSyntheticForecast(scratch, steps)) {
+            std::cerr << "Could not write " << scratch << std::endl;
+            return 1;
+        }
+        path = scratch;
+    }
+
+    int result = 1;
+    {
+        WeatherOverlay overlay;
+        if (overlay.open(path)) {
+            overlay.setStepInterval(std::chrono::milliseconds(std::max(1, args.getInt("interval", 250))));
+            overlay.setPlaying(true);
+
+            // The whole world on a 1280x720 window, panned a little every frame
+            const sf::Vector2u window(1280, 720);
+            const sf::Vector2f worldSize(static_cast<float>(window.x), static_cast<float>(window.y));
+            sf::View view(sf::FloatRect(0.f, 0.f, worldSize.x, worldSize.y));
+            const std::size_t stepCount = overlay.stepCount();
+            Clock::time_point end = Clock::now() + std::chrono::seconds(std::max(1, args.getInt("seconds", 30)));
+            double slowestFrame = 0.0;
+            std::size_t frames = 0;
+            while (Clock::now() < end && overlay.stats().advanced < stepCount) {
+                Clock::time_point start = Clock::now();
+                view.move(frames % 2 ? -1.f : 1.f, 0.f);
+                overlay.update();
+                overlay.resample(view, worldSize, window);
+                slowestFrame = std::max(slowestFrame, std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+                ++frames;
+                std::this_thread::sleep_for(FrameTime);
+            }
+
+            WeatherOverlay::Stats stats = overlay.stats();
+            std::cout << std::fixed << std::setprecision(3) << overlay.describe() << std::endl
+                      << frames << " frames, " << stats.advanced << " of " << stepCount << " steps played, " << stats.stalls << " stalls" << std::endl
+                      << stats.decoded << " steps decoded, avg " << stats.decodeMilliseconds << " ms" << std::endl
+                      << stats.resampled << " resamples, avg " << stats.resampleMilliseconds << " ms, max " << stats.maxResampleMilliseconds
+                      << " ms; slowest frame " << slowestFrame << " ms" << std::endl;
+            bool ok = stats.advanced >= stepCount && stats.stalls == 0;
+            std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+            result = ok ? 0 : 1;
+        }
+    }
+    if (!scratch.empty()) {
+        std::error_code error;
+        std::filesystem::remove(scratch, error);
+    }
+    return result;
+}
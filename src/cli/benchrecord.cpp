@@ -0,0 +1,69 @@
+#include "commands.hpp"
+#include "../camera/capturepipeline.hpp"
+#include "../camera/framerecorder.hpp"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Records a frame source through the capture pipeline and prints the write
+// rate, queue depth and quality once a second. --max-mbps throttles the
+// writer to show how the queue and the backpressure policy behave when the
+// disk cannot keep up.
+int runBenchRecord(const CommandLine& args) {
+    const std::string spec = args.getString("source", "pattern:1280x720@60");
+    const int seconds = args.getInt("seconds", 10);
+    const std::string directory = args.getString("dir", "bench_record");
+    const std::string policy = args.getString("policy", "quality");
+    if (seconds <= 0) {
+        std::cerr << "bench-record: --seconds must be positive" << std::endl;
+        return 1;
+    }
+
+    FrameRecorder::Options options;
+    if (!FrameRecorder::parseFormat(args.getString("format", "mjpeg"), options.format)) {
+        std::cerr << "bench-record: --format must be raw, png or mjpeg" << std::endl;
+        return 1;
+    }
+    if (policy != "quality" && policy != "drop") {
+        std::cerr << "bench-record: --policy must be quality or drop" << std::endl;
+        return 1;
+    }
+    options.backpressure = policy == "drop" ? FrameRecorder::Backpressure::DropFrames : FrameRecorder::Backpressure::LowerQuality;
+    options.encoderThreads = static_cast<unsigned int>(std::max(0, args.getInt("threads", 0)));
+    options.maxMegabytesPerSecond = args.getDouble("max-mbps", 0.0);
+
+    CapturePipeline pipeline;
+    if (!pipeline.start(createFrameSource(spec))) return 1;
+    FrameRecorder recorder;
+    if (!recorder.start(directory, pipeline.width(), pipeline.height(), options)) {
+        std::cerr << "bench-record: " << recorder.error() << std::endl;
+        return 1;
+    }
+    pipeline.addSink(&recorder);
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point end = Clock::now() + std::chrono::seconds(seconds);
+    std::cout << std::fixed << std::setprecision(1);
+    while (Clock::now() < end && pipeline.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        // Keep the triple buffer moving the way the renderer would
+        pipeline.latest();
+        FrameRecorder::Stats stats = recorder.stats();
+        std::cout << stats.written << " written, " << stats.dropped << " dropped | " << stats.megabytesPerSecond << " MB/s"
+                  << " | queue " << stats.queueDepth << "/" << FrameRecorder::QueueFrames << " (max " << stats.maxQueueDepth
+                  << ") | quality " << stats.quality << std::endl;
+    }
+
+    pipeline.removeSink(&recorder);
+    CapturePipeline::Stats capture = pipeline.stats();
+    pipeline.stop();
+    recorder.stop();
+    FrameRecorder::Stats stats = recorder.stats();
+    std::cout << pipeline.width() << "x" << pipeline.height() << " " << FrameRecorder::formatName(options.format) << " from "
+              << spec << ": " << capture.captured << " captured, " << stats.written << " written, " << stats.dropped
+              << " dropped, " << stats.failed << " failed; max queue depth " << stats.maxQueueDepth << "/"
+              << FrameRecorder::QueueFrames << ", final quality " << stats.quality << std::endl;
+    return stats.failed == 0 ? 0 : 1;
+}
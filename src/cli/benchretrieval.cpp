@@ -0,0 +1,141 @@
+#include "commands.hpp"
+#include "../chatbot/documentindex.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::size_t PassagesPerFile = 1000;
+    const std::size_t WordsPerPassage = 30;
+    const std::size_t VocabularySize = 100000;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    // Distinct made-up word for every rank
+    std::string word(std::size_t rank) {
+        std::string text;
+        do {
+            text += static_cast<char>('a' + rank % 26);
+            rank /= 26;
+        } while (rank);
+        return text + "x";
+    }
+
+    // Word ranks follow Zipf's law like natural text
+    class ZipfWords {
+    public:
+        explicit ZipfWords(std::size_t vocabulary) : m_cumulative(vocabulary) {
+            double sum = 0.0;
+            for (std::size_t i = 0; i < vocabulary; ++i) {
+                sum += 1.0 / static_cast<double>(i + 1);
+                m_cumulative[i] = sum;
+            }
+        }
+
+        std::size_t operator()(std::mt19937& random) const {
+            std::uniform_real_distribution<double> uniform(0.0, m_cumulative.back());
+            return std::lower_bound(m_cumulative.begin(), m_cumulative.end(), uniform(random)) - m_cumulative.begin();
+        }
+
+    private:
+        std::vector<double> m_cumulative;
+    };
+
+    void writeFile(const std::string& path, std::size_t fileIndex, std::size_t passages, const ZipfWords& zipf) {
+        std::mt19937 random(static_cast<unsigned int>(fileIndex));
+        std::ofstream out(path, std::ios::binary);
+        std::string text;
+        for (std::size_t p = 0; p < passages; ++p) {
+            // A heading line starts a new passage
+            text = "#\n";
+            for (std::size_t w = 0; w < WordsPerPassage; ++w) {
+                text += word(zipf(random));
+                text += w + 1 < WordsPerPassage ? ' ' : '\n';
+            }
+            out << text;
+        }
+    }
+}
+
+// Generates a synthetic corpus (once), indexes it, times queries, then
+// touches one file and times the incremental update.
+int runBenchRetrieval(const CommandLine& args) {
+    const int passages = args.getInt("passages", 1000000);
+    const int queries = args.getInt("queries", 1000);
+    const std::string directory = args.getString("dir", "bench_docs");
+    const std::string indexPath = args.getString("index", "bench_docs.bin");
+    if (passages <= 0 || queries <= 0) {
+        std::cerr << "bench-retrieval: --passages and --queries must be positive" << std::endl;
+        return 1;
+    }
+
+    ZipfWords zipf(VocabularySize);
+    std::size_t fileCount = (static_cast<std::size_t>(passages) + PassagesPerFile - 1) / PassagesPerFile;
+    std::error_code error;
+    fs::create_directories(directory, error);
+    Clock::time_point start = Clock::now();
+    std::size_t written = 0;
+    for (std::size_t i = 0; i < fileCount; ++i) {
+        std::string path = directory + "/doc" + std::to_string(i) + ".txt";
+        if (fs::exists(path, error)) continue;
+        writeFile(path, i, std::min(PassagesPerFile, passages - i * PassagesPerFile), zipf);
+        ++written;
+    }
+    if (written) {
+        std::cout << "Generated " << written << " files in " << std::chrono::duration<double>(Clock::now() - start).count() << " s" << std::endl;
+    }
+
+    DocumentIndex index;
+    DocumentIndex::BuildStats stats;
+    if (!index.update(directory, indexPath, 0, &stats)) return 1;
+    std::cout << std::fixed << std::setprecision(2)
+              << "Index: " << stats.passages << " passages, " << stats.terms << " terms, "
+              << stats.indexBytes / (1024.0 * 1024.0) << " MB, built in " << stats.seconds << " s ("
+              << stats.filesTokenized << " of " << stats.files << " files tokenized)" << std::endl;
+
+    // Reopening is just a mapping
+    start = Clock::now();
+    DocumentIndex reopened;
+    if (!reopened.open(indexPath)) return 1;
+    std::cout << "Open: " << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+
+    std::mt19937 random(42);
+    std::uniform_int_distribution<int> queryLength(2, 4);
+    std::vector<double> times;
+    std::size_t hits = 0;
+    for (int q = 0; q < queries; ++q) {
+        std::string query;
+        for (int w = queryLength(random); w > 0; --w) {
+            query += word(zipf(random)) + " ";
+        }
+        Clock::time_point queryStart = Clock::now();
+        hits += reopened.search(query, 5).size();
+        times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - queryStart).count());
+    }
+    std::cout << "Queries: " << queries << ", p50 " << percentile(times, 0.50) << " ms, p99 " << percentile(times, 0.99)
+              << " ms, max " << percentile(times, 1.0) << " ms, " << hits << " passages returned" << std::endl;
+
+    // Change one file and measure the incremental update
+    {
+        std::ofstream out(directory + "/doc0.txt", std::ios::app);
+        out << "#\nan appended passage about incremental indexing\n";
+    }
+    if (!index.update(directory, indexPath, 0, &stats)) return 1;
+    std::cout << "Incremental update: " << stats.filesTokenized << " file tokenized, " << stats.seconds << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include "commands.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // Stands in for decoding, parsing or warping
+    void spin(std::chrono::microseconds length) {
+        Clock::time_point end = Clock::now() + length;
+        while (Clock::now() < end) {
+        }
+    }
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "ok    " : "FAIL  ") << what << std::endl;
+        return ok;
+    }
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        return values[std::min(values.size() - 1, static_cast<std::size_t>(fraction * values.size()))];
+    }
+
+    void printHistogram(const char* name, const TaskScheduler::Histogram& histogram) {
+        std::cout << "  " << std::setw(6) << name << " p50 <" << static_cast<long long>(TaskScheduler::percentile(histogram, 0.5))
+                  << " us, p99 <" << static_cast<long long>(TaskScheduler::percentile(histogram, 0.99)) << " us |";
+        std::size_t last = 0;
+        for (std::size_t b = 0; b < histogram.size(); ++b) {
+            if (histogram[b]) last = b;
+        }
+        for (std::size_t b = 0; b <= last; ++b) std::cout << ' ' << histogram[b];
+        std::cout << std::endl;
+    }
+}
+
+// Runs the task scheduler through what the apps rely on: UI-visible tasks
+// overtaking a prefetch backlog, fan-out from a worker being stolen, a
+// cancelled batch being skipped, and results coming back to the calling
+// thread only through runMainThreadTasks(). Prints the queue wait
+// histograms at the end.
+int runBenchScheduler(const CommandLine& args) {
+    const std::chrono::microseconds taskLength(std::max(1, args.getInt("task-us", 200)));
+    const int backlog = std::max(1, args.getInt("tasks", 4000));
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, args.getInt("threads", 0))));
+    std::cout << "Scheduler with " << scheduler.threadCount() << " threads, " << taskLength.count() << " us tasks" << std::endl;
+    bool ok = true;
+
+    // A prefetch backlog, with a UI task arriving every 2 ms while it drains
+    std::atomic<int> lowDone{0};
+    for (int i = 0; i < backlog; ++i) {
+        scheduler.submit(TaskScheduler::Priority::Low, [&] { spin(taskLength); ++lowDone; });
+    }
+    std::vector<std::shared_ptr<std::atomic<double>>> highWaits;
+    while (lowDone < backlog / 2) {
+        auto wait = std::make_shared<std::atomic<double>>(-1.0);
+        Clock::time_point submitted = Clock::now();
+        scheduler.submit(TaskScheduler::Priority::High, [wait, submitted, taskLength] {
+            *wait = std::chrono::duration<double, std::micro>(Clock::now() - submitted).count();
+            spin(taskLength);
+        });
+        highWaits.push_back(wait);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    while (lowDone < backlog) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    std::vector<double> waits;
+    for (const auto& wait : highWaits) {
+        if (*wait >= 0.0) waits.push_back(*wait);
+    }
+    const double highP99 = percentile(waits, 0.99);
+    const double allowed = std::max(2000.0, 5.0 * taskLength.count());
+    ok &= check(waits.size() == highWaits.size() && highP99 < allowed,
+                std::to_string(waits.size()) + " high priority tasks behind a backlog of " + std::to_string(backlog) +
+                ": p99 wait " + std::to_string(static_cast<int>(highP99)) + " us (limit " + std::to_string(static_cast<int>(allowed)) + ")");
+
+    // Fan-out from inside a worker lands on its own deque; the others steal
+    const int subtasks = 512;
+    std::atomic<int> subtasksDone{0};
+    std::uint64_t stealsBefore = scheduler.stats().steals;
+    Clock::time_point fanOutStart = Clock::now();
+    scheduler.submit(TaskScheduler::Priority::Normal, [&] {
+        for (int i = 0; i < subtasks; ++i) {
+            scheduler.submit(TaskScheduler::Priority::Normal, [&] { spin(taskLength); ++subtasksDone; });
+        }
+    });
+    while (subtasksDone < subtasks) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    double fanOutMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - fanOutStart).count();
+    std::uint64_t steals = scheduler.stats().steals - stealsBefore;
+    ok &= check(scheduler.threadCount() < 2 || steals > 0,
+                std::to_string(subtasks) + " subtasks from one worker: " + std::to_string(steals) + " stolen, " +
+                std::to_string(fanOutMilliseconds) + " ms (" + std::to_string(subtasks * taskLength.count() / 1000.0) + " ms of work)");
+
+    // A cancelled batch is skipped and wait() returns once its tasks are gone
+    CancellationToken token;
+    std::atomic<int> cancelledRan{0};
+    const int batch = 1000;
+    for (int i = 0; i < batch; ++i) {
+        scheduler.submit(TaskScheduler::Priority::Low, token, [&] { spin(taskLength); ++cancelledRan; });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    token.cancel();
+    Clock::time_point cancelled = Clock::now();
+    token.wait();
+    double cancelMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - cancelled).count();
+    ok &= check(cancelledRan < batch, "cancelled batch: " + std::to_string(cancelledRan) + " of " + std::to_string(batch) +
+                                      " ran, wait() returned after " + std::to_string(cancelMilliseconds) + " ms");
+
+    // Results come back to this thread, and not at all once cancelled
+    const std::thread::id mainThread = std::this_thread::get_id();
+    const int results = 100;
+    int delivered = 0;
+    bool onMainThread = true;
+    CancellationToken live;
+    CancellationToken dropped;
+    for (int i = 0; i < results; ++i) {
+        scheduler.submitThen(TaskScheduler::Priority::Normal, live, [i] { return i * i; },
+                             [&](int) { ++delivered; onMainThread &= std::this_thread::get_id() == mainThread; });
+        scheduler.submitThen(TaskScheduler::Priority::Normal, dropped, [i] { return i; }, [&](int) { ++delivered; });
+    }
+    live.wait();
+    dropped.wait();
+    dropped.cancel();
+    Clock::time_point end = Clock::now() + std::chrono::seconds(2);
+    while (delivered < results && Clock::now() < end) {
+        scheduler.runMainThreadTasks(std::chrono::microseconds(4000));
+        std::this_thread::sleep_for(std::chrono::milliseconds(16));
+    }
+    scheduler.runMainThreadTasks(std::chrono::microseconds(4000));
+    ok &= check(delivered == results && onMainThread,
+                std::to_string(delivered) + " continuations ran on the main thread, those of the cancelled token did not");
+
+    TaskScheduler::Stats stats = scheduler.stats();
+    std::cout << "executed " << stats.executed[0] << "/" << stats.executed[1] << "/" << stats.executed[2]
+              << " (high/normal/low), " << stats.steals << " stolen, " << stats.cancelled << " cancelled, "
+              << stats.mainThreadExecuted << " on the main thread" << std::endl
+              << "Queue wait, buckets of <1, <2, <4 ... us:" << std::endl;
+    printHistogram("high", stats.latency[0]);
+    printHistogram("normal", stats.latency[1]);
+    printHistogram("low", stats.latency[2]);
+    printHistogram("main", stats.mainThreadLatency);
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
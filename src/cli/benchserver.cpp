@@ -0,0 +1,246 @@
+#include "commands.hpp"
+#include "../map/projection.hpp"
+#include "../map/tileservice.hpp"
+#include "../net/httpserver.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+namespace {
+    // One keep-alive connection, used by a single benchmark thread
+    class Client {
+    public:
+        Client(const std::string& host, const std::string& port)
+            : m_stream(m_context),
+              m_host(host),
+              m_port(port)
+        {
+        }
+
+        // Returns the HTTP status, or 0 on a transport error
+        int get(const std::string& target, const std::string& ifNoneMatch, std::string* body, std::string* etag) {
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                beast::error_code ec;
+                if (!m_connected) {
+                    tcp::resolver resolver(m_context);
+                    auto results = resolver.resolve(m_host, m_port, ec);
+                    if (!ec) m_stream.connect(results, ec);
+                    if (ec) return 0;
+                    m_connected = true;
+                }
+
+                http::request<http::empty_body> request(http::verb::get, target, 11);
+                request.set(http::field::host, m_host);
+                request.keep_alive(true);
+                if (!ifNoneMatch.empty()) {
+                    request.set(http::field::if_none_match, ifNoneMatch);
+                }
+
+                http::response<http::string_body> response;
+                http::write(m_stream, request, ec);
+                if (!ec) http::read(m_stream, m_buffer, response, ec);
+                if (ec) {
+                    // The server may have closed an idle connection; reconnect once
+                    m_stream.socket().close(ec);
+                    m_buffer.clear();
+                    m_connected = false;
+                    continue;
+                }
+
+                if (body) *body = std::move(response.body());
+                if (etag) *etag = std::string(response[http::field::etag]);
+                if (!response.keep_alive()) {
+                    m_stream.socket().close(ec);
+                    m_connected = false;
+                }
+                return response.result_int();
+            }
+            return 0;
+        }
+
+    private:
+        net::io_context m_context;
+        beast::tcp_stream m_stream;
+        beast::flat_buffer m_buffer;
+        std::string m_host;
+        std::string m_port;
+        bool m_connected = false;
+    };
+
+    struct PhaseResult {
+        double seconds = 0.0;
+        std::vector<double> latencies; // milliseconds
+        std::size_t errors = 0;
+    };
+
+    double percentile(const std::vector<double>& sorted, double p) {
+        if (sorted.empty()) return 0.0;
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(sorted.size() - 1) + 0.5);
+        return sorted[std::min(index, sorted.size() - 1)];
+    }
+
+    void printPhase(const std::string& name, PhaseResult& result) {
+        std::sort(result.latencies.begin(), result.latencies.end());
+        double rps = result.seconds > 0.0 ? static_cast<double>(result.latencies.size()) / result.seconds : 0.0;
+        std::cout << std::left << std::setw(12) << name << std::right << std::fixed
+                  << std::setw(7) << result.latencies.size() << " req  "
+                  << std::setprecision(0) << std::setw(8) << rps << " req/s  "
+                  << std::setprecision(2)
+                  << "p50 " << std::setw(7) << percentile(result.latencies, 0.50) << " ms  "
+                  << "p99 " << std::setw(7) << percentile(result.latencies, 0.99) << " ms  "
+                  << "max " << std::setw(7) << (result.latencies.empty() ? 0.0 : result.latencies.back()) << " ms  "
+                  << result.errors << " errors" << std::endl;
+    }
+}
+
+// Load benchmark for the tile server.
+//
+// Without --port a TileService is started in-process on a free localhost
+// port, so the whole run stays on this machine. Three phases are measured:
+// cold (every tile rendered), warm (every tile served from the LRU) and
+// conditional (If-None-Match answered with 304).
+int runBenchServer(const CommandLine& args) {
+    const std::string host = args.getString("host", "127.0.0.1");
+    const std::string layer = args.getString("layer", "streetmap");
+    const int connections = args.getInt("connections", 16);
+    const int requests = args.getInt("requests", 2000);
+    const int minZoom = args.getInt("min-zoom", 0);
+    const int maxZoom = args.getInt("max-zoom", 12);
+    const int tileLimit = args.getInt("tiles", 500);
+
+    if (connections <= 0 || requests <= 0 || tileLimit <= 0 || minZoom < 0 || maxZoom < minZoom || maxZoom > 24) {
+        std::cerr << "bench-server: invalid --connections, --requests, --tiles or zoom range" << std::endl;
+        return 1;
+    }
+
+    std::unique_ptr<TileService> service;
+    std::unique_ptr<HttpServer> server;
+    int port = args.getInt("port", 0);
+    if (port == 0) {
+        GDALAllRegister();
+        service = std::make_unique<TileService>(args.getString("maps", "resources/maps"),
+                                                static_cast<std::size_t>(args.getInt("cache-mb", 256)) * 1024 * 1024);
+        server = std::make_unique<HttpServer>([&service](const HttpRequest& request, HttpResponse& response) {
+            service->handle(request, response);
+        });
+        if (!server->start(host, 0, static_cast<unsigned int>(std::max(0, args.getInt("threads", 0))))) {
+            return 1;
+        }
+        port = server->port();
+        std::cout << "Started in-process server on " << host << ":" << port << std::endl;
+    }
+    const std::string portString = std::to_string(port);
+
+    // The layer bounds decide which tiles are worth requesting
+    std::string tileJson;
+    Client probe(host, portString);
+    if (probe.get("/tiles/" + layer + ".json", "", &tileJson, nullptr) != 200) {
+        std::cerr << "bench-server: layer " << layer << " is not available" << std::endl;
+        return 1;
+    }
+    double minLon = -180.0, minLat = -85.0, maxLon = 180.0, maxLat = 85.0;
+    std::size_t boundsStart = tileJson.find("\"bounds\":[");
+    if (boundsStart == std::string::npos ||
+        std::sscanf(tileJson.c_str() + boundsStart + 10, "%lf,%lf,%lf,%lf", &minLon, &minLat, &maxLon, &maxLat) != 4) {
+        std::cerr << "bench-server: no bounds in TileJSON, using the whole world" << std::endl;
+    }
+
+    std::vector<projection::TileId> tiles;
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        int maxIndex = (1 << z) - 1;
+        int x0 = std::max(0, std::min(maxIndex, static_cast<int>(projection::lonToTileX(minLon, z))));
+        int x1 = std::max(0, std::min(maxIndex, static_cast<int>(projection::lonToTileX(maxLon, z))));
+        int y0 = std::max(0, std::min(maxIndex, static_cast<int>(projection::latToTileY(maxLat, z))));
+        int y1 = std::max(0, std::min(maxIndex, static_cast<int>(projection::latToTileY(minLat, z))));
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                tiles.push_back(projection::TileId{z, x, y});
+            }
+        }
+    }
+    // Sample a fixed subset so deep zoom ranges do not explode the tile count
+    std::mt19937 random(42);
+    std::shuffle(tiles.begin(), tiles.end(), random);
+    if (tiles.size() > static_cast<std::size_t>(tileLimit)) {
+        tiles.resize(static_cast<std::size_t>(tileLimit));
+    }
+
+    std::vector<std::string> targets;
+    for (const projection::TileId& tile : tiles) {
+        targets.push_back("/tiles/" + layer + "/" + std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" + std::to_string(tile.y) + ".png");
+    }
+    std::vector<std::string> etags(targets.size());
+
+    std::cout << "Benchmarking " << targets.size() << " tiles of " << layer << " (zoom " << minZoom << "-" << maxZoom
+              << ") with " << connections << " connections" << std::endl;
+
+    // Runs `count` requests spread over all connections; request i goes to targets[i % size]
+    auto runPhase = [&](std::size_t count, bool conditional, bool recordEtags) {
+        PhaseResult result;
+        std::mutex resultMutex;
+        std::atomic<std::size_t> next(0);
+        std::vector<std::thread> threads;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int c = 0; c < connections; ++c) {
+            threads.emplace_back([&] {
+                Client client(host, portString);
+                std::vector<double> latencies;
+                std::size_t errors = 0;
+                std::string etag;
+                for (std::size_t i = next++; i < count; i = next++) {
+                    std::size_t index = i % targets.size();
+                    auto requestStart = std::chrono::steady_clock::now();
+                    int status = client.get(targets[index], conditional ? etags[index] : std::string(), nullptr, &etag);
+                    latencies.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - requestStart).count());
+
+                    int expected = conditional ? 304 : 200;
+                    if (status != expected) ++errors;
+                    if (recordEtags && status == 200) etags[index] = etag;
+                }
+
+                std::lock_guard<std::mutex> lock(resultMutex);
+                result.latencies.insert(result.latencies.end(), latencies.begin(), latencies.end());
+                result.errors += errors;
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return result;
+    };
+
+    // Cold touches each tile exactly once so every request is a render
+    PhaseResult cold = runPhase(targets.size(), false, true);
+    PhaseResult warm = runPhase(static_cast<std::size_t>(requests), false, false);
+    PhaseResult conditional = runPhase(static_cast<std::size_t>(requests), true, false);
+
+    printPhase("cold", cold);
+    printPhase("warm", warm);
+    printPhase("conditional", conditional);
+
+    std::string stats;
+    if (probe.get("/stats", "", &stats, nullptr) == 200) {
+        std::cout << "Server stats: " << stats << std::endl;
+    }
+
+    if (server) server->stop();
+    return cold.errors + warm.errors + conditional.errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,111 @@
+#include "commands.hpp"
+#include "../ui/textinput.hpp"
+#include <SFML/Graphics.hpp>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double percentile(std::vector<double> values, double p) {
+        if (values.empty()) return 0.0;
+        std::sort(values.begin(), values.end());
+        std::size_t index = static_cast<std::size_t>(p * static_cast<double>(values.size() - 1) + 0.5);
+        return values[std::min(index, values.size() - 1)];
+    }
+
+    double elapsedMs(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    void report(const char* phase, const std::vector<double>& times) {
+        std::cout << std::fixed << std::setprecision(3) << std::setw(16) << phase << ": p50 " << percentile(times, 0.50)
+                  << " ms, p99 " << percentile(times, 0.99) << " ms, max " << percentile(times, 1.0) << " ms" << std::endl;
+    }
+}
+
+// Pastes a large value into a TextInput and types and deletes in the middle
+// of it, drawing after every edit like the UI does. The same keystrokes are
+// replayed on a plain sf::Text rebuilt from its string for comparison.
+int runBenchTextInput(const CommandLine& args) {
+    const int length = args.getInt("length", 100 * 1024);
+    const int keys = args.getInt("keys", 1000);
+    if (length <= 0 || keys <= 0) {
+        std::cerr << "bench-text-input: --length and --keys must be positive" << std::endl;
+        return 1;
+    }
+
+    sf::Font font;
+    if (!font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
+        std::cerr << "Failed to load font" << std::endl;
+        return 1;
+    }
+    sf::RenderTexture target;
+    if (!target.create(800, 100)) {
+        std::cerr << "Failed to create render texture" << std::endl;
+        return 1;
+    }
+
+    std::u32string text;
+    text.reserve(length);
+    const std::u32string sample = U"The quick brown fox jumps over the lazy dog, été über grün. ";
+    while (text.size() < static_cast<std::size_t>(length)) {
+        text += sample;
+    }
+    text.resize(length);
+
+    TextInput input(font, 24);
+    input.setArea(sf::FloatRect(10, 30, 780, 40));
+
+    auto frame = [&]() {
+        target.clear(sf::Color::White);
+        input.draw(target);
+        target.display();
+    };
+
+    Clock::time_point start = Clock::now();
+    input.insert(text);
+    frame();
+    std::cout << "Paste of " << length << " characters: " << std::setprecision(3) << elapsedMs(start) << " ms" << std::endl;
+
+    sf::Event event;
+    event.type = sf::Event::TextEntered;
+    std::vector<double> typing;
+    input.setCursor(input.size() / 2);
+    for (int i = 0; i < keys; ++i) {
+        start = Clock::now();
+        event.text.unicode = 'a' + i % 26;
+        input.handleEvent(event);
+        frame();
+        typing.push_back(elapsedMs(start));
+    }
+    report("type + draw", typing);
+
+    std::vector<double> deleting;
+    for (int i = 0; i < keys; ++i) {
+        start = Clock::now();
+        event.text.unicode = 8;
+        input.handleEvent(event);
+        frame();
+        deleting.push_back(elapsedMs(start));
+    }
+    report("backspace + draw", deleting);
+    std::cout << "Chunk layouts rebuilt: " << input.layoutCount() << std::endl;
+
+    // Baseline: what the widgets did before, the whole string rebuilt per key
+    sf::Text plain(sf::String::fromUtf32(text.begin(), text.end()), font, 24);
+    std::vector<double> baseline;
+    for (int i = 0; i < std::min(keys, 100); ++i) {
+        start = Clock::now();
+        plain.setString(plain.getString() + static_cast<char>('a' + i % 26));
+        target.clear(sf::Color::White);
+        target.draw(plain);
+        target.display();
+        baseline.push_back(elapsedMs(start));
+    }
+    report("sf::Text rebuild", baseline);
+    return 0;
+}
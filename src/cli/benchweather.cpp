@@ -0,0 +1,134 @@
+#include "commands.hpp"
+#include "../net/httpserver.hpp"
+#include "../utils/weather.hpp"
+#include "../utils/weatherstub.hpp"
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::chrono::milliseconds FrameTime(16);
+
+    // Plays the UI: reads the snapshot once per frame until `done` holds or
+    // time runs out, and keeps the slowest read
+    struct Frames {
+        Weather& weather;
+        double slowestReadMicroseconds = 0.0;
+        std::uint64_t frames = 0;
+
+        bool runUntil(const std::function<bool(const Weather::Snapshot&)>& done, std::chrono::milliseconds timeout) {
+            Clock::time_point end = Clock::now() + timeout;
+            while (Clock::now() < end) {
+                Clock::time_point start = Clock::now();
+                std::shared_ptr<const Weather::Snapshot> snapshot = weather.snapshot();
+                double microseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+                slowestReadMicroseconds = std::max(slowestReadMicroseconds, microseconds);
+                ++frames;
+                if (done(*snapshot)) return true;
+                std::this_thread::sleep_for(FrameTime);
+            }
+            return false;
+        }
+    };
+
+    bool check(bool ok, const std::string& what) {
+        std::cout << (ok ? "ok    " : "FAIL  ") << what << std::endl;
+        return ok;
+    }
+}
+
+// Runs the Weather client against an in-process WeatherStub and walks it
+// through a first fetch, ETag revalidation, a changed reading, an outage
+// with backoff, a slow endpoint and recovery, while a stand-in UI reads the
+// snapshot every frame. With --endpoint it only watches a real endpoint.
+int runBenchWeather(const CommandLine& args) {
+    const std::string external = args.getString("endpoint");
+    if (!external.empty()) {
+        Weather::Options options;
+        options.endpoint = external;
+        Weather weather(options);
+        Frames frames{weather};
+        const int seconds = std::max(1, args.getInt("seconds", 30));
+        std::uint64_t version = 0;
+        frames.runUntil([&](const Weather::Snapshot& snapshot) {
+            if (snapshot.version != version) {
+                version = snapshot.version;
+                std::cout << snapshot.text << (snapshot.error.empty() ? "" : " [" + snapshot.error + "]") << std::endl;
+            }
+            return false;
+        }, std::chrono::seconds(seconds));
+        Weather::Stats stats = weather.stats();
+        std::cout << stats.requests << " requests, " << stats.updated << " updated, " << stats.notModified << " not modified, "
+                  << stats.failures << " failed; slowest snapshot read " << frames.slowestReadMicroseconds << " us" << std::endl;
+        return 0;
+    }
+
+    WeatherStub stub(1);
+    stub.setReading(21.0, "Sunny");
+    HttpServer server([&stub](const HttpRequest& request, HttpResponse& response) {
+        stub.handle(request, response);
+    });
+    if (!server.start("127.0.0.1", 0, 2)) return 1;
+
+    Weather::Options options;
+    options.endpoint = "http://127.0.0.1:" + std::to_string(server.port()) + "/weather";
+    options.initialBackoff = std::chrono::milliseconds(100);
+    options.maxBackoff = std::chrono::milliseconds(800);
+    options.timeout = std::chrono::milliseconds(1500);
+    std::cout << "Stub weather on " << options.endpoint << " (max-age 1 s)" << std::endl;
+
+    Weather weather(options);
+    Frames frames{weather};
+    bool ok = true;
+
+    Clock::time_point start = Clock::now();
+    ok &= check(frames.runUntil([](const Weather::Snapshot& s) { return s.valid; }, std::chrono::seconds(3)), "first reading");
+    std::cout << "      " << weather.snapshot()->text << " after "
+              << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+
+    // Unchanged reading: every expiry should come back as a 304
+    std::uint64_t version = weather.snapshot()->version;
+    frames.runUntil([](const Weather::Snapshot&) { return false; }, std::chrono::milliseconds(3500));
+    ok &= check(stub.notModified() >= 2 && weather.snapshot()->version == version,
+                "revalidation: " + std::to_string(stub.notModified()) + " answers were 304, snapshot unchanged");
+
+    stub.setReading(-3.0, "Snowy");
+    ok &= check(frames.runUntil([](const Weather::Snapshot& s) { return s.condition == "Snowy"; }, std::chrono::seconds(3)),
+                "changed reading picked up on the next expiry");
+
+    // Outage: retries back off, the last reading stays up and turns stale
+    stub.setFailing(true);
+    std::uint64_t requestsBefore = stub.requests();
+    bool stale = frames.runUntil([](const Weather::Snapshot& s) { return s.stale && s.valid; }, std::chrono::seconds(4));
+    ok &= check(stale, "reading marked stale during an outage: " + weather.snapshot()->text);
+    frames.runUntil([](const Weather::Snapshot&) { return false; }, std::chrono::seconds(3));
+    std::uint64_t outageRequests = stub.requests() - requestsBefore;
+    // 3-4 s of outage at 100, 200, 400, 800, 800 ... ms (each 50-100%) is about 5 to 12 requests
+    ok &= check(outageRequests >= 3 && outageRequests <= 15,
+                "backoff: " + std::to_string(outageRequests) + " requests in the outage, " +
+                std::to_string(weather.stats().consecutiveFailures) + " consecutive failures");
+
+    // A slow endpoint must not slow down frames
+    stub.setFailing(false);
+    stub.setDelay(std::chrono::milliseconds(1200));
+    bool recovered = frames.runUntil([](const Weather::Snapshot& s) { return !s.stale && s.error.empty(); }, std::chrono::seconds(6));
+    ok &= check(recovered, "recovered from a slow endpoint: " + weather.snapshot()->text);
+    stub.setDelay(std::chrono::milliseconds(0));
+
+    ok &= check(frames.slowestReadMicroseconds < 1000.0,
+                "slowest snapshot read over " + std::to_string(frames.frames) + " frames: " +
+                std::to_string(frames.slowestReadMicroseconds) + " us");
+
+    Weather::Stats stats = weather.stats();
+    std::cout << stats.requests << " requests, " << stats.updated << " updated, " << stats.notModified << " not modified, "
+              << stats.failures << " failed" << std::endl;
+    server.stop();
+    std::cout << (ok ? "PASS" : "FAIL") << std::endl;
+    return ok ? 0 : 1;
+}
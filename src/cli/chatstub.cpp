@@ -0,0 +1,23 @@
+#include "commands.hpp"
+#include "../chatbot/stubmodel.hpp"
+#include "../net/httpserver.hpp"
+#include <iostream>
+
+// Runs the stub model server that the Chatbot talks to by default
+int runChatStub(const CommandLine& args) {
+    const std::string address = args.getString("address", "127.0.0.1");
+    const int port = args.getInt("port", 8081);
+
+    StubModel model(args.getInt("first-token-ms", 150), args.getDouble("tokens-per-second", 40.0), args.getInt("tokens", 64));
+    HttpServer server([&model](const HttpRequest& request, HttpResponse& response) {
+        model.handle(request, response);
+    });
+    if (port < 0 || port > 65535 || !server.start(address, static_cast<unsigned short>(port))) {
+        return 1;
+    }
+
+    std::cout << "Stub model streaming on http://" << address << ":" << server.port() << "/generate, press Ctrl+C to stop" << std::endl;
+    waitForInterrupt();
+    server.stop();
+    return 0;
+}
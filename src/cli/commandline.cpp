@@ -0,0 +1,128 @@
+#include "commandline.hpp"
+#include "commands.hpp"
+#include <chrono>
+#include <csignal>
+#include <iostream>
+#include <thread>
+
+namespace {
+    volatile std::sig_atomic_t s_interrupted = 0;
+
+    void onSignal(int) {
+        s_interrupted = 1;
+    }
+
+    struct Command {
+        const char* name;
+        const char* usage;
+        int (*run)(const CommandLine&);
+    };
+
+    const Command Commands[] = {
+        {"render-tiles", "--output <tiles.mbtiles|dir> [--input <dataset>] [--min-zoom 0] [--max-zoom 6] [--threads N] [--tile-size 256]", runRenderTiles},
+        {"serve", "[--maps resources/maps] [--address 0.0.0.0] [--port 8080] [--threads N] [--cache-mb 256]", runServe},
+        {"bench-server", "[--port P (default: start an in-process server)] [--layer streetmap] [--connections 16] [--requests 2000] [--min-zoom 0] [--max-zoom 12] [--tiles 500]", runBenchServer},
+        {"chat-stub", "[--address 127.0.0.1] [--port 8081] [--first-token-ms 150] [--tokens-per-second 40] [--tokens 64]", runChatStub},
+        {"bench-chat", "[--endpoint URL (default: start an in-process stub)] [--requests 20] [--first-token-ms 50] [--tokens-per-second 200] [--tokens 64] [--max-first-token-ms N] [--max-cancel-ms 100]", runBenchChat},
+        {"bench-chat-history", "[--messages 100000] [--db bench_chat_history.db]", runBenchChatHistory},
+        {"index-docs", "[--docs resources/docs] [--index chatbot_index.bin] [--threads N] [--query TEXT] [--limit 5]", runIndexDocs},
+        {"bench-retrieval", "[--passages 1000000] [--queries 1000] [--dir bench_docs] [--index bench_docs.bin]", runBenchRetrieval},
+        {"bench-text-input", "[--length 102400] [--keys 1000]", runBenchTextInput},
+        {"bench-db-browser", "[--rows 50000000] [--frames 2000] [--db bench_browser.db]", runBenchDbBrowser},
+        {"import", "--file FILE.csv|FILE.gpkg [--db database.db] [--table NAME] [--layer NAME]", runImport},
+        {"bench-import", "[--rows 10000000] [--csv bench_import.csv] [--db bench_import.db]", runBenchImport},
+        {"bench-db-pool", "[--rows 1000000] [--threads 8] [--queries 100000] [--db bench_pool.db]", runBenchDbPool},
+        {"bench-capture", "[--source pattern:1280x720@60|/dev/videoN|IMAGE|DIR] [--seconds 10] [--fps 60]", runBenchCapture},
+        {"bench-kernels", "[--width 1920] [--height 1080] [--iterations 200] [--threads N]", runBenchKernels},
+        {"bench-record", "[--source pattern:1280x720@60] [--seconds 10] [--format raw|png|mjpeg] [--dir bench_record] [--max-mbps 0] [--threads N] [--policy quality|drop]", runBenchRecord},
+        {"motion-test", "[--source SPEC (default: synthetic clip)] [--frames 300] [--width 1280] [--height 720] [--threshold 24] [--threads N]", runMotionTest},
+        {"weather-stub", "[--address 127.0.0.1] [--port 8082] [--max-age 60] [--temperature 18] [--condition Cloudy] [--delay-ms 0] [--fail]", runWeatherStub},
+        {"bench-weather", "[--endpoint URL (default: scripted run against an in-process stub)] [--seconds 30]", runBenchWeather},
+        {"bench-overlay", "[--file FORECAST (default: synthetic global forecast)] [--steps 24] [--interval 250] [--seconds 30]", runBenchOverlay},
+        {"bench-scheduler", "[--threads N] [--task-us 200] [--tasks 4000]", runBenchScheduler},
+        {"generate-map", "--output FILE.gpkg [--features 100000] [--types points,lines,polygons,curves] [--vertices 8] [--holes 0.3] [--names 1000] [--categories 16] [--raster 0] [--seed 1]", runGenerateMap},
+        {"bench-map", "[--sizes 1000,10000,100000] [--dir bench_maps] [--frames 30] [--types points,lines,polygons,curves] [--raster 0] [--csv FILE] [--regenerate]", runBenchMap},
+    };
+
+    void printUsage() {
+        std::cout << "Usage: MultiAppProgram [command] [options]" << std::endl;
+        std::cout << "Without a command the interactive program starts." << std::endl << std::endl;
+        for (const Command& command : Commands) {
+            std::cout << "  " << command.name << " " << command.usage << std::endl;
+        }
+    }
+}
+
+CommandLine::CommandLine(int argc, char** argv) {
+    int i = 1;
+    if (argc > 1 && std::string(argv[1]).rfind("--", 0) != 0) {
+        m_command = argv[1];
+        i = 2;
+    }
+
+    for (; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.rfind("--", 0) != 0) {
+            std::cerr << "Ignoring unexpected argument: " << arg << std::endl;
+            continue;
+        }
+        std::string name = arg.substr(2);
+        // A following argument that is not an option is this option's value
+        if (i + 1 < argc && std::string(argv[i + 1]).rfind("--", 0) != 0) {
+            m_options[name] = argv[++i];
+        } else {
+            m_options[name] = "";
+        }
+    }
+}
+
+bool CommandLine::has(const std::string& name) const {
+    return m_options.count(name) > 0;
+}
+
+std::string CommandLine::getString(const std::string& name, const std::string& defaultValue) const {
+    auto it = m_options.find(name);
+    return it != m_options.end() ? it->second : defaultValue;
+}
+
+int CommandLine::getInt(const std::string& name, int defaultValue) const {
+    auto it = m_options.find(name);
+    if (it == m_options.end() || it->second.empty()) return defaultValue;
+    try {
+        return std::stoi(it->second);
+    } catch (const std::exception&) {
+        std::cerr << "Invalid value for --" << name << ": " << it->second << std::endl;
+        return defaultValue;
+    }
+}
+
+double CommandLine::getDouble(const std::string& name, double defaultValue) const {
+    auto it = m_options.find(name);
+    if (it == m_options.end() || it->second.empty()) return defaultValue;
+    try {
+        return std::stod(it->second);
+    } catch (const std::exception&) {
+        std::cerr << "Invalid value for --" << name << ": " << it->second << std::endl;
+        return defaultValue;
+    }
+}
+
+void waitForInterrupt() {
+    std::signal(SIGINT, onSignal);
+    std::signal(SIGTERM, onSignal);
+    while (!s_interrupted) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    }
+}
+
+int runCommandLine(int argc, char** argv) {
+    CommandLine args(argc, argv);
+    for (const Command& command : Commands) {
+        if (args.command() == command.name) {
+            return command.run(args);
+        }
+    }
+
+    printUsage();
+    return args.command().empty() || args.command() == "help" ? 0 : 1;
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+// Parsed arguments for the headless command line modes:
+//   MultiAppProgram <command> [--option value] [--flag]
+class CommandLine {
+public:
+    CommandLine(int argc, char** argv);
+
+    const std::string& command() const { return m_command; }
+    bool has(const std::string& name) const;
+    std::string getString(const std::string& name, const std::string& defaultValue = "") const;
+    int getInt(const std::string& name, int defaultValue) const;
+    double getDouble(const std::string& name, double defaultValue) const;
+
+private:
+    std::string m_command;
+    std::map<std::string, std::string> m_options;
+};
+
+// Runs the command named by argv[1] and returns the process exit code
+int runCommandLine(int argc, char** argv);
+
+// Blocks until SIGINT/SIGTERM, for long-running modes such as servers
+void waitForInterrupt();
@@ -0,0 +1,28 @@
+#pragma once
+
+#include "commandline.hpp"
+
+// One entry point per headless mode; each lives in its own translation unit.
+int runRenderTiles(const CommandLine& args);
+int runServe(const CommandLine& args);
+int runBenchServer(const CommandLine& args);
+int runChatStub(const CommandLine& args);
+int runBenchChat(const CommandLine& args);
+int runBenchChatHistory(const CommandLine& args);
+int runIndexDocs(const CommandLine& args);
+int runBenchRetrieval(const CommandLine& args);
+int runBenchTextInput(const CommandLine& args);
+int runBenchDbBrowser(const CommandLine& args);
+int runImport(const CommandLine& args);
+int runBenchImport(const CommandLine& args);
+int runBenchDbPool(const CommandLine& args);
+int runBenchCapture(const CommandLine& args);
+int runBenchKernels(const CommandLine& args);
+int runBenchRecord(const CommandLine& args);
+int runMotionTest(const CommandLine& args);
+int runWeatherStub(const CommandLine& args);
+int runBenchWeather(const CommandLine& args);
+int runBenchOverlay(const CommandLine& args);
+int runBenchScheduler(const CommandLine& args);
+int runGenerateMap(const CommandLine& args);
+int runBenchMap(const CommandLine& args);
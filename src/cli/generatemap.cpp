@@ -0,0 +1,34 @@
+#include "commands.hpp"
+#include "../map/syntheticmap.hpp"
+#include <algorithm>
+#include <iostream>
+
+// Writes a synthetic GeoPackage for scaling tests. With --features 0 and
+// --raster N it writes only a raster, e.g. a stand-in for a base layer.
+int runGenerateMap(const CommandLine& args) {
+    const std::string output = args.getString("output");
+    if (output.empty()) {
+        std::cerr << "generate-map needs --output FILE.gpkg" << std::endl;
+        return 1;
+    }
+
+    SyntheticMapOptions options;
+    options.features = static_cast<std::uint64_t>(std::max(0.0, args.getDouble("features", static_cast<double>(options.features))));
+    if (args.has("types") && !options.parseTypes(args.getString("types"))) {
+        std::cerr << "Unknown --types " << args.getString("types") << "; use points,lines,polygons,curves" << std::endl;
+        return 1;
+    }
+    options.vertices = static_cast<unsigned int>(std::max(3, args.getInt("vertices", static_cast<int>(options.vertices))));
+    options.holeFraction = std::min(1.0, std::max(0.0, args.getDouble("holes", options.holeFraction)));
+    options.names = static_cast<std::uint64_t>(std::max(0.0, args.getDouble("names", static_cast<double>(options.names))));
+    options.categories = static_cast<unsigned int>(std::max(1, args.getInt("categories", static_cast<int>(options.categories))));
+    options.rasterWidth = static_cast<unsigned int>(std::max(0, args.getInt("raster", 0)));
+    options.seed = static_cast<std::uint64_t>(std::max(0, args.getInt("seed", 1)));
+
+    std::string error;
+    if (!writeSyntheticMap(output, options, error)) {
+        std::cerr << "Could not write " << output << ": " << error << std::endl;
+        return 1;
+    }
+    return 0;
+}
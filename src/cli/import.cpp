@@ -0,0 +1,37 @@
+#include "commands.hpp"
+#include "../database/importer.hpp"
+#include <iomanip>
+#include <iostream>
+#include <thread>
+
+// Loads a CSV file or GeoPackage feature table into a database, printing the rate once a second
+int runImport(const CommandLine& args) {
+    const std::string file = args.getString("file");
+    const std::string dbPath = args.getString("db", "database.db");
+    if (file.empty()) {
+        std::cerr << "import: --file is required" << std::endl;
+        return 1;
+    }
+
+    Importer importer;
+    importer.start(file, dbPath, args.getString("table"), args.getString("layer"));
+    std::cout << std::fixed << std::setprecision(0);
+    while (importer.isRunning()) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        Importer::Progress progress = importer.progress();
+        if (progress.phase == Importer::Phase::Loading) {
+            std::cout << progress.rows << " rows, " << progress.rowsPerSecond << " rows/s" << std::endl;
+        } else if (progress.phase == Importer::Phase::Indexing) {
+            std::cout << "building indexes..." << std::endl;
+        }
+    }
+
+    Importer::Progress progress = importer.progress();
+    if (progress.phase == Importer::Phase::Failed) {
+        std::cerr << "import: " << progress.error << std::endl;
+        return 1;
+    }
+    std::cout << std::setprecision(2) << "Imported " << progress.rows << " rows into " << progress.table << " in "
+              << progress.seconds << " s (" << std::setprecision(0) << progress.averageRowsPerSecond << " rows/s)" << std::endl;
+    return 0;
+}
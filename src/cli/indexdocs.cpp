@@ -0,0 +1,29 @@
+#include "commands.hpp"
+#include "../chatbot/documentindex.hpp"
+#include <iomanip>
+#include <iostream>
+
+// Builds or refreshes the chatbot's document index, optionally running one query against it
+int runIndexDocs(const CommandLine& args) {
+    const std::string docs = args.getString("docs", DocumentIndex::defaultDocsDirectory());
+    const std::string indexPath = args.getString("index", "chatbot_index.bin");
+    const int threads = args.getInt("threads", 0);
+
+    DocumentIndex index;
+    DocumentIndex::BuildStats stats;
+    if (!index.update(docs, indexPath, threads > 0 ? static_cast<unsigned int>(threads) : 0, &stats)) {
+        return 1;
+    }
+    std::cout << std::fixed << std::setprecision(2)
+              << "Indexed " << stats.files << " files (" << stats.filesTokenized << " tokenized): "
+              << stats.passages << " passages, " << stats.terms << " terms, "
+              << stats.indexBytes / (1024.0 * 1024.0) << " MB in " << stats.seconds << " s" << std::endl;
+
+    const std::string query = args.getString("query");
+    if (!query.empty()) {
+        for (const DocumentIndex::Passage& passage : index.search(query, static_cast<std::size_t>(args.getInt("limit", 5)))) {
+            std::cout << "\n[" << passage.score << "] " << passage.path << "\n" << passage.text << std::endl;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+#include "commands.hpp"
+#include "../map/geometrystore.hpp"
+#include "../map/tilerenderer.hpp"
+#include "../map/tilestorage.hpp"
+#include "../utils/imageencoder.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+// Renders an XYZ tile pyramid from a dataset without opening a window.
+//
+// The dataset is loaded once into a GeometryStore that all workers share
+// read-only; each worker renders, PNG-encodes and hands tiles to the sink.
+int runRenderTiles(const CommandLine& args) {
+    const std::string input = args.getString("input", "resources/maps/streetmap.gpkg");
+    const std::string output = args.getString("output");
+    const int minZoom = args.getInt("min-zoom", 0);
+    const int maxZoom = args.getInt("max-zoom", 6);
+    const int tileSize = args.getInt("tile-size", 256);
+
+    if (output.empty() || minZoom < 0 || maxZoom < minZoom || maxZoom > 24 || tileSize <= 0) {
+        std::cerr << "render-tiles: need --output and 0 <= --min-zoom <= --max-zoom <= 24" << std::endl;
+        return 1;
+    }
+
+    GDALAllRegister();
+
+    auto loadStart = std::chrono::steady_clock::now();
+    GeometryStore store;
+    {
+        std::unique_ptr<GDALDataset> dataset(static_cast<GDALDataset*>(
+            GDALOpenEx(input.c_str(), GDAL_OF_VECTOR | GDAL_OF_READONLY, nullptr, nullptr, nullptr)));
+        if (!dataset) {
+            std::cerr << "Failed to open " << input << std::endl;
+            return 1;
+        }
+        if (!store.load(dataset.get())) {
+            std::cerr << "No vector features in " << input << std::endl;
+            return 1;
+        }
+    }
+    double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - loadStart).count();
+    std::cout << "Loaded " << store.features().size() << " features (" << store.vertices().size()
+              << " vertices) in " << std::fixed << std::setprecision(2) << loadSeconds << " s" << std::endl;
+
+    MapStyle style;
+    TileRenderer renderer(store, style, static_cast<unsigned int>(tileSize));
+
+    std::vector<projection::TileId> tiles;
+    for (int z = minZoom; z <= maxZoom; ++z) {
+        renderer.tilesForZoom(z, tiles);
+    }
+
+    std::unique_ptr<TileSink> sink = createTileSink(output, minZoom, maxZoom);
+    if (!sink) {
+        std::cerr << "Failed to open tile output " << output << std::endl;
+        return 1;
+    }
+
+    TaskScheduler scheduler(static_cast<unsigned int>(std::max(0, args.getInt("threads", 0))));
+    CancellationToken rendering;
+    std::cout << "Rendering " << tiles.size() << " tiles for zoom " << minZoom << "-" << maxZoom
+              << " on " << scheduler.threadCount() << " threads" << std::endl;
+
+    std::atomic<std::size_t> nextTile(0);
+    std::atomic<std::size_t> doneTiles(0);
+    std::atomic<std::size_t> writtenTiles(0);
+    std::atomic<std::size_t> failedTiles(0);
+
+    auto renderStart = std::chrono::steady_clock::now();
+    for (unsigned int t = 0; t < scheduler.threadCount(); ++t) {
+        scheduler.submit(TaskScheduler::Priority::Normal, rendering, [&] {
+            std::vector<std::uint8_t> pixels;
+            std::vector<std::uint8_t> png;
+            for (std::size_t i = nextTile++; i < tiles.size(); i = nextTile++) {
+                // Tiles without any feature are left out of the pyramid
+                if (renderer.render(tiles[i], pixels)) {
+                    if (imageencoder::encodePng(pixels.data(), renderer.tileSize(), renderer.tileSize(), png) &&
+                        sink->write(tiles[i], png)) {
+                        ++writtenTiles;
+                    } else {
+                        ++failedTiles;
+                    }
+                }
+                ++doneTiles;
+            }
+        });
+    }
+
+    // Report progress about once a second while the workers run
+    auto lastReport = renderStart;
+    while (doneTiles < tiles.size()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto now = std::chrono::steady_clock::now();
+        if (now - lastReport >= std::chrono::seconds(1)) {
+            double elapsed = std::chrono::duration<double>(now - renderStart).count();
+            std::cout << "  " << doneTiles << "/" << tiles.size() << " tiles, "
+                      << std::fixed << std::setprecision(1) << doneTiles / elapsed << " tiles/s" << std::endl;
+            lastReport = now;
+        }
+    }
+    rendering.wait();
+    sink->close();
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+    std::cout << "Rendered " << tiles.size() << " tiles (" << writtenTiles << " written, "
+              << tiles.size() - writtenTiles - failedTiles << " empty, " << failedTiles << " failed) in "
+              << std::fixed << std::setprecision(2) << seconds << " s: "
+              << std::setprecision(1) << tiles.size() / std::max(seconds, 1e-9) << " tiles/s" << std::endl;
+
+    return failedTiles == 0 ? 0 : 1;
+}
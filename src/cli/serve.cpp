@@ -0,0 +1,37 @@
+#include "commands.hpp"
+#include "../map/tileservice.hpp"
+#include "../net/httpserver.hpp"
+#include <iostream>
+
+// Serves map tiles over HTTP until interrupted (Ctrl+C)
+int runServe(const CommandLine& args) {
+    const std::string address = args.getString("address", "0.0.0.0");
+    const int port = args.getInt("port", 8080);
+    const int threads = args.getInt("threads", 0);
+    const int cacheMegabytes = args.getInt("cache-mb", 256);
+    const std::string maps = args.getString("maps", "resources/maps");
+
+    if (port < 0 || port > 65535 || threads < 0 || cacheMegabytes < 0) {
+        std::cerr << "serve: invalid --port, --threads or --cache-mb" << std::endl;
+        return 1;
+    }
+
+    GDALAllRegister();
+
+    TileService service(maps, static_cast<std::size_t>(cacheMegabytes) * 1024 * 1024);
+    HttpServer server([&service](const HttpRequest& request, HttpResponse& response) {
+        service.handle(request, response);
+    });
+    if (!server.start(address, static_cast<unsigned short>(port), static_cast<unsigned int>(threads))) {
+        return 1;
+    }
+
+    std::cout << "Serving maps from " << maps << " on http://" << address << ":" << server.port() << "/" << std::endl;
+    std::cout << "Tiles: /tiles/<layer>/<z>/<x>/<y>.png, press Ctrl+C to stop" << std::endl;
+
+    waitForInterrupt();
+
+    std::cout << "Stopping server" << std::endl;
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,27 @@
+#include "commands.hpp"
+#include "../net/httpserver.hpp"
+#include "../utils/weatherstub.hpp"
+#include <chrono>
+#include <iostream>
+
+// Runs the stub weather service that the main window fetches by default
+int runWeatherStub(const CommandLine& args) {
+    const std::string address = args.getString("address", "127.0.0.1");
+    const int port = args.getInt("port", 8082);
+
+    WeatherStub stub(args.getInt("max-age", 60));
+    stub.setReading(args.getDouble("temperature", 18.0), args.getString("condition", "Cloudy"));
+    stub.setDelay(std::chrono::milliseconds(args.getInt("delay-ms", 0)));
+    stub.setFailing(args.has("fail"));
+    HttpServer server([&stub](const HttpRequest& request, HttpResponse& response) {
+        stub.handle(request, response);
+    });
+    if (port < 0 || port > 65535 || !server.start(address, static_cast<unsigned short>(port))) {
+        return 1;
+    }
+
+    std::cout << "Stub weather on http://" << address << ":" << server.port() << "/weather, press Ctrl+C to stop" << std::endl;
+    waitForInterrupt();
+    server.stop();
+    return 0;
+}
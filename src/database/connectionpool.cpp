@@ -0,0 +1,239 @@
+#include "connectionpool.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <thread>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // Pages come from the mapping; the private cache only holds what mmap cannot
+    const char* ConnectionSetup =
+        "PRAGMA cache_size = -2048;"
+        "PRAGMA query_only = ON;";
+
+    std::string canonicalPath(const std::string& path) {
+        std::error_code error;
+        std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+        return error ? path : canonical.string();
+    }
+}
+
+ConnectionPool::Lease::Lease(ConnectionPool* pool, File* file, Connection* connection)
+    : m_pool(pool),
+      m_file(file),
+      m_connection(connection)
+{
+}
+
+ConnectionPool::Lease::Lease(Lease&& other) noexcept
+    : m_pool(other.m_pool),
+      m_file(other.m_file),
+      m_connection(other.m_connection)
+{
+    other.m_connection = nullptr;
+}
+
+ConnectionPool::Lease& ConnectionPool::Lease::operator=(Lease&& other) noexcept {
+    if (this != &other) {
+        release();
+        m_pool = other.m_pool;
+        m_file = other.m_file;
+        m_connection = other.m_connection;
+        other.m_connection = nullptr;
+    }
+    return *this;
+}
+
+ConnectionPool::Lease::~Lease() {
+    release();
+}
+
+sqlite3* ConnectionPool::Lease::db() const {
+    return m_connection ? m_connection->db : nullptr;
+}
+
+StatementCache& ConnectionPool::Lease::statements() const {
+    return *m_connection->statements;
+}
+
+void ConnectionPool::Lease::release() {
+    if (!m_connection) return;
+    m_pool->giveBack(m_file, m_connection);
+    m_connection = nullptr;
+}
+
+ConnectionPool& ConnectionPool::instance() {
+    static ConnectionPool pool;
+    return pool;
+}
+
+ConnectionPool::ConnectionPool(std::size_t maxConnectionsPerFile)
+    : m_maxConnectionsPerFile(maxConnectionsPerFile > 0 ? maxConnectionsPerFile
+                                                        : std::max<std::size_t>(4, std::thread::hardware_concurrency()))
+{
+}
+
+ConnectionPool::~ConnectionPool() {
+    for (auto& entry : m_files) {
+        for (auto& connection : entry.second.idle) {
+            close(std::move(connection));
+        }
+        if (entry.second.open > entry.second.idle.size()) {
+            std::cerr << "ConnectionPool: " << entry.first << " still has leased connections" << std::endl;
+        }
+    }
+}
+
+ConnectionPool::Lease ConnectionPool::acquire(const std::string& path) {
+    const std::string key = canonicalPath(path);
+    Clock::time_point start = Clock::now();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    File& file = m_files[key];
+    ++m_acquisitions;
+
+    bool waited = false;
+    while (file.idle.empty() && file.open >= m_maxConnectionsPerFile) {
+        waited = true;
+        file.available.wait(lock);
+    }
+    if (waited) {
+        recordWait(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+    }
+
+    if (!file.idle.empty()) {
+        Connection* connection = file.idle.back().release();
+        file.idle.pop_back();
+        ++m_leased;
+        return Lease(this, &file, connection);
+    }
+
+    // Opening takes a while; the slot is taken so other threads do not overshoot the limit
+    ++file.open;
+    std::uint64_t generation = file.generation;
+    lock.unlock();
+    std::unique_ptr<Connection> connection = open(key);
+    lock.lock();
+
+    if (!connection) {
+        --file.open;
+        file.available.notify_one();
+        return Lease();
+    }
+    connection->generation = generation;
+    ++m_opened;
+    ++m_leased;
+    return Lease(this, &file, connection.release());
+}
+
+void ConnectionPool::invalidate(const std::string& path) {
+    std::vector<std::unique_ptr<Connection>> stale;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_files.find(canonicalPath(path));
+        if (it == m_files.end()) return;
+
+        File& file = it->second;
+        ++file.generation;
+        file.open -= file.idle.size();
+        stale.swap(file.idle);
+        file.available.notify_all();
+    }
+    for (auto& connection : stale) {
+        close(std::move(connection));
+    }
+}
+
+ConnectionPool::Stats ConnectionPool::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    Stats stats;
+    stats.acquisitions = m_acquisitions;
+    stats.waits = m_waits;
+    stats.opened = m_opened;
+    stats.leased = m_leased;
+    for (const auto& entry : m_files) {
+        stats.connections += entry.second.open;
+    }
+    stats.totalWaitMilliseconds = m_totalWaitMilliseconds;
+    stats.maxWaitMilliseconds = m_maxWaitMilliseconds;
+    stats.p50WaitMilliseconds = waitPercentile(0.50);
+    stats.p99WaitMilliseconds = waitPercentile(0.99);
+    return stats;
+}
+
+void ConnectionPool::resetStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_acquisitions = 0;
+    m_waits = 0;
+    m_opened = 0;
+    m_totalWaitMilliseconds = 0.0;
+    m_maxWaitMilliseconds = 0.0;
+    m_waitHistogram.fill(0);
+}
+
+std::unique_ptr<ConnectionPool::Connection> ConnectionPool::open(const std::string& path) {
+    sqlite3* db = nullptr;
+    // Each connection is used by one lease holder at a time, so SQLite's own mutexes are not needed
+    if (sqlite3_open_v2(path.c_str(), &db, SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to open " << path << ": " << sqlite3_errmsg(db) << std::endl;
+        sqlite3_close(db);
+        return nullptr;
+    }
+    sqlite3_busy_timeout(db, 2000);
+    std::string setup = "PRAGMA mmap_size = " + std::to_string(MmapSize) + ";" + ConnectionSetup;
+    if (sqlite3_exec(db, setup.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "ConnectionPool: cannot configure " << path << ": " << sqlite3_errmsg(db) << std::endl;
+    }
+
+    std::unique_ptr<Connection> connection = std::make_unique<Connection>();
+    connection->db = db;
+    connection->statements = std::make_unique<StatementCache>(db);
+    return connection;
+}
+
+void ConnectionPool::close(std::unique_ptr<Connection> connection) {
+    connection->statements.reset();
+    sqlite3_close(connection->db);
+}
+
+void ConnectionPool::giveBack(File* file, Connection* connection) {
+    std::unique_ptr<Connection> owned(connection);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        --m_leased;
+        if (owned->generation == file->generation) {
+            file->idle.push_back(std::move(owned));
+        } else {
+            --file->open;
+        }
+        file->available.notify_one();
+    }
+    if (owned) close(std::move(owned));
+}
+
+void ConnectionPool::recordWait(double milliseconds) {
+    ++m_waits;
+    m_totalWaitMilliseconds += milliseconds;
+    m_maxWaitMilliseconds = std::max(m_maxWaitMilliseconds, milliseconds);
+
+    double microseconds = milliseconds * 1000.0;
+    std::size_t bucket = microseconds < 1.0 ? 0 : static_cast<std::size_t>(std::log2(microseconds)) + 1;
+    ++m_waitHistogram[std::min(bucket, WaitBuckets - 1)];
+}
+
+double ConnectionPool::waitPercentile(double fraction) const {
+    if (m_waits == 0) return 0.0;
+    std::size_t target = static_cast<std::size_t>(std::ceil(fraction * static_cast<double>(m_waits)));
+    std::size_t seen = 0;
+    for (std::size_t bucket = 0; bucket < WaitBuckets; ++bucket) {
+        seen += m_waitHistogram[bucket];
+        if (seen >= std::max<std::size_t>(target, 1)) {
+            return std::min(std::ldexp(1.0, static_cast<int>(bucket)) / 1000.0, m_maxWaitMilliseconds);
+        }
+    }
+    return m_maxWaitMilliseconds;
+}
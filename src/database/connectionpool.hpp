@@ -0,0 +1,130 @@
+#pragma once
+
+#include "statementcache.hpp"
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+
+// Process-wide pool of read-only SQLite connections, shared by the map
+// (GeoPackage change tracking, MBTiles layers) and the Database app.
+//
+// Connections map up to MmapSize bytes of the file, so pages are read
+// straight from the OS page cache, which every connection and thread shares,
+// and each connection only keeps a small private cache. SQLite's own
+// shared-cache mode is not used: it makes readers take table locks on one
+// another, which is the contention this pool is meant to avoid.
+//
+// acquire() hands out an idle connection to the file, opens a new one, or
+// waits once maxConnectionsPerFile are leased. Every connection keeps its
+// prepared statements across leases. Time spent waiting is recorded.
+class ConnectionPool {
+private:
+    struct Connection;
+    struct File;
+
+public:
+    static const std::int64_t MmapSize = 256LL * 1024 * 1024;
+
+    // A connection on loan; it goes back to the pool when the lease is destroyed
+    class Lease {
+    public:
+        Lease() = default;
+        Lease(Lease&& other) noexcept;
+        Lease& operator=(Lease&& other) noexcept;
+        ~Lease();
+
+        Lease(const Lease&) = delete;
+        Lease& operator=(const Lease&) = delete;
+
+        explicit operator bool() const { return m_connection != nullptr; }
+        sqlite3* db() const;
+        // Statements prepared on this connection, kept while it is pooled
+        StatementCache& statements() const;
+        void release();
+
+    private:
+        friend class ConnectionPool;
+        Lease(ConnectionPool* pool, File* file, Connection* connection);
+
+        ConnectionPool* m_pool = nullptr;
+        File* m_file = nullptr;
+        Connection* m_connection = nullptr;
+    };
+
+    struct Stats {
+        std::size_t acquisitions = 0;
+        std::size_t waits = 0;       // acquisitions that found every connection leased
+        std::size_t opened = 0;
+        std::size_t connections = 0; // open now, leased or idle
+        std::size_t leased = 0;
+        double totalWaitMilliseconds = 0.0;
+        double maxWaitMilliseconds = 0.0;
+        // Over the acquisitions that waited; upper bounds of power-of-two buckets
+        double p50WaitMilliseconds = 0.0;
+        double p99WaitMilliseconds = 0.0;
+    };
+
+    // The pool used by the map and the Database app
+    static ConnectionPool& instance();
+
+    // maxConnectionsPerFile == 0 uses one per hardware core, and at least 4
+    explicit ConnectionPool(std::size_t maxConnectionsPerFile = 0);
+    // Every lease must have been released
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    // Blocks while every connection to the file is leased. Returns an empty
+    // lease (and logs why) if the file cannot be opened.
+    Lease acquire(const std::string& path);
+    // Closes the idle connections to a file that was replaced on disk;
+    // leased ones are closed when they come back
+    void invalidate(const std::string& path);
+
+    Stats stats() const;
+    void resetStats();
+    std::size_t maxConnectionsPerFile() const { return m_maxConnectionsPerFile; }
+
+private:
+    static const std::size_t WaitBuckets = 32; // log2 of microseconds
+
+    struct Connection {
+        sqlite3* db = nullptr;
+        std::unique_ptr<StatementCache> statements;
+        std::uint64_t generation = 0;
+    };
+
+    struct File {
+        std::vector<std::unique_ptr<Connection>> idle;
+        std::size_t open = 0; // idle, leased or being opened
+        std::uint64_t generation = 0;
+        std::condition_variable available;
+    };
+
+    std::size_t m_maxConnectionsPerFile;
+    mutable std::mutex m_mutex;
+    std::map<std::string, File> m_files; // by canonical path
+
+    std::size_t m_acquisitions = 0;
+    std::size_t m_waits = 0;
+    std::size_t m_opened = 0;
+    std::size_t m_leased = 0;
+    double m_totalWaitMilliseconds = 0.0;
+    double m_maxWaitMilliseconds = 0.0;
+    std::array<std::size_t, WaitBuckets> m_waitHistogram{};
+
+    std::unique_ptr<Connection> open(const std::string& path);
+    void close(std::unique_ptr<Connection> connection);
+    void giveBack(File* file, Connection* connection);
+    void recordWait(double milliseconds);
+    double waitPercentile(double fraction) const;
+};
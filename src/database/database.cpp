@@ -1,10 +1,30 @@
 #include "database.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
 #include <iostream>
 
+namespace {
+    const char* const DefaultDatabasePath = "database.db";
+    const float TableListTop = 110.f;
+    const float TableRowHeight = 24.f;
+}
+
 Database::Database(sf::RenderWindow& window)
-    : m_window(window)
+    : m_window(window),
+      m_pathInput(m_font, 20),
+      m_sqlInput(m_font, 20)
 {
-    m_background = sf::RectangleShape(sf::Vector2f(m_window.getSize().x, m_window.getSize().y));
+    if (!m_font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
+        std::cerr << "Failed to load font" << std::endl;
+    }
+
+    const float width = static_cast<float>(m_window.getSize().x);
+    const float height = static_cast<float>(m_window.getSize().y);
+
+    m_background = sf::RectangleShape(sf::Vector2f(width, height));
     m_background.setFillColor(sf::Color::Green);
 
     m_exitButton = sf::RectangleShape(sf::Vector2f(50, 50));
@@ -12,22 +32,338 @@ Database::Database(sf::RenderWindow& window)
     m_exitButton.setFillColor(sf::Color::White);
     m_exitButton.setOutlineThickness(2);
     m_exitButton.setOutlineColor(sf::Color::Black);
+
+    for (sf::RectangleShape* box : {&m_pathBox, &m_sqlBox}) {
+        box->setFillColor(sf::Color::White);
+        box->setOutlineThickness(2);
+        box->setOutlineColor(sf::Color::Black);
+    }
+    m_pathBox.setSize(sf::Vector2f(width - 80, 40));
+    m_pathBox.setPosition(70, 10);
+    m_pathInput.setArea(sf::FloatRect(75, 12, width - 90, 36));
+    m_sqlBox.setSize(sf::Vector2f(width - 80, 40));
+    m_sqlBox.setPosition(70, 60);
+    m_sqlInput.setArea(sf::FloatRect(75, 62, width - 90, 36));
+
+    m_tablePanel.setSize(sf::Vector2f(190, height - TableListTop - 40));
+    m_tablePanel.setPosition(10, TableListTop);
+    m_tablePanel.setFillColor(sf::Color(250, 250, 250));
+    m_tableHighlight.setSize(sf::Vector2f(190, TableRowHeight));
+    m_tableHighlight.setFillColor(sf::Color(200, 220, 255));
+
+    m_status.setFont(m_font);
+    m_status.setCharacterSize(16);
+    m_status.setPosition(10, height - 30);
+
+    m_cancelButton.setSize(sf::Vector2f(90, 30));
+    m_cancelButton.setPosition(width - 100, height - 35);
+    m_cancelButton.setFillColor(sf::Color(220, 60, 60));
+    m_cancelLabel.setFont(m_font);
+    m_cancelLabel.setCharacterSize(16);
+    m_cancelLabel.setString("Cancel");
+    m_cancelLabel.setFillColor(sf::Color::White);
+    m_cancelLabel.setPosition(width - 80, height - 31);
+
+    m_pathInput.setString(DefaultDatabasePath);
+    if (std::filesystem::exists(DefaultDatabasePath)) {
+        openDatabase(DefaultDatabasePath);
+    } else {
+        setStatus("Enter the path of a database and press Enter", false);
+    }
+}
+
+Database::~Database() {
+    closeDatabase();
 }
 
 void Database::handleEvent(const sf::Event& event) {
+    if (m_grid && m_grid->handleEvent(event)) return;
+
     if (event.type == sf::Event::MouseButtonPressed) {
         if (event.mouseButton.button == sf::Mouse::Left) {
             sf::Vector2f mousePos = m_window.mapPixelToCoords(sf::Mouse::getPosition(m_window));
 
             if (m_exitButton.getGlobalBounds().contains(mousePos)) {
                 m_shouldExit = true;
+                return;
             }
+            bool running = (m_pager && m_pager->isRunning()) || m_importer.isRunning();
+            if (running && m_cancelButton.getGlobalBounds().contains(mousePos)) {
+                if (m_pager) m_pager->cancel();
+                m_importer.cancel();
+                return;
+            }
+            if (m_pathBox.getGlobalBounds().contains(mousePos)) {
+                m_focus = Focus::Path;
+            } else if (m_sqlBox.getGlobalBounds().contains(mousePos)) {
+                m_focus = Focus::Sql;
+            } else if (m_tablePanel.getGlobalBounds().contains(mousePos)) {
+                showTable(static_cast<std::size_t>((mousePos.y - TableListTop) / TableRowHeight));
+                return;
+            }
+        }
+        (m_focus == Focus::Path ? m_pathInput : m_sqlInput).handleEvent(event);
+    } else if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::Escape) {
+        if (m_pager) m_pager->cancel();
+        m_importer.cancel();
+    } else if (event.type == sf::Event::KeyPressed && m_grid && event.key.code == sf::Keyboard::PageUp) {
+        m_grid->scrollRows(-static_cast<long long>(m_grid->visibleRows()));
+    } else if (event.type == sf::Event::KeyPressed && m_grid && event.key.code == sf::Keyboard::PageDown) {
+        m_grid->scrollRows(static_cast<long long>(m_grid->visibleRows()));
+    } else if (event.type == sf::Event::KeyPressed && m_grid && event.key.control && event.key.code == sf::Keyboard::Home) {
+        // Plain Home/End move the input cursor
+        m_grid->scrollToRow(0);
+    } else if (event.type == sf::Event::KeyPressed && m_grid && event.key.control && event.key.code == sf::Keyboard::End) {
+        m_grid->scrollToEnd();
+    } else if (event.type == sf::Event::TextEntered && event.text.unicode == 13) { // Enter key
+        if (m_focus == Focus::Path) {
+            openDatabase(m_pathInput.toUtf8());
+        } else {
+            runQuery();
         }
+    } else {
+        (m_focus == Focus::Path ? m_pathInput : m_sqlInput).handleEvent(event);
     }
 }
 
+void Database::onSuspend() {
+    if (m_grid) m_grid->releaseLayouts();
+}
+
+AppMemory Database::memoryUsage() const {
+    AppMemory memory;
+    if (m_pager) memory.cpuBytes += m_pager->memoryBytes();
+    if (m_grid) memory.cpuBytes += m_grid->memoryBytes();
+    return memory;
+}
 
 void Database::draw(sf::RenderWindow& window) {
+    updateQuery();
+    updateImport();
+
+    m_pathBox.setOutlineColor(m_focus == Focus::Path ? sf::Color::Blue : sf::Color::Black);
+    m_sqlBox.setOutlineColor(m_focus == Focus::Sql ? sf::Color::Blue : sf::Color::Black);
+
     m_window.draw(m_background);
     m_window.draw(m_exitButton);
-}
\ No newline at end of file
+    m_window.draw(m_pathBox);
+    m_pathInput.draw(m_window);
+    m_window.draw(m_sqlBox);
+    m_sqlInput.draw(m_window);
+
+    m_window.draw(m_tablePanel);
+    if (m_selectedTable < m_tableLabels.size()) {
+        m_tableHighlight.setPosition(10, TableListTop + m_selectedTable * TableRowHeight);
+        m_window.draw(m_tableHighlight);
+    }
+    for (const sf::Text& label : m_tableLabels) {
+        m_window.draw(label);
+    }
+
+    if (m_grid) {
+        m_grid->draw(m_window);
+    }
+    m_window.draw(m_status);
+    if ((m_pager && m_pager->isRunning()) || m_importer.isRunning()) {
+        m_window.draw(m_cancelButton);
+        m_window.draw(m_cancelLabel);
+    }
+}
+
+void Database::openDatabase(const std::string& path) {
+    closeDatabase();
+    // The worker's read-write connection creates the file if needed; browsing
+    // tables reads through a pooled read-only connection
+    m_worker = std::make_unique<QueryWorker>(path);
+    m_connection = ConnectionPool::instance().acquire(path);
+    if (!m_connection) {
+        setStatus("Cannot open " + path, true);
+        m_worker.reset();
+        return;
+    }
+
+    m_databasePath = path;
+    m_pager = std::make_unique<ResultPager>(m_connection.statements(), *m_worker);
+    m_grid = std::make_unique<ResultGrid>(*m_pager, m_font);
+    m_grid->setArea(sf::FloatRect(210, TableListTop, m_window.getSize().x - 220.f, m_window.getSize().y - TableListTop - 40));
+
+    loadTables();
+    setStatus("Opened " + path + " (" + std::to_string(m_tables.size()) + " tables)", false);
+}
+
+void Database::closeDatabase() {
+    m_grid.reset();
+    m_pager.reset();
+    m_worker.reset();
+    m_connection.release();
+    m_tables.clear();
+    m_tableLabels.clear();
+    m_selectedTable = static_cast<std::size_t>(-1);
+}
+
+void Database::loadTables() {
+    m_tables.clear();
+    m_tableLabels.clear();
+    sqlite3_stmt* statement = m_connection.statements().acquire(
+        "SELECT name FROM sqlite_master WHERE type IN ('table', 'view') AND name NOT LIKE 'sqlite_%' ORDER BY name");
+    if (!statement) return;
+
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        const unsigned char* name = sqlite3_column_text(statement, 0);
+        m_tables.push_back(name ? reinterpret_cast<const char*>(name) : "");
+
+        sf::Text label(sf::String::fromUtf8(m_tables.back().begin(), m_tables.back().end()), m_font, 16);
+        label.setFillColor(sf::Color::Black);
+        label.setPosition(16, TableListTop + (m_tables.size() - 1) * TableRowHeight + 2);
+        m_tableLabels.push_back(label);
+    }
+}
+
+void Database::showTable(std::size_t index) {
+    if (!m_pager || index >= m_tables.size()) return;
+    m_selectedTable = index;
+    m_sqlInput.setString(sf::String::fromUtf8(m_tables[index].begin(), m_tables[index].end()));
+
+    auto start = std::chrono::steady_clock::now();
+    m_pager->openTable(m_tables[index]);
+    m_grid->reset();
+    m_tableOpenMilliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    showResultStatus();
+}
+
+void Database::runQuery() {
+    if (!m_pager) {
+        setStatus("No database open", true);
+        return;
+    }
+    std::string sql = m_sqlInput.toUtf8();
+    if (sql.compare(0, 7, ".import") == 0) {
+        startImport(sql);
+        return;
+    }
+    m_selectedTable = static_cast<std::size_t>(-1);
+    m_pager->openQuery(sql);
+    m_grid->reset();
+    showResultStatus();
+}
+
+void Database::updateQuery() {
+    if (!m_pager) return;
+
+    if (m_pager->update()) {
+        m_grid->reset();
+        // CREATE / DROP change the table list
+        if (m_pager->columns().empty()) {
+            loadTables();
+        }
+    }
+
+    // Progress while the worker runs, and once more when it stops
+    bool running = m_pager->isRunning();
+    if ((running || m_wasRunning) && !m_importer.isRunning()) {
+        showResultStatus();
+    }
+    m_wasRunning = running;
+}
+
+void Database::startImport(const std::string& command) {
+    // .import FILE [TABLE]; the file name may be in double quotes
+    std::vector<std::string> arguments;
+    for (std::size_t pos = 7; pos < command.size();) {
+        if (command[pos] == ' ' || command[pos] == '\t') {
+            ++pos;
+        } else if (command[pos] == '"') {
+            std::size_t end = command.find('"', pos + 1);
+            if (end == std::string::npos) end = command.size();
+            arguments.push_back(command.substr(pos + 1, end - pos - 1));
+            pos = end + 1;
+        } else {
+            std::size_t end = command.find_first_of(" \t", pos);
+            if (end == std::string::npos) end = command.size();
+            arguments.push_back(command.substr(pos, end - pos));
+            pos = end;
+        }
+    }
+    if (arguments.empty() || arguments.size() > 2) {
+        setStatus("Usage: .import FILE [TABLE]  (CSV or GeoPackage)", true);
+        return;
+    }
+    if (!m_importer.start(arguments[0], m_databasePath, arguments.size() > 1 ? arguments[1] : "")) {
+        setStatus("An import is still running", true);
+        return;
+    }
+    m_importPath = m_databasePath;
+}
+
+void Database::updateImport() {
+    bool importing = m_importer.isRunning();
+    if (!importing && !m_wasImporting) return;
+    m_wasImporting = importing;
+
+    Importer::Progress progress = m_importer.progress();
+    char line[200];
+    bool isError = false;
+    if (progress.phase == Importer::Phase::Loading) {
+        double percent = progress.bytesTotal ? 100.0 * progress.bytesRead / progress.bytesTotal : 0.0;
+        std::snprintf(line, sizeof(line), "Importing %s: %llu rows, %.0f rows/s (%.0f%%) (Esc to cancel)", progress.table.c_str(),
+                      static_cast<unsigned long long>(progress.rows), progress.rowsPerSecond, percent);
+    } else if (progress.phase == Importer::Phase::Indexing) {
+        std::snprintf(line, sizeof(line), "Importing %s: %llu rows loaded at %.0f rows/s, building indexes...", progress.table.c_str(),
+                      static_cast<unsigned long long>(progress.rows), progress.averageRowsPerSecond);
+    } else if (progress.phase == Importer::Phase::Failed) {
+        std::snprintf(line, sizeof(line), "Import failed: %s", progress.error.c_str());
+        isError = true;
+    } else {
+        std::snprintf(line, sizeof(line), "%s %llu rows into %s in %.1f s (%.0f rows/s, indexes %.1f s)",
+                      progress.phase == Importer::Phase::Cancelled ? "Cancelled; kept" : "Imported",
+                      static_cast<unsigned long long>(progress.rows), progress.table.c_str(), progress.seconds,
+                      progress.averageRowsPerSecond, progress.indexSeconds);
+    }
+
+    // Show the new table once it is in, keeping the import summary
+    if (!importing && !isError && m_pager && m_importPath == m_databasePath) {
+        loadTables();
+        auto it = std::find(m_tables.begin(), m_tables.end(), progress.table);
+        if (it != m_tables.end()) {
+            showTable(it - m_tables.begin());
+        }
+    }
+    setStatus(line, isError);
+}
+
+void Database::showResultStatus() {
+    if (!m_pager->error().empty()) {
+        setStatus(m_pager->error(), true);
+        return;
+    }
+
+    char time[32];
+    double milliseconds = m_pager->isTable() ? m_tableOpenMilliseconds : m_pager->milliseconds();
+    std::snprintf(time, sizeof(time), "%.1f %s", milliseconds < 10000.0 ? milliseconds : milliseconds / 1000.0,
+                  milliseconds < 10000.0 ? "ms" : "s");
+
+    std::string status;
+    if (m_pager->isRunning()) {
+        status = "Running: " + std::to_string(m_pager->rowsRead()) + " rows read, " + time + " (Esc to cancel)";
+    } else if (m_pager->isCancelled()) {
+        status = "Cancelled after " + std::to_string(m_pager->rowsRead()) + " rows read, " + time;
+    } else if (m_pager->isTable()) {
+        status = "about " + std::to_string(m_pager->rowCount()) + " rows | " + time;
+    } else if (m_pager->columns().empty()) {
+        status = std::to_string(m_pager->changes()) + " rows changed | " + time;
+    } else if (m_pager->isRowCountExact()) {
+        status = std::to_string(m_pager->rowCount()) + " rows | " + time;
+    } else {
+        status = "more than " + std::to_string(m_pager->rowCount() - ResultPager::PageSize) + " rows | " + time;
+    }
+    ConnectionPool::Stats pool = ConnectionPool::instance().stats();
+    status += " | statement cache " + std::to_string(m_connection.statements().hits()) + " hits / " +
+              std::to_string(m_connection.statements().misses()) + " misses";
+    status += " | pool " + std::to_string(pool.waits) + " waits";
+    setStatus(status, false);
+}
+
+void Database::setStatus(const std::string& text, bool isError) {
+    m_status.setString(sf::String::fromUtf8(text.begin(), text.end()));
+    m_status.setFillColor(isError ? sf::Color::Red : sf::Color::Black);
+}
@@ -1,18 +1,79 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include "connectionpool.hpp"
+#include "importer.hpp"
+#include "queryworker.hpp"
+#include "resultgrid.hpp"
+#include "resultpager.hpp"
+#include "../ui/app.hpp"
+#include "../ui/textinput.hpp"
+#include <memory>
+#include <string>
+#include <vector>
 
-class Database {
+class Database : public App {
 public:
     Database(sf::RenderWindow& window);
-    void handleEvent(const sf::Event& event);
-    void draw(sf::RenderWindow& window);
-    void resetShouldExit() { m_shouldExit = false; }
-    bool shouldReturnToMain() const { return m_shouldExit; }
+    ~Database() override;
+    const char* name() const override { return "Database"; }
+    void handleEvent(const sf::Event& event) override;
+    void draw(sf::RenderWindow& window) override;
+    void resetShouldExit() override { m_shouldExit = false; }
+    bool shouldReturnToMain() const override { return m_shouldExit; }
+    // Drops the grid's row layouts. The pager keeps its pages: it holds at
+    // most 16 pages, and query results cannot be read back cheaply.
+    void onSuspend() override;
+    AppMemory memoryUsage() const override;
 
 private:
+    enum class Focus { Path, Sql };
+
     sf::RenderWindow& m_window;
+    sf::Font m_font;
     sf::RectangleShape m_background;
     sf::RectangleShape m_exitButton;
     bool m_shouldExit = false;
-};
\ No newline at end of file
+
+    TextInput m_pathInput;
+    TextInput m_sqlInput;
+    sf::RectangleShape m_pathBox;
+    sf::RectangleShape m_sqlBox;
+    Focus m_focus = Focus::Sql;
+
+    sf::RectangleShape m_tablePanel;
+    std::vector<std::string> m_tables;
+    std::vector<sf::Text> m_tableLabels;
+    std::size_t m_selectedTable = static_cast<std::size_t>(-1);
+    sf::RectangleShape m_tableHighlight;
+
+    sf::Text m_status;
+    sf::RectangleShape m_cancelButton;
+    sf::Text m_cancelLabel;
+    bool m_wasRunning = false;
+    double m_tableOpenMilliseconds = 0.0;
+
+    // Loads run on their own connection and may outlive the database shown
+    Importer m_importer;
+    std::string m_importPath; // database the current import writes to
+    bool m_wasImporting = false;
+
+    // Recreated for every database that is opened, in this order
+    std::string m_databasePath;
+    std::unique_ptr<QueryWorker> m_worker;
+    ConnectionPool::Lease m_connection;
+    std::unique_ptr<ResultPager> m_pager;
+    std::unique_ptr<ResultGrid> m_grid;
+
+    void openDatabase(const std::string& path);
+    void closeDatabase();
+    void loadTables();
+    void showTable(std::size_t index);
+    void runQuery();
+    void updateQuery();
+    // ".import FILE [TABLE]" in the SQL field
+    void startImport(const std::string& command);
+    void updateImport();
+    void showResultStatus();
+    void setStatus(const std::string& text, bool isError);
+};
@@ -0,0 +1,732 @@
+#include "importer.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <vector>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::size_t QueueBatches = 8;
+    const std::size_t ReadChunk = 4 << 20;
+
+    enum FieldType : unsigned char { Null, Integer, Real, Text, Blob };
+
+    std::string quoteIdentifier(const std::string& name) {
+        std::string quoted = "\"";
+        for (char c : name) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    bool execute(sqlite3* db, const std::string& sql, std::string& error) {
+        char* message = nullptr;
+        if (sqlite3_exec(db, sql.c_str(), nullptr, nullptr, &message) != SQLITE_OK) {
+            error = message ? message : sqlite3_errmsg(db);
+            sqlite3_free(message);
+            return false;
+        }
+        return true;
+    }
+
+    // Rows of one batch, field after field; field i spans [ends[i - 1], ends[i]) of data
+    struct Batch {
+        std::string data;
+        std::vector<std::uint32_t> ends;
+        std::vector<unsigned char> types;
+        std::size_t rows = 0;
+
+        void clear() {
+            data.clear();
+            ends.clear();
+            types.clear();
+            rows = 0;
+        }
+
+        void add(FieldType type, const void* bytes, std::size_t size) {
+            data.append(static_cast<const char*>(bytes), size);
+            ends.push_back(static_cast<std::uint32_t>(data.size()));
+            types.push_back(type);
+        }
+
+        std::size_t begin(std::size_t field) const { return field ? ends[field - 1] : 0; }
+    };
+
+    // Bounded hand-over from the reader thread to the inserting thread.
+    // Drained batches go back to the reader to be filled again.
+    class BatchQueue {
+    public:
+        // Blocks while the queue is full; false once the consumer has gone
+        bool push(std::unique_ptr<Batch> batch) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this] { return m_closed || m_full.size() < QueueBatches; });
+            if (m_closed) return false;
+            m_full.push_back(std::move(batch));
+            m_changed.notify_all();
+            return true;
+        }
+
+        // nullptr once the producer has finished and everything was taken
+        std::unique_ptr<Batch> pop() {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_changed.wait(lock, [this] { return m_closed || m_finished || !m_full.empty(); });
+            if (m_full.empty()) return nullptr;
+            std::unique_ptr<Batch> batch = std::move(m_full.front());
+            m_full.pop_front();
+            m_changed.notify_all();
+            return batch;
+        }
+
+        std::unique_ptr<Batch> spare() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (m_spare.empty()) return std::make_unique<Batch>();
+            std::unique_ptr<Batch> batch = std::move(m_spare.back());
+            m_spare.pop_back();
+            return batch;
+        }
+
+        void recycle(std::unique_ptr<Batch> batch) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_spare.push_back(std::move(batch));
+        }
+
+        void finish() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_finished = true;
+            m_changed.notify_all();
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_closed = true;
+            m_changed.notify_all();
+        }
+
+    private:
+        std::mutex m_mutex;
+        std::condition_variable m_changed;
+        std::deque<std::unique_ptr<Batch>> m_full;
+        std::vector<std::unique_ptr<Batch>> m_spare;
+        bool m_finished = false;
+        bool m_closed = false;
+    };
+
+    class Source {
+    public:
+        virtual ~Source() = default;
+        virtual bool open(std::string& error) = 0;
+        // Up to Importer::BatchRows rows; false at the end or on an error
+        virtual bool read(Batch& batch) = 0;
+        virtual std::uint64_t bytesRead() const { return 0; }
+        virtual std::uint64_t bytesTotal() const { return 0; }
+
+        const std::vector<std::string>& columns() const { return m_columns; }
+        // Empty where the source has no declared types
+        const std::vector<std::string>& declaredTypes() const { return m_declaredTypes; }
+        const std::string& error() const { return m_error; }
+
+    protected:
+        std::vector<std::string> m_columns;
+        std::vector<std::string> m_declaredTypes;
+        std::string m_error;
+    };
+
+    class CsvSource : public Source {
+    public:
+        explicit CsvSource(const std::string& path) : m_path(path) {}
+        ~CsvSource() override {
+            if (m_file) std::fclose(m_file);
+        }
+
+        bool open(std::string& error) override {
+            m_file = std::fopen(m_path.c_str(), "rb");
+            if (!m_file) {
+                error = "Cannot open " + m_path;
+                return false;
+            }
+            std::error_code ec;
+            m_bytesTotal = std::filesystem::file_size(m_path, ec);
+            m_buffer.resize(ReadChunk);
+            refill();
+            if (m_end >= 3 && std::memcmp(m_buffer.data(), "\xEF\xBB\xBF", 3) == 0) {
+                m_begin = 3;
+            }
+
+            // The header line decides the delimiter
+            std::size_t counts[3] = {0, 0, 0};
+            const char candidates[3] = {',', ';', '\t'};
+            for (std::size_t i = m_begin; i < m_end && m_buffer[i] != '\n'; ++i) {
+                for (int c = 0; c < 3; ++c) {
+                    if (m_buffer[i] == candidates[c]) ++counts[c];
+                }
+            }
+            m_delimiter = candidates[std::max_element(counts, counts + 3) - counts];
+
+            Batch header;
+            if (!next(header)) {
+                error = m_error.empty() ? m_path + " is empty" : m_error;
+                return false;
+            }
+            std::set<std::string> seen;
+            for (std::size_t i = 0; i < header.ends.size(); ++i) {
+                std::string name = header.data.substr(header.begin(i), header.ends[i] - header.begin(i));
+                if (name.empty()) name = "column" + std::to_string(i + 1);
+                std::string unique = name;
+                for (int n = 2; !seen.insert(unique).second; ++n) unique = name + "_" + std::to_string(n);
+                m_columns.push_back(unique);
+            }
+            return true;
+        }
+
+        bool read(Batch& batch) override {
+            batch.clear();
+            while (batch.rows < Importer::BatchRows && next(batch)) {}
+            return batch.rows > 0;
+        }
+
+        std::uint64_t bytesRead() const override { return m_consumed + m_begin; }
+        std::uint64_t bytesTotal() const override { return m_bytesTotal; }
+
+    private:
+        enum class Parse { Complete, NeedMore, End };
+
+        std::string m_path;
+        std::FILE* m_file = nullptr;
+        std::uint64_t m_bytesTotal = 0;
+        std::vector<char> m_buffer;
+        std::size_t m_begin = 0;      // first byte not parsed yet
+        std::size_t m_end = 0;        // end of the bytes read into m_buffer
+        std::uint64_t m_consumed = 0; // file offset of m_buffer[0]
+        bool m_eof = false;
+        char m_delimiter = ',';
+
+        void refill() {
+            // Keep the unparsed tail; grow only for a record longer than the buffer
+            std::memmove(m_buffer.data(), m_buffer.data() + m_begin, m_end - m_begin);
+            m_consumed += m_begin;
+            m_end -= m_begin;
+            m_begin = 0;
+            if (m_end == m_buffer.size()) m_buffer.resize(m_buffer.size() * 2);
+
+            std::size_t read = std::fread(m_buffer.data() + m_end, 1, m_buffer.size() - m_end, m_file);
+            m_end += read;
+            if (read == 0) {
+                if (std::ferror(m_file)) m_error = "Read error in " + m_path;
+                m_eof = true;
+            }
+        }
+
+        bool next(Batch& batch) {
+            for (;;) {
+                std::size_t dataMark = batch.data.size();
+                std::size_t fieldMark = batch.ends.size();
+                Parse result = parse(batch);
+                if (result == Parse::Complete) return true;
+                batch.data.resize(dataMark);
+                batch.ends.resize(fieldMark);
+                batch.types.resize(fieldMark);
+                if (result == Parse::End || !m_error.empty()) return false;
+                refill();
+            }
+        }
+
+        // One record from m_begin. NeedMore when the buffer ends inside it
+        // and there is more to read; at the end of the file the buffer end
+        // also ends the record.
+        Parse parse(Batch& batch) {
+            const char* buffer = m_buffer.data();
+            std::size_t pos = m_begin;
+            // Blank lines are skipped
+            while (pos < m_end && (buffer[pos] == '\n' || buffer[pos] == '\r')) ++pos;
+            m_begin = pos;
+            if (pos == m_end) return m_eof ? Parse::End : Parse::NeedMore;
+
+            std::size_t fields = 0;
+            for (;;) {
+                std::size_t fieldStart = batch.data.size();
+                bool quoted = pos < m_end && buffer[pos] == '"';
+                if (quoted) {
+                    ++pos;
+                    for (;;) {
+                        const char* quote = static_cast<const char*>(std::memchr(buffer + pos, '"', m_end - pos));
+                        if (!quote) {
+                            if (!m_eof) return Parse::NeedMore;
+                            batch.data.append(buffer + pos, m_end - pos);
+                            pos = m_end;
+                            break;
+                        }
+                        batch.data.append(buffer + pos, quote - (buffer + pos));
+                        pos = quote - buffer + 1;
+                        if (pos == m_end && !m_eof) return Parse::NeedMore;
+                        if (pos < m_end && buffer[pos] == '"') {
+                            batch.data += '"';
+                            ++pos;
+                            continue;
+                        }
+                        break;
+                    }
+                }
+
+                std::size_t stop = pos;
+                while (stop < m_end && buffer[stop] != m_delimiter && buffer[stop] != '\n' && buffer[stop] != '\r') ++stop;
+                if (stop == m_end && !m_eof) return Parse::NeedMore;
+                batch.data.append(buffer + pos, stop - pos);
+                pos = stop;
+
+                bool empty = batch.data.size() == fieldStart && !quoted;
+                batch.ends.push_back(static_cast<std::uint32_t>(batch.data.size()));
+                batch.types.push_back(empty ? Null : Text);
+                ++fields;
+
+                if (pos < m_end && buffer[pos] == m_delimiter) {
+                    ++pos;
+                    continue;
+                }
+                if (pos < m_end && buffer[pos] == '\r') {
+                    ++pos;
+                    if (pos == m_end && !m_eof) return Parse::NeedMore;
+                }
+                if (pos < m_end && buffer[pos] == '\n') ++pos;
+                break;
+            }
+
+            // Short rows are padded with NULLs, long ones cut to the header
+            if (!m_columns.empty()) {
+                std::size_t first = batch.ends.size() - fields;
+                if (fields > m_columns.size()) {
+                    std::size_t keep = first + m_columns.size();
+                    batch.data.resize(batch.begin(keep));
+                    batch.ends.resize(keep);
+                    batch.types.resize(keep);
+                }
+                for (std::size_t i = fields; i < m_columns.size(); ++i) {
+                    batch.add(Null, nullptr, 0);
+                }
+            }
+            m_begin = pos;
+            ++batch.rows;
+            return Parse::Complete;
+        }
+    };
+
+    class GeoPackageSource : public Source {
+    public:
+        GeoPackageSource(const std::string& path, const std::string& layer) : m_path(path), m_layer(layer) {}
+        ~GeoPackageSource() override {
+            sqlite3_finalize(m_statement);
+            sqlite3_close(m_db);
+        }
+
+        const std::string& layer() const { return m_layer; }
+
+        bool open(std::string& error) override {
+            if (sqlite3_open_v2(m_path.c_str(), &m_db, SQLITE_OPEN_READONLY, nullptr) != SQLITE_OK) {
+                error = "Cannot open " + m_path + ": " + sqlite3_errmsg(m_db);
+                return false;
+            }
+            sqlite3_stmt* statement = nullptr;
+            if (m_layer.empty()) {
+                if (sqlite3_prepare_v2(m_db, "SELECT table_name FROM gpkg_contents WHERE data_type = 'features' ORDER BY table_name LIMIT 1",
+                                       -1, &statement, nullptr) != SQLITE_OK) {
+                    error = "Not a GeoPackage: " + std::string(sqlite3_errmsg(m_db));
+                    return false;
+                }
+                if (sqlite3_step(statement) == SQLITE_ROW && sqlite3_column_text(statement, 0)) {
+                    m_layer = reinterpret_cast<const char*>(sqlite3_column_text(statement, 0));
+                }
+                sqlite3_finalize(statement);
+                if (m_layer.empty()) {
+                    error = m_path + " has no feature tables";
+                    return false;
+                }
+            }
+
+            // Declared types carry over, including the fid primary key
+            std::string pragma = "PRAGMA table_info(" + quoteIdentifier(m_layer) + ")";
+            if (sqlite3_prepare_v2(m_db, pragma.c_str(), -1, &statement, nullptr) == SQLITE_OK) {
+                while (sqlite3_step(statement) == SQLITE_ROW) {
+                    const unsigned char* name = sqlite3_column_text(statement, 1);
+                    const unsigned char* type = sqlite3_column_text(statement, 2);
+                    m_columns.push_back(name ? reinterpret_cast<const char*>(name) : "");
+                    std::string declared = type ? reinterpret_cast<const char*>(type) : "";
+                    if (sqlite3_column_int(statement, 5) == 1 && declared == "INTEGER") declared += " PRIMARY KEY";
+                    m_declaredTypes.push_back(declared);
+                }
+            }
+            sqlite3_finalize(statement);
+            if (m_columns.empty()) {
+                error = "No such feature table: " + m_layer;
+                return false;
+            }
+
+            std::string select = "SELECT * FROM " + quoteIdentifier(m_layer);
+            if (sqlite3_prepare_v2(m_db, select.c_str(), -1, &m_statement, nullptr) != SQLITE_OK) {
+                error = sqlite3_errmsg(m_db);
+                return false;
+            }
+            return true;
+        }
+
+        bool read(Batch& batch) override {
+            batch.clear();
+            const int columns = static_cast<int>(m_columns.size());
+            while (batch.rows < Importer::BatchRows) {
+                int result = sqlite3_step(m_statement);
+                if (result != SQLITE_ROW) {
+                    if (result != SQLITE_DONE) m_error = sqlite3_errmsg(m_db);
+                    break;
+                }
+                for (int c = 0; c < columns; ++c) {
+                    switch (sqlite3_column_type(m_statement, c)) {
+                        case SQLITE_INTEGER: {
+                            sqlite3_int64 value = sqlite3_column_int64(m_statement, c);
+                            batch.add(Integer, &value, sizeof(value));
+                            break;
+                        }
+                        case SQLITE_FLOAT: {
+                            double value = sqlite3_column_double(m_statement, c);
+                            batch.add(Real, &value, sizeof(value));
+                            break;
+                        }
+                        case SQLITE_TEXT:
+                            batch.add(Text, sqlite3_column_text(m_statement, c), sqlite3_column_bytes(m_statement, c));
+                            break;
+                        case SQLITE_BLOB:
+                            batch.add(Blob, sqlite3_column_blob(m_statement, c), sqlite3_column_bytes(m_statement, c));
+                            break;
+                        default:
+                            batch.add(Null, nullptr, 0);
+                            break;
+                    }
+                }
+                ++batch.rows;
+            }
+            return batch.rows > 0;
+        }
+
+    private:
+        std::string m_path;
+        std::string m_layer;
+        sqlite3* m_db = nullptr;
+        sqlite3_stmt* m_statement = nullptr;
+    };
+
+    // INTEGER if every value of the column parses as one, else REAL, else TEXT
+    std::vector<std::string> sniffTypes(const Batch& batch, std::size_t columns) {
+        std::vector<std::string> types(columns, "INTEGER");
+        std::vector<bool> seen(columns, false);
+        for (std::size_t field = 0; field < batch.ends.size(); ++field) {
+            std::size_t column = field % columns;
+            if (batch.types[field] == Null || types[column] == "TEXT") continue;
+            seen[column] = true;
+
+            std::string value = batch.data.substr(batch.begin(field), batch.ends[field] - batch.begin(field));
+            char* end = nullptr;
+            errno = 0;
+            std::strtoll(value.c_str(), &end, 10);
+            if (*end == '\0' && errno == 0 && !value.empty()) continue;
+            std::strtod(value.c_str(), &end);
+            if (*end == '\0' && !value.empty()) {
+                types[column] = "REAL";
+            } else {
+                types[column] = "TEXT";
+            }
+        }
+        for (std::size_t c = 0; c < columns; ++c) {
+            if (!seen[c]) types[c] = "TEXT";
+        }
+        return types;
+    }
+}
+
+Importer::Importer() = default;
+
+Importer::~Importer() {
+    cancel();
+    wait();
+}
+
+bool Importer::start(const std::string& source, const std::string& databasePath, const std::string& table, const std::string& layer) {
+    if (isRunning()) return false;
+    wait();
+
+    m_cancelled = false;
+    m_rows = 0;
+    m_bytesRead = 0;
+    m_started = m_rateTime = Clock::now();
+    m_rateRows = 0;
+    m_rate = 0.0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress = Progress();
+        m_progress.phase = Phase::Loading;
+    }
+    m_thread = std::thread(&Importer::run, this, source, databasePath, table, layer);
+    return true;
+}
+
+void Importer::cancel() {
+    m_cancelled = true;
+}
+
+void Importer::wait() {
+    if (m_thread.joinable()) m_thread.join();
+}
+
+bool Importer::isRunning() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_progress.phase == Phase::Loading || m_progress.phase == Phase::Indexing;
+}
+
+Importer::Progress Importer::progress() {
+    Progress progress;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        progress = m_progress;
+    }
+    progress.rows = m_rows;
+    progress.bytesRead = m_bytesRead;
+
+    Clock::time_point now = Clock::now();
+    bool running = progress.phase == Phase::Loading || progress.phase == Phase::Indexing;
+    if (running) {
+        progress.seconds = std::chrono::duration<double>(now - m_started).count();
+    }
+    double sinceRate = std::chrono::duration<double>(now - m_rateTime).count();
+    if (sinceRate >= 1.0) {
+        m_rate = (progress.rows - m_rateRows) / sinceRate;
+        m_rateRows = progress.rows;
+        m_rateTime = now;
+    }
+    progress.rowsPerSecond = running ? m_rate : 0.0;
+    double loadSeconds = progress.loadSeconds > 0.0 ? progress.loadSeconds : progress.seconds;
+    progress.averageRowsPerSecond = loadSeconds > 0.0 ? progress.rows / loadSeconds : 0.0;
+    return progress;
+}
+
+void Importer::setPhase(Phase phase, const std::string& error) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double seconds = std::chrono::duration<double>(Clock::now() - m_started).count();
+    if (m_progress.phase == Phase::Loading && phase != Phase::Loading) {
+        m_progress.loadSeconds = seconds;
+    }
+    if (phase != Phase::Loading && phase != Phase::Indexing) {
+        m_progress.indexSeconds = m_progress.loadSeconds > 0.0 ? seconds - m_progress.loadSeconds : 0.0;
+        m_progress.seconds = seconds;
+    }
+    m_progress.phase = phase;
+    if (!error.empty()) m_progress.error = error;
+}
+
+void Importer::run(std::string sourcePath, std::string databasePath, std::string table, std::string layer) {
+    std::string extension = std::filesystem::path(sourcePath).extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    std::unique_ptr<Source> source;
+    GeoPackageSource* geoPackage = nullptr;
+    if (extension == ".gpkg") {
+        source = std::make_unique<GeoPackageSource>(sourcePath, layer);
+        geoPackage = static_cast<GeoPackageSource*>(source.get());
+    } else {
+        source = std::make_unique<CsvSource>(sourcePath);
+    }
+
+    std::string error;
+    if (!source->open(error)) {
+        setPhase(Phase::Failed, error);
+        return;
+    }
+    if (table.empty()) {
+        table = geoPackage ? geoPackage->layer() : std::filesystem::path(sourcePath).stem().string();
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_progress.table = table;
+        m_progress.bytesTotal = source->bytesTotal();
+    }
+
+    sqlite3* db = nullptr;
+    if (sqlite3_open_v2(databasePath.c_str(), &db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        setPhase(Phase::Failed, "Cannot open " + databasePath + ": " + sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return;
+    }
+    sqlite3_busy_timeout(db, 5000);
+
+    // WAL stays on afterwards; the rest only applies to this connection
+    std::string ignored;
+    if (!execute(db, "PRAGMA journal_mode=WAL", ignored)) {
+        std::cerr << "Import: could not switch " << databasePath << " to WAL: " << ignored << std::endl;
+    }
+    execute(db, "PRAGMA synchronous=OFF", ignored);
+    execute(db, "PRAGMA cache_size=-262144", ignored);
+    execute(db, "PRAGMA temp_store=MEMORY", ignored);
+    // Lets CREATE INDEX sort with helper threads
+    execute(db, "PRAGMA threads=" + std::to_string(std::min(8u, std::max(1u, std::thread::hardware_concurrency()))), ignored);
+
+    // Parsing runs ahead on its own thread
+    BatchQueue queue;
+    std::thread reader([&] {
+        for (;;) {
+            std::unique_ptr<Batch> batch = queue.spare();
+            bool more = !m_cancelled && source->read(*batch);
+            m_bytesRead = source->bytesRead();
+            if (!more || !queue.push(std::move(batch))) break;
+        }
+        queue.finish();
+    });
+
+    const std::string quotedTable = quoteIdentifier(table);
+    const std::size_t columns = source->columns().size();
+    std::unique_ptr<Batch> first = queue.pop();
+    std::vector<std::pair<std::string, std::string>> indexes; // name, sql
+    sqlite3_stmt* insert = nullptr;
+    bool ok = true;
+
+    // Create the table if needed, or check that the rows fit
+    sqlite3_stmt* statement = nullptr;
+    int existingColumns = 0;
+    std::string pragma = "PRAGMA table_info(" + quotedTable + ")";
+    if (sqlite3_prepare_v2(db, pragma.c_str(), -1, &statement, nullptr) == SQLITE_OK) {
+        while (sqlite3_step(statement) == SQLITE_ROW) ++existingColumns;
+    }
+    sqlite3_finalize(statement);
+    if (existingColumns == 0) {
+        std::vector<std::string> types = source->declaredTypes();
+        if (types.size() != columns) {
+            types = first ? sniffTypes(*first, columns) : std::vector<std::string>(columns, "TEXT");
+        }
+        std::string create = "CREATE TABLE " + quotedTable + " (";
+        for (std::size_t c = 0; c < columns; ++c) {
+            create += (c ? ", " : "") + quoteIdentifier(source->columns()[c]) + (types[c].empty() ? "" : " " + types[c]);
+        }
+        ok = execute(db, create + ")", error);
+    } else if (static_cast<std::size_t>(existingColumns) != columns) {
+        error = table + " has " + std::to_string(existingColumns) + " columns, the source has " + std::to_string(columns);
+        ok = false;
+    }
+
+    // Indexes are dropped for the load and built again from their SQL afterwards
+    if (ok && sqlite3_prepare_v2(db, "SELECT name, sql FROM sqlite_master WHERE type = 'index' AND tbl_name = ?1 AND sql IS NOT NULL",
+                                 -1, &statement, nullptr) == SQLITE_OK) {
+        sqlite3_bind_text(statement, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+        while (sqlite3_step(statement) == SQLITE_ROW) {
+            indexes.emplace_back(reinterpret_cast<const char*>(sqlite3_column_text(statement, 0)),
+                                 reinterpret_cast<const char*>(sqlite3_column_text(statement, 1)));
+        }
+        sqlite3_finalize(statement);
+    }
+    for (std::size_t i = 0; ok && i < indexes.size(); ++i) {
+        ok = execute(db, "DROP INDEX " + quoteIdentifier(indexes[i].first), error);
+    }
+
+    if (ok) {
+        std::string sql = "INSERT INTO " + quotedTable + " VALUES (";
+        for (std::size_t c = 0; c < columns; ++c) sql += c ? ", ?" : "?";
+        if (sqlite3_prepare_v2(db, (sql + ")").c_str(), -1, &insert, nullptr) != SQLITE_OK) {
+            error = sqlite3_errmsg(db);
+            ok = false;
+        }
+    }
+
+    std::uint64_t inTransaction = 0;
+    if (ok) ok = execute(db, "BEGIN", error);
+    for (std::unique_ptr<Batch> batch = std::move(first); ok && batch && !m_cancelled; batch = queue.pop()) {
+        std::size_t field = 0;
+        for (std::size_t row = 0; row < batch->rows && ok; ++row) {
+            for (std::size_t c = 0; c < columns; ++c, ++field) {
+                const char* bytes = batch->data.data() + batch->begin(field);
+                int size = static_cast<int>(batch->ends[field] - batch->begin(field));
+                int parameter = static_cast<int>(c) + 1;
+                switch (batch->types[field]) {
+                    case Integer: {
+                        sqlite3_int64 value;
+                        std::memcpy(&value, bytes, sizeof(value));
+                        sqlite3_bind_int64(insert, parameter, value);
+                        break;
+                    }
+                    case Real: {
+                        double value;
+                        std::memcpy(&value, bytes, sizeof(value));
+                        sqlite3_bind_double(insert, parameter, value);
+                        break;
+                    }
+                    // The batch outlives the step, so nothing needs copying
+                    case Text:
+                        sqlite3_bind_text(insert, parameter, bytes, size, SQLITE_STATIC);
+                        break;
+                    case Blob:
+                        sqlite3_bind_blob(insert, parameter, bytes, size, SQLITE_STATIC);
+                        break;
+                    default:
+                        sqlite3_bind_null(insert, parameter);
+                        break;
+                }
+            }
+            if (sqlite3_step(insert) != SQLITE_DONE) {
+                error = "Row " + std::to_string(m_rows + row + 1) + ": " + sqlite3_errmsg(db);
+                ok = false;
+            }
+            sqlite3_reset(insert);
+        }
+        if (!ok) break;
+
+        m_rows += batch->rows;
+        inTransaction += batch->rows;
+        if (inTransaction >= TransactionRows) {
+            ok = execute(db, "COMMIT", error) && execute(db, "BEGIN", error);
+            inTransaction = 0;
+        }
+        queue.recycle(std::move(batch));
+    }
+    sqlite3_finalize(insert);
+    if (ok) {
+        ok = execute(db, "COMMIT", error);
+    } else {
+        // Only the last, unfinished transaction is lost
+        m_rows -= std::min<std::uint64_t>(m_rows, inTransaction);
+        execute(db, "ROLLBACK", ignored);
+    }
+
+    queue.close();
+    reader.join();
+    if (ok && !source->error().empty()) {
+        error = source->error();
+        ok = false;
+    }
+
+    // Even a failed or cancelled load gets its indexes back
+    setPhase(Phase::Indexing);
+    std::string indexError;
+    bool indexed = execute(db, "BEGIN", indexError);
+    for (std::size_t i = 0; indexed && i < indexes.size(); ++i) {
+        indexed = execute(db, indexes[i].second, indexError);
+    }
+    if (indexed) {
+        execute(db, "COMMIT", indexError);
+    } else {
+        execute(db, "ROLLBACK", ignored);
+        std::cerr << "Import: could not rebuild indexes of " << table << ": " << indexError << std::endl;
+    }
+    execute(db, "PRAGMA wal_checkpoint(TRUNCATE)", ignored);
+    sqlite3_close(db);
+
+    if (!ok) {
+        setPhase(Phase::Failed, error);
+    } else if (!indexed) {
+        setPhase(Phase::Failed, indexError);
+    } else {
+        setPhase(m_cancelled ? Phase::Cancelled : Phase::Done);
+    }
+}
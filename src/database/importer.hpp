@@ -0,0 +1,84 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Loads a CSV file or a GeoPackage feature table into a SQLite table.
+//
+// A reader thread parses the source into batches of rows; the import
+// thread inserts them through one prepared statement, committing every
+// TransactionRows rows. The two are connected by a small bounded queue so
+// parsing and inserting overlap and memory stays flat. During the load the
+// import connection runs in WAL mode with synchronous=OFF, a large page
+// cache and multi-threaded sorting; indexes on the target table are dropped first and created again
+// once all rows are in, which is much faster than updating them row by row.
+//
+// CSV: the first line holds the column names and the delimiter (',' ';'
+// or tab) is taken from it. Quoted fields may contain delimiters, quotes
+// ("") and line breaks. Empty fields become NULL. A new table gets
+// INTEGER, REAL or TEXT columns from the first batch of rows.
+//
+// Cancelling keeps the rows of transactions already committed.
+class Importer {
+public:
+    enum class Phase { Idle, Loading, Indexing, Done, Cancelled, Failed };
+
+    struct Progress {
+        Phase phase = Phase::Idle;
+        std::uint64_t rows = 0;          // inserted so far
+        std::uint64_t bytesRead = 0;     // CSV only
+        std::uint64_t bytesTotal = 0;
+        double rowsPerSecond = 0.0;      // over the last second or so
+        double averageRowsPerSecond = 0.0;
+        double seconds = 0.0;
+        double loadSeconds = 0.0;        // set once the rows are in
+        double indexSeconds = 0.0;       // set when done
+        std::string table;
+        std::string error;
+    };
+
+    static const std::size_t BatchRows = 8192;
+    static const std::uint64_t TransactionRows = 250000;
+
+    Importer();
+    ~Importer();
+
+    Importer(const Importer&) = delete;
+    Importer& operator=(const Importer&) = delete;
+
+    // Imports `source` (.gpkg, anything else is read as CSV) into `table` of
+    // the database at `databasePath`. An empty `table` is named after the
+    // file, or the first feature table for a GeoPackage; `layer` picks a
+    // feature table. Returns false if an import is still running.
+    bool start(const std::string& source, const std::string& databasePath, const std::string& table = "", const std::string& layer = "");
+    void cancel();
+    // Blocks until the import has finished
+    void wait();
+
+    bool isRunning() const;
+    // Meant to be polled by one thread; the current rate is measured between calls
+    Progress progress();
+
+private:
+    std::thread m_thread;
+    std::atomic<bool> m_cancelled{false};
+
+    mutable std::mutex m_mutex; // guards m_progress
+    Progress m_progress;
+    std::atomic<std::uint64_t> m_rows{0};
+    std::atomic<std::uint64_t> m_bytesRead{0};
+    std::chrono::steady_clock::time_point m_started;
+
+    // Rate measurement, polling thread only
+    std::chrono::steady_clock::time_point m_rateTime;
+    std::uint64_t m_rateRows = 0;
+    double m_rate = 0.0;
+
+    void run(std::string source, std::string databasePath, std::string table, std::string layer);
+    void setPhase(Phase phase, const std::string& error = std::string());
+};
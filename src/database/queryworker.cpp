@@ -0,0 +1,300 @@
+#include "queryworker.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    // Virtual machine instructions between progress callbacks
+    const int ProgressInstructions = 10000;
+    const std::chrono::milliseconds ProgressInterval(100);
+
+    // Trailing semicolons would break wrapping the query in a subselect
+    std::string trimStatement(const std::string& sql) {
+        std::size_t begin = sql.find_first_not_of(" \t\r\n");
+        std::size_t end = sql.find_last_not_of(" \t\r\n;");
+        return begin == std::string::npos || end == std::string::npos || end < begin ? std::string() : sql.substr(begin, end - begin + 1);
+    }
+}
+
+QueryWorker::QueryWorker(const std::string& path) {
+    if (sqlite3_open_v2(path.c_str(), &m_db, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, nullptr) != SQLITE_OK) {
+        m_openError = "Cannot open " + path + ": " + sqlite3_errmsg(m_db);
+        sqlite3_close(m_db);
+        m_db = nullptr;
+    } else {
+        // Writes from here wait for readers on the UI connection rather than failing
+        sqlite3_busy_timeout(m_db, 5000);
+        sqlite3_progress_handler(m_db, ProgressInstructions, &QueryWorker::onProgress, this);
+    }
+    m_worker = std::thread(&QueryWorker::workerLoop, this);
+}
+
+QueryWorker::~QueryWorker() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+        m_cancelledUpTo = m_nextId.load();
+        if (m_db) sqlite3_interrupt(m_db);
+    }
+    m_jobAvailable.notify_all();
+    m_worker.join();
+    closeCursor();
+    sqlite3_close(m_db);
+}
+
+std::uint64_t QueryWorker::run(const std::string& sql) {
+    std::uint64_t id = m_nextId++;
+    m_cancelledUpTo = id - 1;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_db && m_runningId != 0 && isCancelled(m_runningId)) sqlite3_interrupt(m_db);
+        m_pendingSql = sql;
+        m_pendingId = id;
+        m_pendingBatches.clear();
+    }
+    m_busy = true;
+    m_jobAvailable.notify_one();
+    return id;
+}
+
+void QueryWorker::requestBatch(std::uint64_t queryId, std::size_t batch) {
+    if (isCancelled(queryId)) return;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_pendingBatches.emplace_back(queryId, batch);
+    }
+    m_busy = true;
+    m_jobAvailable.notify_one();
+}
+
+void QueryWorker::cancel() {
+    m_cancelledUpTo = m_nextId - 1;
+    std::lock_guard<std::mutex> lock(m_mutex);
+    // Only while the cancelled statement is the one on the connection: an
+    // interrupt also hits statements started before the connection goes idle
+    if (m_db && m_runningId != 0 && isCancelled(m_runningId)) sqlite3_interrupt(m_db);
+}
+
+bool QueryWorker::poll(Event& event) {
+    return m_events.pop(event);
+}
+
+void QueryWorker::publish(Event&& event) {
+    while (!m_events.push(event)) {
+        // The UI has not drained the queue yet; rows of a cancelled statement can go
+        if (m_stopping || (event.type != Event::Type::Cancelled && isCancelled(event.queryId))) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+int QueryWorker::onProgress(void* user) {
+    QueryWorker* worker = static_cast<QueryWorker*>(user);
+    Clock::time_point now = Clock::now();
+    if (now - worker->m_lastProgress >= ProgressInterval) {
+        worker->m_lastProgress = now;
+        Event progress;
+        progress.type = Event::Type::Progress;
+        progress.queryId = worker->m_queryId;
+        progress.rowsRead = worker->m_cursorRow;
+        progress.milliseconds = worker->elapsed();
+        // Dropped rather than waited for when the queue is full
+        worker->m_events.push(progress);
+    }
+    return worker->m_stopping || (worker->m_queryId != 0 && worker->isCancelled(worker->m_queryId)) ? 1 : 0;
+}
+
+void QueryWorker::workerLoop() {
+    for (;;) {
+        std::string sql;
+        std::uint64_t newId = 0;
+        std::pair<std::uint64_t, std::size_t> batch(0, 0);
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_stopping || m_pendingId != 0 || !m_pendingBatches.empty(); });
+            if (m_stopping) return;
+            if (m_pendingId != 0) {
+                sql.swap(m_pendingSql);
+                newId = m_pendingId;
+                m_pendingId = 0;
+                m_runningId = newId;
+            } else {
+                batch = m_pendingBatches.front();
+                m_pendingBatches.pop_front();
+            }
+        }
+
+        if (newId != 0) {
+            start(newId, sql);
+        } else if (batch.first == m_queryId && m_queryId != 0) {
+            serveBatch(batch.first, batch.second);
+        }
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_pendingId == 0 && m_pendingBatches.empty()) m_busy = false;
+    }
+}
+
+void QueryWorker::start(std::uint64_t queryId, const std::string& sql) {
+    closeCursor();
+    m_queryId = queryId;
+    m_started = m_lastProgress = Clock::now();
+
+    Event result;
+    result.queryId = queryId;
+    if (!m_db) {
+        result.type = Event::Type::Error;
+        result.error = m_openError;
+        publish(std::move(result));
+        m_queryId = 0;
+        return;
+    }
+
+    m_sql = trimStatement(sql);
+    if (sqlite3_prepare_v2(m_db, m_sql.c_str(), static_cast<int>(m_sql.size()), &m_cursor, nullptr) != SQLITE_OK || !m_cursor) {
+        finish(queryId, m_cursor || !m_sql.empty() ? sqlite3_errcode(m_db) : SQLITE_MISUSE);
+        return;
+    }
+
+    if (sqlite3_column_count(m_cursor) == 0) {
+        // Not a query; run it now
+        int stepResult;
+        while (step(stepResult)) {}
+        finish(queryId, stepResult);
+        return;
+    }
+
+    result.type = Event::Type::Started;
+    for (int c = 0; c < sqlite3_column_count(m_cursor); ++c) {
+        const char* name = sqlite3_column_name(m_cursor, c);
+        result.columns.push_back(name ? name : "");
+    }
+    result.milliseconds = elapsed();
+    publish(std::move(result));
+}
+
+void QueryWorker::serveBatch(std::uint64_t queryId, std::size_t batch) {
+    const std::size_t first = batch * BatchSize;
+    if (first < m_cursorRow && !restart(first)) {
+        finish(queryId, sqlite3_errcode(m_db));
+        return;
+    }
+
+    int stepResult = SQLITE_DONE;
+    while (m_cursorRow < first && step(stepResult)) {}
+
+    Event rows;
+    rows.type = Event::Type::Rows;
+    rows.queryId = queryId;
+    rows.firstRow = first;
+    if (m_cursorRow == first) {
+        rows.rows.reserve(BatchSize);
+        while (rows.rows.size() < BatchSize && step(stepResult)) {
+            rows.rows.emplace_back();
+            readRow(m_cursor, 0, rows.rows.back());
+            rows.rows.back().rowid = static_cast<std::int64_t>(m_cursorRow);
+        }
+    }
+    rows.rowsRead = m_cursorRow;
+    rows.milliseconds = elapsed();
+    publish(std::move(rows));
+
+    if (m_cursorDone) finish(queryId, stepResult);
+}
+
+bool QueryWorker::restart(std::size_t offset) {
+    sqlite3_finalize(m_cursor);
+    m_cursor = nullptr;
+    m_cursorDone = false;
+
+    if (offset > 0) {
+        std::string wrapped = "SELECT * FROM (" + m_sql + ") LIMIT -1 OFFSET " + std::to_string(offset);
+        if (sqlite3_prepare_v2(m_db, wrapped.c_str(), -1, &m_cursor, nullptr) == SQLITE_OK && m_cursor) {
+            m_cursorRow = offset;
+            return true;
+        }
+        sqlite3_finalize(m_cursor);
+        m_cursor = nullptr;
+    }
+
+    // Statements that cannot be a subquery (PRAGMA and the like) start over and skip
+    m_cursorRow = 0;
+    if (sqlite3_prepare_v2(m_db, m_sql.c_str(), -1, &m_cursor, nullptr) != SQLITE_OK || !m_cursor) {
+        sqlite3_finalize(m_cursor);
+        m_cursor = nullptr;
+        m_cursorDone = true;
+        return false;
+    }
+    return true;
+}
+
+bool QueryWorker::step(int& result) {
+    // Stepping a finished statement would silently start it over
+    if (m_cursorDone || !m_cursor) {
+        result = SQLITE_DONE;
+        return false;
+    }
+    result = sqlite3_step(m_cursor);
+    if (result == SQLITE_ROW) {
+        ++m_cursorRow;
+        return true;
+    }
+    m_cursorDone = true;
+    return false;
+}
+
+void QueryWorker::finish(std::uint64_t queryId, int result) {
+    Event event;
+    event.queryId = queryId;
+    event.rowsRead = m_cursorRow;
+    event.milliseconds = elapsed();
+    if (result == SQLITE_DONE) {
+        event.type = Event::Type::Done;
+        event.changes = sqlite3_changes(m_db);
+        // A finished query keeps its SQL so earlier batches can be served again
+        if (!m_cursor || sqlite3_column_count(m_cursor) == 0) {
+            closeCursor();
+            m_queryId = 0;
+        }
+    } else {
+        event.type = result == SQLITE_INTERRUPT || isCancelled(queryId) ? Event::Type::Cancelled : Event::Type::Error;
+        event.error = result == SQLITE_MISUSE && m_sql.empty() ? "empty statement" : sqlite3_errmsg(m_db);
+        closeCursor();
+        m_queryId = 0;
+    }
+    publish(std::move(event));
+}
+
+void QueryWorker::closeCursor() {
+    sqlite3_finalize(m_cursor);
+    m_cursor = nullptr;
+    m_cursorRow = 0;
+    m_cursorDone = false;
+}
+
+double QueryWorker::elapsed() const {
+    return std::chrono::duration<double, std::milli>(Clock::now() - m_started).count();
+}
+
+void QueryWorker::readRow(sqlite3_stmt* statement, int firstColumn, Row& row) {
+    int count = sqlite3_column_count(statement) - firstColumn;
+    row.cells.resize(count);
+    row.nulls.assign(count, false);
+    for (int c = 0; c < count; ++c) {
+        int column = c + firstColumn;
+        switch (sqlite3_column_type(statement, column)) {
+            case SQLITE_NULL:
+                row.nulls[c] = true;
+                break;
+            case SQLITE_BLOB:
+                row.cells[c] = "<blob " + std::to_string(sqlite3_column_bytes(statement, column)) + " bytes>";
+                break;
+            default: {
+                const unsigned char* text = sqlite3_column_text(statement, column);
+                std::size_t bytes = static_cast<std::size_t>(sqlite3_column_bytes(statement, column));
+                row.cells[c].assign(reinterpret_cast<const char*>(text), std::min(bytes, static_cast<std::size_t>(MaxCellLength)));
+                break;
+            }
+        }
+    }
+}
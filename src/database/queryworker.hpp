@@ -0,0 +1,128 @@
+#pragma once
+
+#include <boost/lockfree/spsc_queue.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Runs SQL statements on a worker thread with its own connection, so a
+// statement that takes minutes never blocks the UI.
+//
+// A query is prepared and then read on demand: the UI asks for batches of
+// BatchSize rows and each batch is sent back as one event once the worker
+// has stepped to it. Going back to a batch the UI has dropped re-runs the
+// query from an OFFSET. Statements that return no rows are run to the end
+// straight away.
+//
+// While a statement runs, sqlite3_progress_handler reports how far it got a
+// few times per second. cancel() interrupts it with sqlite3_interrupt;
+// running a new statement cancels the previous one. Events are taken from
+// a lock-free queue with poll() once per frame.
+class QueryWorker {
+public:
+    struct Row {
+        std::int64_t rowid = 0;
+        std::vector<std::string> cells;
+        std::vector<bool> nulls;
+    };
+
+    struct Event {
+        enum class Type {
+            Started,   // columns is set
+            Rows,      // firstRow and rows are set
+            Progress,
+            Done,      // for queries: the last row was read
+            Cancelled,
+            Error
+        };
+
+        Type type = Type::Progress;
+        std::uint64_t queryId = 0;
+        std::vector<std::string> columns;
+        std::size_t firstRow = 0;
+        std::vector<Row> rows;
+        std::size_t rowsRead = 0;     // rows stepped over so far
+        int changes = 0;              // Done, for statements without rows
+        double milliseconds = 0.0;    // since the statement was started
+        std::string error;
+    };
+
+    static const std::size_t BatchSize = 256;
+    static const std::size_t MaxCellLength = 256;
+
+    explicit QueryWorker(const std::string& path);
+    ~QueryWorker();
+
+    QueryWorker(const QueryWorker&) = delete;
+    QueryWorker& operator=(const QueryWorker&) = delete;
+
+    // Starts `sql`, cancelling the statement in flight. Returns the id the
+    // events for this statement will carry.
+    std::uint64_t run(const std::string& sql);
+    // Asks for rows [batch * BatchSize, (batch + 1) * BatchSize) of query `queryId`
+    void requestBatch(std::uint64_t queryId, std::size_t batch);
+    void cancel();
+
+    // UI thread only: takes the next event, if any
+    bool poll(Event& event);
+
+    bool isBusy() const { return m_busy; }
+
+    // Formats the current row of `statement` starting at `firstColumn`;
+    // blobs are summarized and long text is cut at MaxCellLength bytes
+    static void readRow(sqlite3_stmt* statement, int firstColumn, Row& row);
+
+private:
+    sqlite3* m_db = nullptr;
+    std::string m_openError;
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::string m_pendingSql;
+    std::uint64_t m_pendingId = 0;
+    std::deque<std::pair<std::uint64_t, std::size_t>> m_pendingBatches; // query id, batch
+    std::uint64_t m_runningId = 0;            // guarded by m_mutex, read by cancel()
+    std::atomic<bool> m_stopping{false};
+
+    std::atomic<std::uint64_t> m_nextId{1};
+    // Every statement with an id up to this one is cancelled
+    std::atomic<std::uint64_t> m_cancelledUpTo{0};
+    std::atomic<bool> m_busy{false};
+
+    // Worker thread only
+    std::uint64_t m_queryId = 0; // query whose batches can still be served
+    std::string m_sql;
+    sqlite3_stmt* m_cursor = nullptr;
+    std::size_t m_cursorRow = 0; // index of the row the next step returns
+    bool m_cursorDone = false;
+    std::chrono::steady_clock::time_point m_started;
+    std::chrono::steady_clock::time_point m_lastProgress;
+
+    boost::lockfree::spsc_queue<Event, boost::lockfree::capacity<256>> m_events;
+
+    void workerLoop();
+    void start(std::uint64_t queryId, const std::string& sql);
+    void serveBatch(std::uint64_t queryId, std::size_t batch);
+    bool restart(std::size_t offset);
+    // false at the end of the rows; `result` is the last sqlite3_step result
+    bool step(int& result);
+    void finish(std::uint64_t queryId, int result);
+    void closeCursor();
+    double elapsed() const;
+    bool isCancelled(std::uint64_t queryId) const { return queryId <= m_cancelledUpTo; }
+    // Blocks while the queue is full unless the statement gets cancelled
+    void publish(Event&& event);
+    static int onProgress(void* user);
+};
@@ -0,0 +1,326 @@
+#include "resultgrid.hpp"
+#include "../ui/app.hpp"
+#include <algorithm>
+#include <string>
+
+namespace {
+    const unsigned int CharacterSize = 16;
+    const float RowHeight = 24.f;
+    const float HeaderHeight = 28.f;
+    const float Padding = 6.f;
+    const float MinColumnWidth = 60.f;
+    const float MaxColumnWidth = 320.f;
+    const float ScrollbarWidth = 12.f;
+    const std::size_t WidthSampleRows = 64;
+
+    void addQuad(sf::VertexArray& vertices, const sf::FloatRect& rect, const sf::Color& color) {
+        vertices.append(sf::Vertex(sf::Vector2f(rect.left, rect.top), color));
+        vertices.append(sf::Vertex(sf::Vector2f(rect.left + rect.width, rect.top), color));
+        vertices.append(sf::Vertex(sf::Vector2f(rect.left + rect.width, rect.top + rect.height), color));
+        vertices.append(sf::Vertex(sf::Vector2f(rect.left, rect.top + rect.height), color));
+    }
+
+    void addLine(sf::VertexArray& vertices, sf::Vector2f from, sf::Vector2f to, const sf::Color& color) {
+        vertices.append(sf::Vertex(from, color));
+        vertices.append(sf::Vertex(to, color));
+    }
+}
+
+ResultGrid::ResultGrid(ResultPager& pager, const sf::Font& font)
+    : m_pager(pager),
+      m_font(font),
+      m_background(sf::Quads),
+      m_lines(sf::Lines)
+{
+    m_scrollTrack.setFillColor(sf::Color(230, 230, 230));
+    m_scrollThumb.setFillColor(sf::Color(160, 160, 160));
+}
+
+void ResultGrid::setArea(const sf::FloatRect& area) {
+    m_area = area;
+    clampScroll();
+}
+
+std::size_t ResultGrid::visibleRows() const {
+    float height = m_area.height - HeaderHeight;
+    return height > 0.f ? static_cast<std::size_t>(height / RowHeight) : 0;
+}
+
+float ResultGrid::contentWidth() const {
+    return std::max(0.f, m_area.width - ScrollbarWidth);
+}
+
+void ResultGrid::releaseLayouts() {
+    std::unordered_map<std::size_t, RowLayout>().swap(m_layouts);
+}
+
+std::size_t ResultGrid::memoryBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : m_layouts) {
+        bytes += appmemory::textBytes(entry.second.label);
+        for (const sf::Text& cell : entry.second.cells) {
+            bytes += appmemory::textBytes(cell);
+        }
+    }
+    for (const sf::Text& header : m_headers) {
+        bytes += appmemory::textBytes(header);
+    }
+    return bytes;
+}
+
+void ResultGrid::reset() {
+    m_layouts.clear();
+    m_headers.clear();
+    m_columnX.clear();
+    m_firstRow = 0;
+    m_scrollX = 0.f;
+    m_dragging = false;
+    if (!m_pager.isOpen()) return;
+
+    // Size columns from the header and a sample of the first page
+    const std::vector<std::string>& columns = m_pager.columns();
+    std::vector<float> widths(columns.size(), 0.f);
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        widths[c] = textWidth(sf::String::fromUtf8(columns[c].begin(), columns[c].end()));
+    }
+    std::int64_t largestLabel = 0;
+    for (std::size_t i = 0; i < WidthSampleRows; ++i) {
+        const ResultPager::Row* row = m_pager.row(i);
+        if (!row) break;
+        largestLabel = std::max(largestLabel, m_pager.isTable() ? row->rowid : static_cast<std::int64_t>(i + 1));
+        for (std::size_t c = 0; c < row->cells.size() && c < widths.size(); ++c) {
+            widths[c] = std::max(widths[c], textWidth(sf::String::fromUtf8(row->cells[c].begin(), row->cells[c].end())));
+        }
+    }
+
+    float x = 0.f;
+    for (std::size_t c = 0; c < columns.size(); ++c) {
+        m_columnX.push_back(x);
+        x += std::min(MaxColumnWidth, std::max(MinColumnWidth, widths[c] + 2 * Padding));
+
+        sf::Text header(fit(columns[c], x - m_columnX.back() - 2 * Padding), m_font, CharacterSize);
+        header.setStyle(sf::Text::Bold);
+        header.setFillColor(sf::Color::Black);
+        m_headers.push_back(header);
+    }
+    m_columnX.push_back(x);
+
+    // Room for the largest row number that can be expected
+    largestLabel = std::max<std::int64_t>(largestLabel, static_cast<std::int64_t>(m_pager.rowCount()));
+    m_labelWidth = std::max(50.f, textWidth(std::to_string(largestLabel)) + 2 * Padding);
+}
+
+void ResultGrid::scrollRows(long long rows) {
+    if (rows < 0 && static_cast<std::size_t>(-rows) > m_firstRow) {
+        m_firstRow = 0;
+    } else {
+        m_firstRow += rows;
+    }
+    clampScroll();
+}
+
+void ResultGrid::scrollToRow(std::size_t row) {
+    m_firstRow = row;
+    clampScroll();
+}
+
+void ResultGrid::scrollToEnd() {
+    m_firstRow = m_pager.rowCount();
+    clampScroll();
+}
+
+void ResultGrid::clampScroll() {
+    std::size_t rows = m_pager.rowCount();
+    std::size_t visible = visibleRows();
+    m_firstRow = std::min(m_firstRow, rows > visible ? rows - visible : 0);
+
+    float width = m_columnX.empty() ? 0.f : m_columnX.back();
+    float room = contentWidth() - m_labelWidth;
+    m_scrollX = std::max(0.f, std::min(m_scrollX, width - room));
+}
+
+bool ResultGrid::handleEvent(const sf::Event& event) {
+    const sf::FloatRect track(m_area.left + contentWidth(), m_area.top + HeaderHeight, ScrollbarWidth, m_area.height - HeaderHeight);
+
+    if (event.type == sf::Event::MouseWheelScrolled) {
+        if (!m_area.contains(static_cast<float>(event.mouseWheelScroll.x), static_cast<float>(event.mouseWheelScroll.y))) return false;
+        bool horizontal = event.mouseWheelScroll.wheel == sf::Mouse::HorizontalWheel ||
+                          sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift);
+        if (horizontal) {
+            m_scrollX -= event.mouseWheelScroll.delta * 40.f;
+            clampScroll();
+        } else {
+            scrollRows(static_cast<long long>(-event.mouseWheelScroll.delta * 3.f));
+        }
+        return true;
+    }
+    if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left) {
+        if (!track.contains(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y))) return false;
+        m_dragging = true;
+        dragTo(static_cast<float>(event.mouseButton.y));
+        return true;
+    }
+    if (event.type == sf::Event::MouseMoved && m_dragging) {
+        dragTo(static_cast<float>(event.mouseMove.y));
+        return true;
+    }
+    if (event.type == sf::Event::MouseButtonReleased && m_dragging) {
+        m_dragging = false;
+        return true;
+    }
+    return false;
+}
+
+void ResultGrid::dragTo(float y) {
+    // Jumps straight to the position; only the rows landed on are fetched
+    float trackHeight = m_area.height - HeaderHeight;
+    float fraction = trackHeight > 0.f ? (y - m_area.top - HeaderHeight) / trackHeight : 0.f;
+    fraction = std::max(0.f, std::min(1.f, fraction));
+    std::size_t rows = m_pager.rowCount();
+    std::size_t visible = visibleRows();
+    std::size_t last = rows > visible ? rows - visible : 0;
+    scrollToRow(static_cast<std::size_t>(fraction * last));
+}
+
+void ResultGrid::draw(sf::RenderTarget& target) {
+    clampScroll();
+    const float width = contentWidth();
+    const std::size_t visible = visibleRows();
+    const std::size_t endRow = std::min(m_pager.rowCount(), m_firstRow + visible);
+
+    // Layouts of rows scrolled out of view are dropped
+    for (auto it = m_layouts.begin(); it != m_layouts.end();) {
+        if (it->first < m_firstRow || it->first >= endRow) {
+            it = m_layouts.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    // Clip to the area with a view whose viewport covers just that area
+    const sf::View previousView = target.getView();
+    const sf::Vector2f targetSize(static_cast<float>(target.getSize().x), static_cast<float>(target.getSize().y));
+    sf::View clip(sf::FloatRect(0.f, 0.f, width, m_area.height));
+    clip.setViewport(sf::FloatRect(m_area.left / targetSize.x, m_area.top / targetSize.y,
+                                   width / targetSize.x, m_area.height / targetSize.y));
+    target.setView(clip);
+
+    m_background.clear();
+    m_lines.clear();
+    addQuad(m_background, sf::FloatRect(0.f, 0.f, width, m_area.height), sf::Color::White);
+    for (std::size_t row = m_firstRow; row < endRow; ++row) {
+        if (row % 2 == 1) {
+            addQuad(m_background, sf::FloatRect(0.f, HeaderHeight + (row - m_firstRow) * RowHeight, width, RowHeight), sf::Color(245, 245, 250));
+        }
+    }
+    addQuad(m_background, sf::FloatRect(0.f, 0.f, width, HeaderHeight), sf::Color(220, 220, 225));
+    addQuad(m_background, sf::FloatRect(0.f, HeaderHeight, m_labelWidth, m_area.height - HeaderHeight), sf::Color(235, 235, 238));
+    target.draw(m_background);
+
+    // Columns left of or right of the viewport are skipped
+    std::size_t firstColumn = 0;
+    while (firstColumn + 1 < m_columnX.size() && m_columnX[firstColumn + 1] <= m_scrollX) ++firstColumn;
+    auto columnLeft = [&](std::size_t c) { return m_labelWidth + m_columnX[c] - m_scrollX; };
+
+    for (std::size_t row = m_firstRow; row < endRow; ++row) {
+        RowLayout& current = layout(row);
+        float y = HeaderHeight + (row - m_firstRow) * RowHeight + (RowHeight - CharacterSize) / 2.f - 2.f;
+        for (std::size_t c = firstColumn; c < current.cells.size() && columnLeft(c) < width; ++c) {
+            // Cells partly under the row labels are left out rather than overlapping them
+            if (columnLeft(c) < m_labelWidth) continue;
+            current.cells[c].setPosition(columnLeft(c) + Padding, y);
+            target.draw(current.cells[c]);
+        }
+        current.label.setPosition(Padding, y);
+        target.draw(current.label);
+    }
+
+    for (std::size_t c = firstColumn; c < m_headers.size() && columnLeft(c) < width; ++c) {
+        if (columnLeft(c) < m_labelWidth) continue;
+        m_headers[c].setPosition(columnLeft(c) + Padding, (HeaderHeight - CharacterSize) / 2.f - 2.f);
+        target.draw(m_headers[c]);
+    }
+
+    const sf::Color lineColor(200, 200, 205);
+    for (std::size_t c = firstColumn; c < m_columnX.size(); ++c) {
+        float x = columnLeft(c);
+        if (x >= width) break;
+        if (x > m_labelWidth) addLine(m_lines, sf::Vector2f(x, 0.f), sf::Vector2f(x, m_area.height), lineColor);
+    }
+    addLine(m_lines, sf::Vector2f(m_labelWidth, 0.f), sf::Vector2f(m_labelWidth, m_area.height), lineColor);
+    addLine(m_lines, sf::Vector2f(0.f, HeaderHeight), sf::Vector2f(width, HeaderHeight), lineColor);
+    target.draw(m_lines);
+
+    target.setView(previousView);
+
+    // Scrollbar in window coordinates
+    std::size_t rows = m_pager.rowCount();
+    float trackHeight = m_area.height - HeaderHeight;
+    m_scrollTrack.setSize(sf::Vector2f(ScrollbarWidth, trackHeight));
+    m_scrollTrack.setPosition(m_area.left + width, m_area.top + HeaderHeight);
+    target.draw(m_scrollTrack);
+    if (rows > visible) {
+        float thumbHeight = std::max(20.f, trackHeight * visible / rows);
+        float fraction = static_cast<float>(m_firstRow) / (rows - visible);
+        m_scrollThumb.setSize(sf::Vector2f(ScrollbarWidth, thumbHeight));
+        m_scrollThumb.setPosition(m_area.left + width, m_area.top + HeaderHeight + fraction * (trackHeight - thumbHeight));
+        target.draw(m_scrollThumb);
+    }
+}
+
+ResultGrid::RowLayout& ResultGrid::layout(std::size_t row) {
+    auto it = m_layouts.find(row);
+    if (it != m_layouts.end()) return it->second;
+
+    // Not kept while the row is missing: a query page may still be on its way
+    const ResultPager::Row* data = m_pager.row(row);
+    if (!data) return m_emptyLayout;
+
+    ++m_layoutCount;
+    RowLayout& created = m_layouts[row];
+
+    std::int64_t label = m_pager.isTable() ? data->rowid : static_cast<std::int64_t>(row + 1);
+    created.label = sf::Text(std::to_string(label), m_font, CharacterSize);
+    created.label.setFillColor(sf::Color(90, 90, 90));
+
+    created.cells.reserve(data->cells.size());
+    for (std::size_t c = 0; c < data->cells.size() && c + 1 < m_columnX.size(); ++c) {
+        float cellWidth = m_columnX[c + 1] - m_columnX[c] - 2 * Padding;
+        bool isNull = data->nulls[c];
+        created.cells.emplace_back(isNull ? sf::String("NULL") : fit(data->cells[c], cellWidth), m_font, CharacterSize);
+        created.cells.back().setFillColor(isNull ? sf::Color(160, 160, 160) : sf::Color::Black);
+    }
+    return created;
+}
+
+float ResultGrid::textWidth(const sf::String& text) const {
+    float width = 0.f;
+    for (std::size_t i = 0; i < text.getSize(); ++i) {
+        width += m_font.getGlyph(text[i], CharacterSize, false).advance;
+    }
+    return width;
+}
+
+sf::String ResultGrid::fit(const std::string& utf8, float width) const {
+    sf::String text = sf::String::fromUtf8(utf8.begin(), utf8.end());
+    sf::String fitted;
+    const sf::Uint32 ellipsis = 0x2026;
+    const float ellipsisWidth = m_font.getGlyph(ellipsis, CharacterSize, false).advance;
+    float used = 0.f;
+    for (std::size_t i = 0; i < text.getSize(); ++i) {
+        // One line per cell
+        sf::Uint32 c = text[i] == '\n' || text[i] == '\r' || text[i] == '\t' ? ' ' : text[i];
+        float advance = m_font.getGlyph(c, CharacterSize, false).advance;
+        if (used + advance > width) {
+            while (!fitted.isEmpty() && used + ellipsisWidth > width) {
+                used -= m_font.getGlyph(fitted[fitted.getSize() - 1], CharacterSize, false).advance;
+                fitted.erase(fitted.getSize() - 1);
+            }
+            fitted += ellipsis;
+            break;
+        }
+        fitted += c;
+        used += advance;
+    }
+    return fitted;
+}
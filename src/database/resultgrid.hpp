@@ -0,0 +1,74 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "resultpager.hpp"
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+// Scrollable table view of a ResultPager.
+//
+// Only the rows inside the viewport are laid out, and their text is kept
+// only while they stay visible, so the cost of a frame depends on the size
+// of the window and not on the number of rows. Scrolling by one row lays
+// out one row. Column widths are taken from the header and the first page
+// and long values are cut off to fit.
+class ResultGrid {
+public:
+    ResultGrid(ResultPager& pager, const sf::Font& font);
+
+    void setArea(const sf::FloatRect& area);
+    // Call after the pager was opened on a new table or query
+    void reset();
+
+    // Mouse wheel (Shift for horizontal) and dragging the scrollbar; returns true if the event was used
+    bool handleEvent(const sf::Event& event);
+    void draw(sf::RenderTarget& target);
+
+    void scrollRows(long long rows);
+    void scrollToRow(std::size_t row);
+    // For queries the end is only as far as has been read so far
+    void scrollToEnd();
+    std::size_t firstRow() const { return m_firstRow; }
+    std::size_t visibleRows() const;
+
+    // Rows laid out so far, for benchmarks
+    std::size_t layoutCount() const { return m_layoutCount; }
+    // Forgets the row layouts; the visible rows are laid out again on the next draw
+    void releaseLayouts();
+    std::size_t memoryBytes() const;
+
+private:
+    struct RowLayout {
+        sf::Text label;
+        std::vector<sf::Text> cells;
+    };
+
+    ResultPager& m_pager;
+    const sf::Font& m_font;
+    sf::FloatRect m_area;
+
+    std::vector<float> m_columnX; // left edge of each column, plus the right edge of the last
+    std::vector<sf::Text> m_headers;
+    float m_labelWidth = 0.f;
+
+    std::size_t m_firstRow = 0;
+    float m_scrollX = 0.f;
+    bool m_dragging = false;
+
+    std::unordered_map<std::size_t, RowLayout> m_layouts; // visible rows only
+    RowLayout m_emptyLayout; // for rows that are not loaded (yet)
+    std::size_t m_layoutCount = 0;
+
+    sf::VertexArray m_background;
+    sf::VertexArray m_lines;
+    sf::RectangleShape m_scrollTrack;
+    sf::RectangleShape m_scrollThumb;
+
+    float textWidth(const sf::String& text) const;
+    sf::String fit(const std::string& utf8, float width) const;
+    RowLayout& layout(std::size_t row);
+    float contentWidth() const;
+    void clampScroll();
+    void dragTo(float y);
+};
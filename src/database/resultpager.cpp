@@ -0,0 +1,293 @@
+#include "resultpager.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+
+namespace {
+    std::string quoteIdentifier(const std::string& name) {
+        std::string quoted = "\"";
+        for (char c : name) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Resets the statement afterwards so it does not hold a read transaction open
+    bool readInt64(sqlite3_stmt* statement, std::int64_t& value) {
+        if (!statement) return false;
+        bool found = sqlite3_step(statement) == SQLITE_ROW && sqlite3_column_type(statement, 0) != SQLITE_NULL;
+        if (found) value = sqlite3_column_int64(statement, 0);
+        sqlite3_reset(statement);
+        return found;
+    }
+}
+
+ResultPager::ResultPager(StatementCache& statements, QueryWorker& worker)
+    : m_statements(statements),
+      m_worker(worker)
+{
+}
+
+ResultPager::~ResultPager() {
+    close();
+}
+
+void ResultPager::close() {
+    if (m_mode == Mode::Query) {
+        m_worker.cancel();
+    }
+    m_mode = Mode::Closed;
+    m_columns.clear();
+    m_error.clear();
+    m_changes = 0;
+    m_pages.clear();
+    m_pageOrder.clear();
+    m_pagesLoaded = 0;
+    m_table.clear();
+    m_minRowid = 0;
+    m_maxRowid = -1;
+    m_endRow = static_cast<std::size_t>(-1);
+    m_queryId = 0;
+    m_requested.clear();
+    m_seenRows = 0;
+    m_endReached = false;
+    m_firstPageArrived = false;
+    m_cancelled = false;
+    m_rowsRead = 0;
+    m_milliseconds = 0.0;
+}
+
+void ResultPager::cancel() {
+    if (isRunning()) {
+        m_worker.cancel();
+    }
+}
+
+bool ResultPager::openTable(const std::string& table) {
+    close();
+    m_table = quoteIdentifier(table);
+
+    // A view could take as long as any query, so it runs on the worker
+    sqlite3_stmt* statement = m_statements.acquire("SELECT type FROM sqlite_master WHERE name = ?1");
+    if (statement) {
+        sqlite3_bind_text(statement, 1, table.c_str(), static_cast<int>(table.size()), SQLITE_TRANSIENT);
+        const unsigned char* type = sqlite3_step(statement) == SQLITE_ROW ? sqlite3_column_text(statement, 0) : nullptr;
+        bool isView = type && std::string(reinterpret_cast<const char*>(type)) == "view";
+        sqlite3_reset(statement);
+        if (isView) {
+            return openQuery("SELECT * FROM " + m_table);
+        }
+    }
+
+    // Separate statements: SQLite answers min() and max() of rowid with one seek each, but not together
+    statement = m_statements.acquire("SELECT min(rowid) FROM " + m_table);
+    if (!statement) {
+        // WITHOUT ROWID tables have no rowid to page by
+        return openQuery("SELECT * FROM " + m_table);
+    }
+    if (readInt64(statement, m_minRowid)) {
+        readInt64(m_statements.acquire("SELECT max(rowid) FROM " + m_table), m_maxRowid);
+    }
+
+    statement = m_statements.acquire("SELECT rowid, * FROM " + m_table + " WHERE rowid >= ?1 ORDER BY rowid LIMIT ?2");
+    if (!statement) {
+        m_error = m_statements.error();
+        return false;
+    }
+    readColumns(statement, 1);
+    m_mode = Mode::Table;
+    return true;
+}
+
+bool ResultPager::openQuery(const std::string& sql) {
+    close();
+    m_mode = Mode::Query;
+    m_queryId = m_worker.run(sql);
+    // Asked for right away so the first rows come with the columns
+    m_requested.insert(0);
+    m_worker.requestBatch(m_queryId, 0);
+    return true;
+}
+
+bool ResultPager::update() {
+    bool reset = false;
+    QueryWorker::Event event;
+    while (m_worker.poll(event)) {
+        // Events of replaced statements may still be queued
+        if (m_mode != Mode::Query || event.queryId != m_queryId) continue;
+
+        m_rowsRead = std::max(m_rowsRead, event.rowsRead);
+        m_milliseconds = event.milliseconds;
+        switch (event.type) {
+            case QueryWorker::Event::Type::Started:
+                m_columns = std::move(event.columns);
+                break;
+            case QueryWorker::Event::Type::Rows: {
+                std::size_t pageIndex = event.firstRow / PageSize;
+                m_requested.erase(pageIndex);
+                m_seenRows = std::max(m_seenRows, event.firstRow + event.rows.size());
+                store(pageIndex, std::move(event.rows));
+                if (pageIndex == 0 && !m_firstPageArrived) {
+                    m_firstPageArrived = true;
+                    reset = true;
+                }
+                break;
+            }
+            case QueryWorker::Event::Type::Progress:
+                break;
+            case QueryWorker::Event::Type::Done:
+                if (m_columns.empty()) {
+                    m_changes = event.changes;
+                    reset = true;
+                } else {
+                    m_seenRows = event.rowsRead;
+                }
+                m_endReached = true;
+                break;
+            case QueryWorker::Event::Type::Cancelled:
+                m_cancelled = true;
+                m_endReached = true;
+                m_requested.clear();
+                break;
+            case QueryWorker::Event::Type::Error:
+                m_error = event.error;
+                m_endReached = true;
+                m_requested.clear();
+                reset = true;
+                break;
+        }
+    }
+    return reset;
+}
+
+void ResultPager::readColumns(sqlite3_stmt* statement, int firstColumn) {
+    m_columns.clear();
+    for (int c = firstColumn; c < sqlite3_column_count(statement); ++c) {
+        const char* name = sqlite3_column_name(statement, c);
+        m_columns.push_back(name ? name : "");
+    }
+}
+
+std::size_t ResultPager::rowCount() const {
+    switch (m_mode) {
+        case Mode::Table:
+            return m_maxRowid >= m_minRowid ? std::min(m_endRow, static_cast<std::size_t>(m_maxRowid - m_minRowid + 1)) : 0;
+        case Mode::Query:
+            if (m_columns.empty()) return 0;
+            return m_endReached ? m_seenRows : m_seenRows + PageSize;
+        default:
+            return 0;
+    }
+}
+
+bool ResultPager::isRowCountExact() const {
+    return m_mode == Mode::Query && m_endReached && !m_cancelled && m_error.empty();
+}
+
+std::size_t ResultPager::residentRows() const {
+    std::size_t rows = 0;
+    for (const auto& entry : m_pages) {
+        rows += entry.second.rows.size();
+    }
+    return rows;
+}
+
+std::size_t ResultPager::memoryBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : m_pages) {
+        bytes += entry.second.rows.capacity() * sizeof(Row);
+        for (const Row& row : entry.second.rows) {
+            bytes += row.cells.capacity() * sizeof(std::string) + row.nulls.capacity() / 8;
+            for (const std::string& cell : row.cells) {
+                bytes += cell.capacity();
+            }
+        }
+    }
+    return bytes;
+}
+
+const ResultPager::Row* ResultPager::row(std::size_t index) {
+    if (index >= rowCount()) return nullptr;
+    Page* loaded = page(index / PageSize);
+    std::size_t offset = index % PageSize;
+    return loaded && offset < loaded->rows.size() ? &loaded->rows[offset] : nullptr;
+}
+
+ResultPager::Page* ResultPager::page(std::size_t pageIndex) {
+    auto it = m_pages.find(pageIndex);
+    if (it != m_pages.end()) {
+        m_pageOrder.splice(m_pageOrder.begin(), m_pageOrder, it->second.order);
+        return &it->second;
+    }
+
+    if (m_mode == Mode::Query) {
+        // Arrives in a later update(); a cancelled or failed statement has nothing more to give
+        if (!m_cancelled && m_error.empty() && m_requested.insert(pageIndex).second) {
+            m_worker.requestBatch(m_queryId, pageIndex);
+        }
+        return nullptr;
+    }
+    if (m_mode != Mode::Table) return nullptr;
+
+    // Load before evicting; table pages continue from their neighbours
+    std::vector<Row> rows;
+    loadTablePage(pageIndex, rows);
+    return store(pageIndex, std::move(rows));
+}
+
+ResultPager::Page* ResultPager::store(std::size_t pageIndex, std::vector<Row>&& rows) {
+    ++m_pagesLoaded;
+    auto it = m_pages.find(pageIndex);
+    if (it == m_pages.end()) {
+        if (m_pages.size() >= MaxCachedPages) {
+            m_pages.erase(m_pageOrder.back());
+            m_pageOrder.pop_back();
+        }
+        m_pageOrder.push_front(pageIndex);
+        it = m_pages.emplace(pageIndex, Page()).first;
+        it->second.order = m_pageOrder.begin();
+    }
+    it->second.rows = std::move(rows);
+    return &it->second;
+}
+
+void ResultPager::loadTablePage(std::size_t pageIndex, std::vector<Row>& rows) {
+    auto previous = pageIndex > 0 ? m_pages.find(pageIndex - 1) : m_pages.end();
+    auto next = m_pages.find(pageIndex + 1);
+
+    std::int64_t start;
+    if (previous != m_pages.end()) {
+        if (previous->second.rows.size() < PageSize) return; // past the last row
+        start = previous->second.rows.back().rowid + 1;
+    } else if (next != m_pages.end() && !next->second.rows.empty()) {
+        sqlite3_stmt* statement = m_statements.acquire("SELECT rowid, * FROM " + m_table + " WHERE rowid < ?1 ORDER BY rowid DESC LIMIT ?2");
+        if (!statement) return;
+        sqlite3_bind_int64(statement, 1, next->second.rows.front().rowid);
+        sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(PageSize));
+        while (sqlite3_step(statement) == SQLITE_ROW) {
+            rows.emplace_back();
+            QueryWorker::readRow(statement, 1, rows.back());
+            rows.back().rowid = sqlite3_column_int64(statement, 0);
+        }
+        std::reverse(rows.begin(), rows.end());
+        return;
+    } else {
+        // Nothing loaded nearby: assume rowids without gaps
+        start = m_minRowid + static_cast<std::int64_t>(pageIndex * PageSize);
+    }
+
+    sqlite3_stmt* statement = m_statements.acquire("SELECT rowid, * FROM " + m_table + " WHERE rowid >= ?1 ORDER BY rowid LIMIT ?2");
+    if (!statement) return;
+    sqlite3_bind_int64(statement, 1, start);
+    sqlite3_bind_int64(statement, 2, static_cast<sqlite3_int64>(PageSize));
+    rows.reserve(PageSize);
+    while (sqlite3_step(statement) == SQLITE_ROW) {
+        rows.emplace_back();
+        QueryWorker::readRow(statement, 1, rows.back());
+        rows.back().rowid = sqlite3_column_int64(statement, 0);
+    }
+    if (rows.size() < PageSize) {
+        // Ran into the last row: deleted rows made the estimate too large
+        m_endRow = std::min(m_endRow, pageIndex * PageSize + rows.size());
+    }
+}
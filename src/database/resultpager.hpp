@@ -0,0 +1,117 @@
+#pragma once
+
+#include "queryworker.hpp"
+#include "statementcache.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct sqlite3_stmt;
+
+// Random access to the rows of a table or query, one page at a time.
+//
+// Only pages that are asked for are fetched and at most MaxCachedPages are
+// kept, so memory does not depend on the size of the result.
+//
+// Tables are paged by rowid range (WHERE rowid >= ? LIMIT n), so any page
+// costs an index seek and is read right away. The row count is estimated
+// from min/max rowid, which is instant but can overshoot when rows were
+// deleted, until a page runs into the last row. Pages next to a loaded one
+// continue exactly from its first or last rowid.
+//
+// Arbitrary statements run on a QueryWorker: row() returns nullptr for a
+// page that is still on its way, and update() (once per frame) takes in
+// what has arrived. The row count of a query is only known once the worker
+// has read to its end.
+class ResultPager {
+public:
+    typedef QueryWorker::Row Row;
+
+    static const std::size_t PageSize = QueryWorker::BatchSize;
+
+    ResultPager(StatementCache& statements, QueryWorker& worker);
+    ~ResultPager();
+
+    ResultPager(const ResultPager&) = delete;
+    ResultPager& operator=(const ResultPager&) = delete;
+
+    bool openTable(const std::string& table);
+    // Starts the statement on the worker; errors show up in error() after update()
+    bool openQuery(const std::string& sql);
+    void close();
+    // Interrupts the statement the worker is running for this pager
+    void cancel();
+
+    // Applies results from the worker. Returns true when the first page of
+    // a query arrived or a statement without rows finished, i.e. when a view
+    // of the result should be reset.
+    bool update();
+
+    bool isOpen() const { return m_mode != Mode::Closed; }
+    bool isTable() const { return m_mode == Mode::Table; }
+    bool isRunning() const { return m_mode == Mode::Query && m_worker.isBusy(); }
+    bool isCancelled() const { return m_cancelled; }
+    const std::vector<std::string>& columns() const { return m_columns; }
+    // For queries: rows seen so far plus one page, until the end is reached
+    std::size_t rowCount() const;
+    bool isRowCountExact() const;
+
+    // nullptr past the end or while the page is loading. The pointer stays
+    // valid until MaxCachedPages other pages have been loaded.
+    const Row* row(std::size_t index);
+
+    const std::string& error() const { return m_error; }
+    int changes() const { return m_changes; }
+    // Progress of the statement on the worker
+    std::size_t rowsRead() const { return m_rowsRead; }
+    double milliseconds() const { return m_milliseconds; }
+    std::size_t residentRows() const;
+    std::size_t memoryBytes() const;
+    std::size_t pagesLoaded() const { return m_pagesLoaded; }
+
+private:
+    static const std::size_t MaxCachedPages = 16;
+
+    enum class Mode { Closed, Table, Query };
+
+    struct Page {
+        std::vector<Row> rows;
+        std::list<std::size_t>::iterator order;
+    };
+
+    StatementCache& m_statements;
+    QueryWorker& m_worker;
+    Mode m_mode = Mode::Closed;
+    std::vector<std::string> m_columns;
+    std::string m_error;
+    int m_changes = 0;
+
+    std::unordered_map<std::size_t, Page> m_pages;
+    std::list<std::size_t> m_pageOrder; // most recently used first
+    std::size_t m_pagesLoaded = 0;
+
+    // Table mode
+    std::string m_table; // quoted
+    std::int64_t m_minRowid = 0;
+    std::int64_t m_maxRowid = -1;
+    std::size_t m_endRow = static_cast<std::size_t>(-1); // where a page came up short
+
+    // Query mode
+    std::uint64_t m_queryId = 0;
+    std::unordered_set<std::size_t> m_requested; // pages asked for and not yet arrived
+    std::size_t m_seenRows = 0;
+    bool m_endReached = false;
+    bool m_firstPageArrived = false;
+    bool m_cancelled = false;
+    std::size_t m_rowsRead = 0;
+    double m_milliseconds = 0.0;
+
+    Page* page(std::size_t pageIndex);
+    Page* store(std::size_t pageIndex, std::vector<Row>&& rows);
+    void loadTablePage(std::size_t pageIndex, std::vector<Row>& rows);
+    void readColumns(sqlite3_stmt* statement, int firstColumn);
+};
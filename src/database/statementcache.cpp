@@ -0,0 +1,54 @@
+#include "statementcache.hpp"
+#include <sqlite3.h>
+
+StatementCache::StatementCache(sqlite3* db, std::size_t capacity)
+    : m_db(db),
+      m_capacity(capacity > 0 ? capacity : 1)
+{
+}
+
+StatementCache::~StatementCache() {
+    clear();
+}
+
+void StatementCache::clear() {
+    for (auto& entry : m_statements) {
+        sqlite3_finalize(entry.second.statement);
+    }
+    m_statements.clear();
+    m_order.clear();
+}
+
+sqlite3_stmt* StatementCache::acquire(const std::string& sql) {
+    auto it = m_statements.find(sql);
+    if (it != m_statements.end()) {
+        ++m_hits;
+        m_order.splice(m_order.begin(), m_order, it->second.order);
+        sqlite3_reset(it->second.statement);
+        sqlite3_clear_bindings(it->second.statement);
+        return it->second.statement;
+    }
+
+    ++m_misses;
+    sqlite3_stmt* statement = nullptr;
+    if (sqlite3_prepare_v3(m_db, sql.c_str(), static_cast<int>(sql.size()), SQLITE_PREPARE_PERSISTENT, &statement, nullptr) != SQLITE_OK) {
+        m_error = sqlite3_errmsg(m_db);
+        sqlite3_finalize(statement);
+        return nullptr;
+    }
+    if (!statement) {
+        m_error = "empty statement";
+        return nullptr;
+    }
+
+    if (m_statements.size() >= m_capacity) {
+        auto oldest = m_statements.find(m_order.back());
+        sqlite3_finalize(oldest->second.statement);
+        m_statements.erase(oldest);
+        m_order.pop_back();
+    }
+    m_order.push_front(sql);
+    m_statements.emplace(sql, Entry{statement, m_order.begin()});
+    m_error.clear();
+    return statement;
+}
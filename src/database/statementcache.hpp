@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// LRU cache of prepared statements for one connection, keyed by SQL text.
+//
+// Statements handed out are reset and have their bindings cleared; they
+// stay owned by the cache, so a caller must be done with one before asking
+// for the same SQL again or before it can be evicted (after `capacity`
+// other statements).
+class StatementCache {
+public:
+    explicit StatementCache(sqlite3* db, std::size_t capacity = 32);
+    ~StatementCache();
+
+    StatementCache(const StatementCache&) = delete;
+    StatementCache& operator=(const StatementCache&) = delete;
+
+    // nullptr on a syntax error; see error()
+    sqlite3_stmt* acquire(const std::string& sql);
+    void clear();
+
+    sqlite3* db() const { return m_db; }
+    const std::string& error() const { return m_error; }
+    std::size_t hits() const { return m_hits; }
+    std::size_t misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        sqlite3_stmt* statement;
+        std::list<std::string>::iterator order;
+    };
+
+    sqlite3* m_db;
+    std::size_t m_capacity;
+    std::list<std::string> m_order; // most recently used first
+    std::unordered_map<std::string, Entry> m_statements;
+    std::string m_error;
+    std::size_t m_hits = 0;
+    std::size_t m_misses = 0;
+};
@@ -1,7 +1,13 @@
 #include <SFML/Graphics.hpp>
 #include "mainwindow/mainwindow.hpp"
+#include "cli/commandline.hpp"
+
+int main(int argc, char** argv) {
+    // Any argument selects a headless command line mode instead of the GUI
+    if (argc > 1) {
+        return runCommandLine(argc, argv);
+    }
 
-int main() {
     sf::RenderWindow window(sf::VideoMode(1024, 768), "Multi-App Program");
     MainWindow mainWindow(window);
 
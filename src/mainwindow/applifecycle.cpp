@@ -0,0 +1,131 @@
+#include "applifecycle.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+#ifdef _WIN32
+// std::min/std::max are used below; keep the SDK's macros out of the way
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    double megabytes(std::size_t bytes) {
+        return bytes / (1024.0 * 1024.0);
+    }
+
+    std::size_t total(const AppMemory& memory) {
+        return memory.cpuBytes + memory.gpuBytes;
+    }
+}
+
+AppLifecycle::AppLifecycle(std::size_t budgetBytes)
+    : m_budget(budgetBytes)
+{
+}
+
+std::size_t AppLifecycle::defaultBudget() {
+    const char* value = std::getenv("APP_MEMORY_BUDGET_MB");
+    if (value && *value) {
+        char* end = nullptr;
+        long long megabytes = std::strtoll(value, &end, 10);
+        if (end != value && megabytes >= 0) return static_cast<std::size_t>(megabytes) * 1024 * 1024;
+        std::cerr << "Ignoring APP_MEMORY_BUDGET_MB=" << value << std::endl;
+    }
+    return DefaultBudgetMegabytes * 1024 * 1024;
+}
+
+void AppLifecycle::add(App& app) {
+    Entry entry;
+    entry.app = &app;
+    m_entries.push_back(entry);
+}
+
+void AppLifecycle::activate(App* app) {
+    m_active = app;
+    for (Entry& entry : m_entries) {
+        if (entry.app != app) continue;
+        entry.lastActive = ++m_clock;
+        if (entry.suspended) {
+            Clock::time_point start = Clock::now();
+            entry.app->onResume();
+            entry.suspended = false;
+            std::cout << "Resumed " << entry.app->name() << " in "
+                      << std::chrono::duration<double, std::milli>(Clock::now() - start).count() << " ms" << std::endl;
+        }
+    }
+    enforceBudget();
+}
+
+void AppLifecycle::enforceBudget() {
+    std::vector<std::size_t> sizes(m_entries.size());
+    std::size_t used = 0;
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        sizes[i] = total(m_entries[i].app->memoryUsage());
+        used += sizes[i];
+    }
+    if (used <= m_budget && m_budget > 0) return;
+
+    // Least recently active first
+    std::vector<std::size_t> order;
+    for (std::size_t i = 0; i < m_entries.size(); ++i) {
+        if (m_entries[i].app != m_active && !m_entries[i].suspended) order.push_back(i);
+    }
+    std::sort(order.begin(), order.end(), [this](std::size_t a, std::size_t b) {
+        return m_entries[a].lastActive < m_entries[b].lastActive;
+    });
+
+    for (std::size_t i : order) {
+        if (m_budget > 0 && used <= m_budget) break;
+        Entry& entry = m_entries[i];
+        Clock::time_point start = Clock::now();
+        entry.app->onSuspend();
+        entry.suspended = true;
+        std::size_t after = total(entry.app->memoryUsage());
+        used -= sizes[i] - std::min(sizes[i], after);
+        char text[160];
+        std::snprintf(text, sizeof(text), "Suspended %s: %.1f MB -> %.1f MB in %.2f ms", entry.app->name(),
+                      megabytes(sizes[i]), megabytes(after),
+                      std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+        std::cout << text << std::endl;
+    }
+}
+
+std::string AppLifecycle::report() const {
+    std::string line;
+    char text[128];
+    std::size_t used = 0;
+    for (const Entry& entry : m_entries) {
+        AppMemory memory = entry.app->memoryUsage();
+        used += total(memory);
+        std::snprintf(text, sizeof(text), "%s%s %.1f+%.1f%s", line.empty() ? "" : " | ", entry.app->name(),
+                      megabytes(memory.cpuBytes), megabytes(memory.gpuBytes), entry.suspended ? " (suspended)" : "");
+        line += text;
+    }
+    std::snprintf(text, sizeof(text), " | apps %.1f of %.0f MB, RSS %.1f MB", megabytes(used), megabytes(m_budget), megabytes(residentBytes()));
+    return line + text;
+}
+
+std::size_t AppLifecycle::residentBytes() {
+#ifdef _WIN32
+    PROCESS_MEMORY_COUNTERS counters;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) return 0;
+    return counters.WorkingSetSize;
+#else
+    // The second field of statm is the resident page count; Linux only
+    std::ifstream statm("/proc/self/statm");
+    std::size_t size = 0;
+    std::size_t resident = 0;
+    if (!(statm >> size >> resident)) return 0;
+    return resident * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "../ui/app.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Decides which inactive apps keep their caches.
+//
+// The active app is never suspended. Inactive ones keep everything while
+// the apps together stay under the memory budget, so going back and forth
+// between two apps costs nothing; past the budget, the least recently
+// active apps are suspended first. A budget of 0 suspends an app as soon
+// as the user leaves it.
+class AppLifecycle {
+public:
+    explicit AppLifecycle(std::size_t budgetBytes);
+
+    void add(App& app);
+    // Resumes `app` if it was suspended and makes it the active one; null
+    // for the home screen. Then enforces the budget.
+    void activate(App* app);
+    // Only the active app grows much, so activate() is where this is needed
+    void enforceBudget();
+
+    std::size_t budget() const { return m_budget; }
+    // Per app estimates, suspended apps marked, and the process's resident size
+    std::string report() const;
+    // Resident set size of the process, 0 where it cannot be read
+    static std::size_t residentBytes();
+
+    // $APP_MEMORY_BUDGET_MB, else DefaultBudgetMegabytes
+    static std::size_t defaultBudget();
+    static const std::size_t DefaultBudgetMegabytes = 256;
+
+private:
+    struct Entry {
+        App* app = nullptr;
+        bool suspended = false;
+        std::uint64_t lastActive = 0;
+    };
+
+    std::size_t m_budget;
+    std::vector<Entry> m_entries;
+    App* m_active = nullptr;
+    std::uint64_t m_clock = 0;
+};
@@ -10,26 +10,43 @@
 #include <sstream>
 #include <iostream>
 
+namespace {
+    // Main thread time per frame for results coming back from the task scheduler
+    const std::chrono::microseconds MainThreadTaskBudget(4000);
+}
+
 MainWindow::MainWindow(sf::RenderWindow& window)
     : m_window(window),
+      m_home(m_font),
+      m_lifecycle(AppLifecycle::defaultBudget()),
       m_activeApp(ActiveApp::None),
       m_isPasswordProtected(false),
-      m_isPasswordEntered(false)
+      m_isPasswordEntered(false),
+      m_passwordInput(m_font, 24)
 {
     if (!m_font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
         // Handle font loading error
         std::cerr << "Failed to load font" << std::endl;
     }
 
-    m_timeText.setFont(m_font);
-    m_timeText.setCharacterSize(24);
-    m_timeText.setFillColor(sf::Color::Black);
-    m_timeText.setPosition(800, 10);
+    m_diagnosticsText.setFont(m_font);
+    m_diagnosticsText.setCharacterSize(16);
+    m_diagnosticsText.setFillColor(sf::Color(90, 90, 90));
+    m_diagnosticsText.setPosition(10, m_window.getSize().y - 30.f);
+    m_diagnosticsText.setString(m_powerGovernor.describe());
+    m_schedulerText = m_diagnosticsText;
+    m_memoryText = m_diagnosticsText;
+    m_diagnosticsText.setPosition(10, m_window.getSize().y - 52.f);
+    m_schedulerText.setString(TaskScheduler::instance().describe());
+    m_memoryText.setPosition(10, m_window.getSize().y - 74.f);
 
-    m_weatherText.setFont(m_font);
-    m_weatherText.setCharacterSize(24);
-    m_weatherText.setFillColor(sf::Color::Black);
-    m_weatherText.setPosition(800, 50);
+    m_passwordPrompt.setFont(m_font);
+    m_passwordPrompt.setCharacterSize(24);
+    m_passwordPrompt.setFillColor(sf::Color::Black);
+    m_passwordPrompt.setString("Enter password:");
+    m_passwordPrompt.setPosition(m_window.getSize().x / 2.f - 150, m_window.getSize().y / 2.f - 60);
+    m_passwordInput.setMasked(true);
+    m_passwordInput.setArea(sf::FloatRect(m_window.getSize().x / 2.f - 150, m_window.getSize().y / 2.f - 20, 300, 40));
 
     m_map = std::make_unique<Map>(window);
     m_chatbot = std::make_unique<Chatbot>(window);
@@ -39,23 +56,38 @@ MainWindow::MainWindow(sf::RenderWindow& window)
 
     m_settings->onTimeChanged = [this](const sf::Time& newTime) { onTimeChanged(newTime); };
     m_settings->onDateChanged = [this](const sf::Time& newDate) { onDateChanged(newDate); };
+    m_settings->onLowPowerModeChanged = [this](bool isLowPower) { onLowPowerModeChanged(isLowPower); };
+    applyPowerProfile();
 
-    initializeAppButtons(); // Add this line to initialize app buttons
+    m_lifecycle.add(*m_map);
+    m_lifecycle.add(*m_chatbot);
+    m_lifecycle.add(*m_database);
+    m_lifecycle.add(*m_camera);
+    m_lifecycle.add(*m_settings);
+    m_memoryText.setString(m_lifecycle.report());
+
+    initializeHomeScreen();
 }
 
 void MainWindow::handleEvent(const sf::Event& event) {
+    // Widget layouts follow the window even while their screen is hidden
+    if (event.type == sf::Event::Resized) {
+        m_home.setSize(sf::Vector2f(static_cast<float>(event.size.width), static_cast<float>(event.size.height)));
+        m_settings->setSize(sf::Vector2f(static_cast<float>(event.size.width), static_cast<float>(event.size.height)));
+    }
+
     if (m_isPasswordProtected && !m_isPasswordEntered) {
         handlePasswordInput(event);
         return;
     }
 
+    if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3) {
+        m_showDiagnostics = !m_showDiagnostics;
+        return;
+    }
+
     if (m_activeApp == ActiveApp::None) {
-        if (event.type == sf::Event::MouseButtonPressed) {
-            if (event.mouseButton.button == sf::Mouse::Left) {
-                sf::Vector2f mousePos = m_window.mapPixelToCoords(sf::Mouse::getPosition(m_window));
-                handleAppButtonClick(mousePos);
-            }
-        }
+        m_home.handleEvent(event);
     } else {
         switch (m_activeApp) {
             case ActiveApp::Map:
@@ -87,16 +119,17 @@ void MainWindow::handleEvent(const sf::Event& event) {
 }
 
 void MainWindow::draw(sf::RenderWindow& window) {
+    // Apply what background tasks finished, before anything is drawn from it
+    TaskScheduler::instance().runMainThreadTasks(MainThreadTaskBudget);
+
     m_window.clear(sf::Color::White);
 
     if (m_isPasswordProtected && !m_isPasswordEntered) {
         m_window.draw(m_passwordPrompt);
-        m_window.draw(m_passwordInput);
+        m_passwordInput.draw(m_window);
     } else if (m_activeApp == ActiveApp::None) {
         updateTimeAndWeather();
-        m_window.draw(m_timeText);
-        m_window.draw(m_weatherText);
-        drawAppButtons(); // Ensure this method is called to draw app buttons
+        m_home.draw(m_window);
     } else {
         switch (m_activeApp) {
             case ActiveApp::Map:
@@ -118,6 +151,34 @@ void MainWindow::draw(sf::RenderWindow& window) {
                 break;
         }
     }
+
+    if (m_powerGovernor.frame()) {
+        m_diagnosticsText.setString(m_powerGovernor.describe());
+        m_schedulerText.setString(TaskScheduler::instance().describe());
+        // Walks every app's caches, so only while it is on screen
+        if (m_activeApp == ActiveApp::None || m_showDiagnostics) {
+            m_memoryText.setString(m_lifecycle.report());
+        }
+    }
+    if (m_activeApp == ActiveApp::None || m_showDiagnostics) {
+        drawDiagnostics();
+    }
+}
+
+void MainWindow::drawDiagnostics() {
+    m_window.setView(m_window.getDefaultView());
+    m_window.draw(m_diagnosticsText);
+    m_window.draw(m_schedulerText);
+    m_window.draw(m_memoryText);
+}
+
+void MainWindow::applyPowerProfile() {
+    const PowerProfile& profile = m_powerGovernor.profile();
+    m_window.setFramerateLimit(profile.frameRateLimit);
+    TaskScheduler::instance().setActiveWorkers(profile.schedulerWorkers);
+    m_map->applyPowerProfile(profile);
+    m_camera->applyPowerProfile(profile);
+    m_weather.setMinimumInterval(profile.weatherInterval);
 }
 
 void MainWindow::updateTimeAndWeather() {
@@ -125,48 +186,48 @@ void MainWindow::updateTimeAndWeather() {
     auto time = std::chrono::system_clock::to_time_t(now);
     std::stringstream ss;
     ss << std::put_time(std::localtime(&time), "%H:%M:%S");
-    m_timeText.setString(ss.str());
-
-    m_weatherText.setString(m_weather.getCurrentWeather());
-}
+    m_home.setText(m_timeLabel, ss.str());
 
-void MainWindow::drawAppButtons() {
-    for (const auto& button : m_appButtons) {
-        m_window.draw(button);
-    }
-    for (const auto& text : m_appButtonTexts) {
-        m_window.draw(text);
+    // The weather is fetched in the background; only a new snapshot changes the text
+    std::shared_ptr<const Weather::Snapshot> weather = m_weather.snapshot();
+    if (weather->version != m_weatherVersion) {
+        m_home.setText(m_weatherLabel, weather->text);
+        m_weatherVersion = weather->version;
     }
 }
 
-void MainWindow::initializeAppButtons() {
+void MainWindow::initializeHomeScreen() {
+    m_home.setSize(sf::Vector2f(static_cast<float>(m_window.getSize().x), static_cast<float>(m_window.getSize().y)));
+
+    // Clock and weather along the right edge, app buttons down the left
+    WidgetLayer::TextStyle status;
+    status.padding = 0.f;
+    m_timeLabel = m_home.addLabel(WidgetLayer::Root, WidgetLayer::Layout::anchored(1.f, 0.f, -224.f, 10.f, 214.f, 24.f), "", status);
+    m_weatherLabel = m_home.addLabel(WidgetLayer::Root, WidgetLayer::Layout::anchored(1.f, 0.f, -224.f, 50.f, 214.f, 24.f), "", status);
+    std::shared_ptr<const Weather::Snapshot> weather = m_weather.snapshot();
+    m_home.setText(m_weatherLabel, weather->text);
+    m_weatherVersion = weather->version;
+
+    WidgetLayer::Style button;
+    button.fill = sf::Color::White;
+    button.outline = sf::Color::Black;
+    button.outlineThickness = 2.f;
+    WidgetLayer::TextStyle label;
+    label.characterSize = 20;
+
     std::vector<std::string> appNames = {"Map", "Chatbot", "Database", "Camera", "Settings"};
     for (size_t i = 0; i < appNames.size(); ++i) {
-        sf::RectangleShape button(sf::Vector2f(150, 50));
-        button.setPosition(10, 100 + i * 60);
-        button.setFillColor(sf::Color::White);
-        button.setOutlineThickness(2);
-        button.setOutlineColor(sf::Color::Black);
-        m_appButtons.push_back(button);
-
-        sf::Text text(appNames[i], m_font, 20);
-        text.setPosition(15, 110 + i * 60);
-        text.setFillColor(sf::Color::Black);
-        m_appButtonTexts.push_back(text);
-    }
-}
-
-void MainWindow::handleAppButtonClick(sf::Vector2f mousePos) {
-    for (size_t i = 0; i < m_appButtons.size(); ++i) {
-        if (m_appButtons[i].getGlobalBounds().contains(mousePos)) {
-            switchToApp(static_cast<ActiveApp>(i + 1));
-            return;  // Add this line to exit the function after switching
-        }
+        ActiveApp app = static_cast<ActiveApp>(i + 1);
+        m_home.addButton(WidgetLayer::Root, WidgetLayer::Layout::anchored(0.f, 0.13f, 10.f, i * 60.f, 150.f, 50.f),
+                         button, appNames[i], label, [this, app] { switchToApp(app); });
     }
 }
 
 void MainWindow::switchToApp(ActiveApp app) {
     m_activeApp = app;
+    m_lifecycle.activate(appFor(app));
+    m_memoryText.setString(m_lifecycle.report());
+    std::cout << "Memory: " << m_memoryText.getString().toAnsiString() << std::endl;
 
     // Reset the m_shouldExit flag for each app
     m_map->resetShouldExit();
@@ -176,28 +237,31 @@ void MainWindow::switchToApp(ActiveApp app) {
     m_settings->resetShouldExit();
 }
 
+App* MainWindow::appFor(ActiveApp app) const {
+    switch (app) {
+        case ActiveApp::Map: return m_map.get();
+        case ActiveApp::Chatbot: return m_chatbot.get();
+        case ActiveApp::Database: return m_database.get();
+        case ActiveApp::Camera: return m_camera.get();
+        case ActiveApp::Settings: return m_settings.get();
+        default: return nullptr;
+    }
+}
+
 void MainWindow::promptPassword() {
     m_isPasswordEntered = false;
-    m_passwordInput.setString("");
+    m_passwordInput.clear();
 }
 
 void MainWindow::handlePasswordInput(const sf::Event& event) {
-    if (event.type == sf::Event::TextEntered) {
-        if (event.text.unicode == 13) { // Enter key
-            if (checkPassword(m_passwordInput.getString())) {
-                m_isPasswordEntered = true;
-            } else {
-                m_passwordInput.setString("");
-            }
-        } else if (event.text.unicode == 8) { // Backspace key
-            std::string str = m_passwordInput.getString();
-            if (!str.empty()) {
-                str.pop_back();
-                m_passwordInput.setString(str);
-            }
+    if (event.type == sf::Event::TextEntered && event.text.unicode == 13) { // Enter key
+        if (checkPassword(m_passwordInput.toUtf8())) {
+            m_isPasswordEntered = true;
         } else {
-            m_passwordInput.setString(m_passwordInput.getString() + static_cast<char>(event.text.unicode));
+            m_passwordInput.clear();
         }
+    } else {
+        m_passwordInput.handleEvent(event);
     }
 }
 
@@ -218,7 +282,9 @@ void MainWindow::onMetricSystemChanged(bool isMetric) {
 }
 
 void MainWindow::onLowPowerModeChanged(bool isLowPower) {
-    // Handle low power mode change
+    m_powerGovernor.setMode(isLowPower ? PowerGovernor::Mode::LowPower : PowerGovernor::Mode::Normal);
+    m_diagnosticsText.setString(m_powerGovernor.describe());
+    applyPowerProfile();
 }
 
 void MainWindow::onPasswordChanged(const std::string& newPassword) {
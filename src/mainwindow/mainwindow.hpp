@@ -6,7 +6,13 @@
 #include "../database/database.hpp"
 #include "../camera/camera.hpp"
 #include "../settings/settings.hpp"
+#include "../ui/textinput.hpp"
+#include "../ui/widgetlayer.hpp"
+#include "applifecycle.hpp"
+#include "../utils/powergovernor.hpp"
+#include "../utils/taskscheduler.hpp"
 #include "../utils/weather.hpp"
+#include <cstdint>
 #include <memory>
 #include <string>
 
@@ -19,8 +25,10 @@ public:
 private:
     sf::RenderWindow& m_window;
     sf::Font m_font;
-    sf::Text m_timeText;
-    sf::Text m_weatherText;
+    // Clock, weather and app buttons
+    WidgetLayer m_home;
+    WidgetLayer::Id m_timeLabel = WidgetLayer::None;
+    WidgetLayer::Id m_weatherLabel = WidgetLayer::None;
 
     std::unique_ptr<Map> m_map;
     std::unique_ptr<Chatbot> m_chatbot;
@@ -28,6 +36,18 @@ private:
     std::unique_ptr<Camera> m_camera;
     std::unique_ptr<Settings> m_settings;
     Weather m_weather;
+    std::uint64_t m_weatherVersion = 0; // of the snapshot m_weatherLabel shows
+
+    // Frame rate and CPU use of the current power mode, always on the home
+    // screen and over the apps after F3, with task scheduler queues below
+    PowerGovernor m_powerGovernor;
+    sf::Text m_diagnosticsText;
+    sf::Text m_schedulerText;
+    sf::Text m_memoryText;
+    bool m_showDiagnostics = false;
+
+    // Suspends inactive apps once together they hold more than the budget
+    AppLifecycle m_lifecycle;
 
     enum class ActiveApp {
         None,
@@ -40,20 +60,18 @@ private:
 
     ActiveApp m_activeApp;
 
-    std::vector<sf::RectangleShape> m_appButtons;
-    std::vector<sf::Text> m_appButtonTexts;
-
     bool m_isPasswordProtected;
     std::string m_password;
     bool m_isPasswordEntered;
     sf::Text m_passwordPrompt;
-    sf::Text m_passwordInput;
+    TextInput m_passwordInput;
 
     void updateTimeAndWeather();
-    void drawAppButtons();
-    void initializeAppButtons();
-    void handleAppButtonClick(sf::Vector2f mousePos);
+    void applyPowerProfile();
+    void drawDiagnostics();
+    void initializeHomeScreen();
     void switchToApp(ActiveApp app);
+    App* appFor(ActiveApp app) const;
 
     void promptPassword();
     void handlePasswordInput(const sf::Event& event);
@@ -0,0 +1,632 @@
+#include "geometrystore.hpp"
+#include "../utils/allocationtracker.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <memory>
+
+namespace {
+    // A feature spanning more grid cells than this is kept in a separate list
+    const int MaxCellsPerFeature = 64;
+    const int MaxGridSize = 1024;
+
+    // Spreads the layer and fid bits over the whole word before masking
+    std::uint64_t mix(std::uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    // Store lon/lat in x/y order regardless of the CRS axis definition
+    void initWgs84(OGRSpatialReference& wgs84) {
+        wgs84.SetWellKnownGeogCS("WGS84");
+        wgs84.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    }
+}
+
+void GeometryStore::Bounds::expand(const Coordinate& c) {
+    if (!valid) {
+        minLon = maxLon = c.lon;
+        minLat = maxLat = c.lat;
+        valid = true;
+        return;
+    }
+    minLon = std::min(minLon, c.lon);
+    minLat = std::min(minLat, c.lat);
+    maxLon = std::max(maxLon, c.lon);
+    maxLat = std::max(maxLat, c.lat);
+}
+
+void GeometryStore::Bounds::expand(const Bounds& other) {
+    if (!other.valid) return;
+    expand(Coordinate{other.minLon, other.minLat});
+    expand(Coordinate{other.maxLon, other.maxLat});
+}
+
+bool GeometryStore::Bounds::intersects(const Bounds& other) const {
+    return valid && other.valid &&
+           minLon <= other.maxLon && maxLon >= other.minLon &&
+           minLat <= other.maxLat && maxLat >= other.minLat;
+}
+
+void GeometryStore::FeatureIndex::clear() {
+    m_slots.clear();
+    m_size = 0;
+}
+
+void GeometryStore::FeatureIndex::reserve(std::size_t count) {
+    std::size_t slotCount = 16;
+    while (slotCount < count * 2) slotCount *= 2;
+    if (slotCount > m_slots.size()) rehash(slotCount);
+}
+
+std::size_t GeometryStore::FeatureIndex::home(std::uint64_t key) const {
+    return static_cast<std::size_t>(mix(key)) & (m_slots.size() - 1);
+}
+
+void GeometryStore::FeatureIndex::rehash(std::size_t slotCount) {
+    std::vector<Slot> old(slotCount, Slot{0, 0, false});
+    old.swap(m_slots);
+    m_size = 0;
+    for (const Slot& slot : old) {
+        if (slot.used) set(slot.key, slot.value);
+    }
+}
+
+void GeometryStore::FeatureIndex::set(std::uint64_t key, std::uint32_t value) {
+    if ((m_size + 1) * 2 > m_slots.size()) rehash(std::max<std::size_t>(16, m_slots.size() * 2));
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = home(key);; i = (i + 1) & mask) {
+        Slot& slot = m_slots[i];
+        if (!slot.used) {
+            slot = Slot{key, value, true};
+            ++m_size;
+            return;
+        }
+        if (slot.key == key) {
+            slot.value = value;
+            return;
+        }
+    }
+}
+
+bool GeometryStore::FeatureIndex::find(std::uint64_t key, std::uint32_t& value) const {
+    if (m_slots.empty()) return false;
+    const std::size_t mask = m_slots.size() - 1;
+    for (std::size_t i = home(key); m_slots[i].used; i = (i + 1) & mask) {
+        if (m_slots[i].key == key) {
+            value = m_slots[i].value;
+            return true;
+        }
+    }
+    return false;
+}
+
+void GeometryStore::FeatureIndex::erase(std::uint64_t key) {
+    if (m_slots.empty()) return;
+    const std::size_t mask = m_slots.size() - 1;
+    std::size_t hole = home(key);
+    while (m_slots[hole].used && m_slots[hole].key != key) hole = (hole + 1) & mask;
+    if (!m_slots[hole].used) return;
+
+    // Shift later entries of the probe run back so lookups never stop early
+    for (std::size_t i = (hole + 1) & mask; m_slots[i].used; i = (i + 1) & mask) {
+        std::size_t wanted = home(m_slots[i].key);
+        bool movable = hole <= i ? (wanted <= hole || wanted > i) : (wanted <= hole && wanted > i);
+        if (movable) {
+            m_slots[hole] = m_slots[i];
+            hole = i;
+        }
+    }
+    m_slots[hole].used = false;
+    --m_size;
+}
+
+void GeometryStore::clear() {
+    m_features.clear();
+    m_parts.clear();
+    m_vertices.clear();
+    m_bounds = Bounds();
+    m_names.clear();
+    m_featureIndex.clear();
+    m_deadVertices = 0;
+    m_deadParts = 0;
+    m_gridBounds = Bounds();
+    m_cellStart.clear();
+    m_cellCount.clear();
+    m_cellItems.clear();
+    m_cellOverflow.clear();
+    m_largeFeatures.clear();
+    m_gridColumns = 0;
+    m_gridRows = 0;
+}
+
+std::size_t GeometryStore::memoryBytes() const {
+    std::size_t bytes = m_features.capacity() * sizeof(Feature) + m_parts.capacity() * sizeof(Part) +
+                        m_vertices.capacity() * sizeof(Coordinate) + m_largeFeatures.capacity() * sizeof(std::uint32_t) +
+                        (m_cellStart.capacity() + m_cellCount.capacity() + m_cellItems.capacity()) * sizeof(std::uint32_t) +
+                        (m_scratchX.capacity() + m_scratchY.capacity()) * sizeof(double) +
+                        m_names.memoryBytes() + m_featureIndex.memoryBytes();
+    for (const auto& cell : m_cellOverflow) {
+        bytes += cell.second.capacity() * sizeof(std::uint32_t) + sizeof(cell) + 2 * sizeof(void*);
+    }
+    return bytes;
+}
+
+bool GeometryStore::load(GDALDataset* dataset, const CancellationToken* token) {
+    clear();
+    if (!dataset) return false;
+
+    AllocationTracker::Scope scope("map.ingest");
+    OGRSpatialReference wgs84;
+    initWgs84(wgs84);
+
+    // Sized up front where the driver knows the count cheaply
+    GIntBig expected = 0;
+    for (int i = 0; i < dataset->GetLayerCount(); ++i) {
+        OGRLayer* layer = dataset->GetLayer(i);
+        GIntBig count = layer ? layer->GetFeatureCount(FALSE) : -1;
+        if (count > 0) expected += count;
+    }
+    m_features.reserve(static_cast<std::size_t>(expected));
+
+    for (int i = 0; i < dataset->GetLayerCount(); ++i) {
+        OGRLayer* layer = dataset->GetLayer(i);
+        if (!layer) continue;
+
+        OGRCoordinateTransformation* coordTransform = nullptr;
+        if (OGRSpatialReference* layerSRS = layer->GetSpatialRef()) {
+            coordTransform = OGRCreateCoordinateTransformation(layerSRS, &wgs84);
+        }
+
+        OGRFeatureDefn* definition = layer->GetLayerDefn();
+        int nameField = definition->GetFieldIndex("name");
+
+        // GDAL builds a new feature for every row, so at least spare it the
+        // attributes nobody reads; the dataset is shared, so this is undone below
+        std::vector<const char*> ignored;
+        for (int f = 0; f < definition->GetFieldCount(); ++f) {
+            if (f != nameField) ignored.push_back(definition->GetFieldDefn(f)->GetNameRef());
+        }
+        ignored.push_back("OGR_STYLE");
+        ignored.push_back(nullptr);
+        layer->SetIgnoredFields(ignored.data());
+
+        layer->ResetReading();
+        OGRFeature* ogrFeature;
+        bool cancelled = false;
+        while ((ogrFeature = layer->GetNextFeature()) != nullptr) {
+            readFeature(ogrFeature, static_cast<std::uint32_t>(i), nameField, coordTransform);
+            OGRFeature::DestroyFeature(ogrFeature);
+            if (token && token->isCancelled()) {
+                cancelled = true;
+                break;
+            }
+        }
+        layer->SetIgnoredFields(nullptr);
+
+        if (coordTransform) {
+            OCTDestroyCoordinateTransformation(coordTransform);
+        }
+        if (cancelled) {
+            clear();
+            return false;
+        }
+    }
+
+    AllocationTracker::Scope indexScope("map.index");
+    m_featureIndex.reserve(m_features.size());
+    for (std::uint32_t i = 0; i < m_features.size(); ++i) {
+        m_featureIndex.set(featureKey(m_features[i].layer, m_features[i].fid), i);
+    }
+
+    buildIndex();
+    return !m_features.empty();
+}
+
+bool GeometryStore::readFeature(OGRFeature* ogrFeature, std::uint32_t layer, int nameField, OGRCoordinateTransformation* coordTransform) {
+    OGRGeometry* geom = ogrFeature->GetGeometryRef();
+    if (!geom) return false;
+
+    Feature feature;
+    feature.fid = ogrFeature->GetFID();
+    feature.layer = layer;
+    feature.firstPart = static_cast<std::uint32_t>(m_parts.size());
+    feature.partCount = 0;
+    if (nameField >= 0 && ogrFeature->IsFieldSetAndNotNull(nameField)) {
+        feature.name = m_names.store(ogrFeature->GetFieldAsString(nameField));
+    }
+
+    appendGeometry(geom, coordTransform, feature);
+    if (feature.partCount == 0) return false;
+
+    m_bounds.expand(feature.bounds);
+    m_features.push_back(std::move(feature));
+    return true;
+}
+
+GeometryStore::Patch GeometryStore::readChanges(GDALDataset* dataset, const std::vector<FeatureChange>& changes) {
+    Patch patch;
+    patch.changes = changes;
+    if (!dataset) return patch;
+
+    AllocationTracker::Scope scope("map.patch");
+    OGRSpatialReference wgs84;
+    initWgs84(wgs84);
+
+    struct LayerContext {
+        OGRLayer* layer = nullptr;
+        OGRCoordinateTransformation* coordTransform = nullptr;
+        int nameField = -1;
+    };
+    std::unordered_map<std::uint32_t, LayerContext> layers;
+
+    for (const FeatureChange& change : changes) {
+        if (change.removed) continue;
+
+        auto context = layers.find(change.layer);
+        if (context == layers.end()) {
+            LayerContext created;
+            created.layer = dataset->GetLayer(static_cast<int>(change.layer));
+            if (created.layer) {
+                if (OGRSpatialReference* layerSRS = created.layer->GetSpatialRef()) {
+                    created.coordTransform = OGRCreateCoordinateTransformation(layerSRS, &wgs84);
+                }
+                created.nameField = created.layer->GetLayerDefn()->GetFieldIndex("name");
+            }
+            context = layers.emplace(change.layer, created).first;
+        }
+        if (!context->second.layer) continue;
+
+        OGRFeature* ogrFeature = context->second.layer->GetFeature(change.fid);
+        if (!ogrFeature) continue;
+        patch.features.readFeature(ogrFeature, change.layer, context->second.nameField, context->second.coordTransform);
+        OGRFeature::DestroyFeature(ogrFeature);
+    }
+
+    for (auto& entry : layers) {
+        if (entry.second.coordTransform) {
+            OCTDestroyCoordinateTransformation(entry.second.coordTransform);
+        }
+    }
+    return patch;
+}
+
+GeometryStore::PatchResult GeometryStore::applyPatch(const Patch& patch) {
+    AllocationTracker::Scope scope("map.patch");
+    PatchResult result;
+
+    // Both modified and removed features lose their old geometry
+    for (const FeatureChange& change : patch.changes) {
+        std::uint32_t existing;
+        if (!m_featureIndex.find(featureKey(change.layer, change.fid), existing)) continue;
+        const Feature& feature = m_features[existing];
+        for (std::uint32_t p = feature.firstPart; p < feature.firstPart + feature.partCount; ++p) {
+            result.removedParts.push_back(p);
+        }
+        removeFeature(existing);
+    }
+
+    result.firstNewPart = static_cast<std::uint32_t>(m_parts.size());
+    const std::uint32_t firstNewFeature = static_cast<std::uint32_t>(m_features.size());
+    const std::vector<Part>& parts = patch.features.parts();
+    const std::vector<Coordinate>& vertices = patch.features.vertices();
+    for (const Feature& added : patch.features.features()) {
+        Feature feature = added;
+        feature.firstPart = static_cast<std::uint32_t>(m_parts.size());
+        feature.name = m_names.store(added.name);
+        for (std::uint32_t p = added.firstPart; p < added.firstPart + added.partCount; ++p) {
+            Part part = parts[p];
+            std::uint32_t firstVertex = static_cast<std::uint32_t>(m_vertices.size());
+            m_vertices.insert(m_vertices.end(), vertices.begin() + part.firstVertex, vertices.begin() + part.firstVertex + part.vertexCount);
+            part.firstVertex = firstVertex;
+            m_parts.push_back(part);
+        }
+        m_bounds.expand(feature.bounds);
+        m_featureIndex.set(featureKey(feature.layer, feature.fid), static_cast<std::uint32_t>(m_features.size()));
+        m_features.push_back(feature);
+    }
+
+    if (m_cellStart.empty()) {
+        // Nothing was indexed yet
+        buildIndex();
+        result.renumbered = true;
+    } else {
+        for (std::uint32_t i = firstNewFeature; i < m_features.size(); ++i) {
+            indexFeature(i);
+        }
+    }
+
+    // Removed geometry is left in place until it makes up half of the arrays
+    if (m_deadVertices > m_vertices.size() / 2 || m_deadParts > m_parts.size() / 2) {
+        compact();
+        result.renumbered = true;
+    }
+    return result;
+}
+
+const GeometryStore::Feature* GeometryStore::findFeature(std::uint32_t layer, std::int64_t fid) const {
+    std::uint32_t index;
+    return m_featureIndex.find(featureKey(layer, fid), index) ? &m_features[index] : nullptr;
+}
+
+void GeometryStore::removeFeature(std::uint32_t index) {
+    Feature& feature = m_features[index];
+    for (std::uint32_t p = feature.firstPart; p < feature.firstPart + feature.partCount; ++p) {
+        m_deadVertices += m_parts[p].vertexCount;
+    }
+    m_deadParts += feature.partCount;
+
+    unindexFeature(index);
+    m_featureIndex.erase(featureKey(feature.layer, feature.fid));
+
+    // Swap with the last feature so indices stay dense
+    std::uint32_t last = static_cast<std::uint32_t>(m_features.size() - 1);
+    if (index != last) {
+        unindexFeature(last);
+        m_features[index] = std::move(m_features[last]);
+        m_featureIndex.set(featureKey(m_features[index].layer, m_features[index].fid), index);
+        m_features.pop_back();
+        indexFeature(index);
+    } else {
+        m_features.pop_back();
+    }
+}
+
+void GeometryStore::compact() {
+    std::vector<Part> parts;
+    std::vector<Coordinate> vertices;
+    parts.reserve(m_parts.size() - m_deadParts);
+    vertices.reserve(m_vertices.size() - m_deadVertices);
+
+    for (Feature& feature : m_features) {
+        std::uint32_t firstPart = static_cast<std::uint32_t>(parts.size());
+        for (std::uint32_t p = feature.firstPart; p < feature.firstPart + feature.partCount; ++p) {
+            Part part = m_parts[p];
+            std::uint32_t firstVertex = static_cast<std::uint32_t>(vertices.size());
+            vertices.insert(vertices.end(), m_vertices.begin() + part.firstVertex, m_vertices.begin() + part.firstVertex + part.vertexCount);
+            part.firstVertex = firstVertex;
+            parts.push_back(part);
+        }
+        feature.firstPart = firstPart;
+    }
+
+    m_parts.swap(parts);
+    m_vertices.swap(vertices);
+
+    // Names of removed features go with them
+    StringArena names;
+    for (Feature& feature : m_features) {
+        feature.name = names.store(feature.name);
+    }
+    m_names = std::move(names);
+    m_deadParts = 0;
+    m_deadVertices = 0;
+}
+
+void GeometryStore::appendGeometry(const OGRGeometry* geom, OGRCoordinateTransformation* coordTransform, Feature& feature) {
+    OGRwkbGeometryType type = wkbFlatten(geom->getGeometryType());
+
+    if (type == wkbPoint) {
+        const OGRPoint* point = static_cast<const OGRPoint*>(geom);
+        Coordinate c{point->getX(), point->getY()};
+        if (coordTransform) coordTransform->Transform(1, &c.lon, &c.lat);
+        m_parts.push_back(Part{static_cast<std::uint32_t>(m_vertices.size()), 1, PartType::Point});
+        m_vertices.push_back(c);
+        feature.bounds.expand(c);
+        ++feature.partCount;
+    } else if (type == wkbLineString || type == wkbLinearRing) {
+        appendCurve(static_cast<const OGRSimpleCurve*>(geom), PartType::Line, coordTransform, feature);
+    } else if (type == wkbCircularString) {
+        // Stroke arcs into line segments
+        std::unique_ptr<OGRGeometry> linear(geom->getLinearGeometry());
+        if (linear) {
+            appendCurve(static_cast<const OGRSimpleCurve*>(linear.get()), PartType::Line, coordTransform, feature);
+        }
+    } else if (type == wkbPolygon || type == wkbCurvePolygon) {
+        OGRCurvePolygon* poly = const_cast<OGRCurvePolygon*>(static_cast<const OGRCurvePolygon*>(geom));
+        std::size_t firstNewPart = m_parts.size();
+        if (OGRCurve* exterior = poly->getExteriorRingCurve()) {
+            appendGeometry(exterior, coordTransform, feature);
+        }
+        for (int r = 0; r < poly->getNumInteriorRings(); ++r) {
+            appendGeometry(poly->getInteriorRingCurve(r), coordTransform, feature);
+        }
+        for (std::size_t p = firstNewPart; p < m_parts.size(); ++p) {
+            m_parts[p].type = PartType::Ring;
+        }
+    } else if (type == wkbMultiPoint || type == wkbMultiLineString || type == wkbMultiPolygon ||
+               type == wkbMultiCurve || type == wkbMultiSurface || type == wkbGeometryCollection) {
+        const OGRGeometryCollection* collection = static_cast<const OGRGeometryCollection*>(geom);
+        for (int j = 0; j < collection->getNumGeometries(); ++j) {
+            appendGeometry(collection->getGeometryRef(j), coordTransform, feature);
+        }
+    } else if (type == wkbCompoundCurve) {
+        const OGRCompoundCurve* compound = static_cast<const OGRCompoundCurve*>(geom);
+        for (int j = 0; j < compound->getNumCurves(); ++j) {
+            appendGeometry(compound->getCurve(j), coordTransform, feature);
+        }
+    } else {
+        std::cout << "Unsupported geometry type: " << OGRGeometryTypeToName(type) << std::endl;
+    }
+}
+
+void GeometryStore::appendCurve(const OGRSimpleCurve* curve, PartType type, OGRCoordinateTransformation* coordTransform, Feature& feature) {
+    int numPoints = curve->getNumPoints();
+    if (numPoints < 2) return;
+
+    std::size_t first = m_vertices.size();
+    m_vertices.resize(first + numPoints);
+    Coordinate* out = m_vertices.data() + first;
+
+    if (coordTransform) {
+        // Transform the whole curve in one call
+        m_scratchX.resize(numPoints);
+        m_scratchY.resize(numPoints);
+        curve->getPoints(m_scratchX.data(), sizeof(double), m_scratchY.data(), sizeof(double));
+        coordTransform->Transform(numPoints, m_scratchX.data(), m_scratchY.data());
+        for (int j = 0; j < numPoints; ++j) {
+            out[j].lon = m_scratchX[j];
+            out[j].lat = m_scratchY[j];
+        }
+    } else {
+        curve->getPoints(&out->lon, sizeof(Coordinate), &out->lat, sizeof(Coordinate));
+    }
+
+    for (int j = 0; j < numPoints; ++j) {
+        feature.bounds.expand(out[j]);
+    }
+
+    m_parts.push_back(Part{static_cast<std::uint32_t>(first), static_cast<std::uint32_t>(numPoints), type});
+    ++feature.partCount;
+}
+
+void GeometryStore::buildIndex() {
+    m_cellStart.clear();
+    m_cellCount.clear();
+    m_cellItems.clear();
+    m_cellOverflow.clear();
+    m_largeFeatures.clear();
+    if (m_features.empty()) return;
+
+    // Roughly one feature per cell on average
+    int side = static_cast<int>(std::sqrt(static_cast<double>(m_features.size())));
+    side = std::max(1, std::min(side, MaxGridSize));
+    m_gridColumns = side;
+    m_gridRows = side;
+    m_gridBounds = m_bounds;
+    const std::size_t cells = static_cast<std::size_t>(m_gridColumns) * m_gridRows;
+
+    // Count first, so each cell gets exactly its share of one array
+    m_cellStart.assign(cells + 1, 0);
+    m_cellCount.assign(cells, 0);
+    for (const Feature& feature : m_features) {
+        int x0, y0, x1, y1;
+        cellRange(feature.bounds, x0, y0, x1, y1);
+        if ((x1 - x0 + 1) * (y1 - y0 + 1) > MaxCellsPerFeature) continue;
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                ++m_cellStart[y * m_gridColumns + x + 1];
+            }
+        }
+    }
+    for (std::size_t c = 0; c < cells; ++c) {
+        m_cellStart[c + 1] += m_cellStart[c];
+    }
+    m_cellItems.resize(m_cellStart[cells]);
+
+    for (std::uint32_t i = 0; i < m_features.size(); ++i) {
+        indexFeature(i);
+    }
+}
+
+void GeometryStore::indexFeature(std::uint32_t index) {
+    int x0, y0, x1, y1;
+    cellRange(m_features[index].bounds, x0, y0, x1, y1);
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > MaxCellsPerFeature) {
+        m_largeFeatures.push_back(index);
+        return;
+    }
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const std::uint32_t cell = static_cast<std::uint32_t>(y * m_gridColumns + x);
+            if (m_cellStart[cell] + m_cellCount[cell] < m_cellStart[cell + 1]) {
+                m_cellItems[m_cellStart[cell] + m_cellCount[cell]++] = index;
+            } else {
+                m_cellOverflow[cell].push_back(index);
+            }
+        }
+    }
+}
+
+void GeometryStore::unindexFeature(std::uint32_t index) {
+    auto erase = [index](std::vector<std::uint32_t>& list) {
+        auto it = std::find(list.begin(), list.end(), index);
+        if (it != list.end()) {
+            *it = list.back();
+            list.pop_back();
+        }
+    };
+
+    int x0, y0, x1, y1;
+    cellRange(m_features[index].bounds, x0, y0, x1, y1);
+    if ((x1 - x0 + 1) * (y1 - y0 + 1) > MaxCellsPerFeature) {
+        erase(m_largeFeatures);
+        return;
+    }
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const std::uint32_t cell = static_cast<std::uint32_t>(y * m_gridColumns + x);
+            std::uint32_t* items = m_cellItems.data() + m_cellStart[cell];
+            std::uint32_t* end = items + m_cellCount[cell];
+            std::uint32_t* it = std::find(items, end, index);
+            if (it != end) {
+                *it = *(end - 1);
+                --m_cellCount[cell];
+                continue;
+            }
+            auto overflow = m_cellOverflow.find(cell);
+            if (overflow != m_cellOverflow.end()) {
+                erase(overflow->second);
+                if (overflow->second.empty()) m_cellOverflow.erase(overflow);
+            }
+        }
+    }
+}
+
+void GeometryStore::cellRange(const Bounds& area, int& x0, int& y0, int& x1, int& y1) const {
+    double width = std::max(m_gridBounds.maxLon - m_gridBounds.minLon, 1e-9);
+    double height = std::max(m_gridBounds.maxLat - m_gridBounds.minLat, 1e-9);
+
+    // Clamped, so anything outside the grid bounds maps to the edge cells
+    auto column = [&](double lon) {
+        double c = std::floor((lon - m_gridBounds.minLon) / width * m_gridColumns);
+        return static_cast<int>(std::max(0.0, std::min(c, static_cast<double>(m_gridColumns - 1))));
+    };
+    auto row = [&](double lat) {
+        double r = std::floor((lat - m_gridBounds.minLat) / height * m_gridRows);
+        return static_cast<int>(std::max(0.0, std::min(r, static_cast<double>(m_gridRows - 1))));
+    };
+
+    x0 = column(area.minLon);
+    x1 = column(area.maxLon);
+    y0 = row(area.minLat);
+    y1 = row(area.maxLat);
+}
+
+void GeometryStore::query(const Bounds& area, std::vector<std::uint32_t>& result) const {
+    if (m_cellStart.empty() || !area.intersects(m_bounds)) return;
+
+    std::size_t first = result.size();
+    for (std::uint32_t index : m_largeFeatures) {
+        if (m_features[index].bounds.intersects(area)) {
+            result.push_back(index);
+        }
+    }
+
+    int x0, y0, x1, y1;
+    cellRange(area, x0, y0, x1, y1);
+    auto collect = [&](const std::uint32_t* items, std::size_t count) {
+        for (std::size_t i = 0; i < count; ++i) {
+            if (m_features[items[i]].bounds.intersects(area)) {
+                result.push_back(items[i]);
+            }
+        }
+    };
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            const std::uint32_t cell = static_cast<std::uint32_t>(y * m_gridColumns + x);
+            collect(m_cellItems.data() + m_cellStart[cell], m_cellCount[cell]);
+            if (m_cellOverflow.empty()) continue;
+            auto overflow = m_cellOverflow.find(cell);
+            if (overflow != m_cellOverflow.end()) {
+                collect(overflow->second.data(), overflow->second.size());
+            }
+        }
+    }
+
+    // Features spanning several cells were found more than once
+    std::sort(result.begin() + first, result.end());
+    result.erase(std::unique(result.begin() + first, result.end()), result.end());
+}
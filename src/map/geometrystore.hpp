@@ -0,0 +1,183 @@
+#pragma once
+
+#include <gdal_priv.h>
+#include <ogrsf_frmts.h>
+#include "../utils/stringarena.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Flat, read-only copy of a dataset's vector geometry in WGS84 lon/lat.
+//
+// Loading goes through GDAL once; afterwards the store owns plain arrays and
+// a uniform grid index, so it can be shared between the interactive map and
+// any number of renderer threads without locking.
+//
+// Edits on disk (e.g. to a GeoPackage) are patched in two steps:
+// readChanges() reads just the changed features into a Patch without
+// touching the store, so it can run on a worker, and applyPatch() swaps them
+// in. applyPatch() must not run concurrently with query().
+//
+// Ingest avoids per-feature allocations: names are copied into an arena,
+// the fid lookup and grid index are flat arrays, and curves are converted
+// through scratch buffers that live as long as the store.
+class GeometryStore {
+public:
+    struct Coordinate {
+        double lon;
+        double lat;
+    };
+
+    struct Bounds {
+        double minLon = 0.0;
+        double minLat = 0.0;
+        double maxLon = 0.0;
+        double maxLat = 0.0;
+        bool valid = false;
+
+        void expand(const Coordinate& c);
+        void expand(const Bounds& other);
+        bool intersects(const Bounds& other) const;
+    };
+
+    enum class PartType : std::uint8_t {
+        Point,
+        Line,
+        Ring
+    };
+
+    struct Part {
+        std::uint32_t firstVertex;
+        std::uint32_t vertexCount;
+        PartType type;
+    };
+
+    struct Feature {
+        std::int64_t fid;
+        std::uint32_t layer;
+        std::uint32_t firstPart;
+        std::uint32_t partCount;
+        Bounds bounds;
+        std::string_view name; // owned by the store
+    };
+
+    // A feature to re-read from the dataset, or to drop if `removed`
+    struct FeatureChange {
+        std::uint32_t layer;
+        std::int64_t fid;
+        bool removed;
+    };
+
+    struct Patch;
+
+    // Which parts applyPatch() dropped and added, for whoever keeps data per part
+    struct PatchResult {
+        std::vector<std::uint32_t> removedParts; // no longer belong to any feature
+        std::uint32_t firstNewPart = 0;          // the patch's parts, in its order, start here
+        bool renumbered = false;                 // parts were compacted or rebuilt: start over
+    };
+
+    // Stops early and leaves the store empty once `token` is cancelled
+    bool load(GDALDataset* dataset, const CancellationToken* token = nullptr);
+    void clear();
+
+    // Reads the listed features from `dataset`, which must have the same
+    // layer order as the one passed to load(). Safe to call on any thread
+    // while the store is in use.
+    static Patch readChanges(GDALDataset* dataset, const std::vector<FeatureChange>& changes);
+    // Drops every changed feature and adds the patch's. Cost is proportional
+    // to the size of the patch, not of the store.
+    PatchResult applyPatch(const Patch& patch);
+
+    static std::uint64_t featureKey(std::uint32_t layer, std::int64_t fid) {
+        return (static_cast<std::uint64_t>(layer) << 48) ^ static_cast<std::uint64_t>(fid);
+    }
+    // nullptr if the store has no such feature
+    const Feature* findFeature(std::uint32_t layer, std::int64_t fid) const;
+
+    const std::vector<Feature>& features() const { return m_features; }
+    const std::vector<Part>& parts() const { return m_parts; }
+    const std::vector<Coordinate>& vertices() const { return m_vertices; }
+    const Bounds& bounds() const { return m_bounds; }
+
+    // Appends the indices of all features whose bounds intersect `area`.
+    // Safe to call concurrently.
+    void query(const Bounds& area, std::vector<std::uint32_t>& result) const;
+
+    // Estimate of what the store holds, names and index included
+    std::size_t memoryBytes() const;
+
+private:
+    std::vector<Feature> m_features;
+    std::vector<Part> m_parts;
+    std::vector<Coordinate> m_vertices;
+    Bounds m_bounds;
+
+    // (layer, fid) -> index into m_features, with open addressing so the
+    // table is one array instead of a node per feature
+    class FeatureIndex {
+    public:
+        void clear();
+        void reserve(std::size_t count);
+        void set(std::uint64_t key, std::uint32_t value);
+        bool find(std::uint64_t key, std::uint32_t& value) const;
+        void erase(std::uint64_t key);
+        std::size_t memoryBytes() const { return m_slots.capacity() * sizeof(Slot); }
+
+    private:
+        struct Slot {
+            std::uint64_t key;
+            std::uint32_t value;
+            bool used;
+        };
+        std::vector<Slot> m_slots; // a power of two in size, at most half full
+        std::size_t m_size = 0;
+
+        std::size_t home(std::uint64_t key) const;
+        void rehash(std::size_t slotCount);
+    };
+
+    StringArena m_names;
+    FeatureIndex m_featureIndex;
+    // Vertices and parts of removed features, reclaimed by compact()
+    std::size_t m_deadVertices = 0;
+    std::size_t m_deadParts = 0;
+
+    // Uniform grid over the bounds at load time; features covering many cells
+    // go to m_largeFeatures. Features added later outside it land in edge cells.
+    // Cell c holds m_cellItems[m_cellStart[c] .. + m_cellCount[c]], with room
+    // up to m_cellStart[c + 1]; features patched in that do not fit go to
+    // m_cellOverflow.
+    Bounds m_gridBounds;
+    int m_gridColumns = 0;
+    int m_gridRows = 0;
+    std::vector<std::uint32_t> m_cellStart;
+    std::vector<std::uint32_t> m_cellCount;
+    std::vector<std::uint32_t> m_cellItems;
+    std::unordered_map<std::uint32_t, std::vector<std::uint32_t>> m_cellOverflow;
+    std::vector<std::uint32_t> m_largeFeatures;
+
+    // Reused by appendCurve() for coordinate transformation
+    std::vector<double> m_scratchX;
+    std::vector<double> m_scratchY;
+
+    bool readFeature(OGRFeature* ogrFeature, std::uint32_t layer, int nameField, OGRCoordinateTransformation* coordTransform);
+    void removeFeature(std::uint32_t index);
+    void compact();
+    void appendGeometry(const OGRGeometry* geom, OGRCoordinateTransformation* coordTransform, Feature& feature);
+    void appendCurve(const OGRSimpleCurve* curve, PartType type, OGRCoordinateTransformation* coordTransform, Feature& feature);
+    void buildIndex();
+    void indexFeature(std::uint32_t index);
+    void unindexFeature(std::uint32_t index);
+    void cellRange(const Bounds& area, int& x0, int& y0, int& x1, int& y1) const;
+};
+
+// The changes to apply and the features they were read into, with parts in
+// the same order applyPatch() appends them
+struct GeometryStore::Patch {
+    std::vector<FeatureChange> changes;
+    GeometryStore features;
+};
@@ -0,0 +1,210 @@
+#include "geopackagechanges.hpp"
+#include "../database/connectionpool.hpp"
+#include <sqlite3.h>
+#include <functional>
+#include <iostream>
+#include <string_view>
+
+namespace {
+    std::string quoteIdentifier(const std::string& name) {
+        std::string quoted = "\"";
+        for (char c : name) {
+            if (c == '"') quoted += '"';
+            quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Feature tables and their last_change timestamps
+    bool readContents(sqlite3* db, std::map<std::string, std::string>& lastChanges) {
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT table_name, last_change FROM gpkg_contents WHERE data_type = 'features'", -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Not a GeoPackage: " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+        int result;
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+            const unsigned char* table = sqlite3_column_text(stmt, 0);
+            const unsigned char* lastChange = sqlite3_column_text(stmt, 1);
+            if (!table) continue;
+            lastChanges[reinterpret_cast<const char*>(table)] = lastChange ? reinterpret_cast<const char*>(lastChange) : "";
+        }
+        // A partial list would make the missing tables look dropped
+        if (result != SQLITE_DONE) {
+            std::cerr << "Failed to read gpkg_contents: " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        sqlite3_finalize(stmt);
+        return true;
+    }
+
+    std::string geometryColumn(sqlite3* db, const std::string& table) {
+        std::string column;
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, "SELECT column_name FROM gpkg_geometry_columns WHERE table_name = ?", -1, &stmt, nullptr) == SQLITE_OK) {
+            sqlite3_bind_text(stmt, 1, table.c_str(), -1, SQLITE_TRANSIENT);
+            if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0)) {
+                column = reinterpret_cast<const char*>(sqlite3_column_text(stmt, 0));
+            }
+        }
+        sqlite3_finalize(stmt);
+        return column;
+    }
+
+    bool hasColumn(sqlite3* db, const std::string& table, const std::string& column) {
+        bool found = false;
+        sqlite3_stmt* stmt = nullptr;
+        std::string sql = "PRAGMA table_info(" + quoteIdentifier(table) + ")";
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) == SQLITE_OK) {
+            while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+                const unsigned char* name = sqlite3_column_text(stmt, 1);
+                found = name && column == reinterpret_cast<const char*>(name);
+            }
+        }
+        sqlite3_finalize(stmt);
+        return found;
+    }
+
+    // Hashes what the GeometryStore keeps of each row: geometry and name
+    bool hashTable(sqlite3* db, const std::string& table, std::unordered_map<std::int64_t, std::uint64_t>& hashes) {
+        std::string geometry = geometryColumn(db, table);
+        if (geometry.empty()) return false;
+
+        std::string sql = "SELECT rowid, " + quoteIdentifier(geometry);
+        if (hasColumn(db, table, "name")) {
+            sql += ", name";
+        }
+        sql += " FROM " + quoteIdentifier(table);
+
+        sqlite3_stmt* stmt = nullptr;
+        if (sqlite3_prepare_v2(db, sql.c_str(), -1, &stmt, nullptr) != SQLITE_OK) {
+            std::cerr << "Failed to read " << table << ": " << sqlite3_errmsg(db) << std::endl;
+            return false;
+        }
+
+        std::hash<std::string_view> hasher;
+        int columns = sqlite3_column_count(stmt);
+        int result;
+        while ((result = sqlite3_step(stmt)) == SQLITE_ROW) {
+            std::uint64_t hash = 0;
+            for (int c = 1; c < columns; ++c) {
+                const char* data = static_cast<const char*>(sqlite3_column_blob(stmt, c));
+                std::size_t size = static_cast<std::size_t>(sqlite3_column_bytes(stmt, c));
+                std::uint64_t columnHash = data ? hasher(std::string_view(data, size)) : 0;
+                hash ^= columnHash + 0x9e3779b97f4a7c15ull + (hash << 6) + (hash >> 2);
+            }
+            hashes[sqlite3_column_int64(stmt, 0)] = hash;
+        }
+        // SQLITE_BUSY while a pipeline is still writing leaves the hashes
+        // incomplete, and missing rows would read as removed features
+        if (result != SQLITE_DONE) {
+            std::cerr << "Failed to read " << table << ": " << sqlite3_errmsg(db) << std::endl;
+            sqlite3_finalize(stmt);
+            return false;
+        }
+        sqlite3_finalize(stmt);
+        return true;
+    }
+}
+
+bool GeoPackageChangeTracker::snapshot(const std::string& path) {
+    m_path.clear();
+    m_tables.clear();
+
+    ConnectionPool::Lease connection = ConnectionPool::instance().acquire(path);
+    if (!connection) return false;
+    sqlite3* db = connection.db();
+
+    std::map<std::string, std::string> lastChanges;
+    if (!readContents(db, lastChanges)) return false;
+    for (const auto& entry : lastChanges) {
+        Table& table = m_tables[entry.first];
+        table.lastChange = entry.second;
+        if (!hashTable(db, entry.first, table.hashes)) {
+            // A partial snapshot would turn the rows it missed into changes
+            m_tables.clear();
+            return false;
+        }
+    }
+
+    m_path = path;
+    return true;
+}
+
+bool GeoPackageChangeTracker::diff(std::vector<Change>& changes) {
+    if (m_path.empty()) return false;
+
+    // Editors often save by replacing the file, which pooled connections would not see
+    ConnectionPool::instance().invalidate(m_path);
+    ConnectionPool::Lease connection = ConnectionPool::instance().acquire(m_path);
+    if (!connection) return false;
+    sqlite3* db = connection.db();
+
+    std::map<std::string, std::string> lastChanges;
+    if (!readContents(db, lastChanges)) {
+        return false;
+    }
+
+    // Writers that keep last_change up to date let us skip untouched tables;
+    // if none moved, the writer did not maintain it and every table is checked
+    bool anyTableChanged = false;
+    for (const auto& entry : lastChanges) {
+        auto known = m_tables.find(entry.first);
+        if (known == m_tables.end() || known->second.lastChange != entry.second) {
+            anyTableChanged = true;
+        }
+    }
+
+    // Nothing in the snapshot changes until every table was read, so a
+    // failed diff can be retried against the same snapshot
+    std::map<std::string, Table> tables;
+    std::vector<Change> found;
+    std::vector<std::string> unchanged;
+    for (const auto& entry : lastChanges) {
+        auto known = m_tables.find(entry.first);
+        bool scan = !anyTableChanged || known == m_tables.end() || known->second.lastChange != entry.second;
+
+        Table& table = tables[entry.first];
+        table.lastChange = entry.second;
+        if (!scan) {
+            unchanged.push_back(entry.first);
+            continue;
+        }
+
+        if (!hashTable(db, entry.first, table.hashes)) return false;
+        const std::unordered_map<std::int64_t, std::uint64_t>* previous = known != m_tables.end() ? &known->second.hashes : nullptr;
+        for (const auto& row : table.hashes) {
+            if (!previous) {
+                found.push_back(Change{entry.first, row.first, false});
+                continue;
+            }
+            auto old = previous->find(row.first);
+            if (old == previous->end() || old->second != row.second) {
+                found.push_back(Change{entry.first, row.first, false});
+            }
+        }
+        if (previous) {
+            for (const auto& row : *previous) {
+                if (table.hashes.count(row.first) == 0) {
+                    found.push_back(Change{entry.first, row.first, true});
+                }
+            }
+        }
+    }
+
+    // Dropped tables
+    for (const auto& entry : m_tables) {
+        if (tables.count(entry.first) > 0) continue;
+        for (const auto& row : entry.second.hashes) {
+            found.push_back(Change{entry.first, row.first, true});
+        }
+    }
+
+    for (const std::string& name : unchanged) {
+        tables[name].hashes.swap(m_tables[name].hashes);
+    }
+    changes.insert(changes.end(), found.begin(), found.end());
+    m_tables.swap(tables);
+    return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Works out which features of a GeoPackage changed on disk since the last
+// snapshot, without going through GDAL.
+//
+// gpkg_contents.last_change narrows the work down to the tables that were
+// written; for those, the geometry blob (and "name" column) of every row is
+// hashed straight from SQLite and compared per FID. Hashing raw blobs is far
+// cheaper than parsing and reprojecting geometry, so only the features that
+// actually differ need to be re-ingested. Reading is still proportional to
+// the size of each written table, not to the number of rows changed.
+//
+// A read that does not run to the end (SQLITE_BUSY while a pipeline is
+// still writing) fails the whole call and leaves the snapshot as it was.
+class GeoPackageChangeTracker {
+public:
+    struct Change {
+        std::string table;
+        std::int64_t fid;
+        bool removed;
+    };
+
+    // Records the current state of the file; on failure there is no snapshot
+    bool snapshot(const std::string& path);
+    // Appends the changes since the last snapshot/diff and moves the snapshot
+    // forward. Returns false, appending nothing and keeping the snapshot, if
+    // the file could not be read completely; calling again later is safe.
+    bool diff(std::vector<Change>& changes);
+
+    const std::string& path() const { return m_path; }
+
+private:
+    struct Table {
+        std::string lastChange;
+        std::unordered_map<std::int64_t, std::uint64_t> hashes; // fid -> content hash
+    };
+
+    std::string m_path;
+    std::map<std::string, Table> m_tables;
+};
@@ -0,0 +1,328 @@
+#include "labelengine.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float LabelPadding = 3.f;
+    const float GridCellSize = 64.f;
+    const sf::Color LabelColor(40, 40, 40);
+}
+
+LabelEngine::LabelEngine(const sf::Font& font, unsigned int characterSize)
+    : m_font(font),
+      m_characterSize(characterSize),
+      m_viewportSize(0, 0),
+      m_pending(sf::Quads),
+      m_batch(sf::Quads)
+{
+}
+
+void LabelEngine::clear() {
+    m_labels.clear();
+    m_glyphQuads.clear();
+    m_order.clear();
+    m_pending.clear();
+    m_batch.clear();
+    m_nextCandidate = 0;
+    m_placedCount = 0;
+    m_pendingPlaced = 0;
+    m_deadLabels = 0;
+}
+
+void LabelEngine::release() {
+    clear();
+    std::vector<Label>().swap(m_labels);
+    std::vector<GlyphQuad>().swap(m_glyphQuads);
+    std::vector<std::uint32_t>().swap(m_order);
+    m_pending = sf::VertexArray(sf::Quads);
+    m_batch = sf::VertexArray(sf::Quads);
+    m_grid.release();
+}
+
+std::size_t LabelEngine::memoryBytes() const {
+    return m_labels.capacity() * sizeof(Label) + m_glyphQuads.capacity() * sizeof(GlyphQuad) +
+           m_order.capacity() * sizeof(std::uint32_t) +
+           (m_pending.getVertexCount() + m_batch.getVertexCount()) * sizeof(sf::Vertex) + m_grid.memoryBytes();
+}
+
+void LabelEngine::addPointLabel(const sf::String& text, sf::Vector2f worldPos, float priority, std::uint64_t key) {
+    Label label;
+    label.key = key;
+    label.anchor = worldPos;
+    label.angle = 0.f;
+    label.lineLength = 0.f;
+    label.priority = priority;
+    layoutGlyphs(label, text);
+    m_labels.push_back(label);
+}
+
+void LabelEngine::addLineLabel(const sf::String& text, sf::Vector2f worldPos, float angle, float lineLength, float priority,
+                               std::uint64_t key) {
+    // Keep line labels upright
+    while (angle > 90.f) angle -= 180.f;
+    while (angle <= -90.f) angle += 180.f;
+
+    Label label;
+    label.key = key;
+    label.anchor = worldPos;
+    label.angle = angle;
+    label.lineLength = lineLength;
+    label.priority = priority;
+    layoutGlyphs(label, text);
+    m_labels.push_back(label);
+}
+
+void LabelEngine::finalize() {
+    m_order.resize(m_labels.size());
+    for (std::uint32_t i = 0; i < m_order.size(); ++i) {
+        m_order[i] = i;
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [this](std::uint32_t a, std::uint32_t b) {
+        return m_labels[a].priority > m_labels[b].priority;
+    });
+    m_nextCandidate = 0;
+}
+
+void LabelEngine::finalizeAdded(std::size_t firstAdded) {
+    const std::size_t middle = m_order.size();
+    for (std::size_t i = firstAdded; i < m_labels.size(); ++i) {
+        m_order.push_back(static_cast<std::uint32_t>(i));
+    }
+    auto higher = [this](std::uint32_t a, std::uint32_t b) {
+        return m_labels[a].priority > m_labels[b].priority;
+    };
+    std::stable_sort(m_order.begin() + middle, m_order.end(), higher);
+    std::inplace_merge(m_order.begin(), m_order.begin() + middle, m_order.end(), higher);
+    m_nextCandidate = 0;
+}
+
+void LabelEngine::removeLabels(const std::vector<std::uint64_t>& keys) {
+    if (keys.empty()) return;
+    for (Label& label : m_labels) {
+        if (label.glyphCount == 0 && label.key == 0) continue;
+        if (!std::binary_search(keys.begin(), keys.end(), label.key)) continue;
+        // Without glyphs the label is never placed; compact() reclaims the slot
+        label.glyphCount = 0;
+        label.key = 0;
+        ++m_deadLabels;
+    }
+    m_order.erase(std::remove_if(m_order.begin(), m_order.end(), [this](std::uint32_t index) {
+        return m_labels[index].glyphCount == 0;
+    }), m_order.end());
+    m_nextCandidate = 0;
+
+    if (m_deadLabels > m_labels.size() / 2) {
+        compact();
+    }
+}
+
+void LabelEngine::compact() {
+    std::vector<Label> labels;
+    std::vector<GlyphQuad> glyphQuads;
+    std::vector<std::uint32_t> newIndex(m_labels.size(), 0);
+    labels.reserve(m_labels.size() - m_deadLabels);
+    for (std::size_t i = 0; i < m_labels.size(); ++i) {
+        Label label = m_labels[i];
+        if (label.glyphCount == 0) continue;
+        std::uint32_t firstGlyph = static_cast<std::uint32_t>(glyphQuads.size());
+        glyphQuads.insert(glyphQuads.end(), m_glyphQuads.begin() + label.firstGlyph,
+                          m_glyphQuads.begin() + label.firstGlyph + label.glyphCount);
+        label.firstGlyph = firstGlyph;
+        newIndex[i] = static_cast<std::uint32_t>(labels.size());
+        labels.push_back(label);
+    }
+    // m_order only holds live labels, so it keeps its priority order
+    for (std::uint32_t& index : m_order) {
+        index = newIndex[index];
+    }
+    m_labels.swap(labels);
+    m_glyphQuads.swap(glyphQuads);
+    m_deadLabels = 0;
+}
+
+void LabelEngine::setView(const sf::View& view, sf::Vector2u viewportSize) {
+    // World -> viewport pixels
+    sf::Transform transform;
+    transform.translate(viewportSize.x / 2.f, viewportSize.y / 2.f)
+             .scale(viewportSize.x / 2.f, -(viewportSize.y / 2.f))
+             .combine(view.getTransform());
+
+    m_viewTransform = transform;
+    m_viewportSize = viewportSize;
+    m_pixelsPerUnit = viewportSize.x / view.getSize().x;
+    m_grid.reset(viewportSize, GridCellSize);
+    m_pending.clear();
+    m_pendingPlaced = 0;
+    m_nextCandidate = 0;
+}
+
+bool LabelEngine::update(sf::Time budget) {
+    if (isPlacementComplete()) return true;
+
+    sf::Clock clock;
+    while (m_nextCandidate < m_order.size()) {
+        placeLabel(m_labels[m_order[m_nextCandidate++]]);
+
+        // Checking the clock is cheap, but not free; do it every few labels
+        if ((m_nextCandidate & 63) == 0 && clock.getElapsedTime() >= budget) {
+            break;
+        }
+    }
+
+    if (isPlacementComplete()) {
+        std::swap(m_batch, m_pending);
+        m_batchScreenToWorld = m_viewTransform.getInverse();
+        m_placedCount = m_pendingPlaced;
+        m_pending.clear();
+        return true;
+    }
+    return false;
+}
+
+void LabelEngine::draw(sf::RenderTarget& target) const {
+    if (m_batch.getVertexCount() == 0) return;
+
+    // The batch is in screen space of the view it was placed for; while a new
+    // pass is running, carry it along with the current view.
+    sf::RenderStates states;
+    states.texture = &m_font.getTexture(m_characterSize);
+    states.transform = m_viewTransform * m_batchScreenToWorld;
+    target.draw(m_batch, states);
+}
+
+void LabelEngine::layoutGlyphs(Label& label, const sf::String& text) {
+    label.firstGlyph = static_cast<std::uint32_t>(m_glyphQuads.size());
+
+    float x = 0.f;
+    float minY = 0.f;
+    float maxY = 0.f;
+    std::uint32_t previous = 0;
+    for (std::size_t i = 0; i < text.getSize(); ++i) {
+        std::uint32_t codePoint = text[i];
+        if (codePoint == '\r' || codePoint == '\n') codePoint = ' ';
+
+        x += m_font.getKerning(previous, codePoint, m_characterSize);
+        previous = codePoint;
+
+        const sf::Glyph& glyph = m_font.getGlyph(codePoint, m_characterSize, false);
+        if (glyph.textureRect.width > 0 && glyph.textureRect.height > 0) {
+            GlyphQuad quad;
+            quad.bounds = sf::FloatRect(x + glyph.bounds.left, glyph.bounds.top, glyph.bounds.width, glyph.bounds.height);
+            quad.texRect = sf::FloatRect(glyph.textureRect);
+            m_glyphQuads.push_back(quad);
+
+            minY = std::min(minY, quad.bounds.top);
+            maxY = std::max(maxY, quad.bounds.top + quad.bounds.height);
+        }
+        x += glyph.advance;
+    }
+
+    label.glyphCount = static_cast<std::uint32_t>(m_glyphQuads.size()) - label.firstGlyph;
+    label.size = sf::Vector2f(x, maxY - minY);
+
+    // Centre the quads on the anchor so rotation happens around the label centre
+    float offsetX = x / 2.f;
+    float offsetY = (minY + maxY) / 2.f;
+    for (std::uint32_t i = label.firstGlyph; i < m_glyphQuads.size(); ++i) {
+        m_glyphQuads[i].bounds.left -= offsetX;
+        m_glyphQuads[i].bounds.top -= offsetY;
+    }
+}
+
+void LabelEngine::placeLabel(const Label& label) {
+    if (label.glyphCount == 0) return;
+    if (label.lineLength > 0.f && label.size.x > label.lineLength * m_pixelsPerUnit) return;
+
+    sf::Vector2f center = m_viewTransform.transformPoint(label.anchor);
+
+    float radians = label.angle * 3.14159265f / 180.f;
+    float cosA = std::cos(radians);
+    float sinA = std::sin(radians);
+    float halfW = (std::abs(label.size.x * cosA) + std::abs(label.size.y * sinA)) / 2.f + LabelPadding;
+    float halfH = (std::abs(label.size.x * sinA) + std::abs(label.size.y * cosA)) / 2.f + LabelPadding;
+
+    sf::FloatRect box(center.x - halfW, center.y - halfH, halfW * 2.f, halfH * 2.f);
+    if (box.left < 0.f || box.top < 0.f ||
+        box.left + box.width > m_viewportSize.x || box.top + box.height > m_viewportSize.y) {
+        return;
+    }
+
+    if (!m_grid.tryInsert(box)) return;
+
+    // Snap unrotated labels to whole pixels so the glyphs stay crisp
+    if (label.angle == 0.f) {
+        center.x = std::round(center.x);
+        center.y = std::round(center.y);
+    }
+
+    for (std::uint32_t i = 0; i < label.glyphCount; ++i) {
+        const GlyphQuad& quad = m_glyphQuads[label.firstGlyph + i];
+        const sf::FloatRect& b = quad.bounds;
+        const sf::FloatRect& t = quad.texRect;
+
+        const sf::Vector2f corners[4] = {
+            {b.left, b.top}, {b.left + b.width, b.top},
+            {b.left + b.width, b.top + b.height}, {b.left, b.top + b.height}
+        };
+        const sf::Vector2f texCoords[4] = {
+            {t.left, t.top}, {t.left + t.width, t.top},
+            {t.left + t.width, t.top + t.height}, {t.left, t.top + t.height}
+        };
+        for (int c = 0; c < 4; ++c) {
+            sf::Vector2f p(center.x + corners[c].x * cosA - corners[c].y * sinA,
+                           center.y + corners[c].x * sinA + corners[c].y * cosA);
+            m_pending.append(sf::Vertex(p, LabelColor, texCoords[c]));
+        }
+    }
+    ++m_pendingPlaced;
+}
+
+void LabelEngine::CollisionGrid::reset(sf::Vector2u viewportSize, float cellSize) {
+    m_cellSize = cellSize;
+    m_columns = static_cast<int>(std::ceil(viewportSize.x / cellSize)) + 1;
+    m_rows = static_cast<int>(std::ceil(viewportSize.y / cellSize)) + 1;
+    m_cells.resize(static_cast<std::size_t>(m_columns) * m_rows);
+    for (auto& cell : m_cells) {
+        cell.clear();
+    }
+    m_boxes.clear();
+}
+
+void LabelEngine::CollisionGrid::release() {
+    std::vector<std::vector<std::uint32_t>>().swap(m_cells);
+    std::vector<sf::FloatRect>().swap(m_boxes);
+    m_columns = 0;
+    m_rows = 0;
+}
+
+std::size_t LabelEngine::CollisionGrid::memoryBytes() const {
+    std::size_t bytes = m_cells.capacity() * sizeof(std::vector<std::uint32_t>) + m_boxes.capacity() * sizeof(sf::FloatRect);
+    for (const auto& cell : m_cells) {
+        bytes += cell.capacity() * sizeof(std::uint32_t);
+    }
+    return bytes;
+}
+
+bool LabelEngine::CollisionGrid::tryInsert(const sf::FloatRect& box) {
+    int x0 = std::max(0, static_cast<int>(box.left / m_cellSize));
+    int y0 = std::max(0, static_cast<int>(box.top / m_cellSize));
+    int x1 = std::min(m_columns - 1, static_cast<int>((box.left + box.width) / m_cellSize));
+    int y1 = std::min(m_rows - 1, static_cast<int>((box.top + box.height) / m_cellSize));
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            for (std::uint32_t index : m_cells[y * m_columns + x]) {
+                if (m_boxes[index].intersects(box)) return false;
+            }
+        }
+    }
+
+    std::uint32_t index = static_cast<std::uint32_t>(m_boxes.size());
+    m_boxes.push_back(box);
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            m_cells[y * m_columns + x].push_back(index);
+        }
+    }
+    return true;
+}
@@ -0,0 +1,110 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstdint>
+#include <vector>
+
+// Places point and line labels in screen space and batches every glyph quad
+// into one vertex array drawn with the font's atlas texture.
+//
+// Candidates are stored in world coordinates (the same space as the map's
+// vector shapes) and laid out once. A placement pass walks them in priority
+// order, rejects overlaps with a collision grid and is time-sliced, so a view
+// change only costs a few milliseconds per frame until the pass completes.
+class LabelEngine {
+public:
+    LabelEngine(const sf::Font& font, unsigned int characterSize = 14);
+
+    void clear();
+    // clear() that also hands the memory back, for a suspended map
+    void release();
+    // `key` names what the label belongs to, for removeLabels()
+    void addPointLabel(const sf::String& text, sf::Vector2f worldPos, float priority, std::uint64_t key = 0);
+    // `lineLength` is in world units; the label is skipped while it would be
+    // longer than the line on screen.
+    void addLineLabel(const sf::String& text, sf::Vector2f worldPos, float angle, float lineLength, float priority,
+                      std::uint64_t key = 0);
+
+    // Sorts candidates by priority. Call once after all candidates were added.
+    void finalize();
+    // Sorts in the candidates added since candidateSlots() returned `firstAdded`,
+    // without sorting the others again
+    void finalizeAdded(std::size_t firstAdded);
+    // Drops the candidates with these keys; `keys` must be sorted
+    void removeLabels(const std::vector<std::uint64_t>& keys);
+
+    // Restarts placement for a new view. Cheap; the actual work happens in update().
+    void setView(const sf::View& view, sf::Vector2u viewportSize);
+
+    // Continues the current placement pass for at most `budget`.
+    // Returns true once the pass is complete and the batch is up to date.
+    bool update(sf::Time budget);
+
+    void draw(sf::RenderTarget& target) const;
+
+    bool isPlacementComplete() const { return m_nextCandidate >= m_order.size(); }
+    std::size_t candidateCount() const { return m_labels.size() - m_deadLabels; }
+    // Including removed candidates not reclaimed yet
+    std::size_t candidateSlots() const { return m_labels.size(); }
+    std::size_t placedCount() const { return m_placedCount; }
+    std::size_t memoryBytes() const;
+
+private:
+    struct Label {
+        sf::Vector2f anchor;      // world position
+        float angle;              // degrees, 0 for point labels
+        float lineLength;         // world units, 0 for point labels
+        float priority;
+        std::uint32_t firstGlyph; // range into m_glyphQuads
+        std::uint32_t glyphCount;
+        sf::Vector2f size;        // unrotated text extent in pixels
+        std::uint64_t key;
+    };
+
+    // Glyph quad relative to the label's centre, before rotation.
+    struct GlyphQuad {
+        sf::FloatRect bounds;
+        sf::FloatRect texRect;
+    };
+
+    // Uniform screen-space grid of placed label boxes.
+    class CollisionGrid {
+    public:
+        void reset(sf::Vector2u viewportSize, float cellSize);
+        bool tryInsert(const sf::FloatRect& box);
+        void release();
+        std::size_t memoryBytes() const;
+
+    private:
+        float m_cellSize = 64.f;
+        int m_columns = 0;
+        int m_rows = 0;
+        std::vector<std::vector<std::uint32_t>> m_cells;
+        std::vector<sf::FloatRect> m_boxes;
+    };
+
+    const sf::Font& m_font;
+    unsigned int m_characterSize;
+
+    std::vector<Label> m_labels;
+    std::vector<GlyphQuad> m_glyphQuads;
+    std::vector<std::uint32_t> m_order; // indices into m_labels, highest priority first
+    std::size_t m_deadLabels = 0;       // removed, still taking a slot in m_labels
+
+    sf::Transform m_viewTransform;
+    sf::Transform m_batchScreenToWorld;
+    sf::Vector2u m_viewportSize;
+    float m_pixelsPerUnit = 1.f;
+    CollisionGrid m_grid;
+    std::size_t m_nextCandidate = 0;
+    std::size_t m_placedCount = 0;
+    std::size_t m_pendingPlaced = 0;
+
+    // The pass fills m_pending while m_batch keeps showing the previous result.
+    sf::VertexArray m_pending;
+    sf::VertexArray m_batch;
+
+    void layoutGlyphs(Label& label, const sf::String& text);
+    void placeLabel(const Label& label);
+    void compact();
+};
@@ -1,20 +1,40 @@
 #include "map.hpp"
+#include "vectorshapes.hpp"
+#include "../utils/allocationtracker.hpp"
 #include <iostream>
 #include <SFML/Graphics.hpp>
 #include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
 #include <ogr_geometry.h>
 
+namespace {
+    // Time per frame the label placement pass may use before yielding
+    const sf::Time LabelPlacementBudget = sf::milliseconds(4);
+    // Point labels (places, POIs) always win over line labels (streets)
+    const float PointLabelPriority = 1e9f;
+    // Looked for next to the maps when $MAP_FORECAST is not set
+    const char* const ForecastFiles[] = {"resources/maps/forecast.grib2", "resources/maps/forecast.grb2", "resources/maps/forecast.nc"};
+}
+
 Map::Map(sf::RenderWindow& window)
     : m_window(window),
+      m_searchInput(m_font, 24),
       m_isLayersPanelOpen(false),
       m_isSecondaryPanelOpen(false),
       m_isSearchActive(false),
       m_currentBaseLayer(BaseLayer::Streetmap),
-      m_needsRedraw(true)
+      m_needsRedraw(true),
+      m_labelEngine(m_font)
 {
 
+#ifdef _WIN32
     // Set the PROJ_LIB environment variable
     _putenv("PROJ_LIB=C:\\project_root\\vcpkg\\installed\\x64-windows\\share\\proj");
+#endif
 
     if (!m_font.loadFromFile("resources/fonts/Roboto-Regular.ttf")) {
        // Handle font loading error
@@ -46,10 +66,8 @@ Map::Map(sf::RenderWindow& window)
     m_searchBar.setPosition(0, -50);
     m_searchBar.setFillColor(sf::Color::White);
 
-    m_searchText.setFont(m_font);
-    m_searchText.setCharacterSize(24);
-    m_searchText.setFillColor(sf::Color::Black);
-    m_searchText.setPosition(10, -40);
+    // Leaves the exit button clickable while searching
+    m_searchInput.setArea(sf::FloatRect(70, 5, m_window.getSize().x - 80, 40));
 
     // Initialize base layer buttons
     std::vector<std::string> baseLayerNames = {"Satellite", "Streetmap", "Terrain", "Topographic"};
@@ -69,19 +87,48 @@ Map::Map(sf::RenderWindow& window)
         m_secondaryLayerButtons.push_back(button);
     }
 
+    m_loadingText.setFont(m_font);
+    m_loadingText.setCharacterSize(18);
+    m_loadingText.setFillColor(sf::Color::Black);
+    m_loadingText.setPosition(70, 20);
+
+    m_mapView = m_window.getDefaultView();
+    m_worldSize = sf::Vector2f(m_window.getSize());
+
     // Initialize GDAL
     GDALAllRegister();
 
     // Load initial map data
     loadMapData("resources/maps/streetmap.gpkg");
+    loadForecast();
     setNeedsRedraw();
 }
 
 Map::~Map() {
+    // A load still in flight holds GDAL datasets, and so may its result
+    m_loadToken.cancel();
+    m_loadToken.wait();
+    m_patchToken.cancel();
+    m_patchToken.wait();
+    TaskScheduler::instance().discardCancelled();
+    // Its decode thread holds GDAL datasets
+    m_weatherOverlay.close();
     GDALDestroyDriverManager();
 }
 
 void Map::handleEvent(const sf::Event& event) {
+    if (m_isSearchActive) {
+        if (event.type == sf::Event::TextEntered && event.text.unicode == '\r') {
+            handleSearch();
+            setNeedsRedraw();
+            return;
+        }
+        if (m_searchInput.handleEvent(event)) {
+            setNeedsRedraw();
+            return;
+        }
+    }
+
     if (event.type == sf::Event::MouseButtonPressed) {
         if (event.mouseButton.button == sf::Mouse::Left) {
             sf::Vector2f mousePos = m_window.mapPixelToCoords(sf::Mouse::getPosition(m_window));
@@ -113,40 +160,77 @@ void Map::handleEvent(const sf::Event& event) {
                     break;
                 }
             }
+        } else if (event.mouseButton.button == sf::Mouse::Right) {
+            // Drag with the right mouse button to pan
+            m_isPanning = true;
+            m_lastPanPosition = sf::Vector2i(event.mouseButton.x, event.mouseButton.y);
         }
-    } else if (event.type == sf::Event::TextEntered) {
-        if (m_isSearchActive) {
-            if (event.text.unicode == '\b') {
-                // Handle backspace
-                if (!m_searchText.getString().isEmpty()) {
-                    std::string str = m_searchText.getString();
-                    str.pop_back();
-                    m_searchText.setString(str);
-                    setNeedsRedraw();
-                }
-            } else if (event.text.unicode == '\r') {
-                // Handle enter
-                handleSearch();
-                setNeedsRedraw();
-            } else {
-                // Handle regular text input
-                m_searchText.setString(m_searchText.getString() + static_cast<char>(event.text.unicode));
-                setNeedsRedraw();
-            }
+    } else if (event.type == sf::Event::MouseButtonReleased) {
+        if (event.mouseButton.button == sf::Mouse::Right) {
+            m_isPanning = false;
+        }
+    } else if (event.type == sf::Event::MouseMoved) {
+        if (m_isPanning) {
+            sf::Vector2i position(event.mouseMove.x, event.mouseMove.y);
+            panView(position - m_lastPanPosition);
+            m_lastPanPosition = position;
+        }
+    } else if (event.type == sf::Event::MouseWheelScrolled) {
+        if (event.mouseWheelScroll.wheel == sf::Mouse::VerticalWheel) {
+            float factor = event.mouseWheelScroll.delta > 0 ? 0.8f : 1.25f;
+            zoomView(factor, sf::Vector2i(event.mouseWheelScroll.x, event.mouseWheelScroll.y));
+        }
+    } else if (event.type == sf::Event::KeyPressed && !m_isSearchActive && m_weatherOverlay.isOpen()) {
+        // Forecast overlay: W shows or hides it, V switches variable, Space
+        // plays the time steps and the arrow keys step through them
+        switch (event.key.code) {
+        case sf::Keyboard::W: m_weatherOverlay.setVisible(!m_weatherOverlay.isVisible()); break;
+        case sf::Keyboard::V: m_weatherOverlay.nextVariable(); break;
+        case sf::Keyboard::Space: m_weatherOverlay.setPlaying(!m_weatherOverlay.isPlaying()); break;
+        case sf::Keyboard::Left: m_weatherOverlay.stepBy(-1); break;
+        case sf::Keyboard::Right: m_weatherOverlay.stepBy(1); break;
+        default: return;
         }
+        setNeedsRedraw();
     }
 }
 
 void Map::draw(sf::RenderWindow& window) {
-    if (!m_needsRedraw) return;
+    // Pick up edits made to the dataset on disk
+    if (!m_fileWatcher.poll().empty()) {
+        reloadChangedFeatures();
+    }
 
-    window.clear(); // Clear the window before drawing
+    m_weatherOverlay.update();
 
-    // Draw the map sprite if it exists
-    if (m_mapTexture.getSize().x > 0 && m_mapTexture.getSize().y > 0) {
-        window.draw(m_mapSprite);
+    // Continue an unfinished label placement pass within the frame budget
+    if (m_labelsEnabled && !m_labelEngine.isPlacementComplete()) {
+        m_labelEngine.update(LabelPlacementBudget);
     }
 
+    // Map content is drawn through the pannable map view
+    window.setView(m_mapView);
+
+    m_rasterLayer.draw(window, m_mapView, m_worldSize);
+
+    // Pre-rendered tiles already contain the vector shapes
+    if (m_tileLayer.isOpen()) {
+        m_tileLayer.draw(window, m_mapView, m_worldSize);
+    } else {
+        for (const auto& shape : m_vectorShapes) {
+            window.draw(shape);
+        }
+    }
+
+    m_weatherOverlay.draw(window, m_mapView, m_worldSize);
+
+    // Labels and UI are in screen space
+    window.setView(window.getDefaultView());
+    if (m_labelsEnabled) {
+        m_labelEngine.draw(window);
+    }
+    m_weatherOverlay.drawLegend(window, m_font);
+
     window.draw(m_layersButton);
     window.draw(m_searchButton);
     window.draw(m_exitButton);
@@ -167,16 +251,51 @@ void Map::draw(sf::RenderWindow& window) {
 
     if (m_isSearchActive) {
         window.draw(m_searchBar);
-        window.draw(m_searchText);
+        m_searchInput.draw(window);
     }
 
-    // Draw vector shapes
-    for (const auto& shape : m_vectorShapes) {
-        window.draw(shape);
+    if (m_isLoading) {
+        window.draw(m_loadingText);
     }
 
-    window.display(); // Display the window contents
-    m_needsRedraw = false;
+    m_needsRedraw = m_isLoading || (m_labelsEnabled && !m_labelEngine.isPlacementComplete()) || m_rasterLayer.isBusy() || m_weatherOverlay.isBusy();
+}
+
+void Map::applyPowerProfile(const PowerProfile& profile) {
+    // A pass left unfinished resumes once labels are back on
+    m_labelsEnabled = profile.mapLabels;
+    m_rasterLayer.setDetailBias(profile.mapDetailBias);
+    m_rasterLayer.setWarpThreads(profile.workerThreads);
+    m_tileLayer.setDetailBias(profile.mapDetailBias);
+    m_weatherOverlay.setResampleDivisor(profile.overlayDivisor);
+    setNeedsRedraw();
+}
+
+void Map::onSuspend() {
+    m_suspended = true;
+    std::vector<sf::VertexArray>().swap(m_vectorShapes);
+    m_labelEngine.release();
+    m_rasterLayer.releaseCache();
+    m_tileLayer.releaseCache();
+    m_weatherOverlay.releaseCache();
+}
+
+void Map::onResume() {
+    m_suspended = false;
+    rebuildVectorShapes();
+    rebuildLabels();
+    setNeedsRedraw();
+}
+
+AppMemory Map::memoryUsage() const {
+    AppMemory memory;
+    memory.cpuBytes = m_geometry.memoryBytes() + m_labelEngine.memoryBytes() + m_weatherOverlay.cpuBytes() +
+                      appmemory::vectorBytes(m_vectorShapes);
+    for (const sf::VertexArray& shape : m_vectorShapes) {
+        memory.cpuBytes += shape.getVertexCount() * sizeof(sf::Vertex);
+    }
+    memory.gpuBytes = m_rasterLayer.textureBytes() + m_tileLayer.textureBytes() + m_weatherOverlay.textureBytes();
+    return memory;
 }
 
 void Map::setNeedsRedraw() {
@@ -189,171 +308,303 @@ bool Map::needsRedraw() const {
 
 void Map::loadMapData(const std::string& filename) {
     std::cout << "Loading map data from: " << filename << std::endl;
-    m_currentDataset.reset(static_cast<GDALDataset*>(GDALOpenEx(filename.c_str(), GDAL_OF_VECTOR | GDAL_OF_RASTER, nullptr, nullptr, nullptr)));
-    if (!m_currentDataset) {
-        std::cerr << "Failed to load map data from " << filename << std::endl;
+    // A newer request replaces one that is still loading
+    m_loadToken.cancel();
+    m_loadToken = CancellationToken();
+    m_isLoading = true;
+    // A patch in flight was read against the map being replaced
+    m_patchToken.cancel();
+    m_isPatching = false;
+    m_patchAgain = false;
+    m_loadingText.setString("Loading " + std::filesystem::path(filename).filename().string() + "...");
+    setNeedsRedraw();
+
+    // The user is waiting on this one
+    const CancellationToken token = m_loadToken;
+    const MapStyle style = m_style;
+    const sf::Vector2f worldSize = m_worldSize;
+    TaskScheduler::instance().submitThen(TaskScheduler::Priority::High, token,
+        [filename, token, style, worldSize] { return readMapData(filename, token, style, worldSize); },
+        [this](const std::shared_ptr<LoadedMap>& loaded) { applyMapData(*loaded); });
+}
+
+std::shared_ptr<Map::LoadedMap> Map::readMapData(const std::string& filename, const CancellationToken& token,
+                                                 const MapStyle& style, sf::Vector2f worldSize) {
+    auto start = std::chrono::steady_clock::now();
+    auto loaded = std::make_shared<LoadedMap>();
+    loaded->filename = filename;
+    // Other loads and patches may run the same phases meanwhile; count only this one
+    AllocationTracker::Sink allocations;
+    AllocationTracker::Scope sinkScope(allocations);
+    {
+        AllocationTracker::Scope scope("map.open");
+        loaded->dataset.reset(static_cast<GDALDataset*>(GDALOpenEx(filename.c_str(), GDAL_OF_VECTOR | GDAL_OF_RASTER, nullptr, nullptr, nullptr)));
+        if (!loaded->dataset || token.isCancelled()) return loaded;
+
+        // Watch GeoPackages so pipeline updates are patched in without a reload
+        if (std::filesystem::path(filename).extension() == ".gpkg") {
+            loaded->tracked = loaded->changes.snapshot(filename);
+        }
+    }
+    loaded->geometry.load(loaded->dataset.get(), &token);
+    if (token.isCancelled()) return loaded;
+    loaded->shapes = buildVectorShapes(loaded->geometry, style, worldSize);
+    loaded->milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    loaded->allocations = allocations.report("map.");
+    return loaded;
+}
+
+void Map::applyMapData(LoadedMap& loaded) {
+    m_isLoading = false;
+    setNeedsRedraw();
+    if (!loaded.dataset) {
+        std::cerr << "Failed to load map data from " << loaded.filename << std::endl;
+        m_patchAgain = false;
         return;
     }
 
-    // Load raster data
-    GDALRasterBand* band = m_currentDataset->GetRasterBand(1);
-    if (band) {
-        int width = band->GetXSize();
-        int height = band->GetYSize();
-        std::vector<float> data(width * height);
-        band->RasterIO(GF_Read, 0, 0, width, height, data.data(), width, height, GDT_Float32, 0, 0);
-
-        m_mapImage.create(width, height);
-        for (int y = 0; y < height; ++y) {
-            for (int x = 0; x < width; ++x) {
-                float value = data[y * width + x];
-                sf::Color color = sf::Color::White; // Default color
-                if (value > 0) {
-                    color = sf::Color::Black; // Example: change color based on value
-                }
-                m_mapImage.setPixel(x, y, color);
-            }
-        }
+    m_fileWatcher.unwatchAll();
+    m_currentFilename = loaded.filename;
+    m_currentDataset = std::move(loaded.dataset);
+    m_changeTracker = std::move(loaded.changes);
+    if (loaded.tracked) {
+        m_fileWatcher.watch(m_currentFilename);
+    }
+
+    // Rasters are warped into the same projection as the vectors
+    m_rasterLayer.open(m_currentFilename);
 
-        m_mapTexture.loadFromImage(m_mapImage);
-        m_mapSprite.setTexture(m_mapTexture);
-        std::cout << "Raster data loaded successfully." << std::endl;
+    m_geometry = std::move(loaded.geometry);
+    m_vectorShapes = std::move(loaded.shapes);
+    // A load that finishes after the user left; onResume() builds the rest
+    if (m_suspended) {
+        std::vector<sf::VertexArray>().swap(m_vectorShapes);
     } else {
-        std::cerr << "No raster band found in the dataset." << std::endl;
+        rebuildLabels();
+    }
+    std::cout << "Vector data loaded in " << loaded.milliseconds << " ms (" << m_geometry.features().size() << " features, "
+              << m_labelEngine.candidateCount() << " label candidates)." << std::endl
+              << loaded.allocations;
+
+    // A pre-rendered pyramid next to the dataset ("<name>.mbtiles" or a
+    // "<name>_tiles" z/x/y directory) replaces drawing the raw vectors
+    std::filesystem::path path(m_currentFilename);
+    std::filesystem::path mbtiles = std::filesystem::path(path).replace_extension(".mbtiles");
+    std::filesystem::path tileDirectory = path.parent_path() / (path.stem().string() + "_tiles");
+    if (!m_tileLayer.open(mbtiles.string())) {
+        m_tileLayer.open(tileDirectory.string());
     }
 
-    // Load vector data
-    loadVectorData(m_currentDataset.get());
-
-    updateMapView();
+    // The file changed again while it was loading
+    if (m_patchAgain) {
+        m_patchAgain = false;
+        if (loaded.tracked) reloadChangedFeatures();
+    }
 }
 
+void Map::loadForecast() {
+    std::string path;
+    if (const char* forecast = std::getenv("MAP_FORECAST")) {
+        path = forecast;
+    } else {
+        for (const char* candidate : ForecastFiles) {
+            if (std::filesystem::exists(candidate)) {
+                path = candidate;
+                break;
+            }
+        }
+    }
+    if (path.empty()) return;
 
-void Map::loadVectorData(GDALDataset* dataset) {
-    m_vectorShapes.clear();
-    std::cout << "Loading vector data..." << std::endl;
+    std::cout << "Loading forecast from: " << path << std::endl;
+    if (m_weatherOverlay.open(path)) {
+        std::cout << "Forecast overlay: W toggles, V switches variable, Space plays, Left/Right step" << std::endl;
+    }
+}
 
-    // Get the spatial reference of the dataset
-    OGRSpatialReference* datasetSRS = nullptr;
-    if (dataset->GetLayerCount() > 0) {
-        datasetSRS = dataset->GetLayer(0)->GetSpatialRef();
+void Map::reloadChangedFeatures() {
+    // applyMapData() comes back here for edits made while loading
+    if (m_isPatching || m_isLoading) {
+        m_patchAgain = true;
+        return;
     }
+    if (!m_currentDataset) return;
 
-    // Create a transformation to the window's coordinate system
-    OGRSpatialReference windowSRS;
-    windowSRS.SetWellKnownGeogCS("WGS84");
-    OGRCoordinateTransformation* coordTransform = nullptr;
-    if (datasetSRS) {
-        coordTransform = OGRCreateCoordinateTransformation(datasetSRS, &windowSRS);
+    // The store refers to layers by index, so the worker checks the file still has these
+    std::vector<std::string> layerNames;
+    for (int i = 0; i < m_currentDataset->GetLayerCount(); ++i) {
+        layerNames.push_back(m_currentDataset->GetLayer(i)->GetName());
     }
 
-    for (int i = 0; i < dataset->GetLayerCount(); ++i) {
-        OGRLayer* layer = dataset->GetLayer(i);
-        if (!layer) {
-            std::cout << "Layer " << i << " is null" << std::endl;
-            continue;
-        }
+    // Diffing and reading run off the main thread; the tracker comes back with the patch
+    auto patch = std::make_shared<MapPatch>();
+    patch->changes = std::move(m_changeTracker);
+    m_isPatching = true;
+    m_patchToken = CancellationToken();
+    const CancellationToken token = m_patchToken;
+    const std::string filename = m_currentFilename;
+    const MapStyle style = m_style;
+    const sf::Vector2f worldSize = m_worldSize;
+    TaskScheduler::instance().submitThen(TaskScheduler::Priority::Normal, token,
+        [patch, token, filename, layerNames, style, worldSize] {
+            if (!token.isCancelled()) readMapPatch(*patch, filename, layerNames, style, worldSize);
+            return patch;
+        },
+        [this](const std::shared_ptr<MapPatch>& patch) { applyMapPatch(*patch); });
+}
 
-        std::cout << "Processing layer " << i << std::endl;
+void Map::applyMapPatch(MapPatch& patch) {
+    m_isPatching = false;
+    m_changeTracker = std::move(patch.changes);
+
+    switch (patch.outcome) {
+    case MapPatch::Outcome::Unchanged:
+        break;
+    case MapPatch::Outcome::Failed:
+        std::cerr << patch.message << std::endl;
+        break;
+    case MapPatch::Outcome::Retry:
+        // Most likely still being written; the map keeps showing the last good state
+        std::cerr << patch.message << std::endl;
+        m_fileWatcher.retry(m_currentFilename);
+        break;
+    case MapPatch::Outcome::Reload:
+        std::cout << patch.message << std::endl;
+        m_patchAgain = false;
+        loadMapData(m_currentFilename);
+        return;
+    case MapPatch::Outcome::Patched: {
+        auto start = std::chrono::steady_clock::now();
+        if (m_tileLayer.isOpen()) {
+            // The pre-rendered pyramid no longer matches; draw the live vectors
+            std::cout << "Tiles are out of date after the update, drawing vectors instead" << std::endl;
+            m_tileLayer.close();
+        }
 
-        layer->ResetReading();
-        OGRFeature* feature;
-        while ((feature = layer->GetNextFeature()) != nullptr) {
-            OGRGeometry* geom = feature->GetGeometryRef();
-            if (!geom) {
-                OGRFeature::DestroyFeature(feature);
-                continue;
+        m_currentDataset = std::move(patch.dataset);
+        GeometryStore::PatchResult result = m_geometry.applyPatch(patch.geometry);
+        // A suspended map has no shapes or labels; onResume() builds them from the patched store
+        if (!m_suspended) {
+            if (result.renumbered || m_vectorShapes.size() != result.firstNewPart) {
+                rebuildVectorShapes();
+            } else {
+                // Dropped parts keep their slot as an empty array, which draws nothing
+                for (std::uint32_t part : result.removedParts) {
+                    m_vectorShapes[part] = sf::VertexArray();
+                }
+                m_vectorShapes.insert(m_vectorShapes.end(), std::make_move_iterator(patch.shapes.begin()),
+                                      std::make_move_iterator(patch.shapes.end()));
             }
 
-            processGeometry(geom, coordTransform);
-            OGRFeature::DestroyFeature(feature);
+            std::vector<std::uint64_t> keys;
+            for (const auto& change : patch.geometry.changes) {
+                keys.push_back(GeometryStore::featureKey(change.layer, change.fid));
+            }
+            std::sort(keys.begin(), keys.end());
+            m_labelEngine.removeLabels(keys);
+            const std::size_t firstAdded = m_labelEngine.candidateSlots();
+            for (const GeometryStore::Feature& changed : patch.geometry.features.features()) {
+                if (const GeometryStore::Feature* feature = m_geometry.findFeature(changed.layer, changed.fid)) {
+                    addFeatureLabel(*feature);
+                }
+            }
+            m_labelEngine.finalizeAdded(firstAdded);
+            onViewChanged();
         }
+        setNeedsRedraw();
+
+        double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Patched " << patch.geometry.changes.size() << " changed features of " << m_currentFilename
+                  << " (read in " << patch.milliseconds << " ms, applied in " << milliseconds << " ms)" << std::endl;
+        break;
+    }
     }
 
-    if (coordTransform) {
-        OCTDestroyCoordinateTransformation(coordTransform);
+    if (m_patchAgain) {
+        m_patchAgain = false;
+        reloadChangedFeatures();
     }
+}
 
-    std::cout << "Vector data loaded successfully." << std::endl;
+void Map::rebuildVectorShapes() {
+    m_vectorShapes = buildVectorShapes(m_geometry, m_style, m_worldSize);
 }
 
-void Map::processGeometry(OGRGeometry* geom, OGRCoordinateTransformation* coordTransform) {
-    OGRwkbGeometryType type = wkbFlatten(geom->getGeometryType());
-    sf::VertexArray shape;
-
-    if (type == wkbLineString || type == wkbLinearRing || type == wkbCircularString) {
-        shape = sf::VertexArray(sf::LineStrip);
-        OGRSimpleCurve* curve = dynamic_cast<OGRSimpleCurve*>(geom);
-        if (curve) {
-            int numPoints = curve->getNumPoints();
-            for (int j = 0; j < numPoints; ++j) {
-                OGRPoint point;
-                curve->getPoint(j, &point);
-                double x = point.getX(), y = point.getY();
-                if (coordTransform) coordTransform->Transform(1, &x, &y);
-                double scaledX = (x + 180.0) * (m_window.getSize().x / 360.0);
-                double scaledY = (90.0 - y) * (m_window.getSize().y / 180.0);
-                shape.append(sf::Vertex(sf::Vector2f(scaledX, scaledY), sf::Color::Red));
-            }
+void Map::rebuildLabels() {
+    m_labelEngine.clear();
+    for (const GeometryStore::Feature& feature : m_geometry.features()) {
+        addFeatureLabel(feature);
+    }
+    m_labelEngine.finalize();
+    onViewChanged();
+}
 
-            // For CircularString, add more points to smooth the curve
-            if (type == wkbCircularString) {
-                sf::VertexArray smoothedShape(sf::LineStrip);
-                int smoothPoints = 100;
-                for (int i = 0; i < shape.getVertexCount() - 1; ++i) {
-                    sf::Vector2f p1 = shape[i].position;
-                    sf::Vector2f p2 = shape[i + 1].position;
-                    for (int j = 0; j < smoothPoints; ++j) {
-                        float t = j / static_cast<float>(smoothPoints);
-                        sf::Vector2f interpolated = p1 + (p2 - p1) * t;
-                        smoothedShape.append(sf::Vertex(interpolated, sf::Color::Red));
-                    }
-                }
-                shape = smoothedShape;
-            }
+void Map::addFeatureLabel(const GeometryStore::Feature& feature) {
+    if (feature.name.empty()) return;
+    sf::String name = sf::String::fromUtf8(feature.name.begin(), feature.name.end());
+    const std::uint64_t key = GeometryStore::featureKey(feature.layer, feature.fid);
+
+    // Points are labelled at the point, lines once at the middle of their longest part
+    const auto& parts = m_geometry.parts();
+    const auto& vertices = m_geometry.vertices();
+    const GeometryStore::Part* longest = nullptr;
+    float longestLength = 0.f;
+    for (std::uint32_t p = feature.firstPart; p < feature.firstPart + feature.partCount; ++p) {
+        const GeometryStore::Part& part = parts[p];
+        if (part.type == GeometryStore::PartType::Point) {
+            m_labelEngine.addPointLabel(name, projectToWorld(vertices[part.firstVertex]), PointLabelPriority, key);
+            return;
+        }
+        if (part.type != GeometryStore::PartType::Line) continue;
 
-            m_vectorShapes.push_back(shape);
+        float length = 0.f;
+        for (std::uint32_t i = 1; i < part.vertexCount; ++i) {
+            sf::Vector2f d = projectToWorld(vertices[part.firstVertex + i]) - projectToWorld(vertices[part.firstVertex + i - 1]);
+            length += std::sqrt(d.x * d.x + d.y * d.y);
         }
-    } else if (type == wkbPolygon) {
-        OGRPolygon* poly = dynamic_cast<OGRPolygon*>(geom);
-        if (poly) {
-            processGeometry(poly->getExteriorRing(), coordTransform);
-            for (int r = 0; r < poly->getNumInteriorRings(); ++r) {
-                processGeometry(poly->getInteriorRing(r), coordTransform);
-            }
+        if (length > longestLength) {
+            longest = &part;
+            longestLength = length;
         }
-    } else if (type == wkbMultiLineString || type == wkbMultiPolygon || type == wkbGeometryCollection) {
-        OGRGeometryCollection* collection = dynamic_cast<OGRGeometryCollection*>(geom);
-        if (collection) {
-            for (int j = 0; j < collection->getNumGeometries(); ++j) {
-                processGeometry(collection->getGeometryRef(j), coordTransform);
-            }
-        }
-    } else if (type == wkbCompoundCurve) {
-        OGRCompoundCurve* compound = dynamic_cast<OGRCompoundCurve*>(geom);
-        if (compound) {
-            for (int j = 0; j < compound->getNumCurves(); ++j) {
-                processGeometry(compound->getCurve(j), coordTransform);
-            }
+    }
+    if (!longest) return;
+
+    float remaining = longestLength / 2.f;
+    for (std::uint32_t i = 1; i < longest->vertexCount; ++i) {
+        sf::Vector2f a = projectToWorld(vertices[longest->firstVertex + i - 1]);
+        sf::Vector2f d = projectToWorld(vertices[longest->firstVertex + i]) - a;
+        float segmentLength = std::sqrt(d.x * d.x + d.y * d.y);
+        if (segmentLength >= remaining && segmentLength > 0.f) {
+            float angle = std::atan2(d.y, d.x) * 180.f / 3.14159265f;
+            m_labelEngine.addLineLabel(name, a + d * (remaining / segmentLength), angle, longestLength, longestLength, key);
+            return;
         }
-    } else {
-        std::cout << "Unsupported geometry type: " << OGRGeometryTypeToName(type) << std::endl;
+        remaining -= segmentLength;
     }
 }
 
-void Map::updateMapView() {
-    // Adjust the map sprite to fit the window
-    float scaleX = m_window.getSize().x / static_cast<float>(m_mapImage.getSize().x);
-    float scaleY = m_window.getSize().y / static_cast<float>(m_mapImage.getSize().y);
-    float scale = std::min(scaleX, scaleY);
-    m_mapSprite.setScale(scale, scale);
-
-    // Center the map in the window
-    sf::FloatRect mapBounds = m_mapSprite.getGlobalBounds();
-    m_mapSprite.setPosition(
-        (m_window.getSize().x - mapBounds.width) / 2.f,
-        (m_window.getSize().y - mapBounds.height) / 2.f
-    );
+sf::Vector2f Map::projectToWorld(const GeometryStore::Coordinate& coordinate) const {
+    return ::projectToWorld(coordinate, m_worldSize);
+}
+
+void Map::zoomView(float factor, sf::Vector2i pixel) {
+    // Keep the world point under the cursor fixed while zooming
+    sf::Vector2f before = m_window.mapPixelToCoords(pixel, m_mapView);
+    m_mapView.zoom(factor);
+    sf::Vector2f after = m_window.mapPixelToCoords(pixel, m_mapView);
+    m_mapView.move(before - after);
+    onViewChanged();
+}
+
+void Map::panView(sf::Vector2i delta) {
+    float unitsPerPixel = m_mapView.getSize().x / m_window.getSize().x;
+    m_mapView.move(-delta.x * unitsPerPixel, -delta.y * unitsPerPixel);
+    onViewChanged();
+}
+
+void Map::onViewChanged() {
+    m_labelEngine.setView(m_mapView, m_window.getSize());
+    setNeedsRedraw();
 }
 
 void Map::toggleLayersPanel() {
@@ -382,16 +633,14 @@ void Map::toggleSearch() {
     m_isSearchActive = !m_isSearchActive;
     if (m_isSearchActive) {
         m_searchBar.setPosition(0, 0);
-        m_searchText.setPosition(10, 10);
     } else {
         m_searchBar.setPosition(0, -50);
-        m_searchText.setPosition(10, -40);
-        m_searchText.setString("");
+        m_searchInput.clear();
     }
 }
 
 void Map::handleSearch() {
-    std::string searchQuery = m_searchText.getString();
+    std::string searchQuery = m_searchInput.toUtf8();
     // Implement search functionality here
     std::cout << "Searching for: " << searchQuery << std::endl;
     toggleSearch();
@@ -3,26 +3,48 @@
 #include <SFML/Graphics.hpp>
 #include <gdal_priv.h>
 #include <ogrsf_frmts.h>
+#include "geometrystore.hpp"
+#include "geopackagechanges.hpp"
+#include "labelengine.hpp"
+#include "mappatch.hpp"
+#include "mapstyle.hpp"
+#include "projection.hpp"
+#include "rasterlayer.hpp"
+#include "tilelayer.hpp"
+#include "weatheroverlay.hpp"
+#include "../ui/app.hpp"
+#include "../ui/textinput.hpp"
+#include "../utils/filewatcher.hpp"
+#include "../utils/powergovernor.hpp"
+#include "../utils/taskscheduler.hpp"
 #include <string>
 #include <vector>
 #include <memory>
 
-class Map {
+class Map : public App {
 public:
     Map(sf::RenderWindow& window);
-    ~Map();
+    ~Map() override;
 
-    void handleEvent(const sf::Event& event);
-    void draw(sf::RenderWindow& window);
-    void resetShouldExit() { m_shouldExit = false; }
+    const char* name() const override { return "Map"; }
+    void handleEvent(const sf::Event& event) override;
+    void draw(sf::RenderWindow& window) override;
+    void resetShouldExit() override { m_shouldExit = false; }
     void setNeedsRedraw();
     bool needsRedraw() const;
-    bool shouldReturnToMain() const { return m_shouldExit; }
+    bool shouldReturnToMain() const override { return m_shouldExit; }
+    // Keeps the geometry and drops what is built from it: vector shapes,
+    // labels, raster and tile textures and the resampled overlay
+    void onSuspend() override;
+    void onResume() override;
+    AppMemory memoryUsage() const override;
+    // Label placement, raster detail, overlay resolution and warp threads
+    void applyPowerProfile(const PowerProfile& profile);
 
 private:
     sf::RenderWindow& m_window;
     sf::Font m_font;
-    sf::Text m_searchText;
+    TextInput m_searchInput;
     sf::RectangleShape m_searchBar;
     sf::RectangleShape m_layersButton;
     sf::RectangleShape m_searchButton;
@@ -33,6 +55,10 @@ private:
     bool m_isSearchActive;
     bool m_shouldExit = false;
     bool m_needsRedraw;
+    bool m_labelsEnabled = true;
+    bool m_suspended = false;
+    bool m_isPanning = false;
+    sf::Vector2i m_lastPanPosition;
 
     sf::RectangleShape m_layersPanel;
     sf::RectangleShape m_secondaryPanel;
@@ -40,6 +66,14 @@ private:
     std::vector<sf::RectangleShape> m_baseLayerButtons;
     std::vector<sf::RectangleShape> m_secondaryLayerButtons;
     std::vector<sf::VertexArray> m_vectorShapes; // Store vector shapes
+    sf::View m_mapView;
+    sf::Vector2f m_worldSize; // extent of the whole world in map view coordinates
+    GeometryStore m_geometry;
+    MapStyle m_style;
+    LabelEngine m_labelEngine;
+    RasterLayer m_rasterLayer;
+    TileLayer m_tileLayer;
+    WeatherOverlay m_weatherOverlay;
 
     enum class BaseLayer {
         Satellite,
@@ -51,20 +85,52 @@ private:
     BaseLayer m_currentBaseLayer;
 
     std::unique_ptr<GDALDataset> m_currentDataset;
+    std::string m_currentFilename;
+
+    // Datasets are read on the task scheduler and swapped in on the main thread
+    struct LoadedMap {
+        std::string filename;
+        std::unique_ptr<GDALDataset> dataset; // null if it could not be opened
+        GeometryStore geometry;
+        GeoPackageChangeTracker changes;
+        bool tracked = false;                 // `changes` holds a snapshot
+        std::vector<sf::VertexArray> shapes;
+        double milliseconds = 0.0;
+        std::string allocations;              // per phase, from AllocationTracker
+    };
+    CancellationToken m_loadToken;
+    bool m_isLoading = false;
+    sf::Text m_loadingText;
+
+    FileWatcher m_fileWatcher;
+    GeoPackageChangeTracker m_changeTracker; // lent to the patch task while one runs
+    CancellationToken m_patchToken;
+    bool m_isPatching = false;
+    bool m_patchAgain = false;               // the file changed again while patching
     std::vector<std::string> m_secondaryLayerNames;
-    sf::Image m_mapImage;
-    sf::Texture m_mapTexture;
-    sf::Sprite m_mapSprite;
 
+    // Starts loading in the background; the current map stays up until it is done
     void loadMapData(const std::string& filename);
-    void loadVectorData(GDALDataset* dataset); // Method to load vector data
+    // Runs on a worker, so touches nothing of the Map
+    static std::shared_ptr<LoadedMap> readMapData(const std::string& filename, const CancellationToken& token,
+                                                  const MapStyle& style, sf::Vector2f worldSize);
+    void applyMapData(LoadedMap& loaded);
+    void loadForecast();
+    // Reads edits on a worker and patches them in on the main thread
+    void reloadChangedFeatures();
+    void applyMapPatch(MapPatch& patch);
     void renderMap();
-    void updateMapView();
     void toggleLayersPanel();
     void toggleSecondaryPanel();
     void toggleSearch();
     void handleSearch();
     void changeBaseLayer(BaseLayer layer);
     void addSecondaryLayer(const std::string& layerName);
-    void processGeometry(OGRGeometry* geom, OGRCoordinateTransformation* coordTransform);
+    void rebuildVectorShapes();
+    void rebuildLabels();
+    void addFeatureLabel(const GeometryStore::Feature& feature);
+    sf::Vector2f projectToWorld(const GeometryStore::Coordinate& coordinate) const;
+    void zoomView(float factor, sf::Vector2i pixel);
+    void panView(sf::Vector2i delta);
+    void onViewChanged();
 };
\ No newline at end of file
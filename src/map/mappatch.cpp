@@ -0,0 +1,54 @@
+#include "mappatch.hpp"
+#include "vectorshapes.hpp"
+#include <chrono>
+#include <map>
+
+void readMapPatch(MapPatch& patch, const std::string& filename, const std::vector<std::string>& layerNames,
+                  const MapStyle& style, sf::Vector2f worldSize) {
+    auto start = std::chrono::steady_clock::now();
+
+    std::vector<GeoPackageChangeTracker::Change> changes;
+    if (!patch.changes.diff(changes)) {
+        patch.outcome = MapPatch::Outcome::Retry;
+        patch.message = "Could not diff " + filename + ", trying again once it settles";
+        return;
+    }
+    if (changes.empty()) return;
+
+    patch.dataset.reset(static_cast<GDALDataset*>(
+        GDALOpenEx(filename.c_str(), GDAL_OF_VECTOR | GDAL_OF_RASTER, nullptr, nullptr, nullptr)));
+    if (!patch.dataset) {
+        patch.outcome = MapPatch::Outcome::Failed;
+        patch.message = "Failed to reopen " + filename;
+        return;
+    }
+
+    std::map<std::string, std::uint32_t> layerIndices;
+    bool sameLayers = static_cast<int>(layerNames.size()) == patch.dataset->GetLayerCount();
+    for (int i = 0; i < patch.dataset->GetLayerCount(); ++i) {
+        std::string name = patch.dataset->GetLayer(i)->GetName();
+        layerIndices[name] = static_cast<std::uint32_t>(i);
+        sameLayers = sameLayers && layerNames[i] == name;
+    }
+
+    std::vector<GeometryStore::FeatureChange> featureChanges;
+    for (const auto& change : changes) {
+        auto layer = layerIndices.find(change.table);
+        if (layer == layerIndices.end()) {
+            sameLayers = false;
+            break;
+        }
+        featureChanges.push_back(GeometryStore::FeatureChange{layer->second, change.fid, change.removed});
+    }
+    if (!sameLayers) {
+        patch.dataset.reset();
+        patch.outcome = MapPatch::Outcome::Reload;
+        patch.message = "Layers of " + filename + " changed, reloading it completely";
+        return;
+    }
+
+    patch.geometry = GeometryStore::readChanges(patch.dataset.get(), featureChanges);
+    patch.shapes = buildVectorShapes(patch.geometry.features, style, worldSize);
+    patch.outcome = MapPatch::Outcome::Patched;
+    patch.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
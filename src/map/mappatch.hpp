@@ -0,0 +1,38 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <gdal_priv.h>
+#include "geometrystore.hpp"
+#include "geopackagechanges.hpp"
+#include "mapstyle.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+// A hot reload of an edited GeoPackage, read off the main thread: what
+// changed since the tracker's snapshot, the changed features and their
+// shapes, ready for GeometryStore::applyPatch().
+struct MapPatch {
+    enum class Outcome {
+        Unchanged,
+        Patched,
+        Reload, // the file cannot be patched, load it again
+        Retry,  // the file could not be read completely; the snapshot is kept
+        Failed
+    };
+
+    GeoPackageChangeTracker changes;      // moved in before reading and back after
+    Outcome outcome = Outcome::Unchanged;
+    std::string message;                  // why, unless Unchanged or Patched
+    std::unique_ptr<GDALDataset> dataset; // reopened, so GDAL does not serve features from before the edit
+    GeometryStore::Patch geometry;
+    std::vector<sf::VertexArray> shapes;  // one per part of geometry.features
+    double milliseconds = 0.0;
+};
+
+// Diffs the file against `patch.changes` and reads what changed. `layerNames`
+// are the layers of the store to be patched, in its order; the store refers
+// to layers by index, so a different list makes the outcome Reload. Touches
+// nothing but `patch`, so it runs on a worker.
+void readMapPatch(MapPatch& patch, const std::string& filename, const std::vector<std::string>& layerNames,
+                  const MapStyle& style, sf::Vector2f worldSize);
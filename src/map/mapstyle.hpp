@@ -0,0 +1,11 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+
+// Colours shared by the interactive map and the offline tile renderer, so
+// pre-rendered tiles look the same as the live view.
+struct MapStyle {
+    sf::Color background = sf::Color::White;
+    sf::Color lineColor = sf::Color::Red;
+    sf::Color ringColor = sf::Color::Red;
+};
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+// Coordinate helpers shared by the map view and the tile renderer.
+//
+// Geometry is stored as WGS84 lon/lat. The interactive map shows it in an
+// equirectangular "world" space scaled to the window size; tiles use the
+// usual XYZ Web Mercator scheme.
+namespace projection {
+
+    const double Pi = 3.14159265358979323846;
+    const double MaxMercatorLatitude = 85.0511287798066;
+
+    struct TileId {
+        int z;
+        int x;
+        int y;
+
+        std::uint64_t key() const {
+            return (static_cast<std::uint64_t>(z) << 58) |
+                   (static_cast<std::uint64_t>(x) << 29) |
+                   static_cast<std::uint64_t>(y);
+        }
+    };
+
+    inline double lonToWorldX(double lon, double worldWidth) {
+        return (lon + 180.0) * (worldWidth / 360.0);
+    }
+
+    inline double latToWorldY(double lat, double worldHeight) {
+        return (90.0 - lat) * (worldHeight / 180.0);
+    }
+
+    inline double worldXToLon(double x, double worldWidth) {
+        return x * (360.0 / worldWidth) - 180.0;
+    }
+
+    inline double worldYToLat(double y, double worldHeight) {
+        return 90.0 - y * (180.0 / worldHeight);
+    }
+
+    // Fractional tile coordinates at zoom level z
+    inline double lonToTileX(double lon, int z) {
+        return (lon + 180.0) / 360.0 * static_cast<double>(1 << z);
+    }
+
+    inline double latToTileY(double lat, int z) {
+        if (lat > MaxMercatorLatitude) lat = MaxMercatorLatitude;
+        if (lat < -MaxMercatorLatitude) lat = -MaxMercatorLatitude;
+        double radians = lat * Pi / 180.0;
+        return (1.0 - std::log(std::tan(radians) + 1.0 / std::cos(radians)) / Pi) / 2.0 * static_cast<double>(1 << z);
+    }
+
+    inline double tileXToLon(double x, int z) {
+        return x / static_cast<double>(1 << z) * 360.0 - 180.0;
+    }
+
+    inline double tileYToLat(double y, int z) {
+        double n = Pi - 2.0 * Pi * y / static_cast<double>(1 << z);
+        return 180.0 / Pi * std::atan(std::sinh(n));
+    }
+
+}
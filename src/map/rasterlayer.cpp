@@ -0,0 +1,470 @@
+#include "rasterlayer.hpp"
+#include <gdal_priv.h>
+#include <gdalwarper.h>
+#include <ogr_spatialref.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+
+namespace {
+    const unsigned int TileSize = 256;
+    const int MaxZoom = 18;
+    const std::size_t MaxCachedTiles = 256;
+    // Levels releaseCache() keeps: 2 + 8 tiles at most
+    const std::uint64_t KeptZoom = 1;
+    // Print throughput and hit rate after this many warped tiles
+    const std::size_t StatsInterval = 64;
+
+    // Equirectangular tiles: at zoom z the world is 2^(z+1) x 2^z square tiles
+    double tileDegrees(int z) {
+        return 180.0 / static_cast<double>(1 << z);
+    }
+
+    void initWgs84(OGRSpatialReference& wgs84) {
+        wgs84.SetWellKnownGeogCS("WGS84");
+        wgs84.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+    }
+
+    // Warps one tile of `source` to RGBA. Leaves `pixels` empty if the tile
+    // does not cover any source data.
+    bool warpTile(GDALDataset* source, GDALDriver* memDriver, const OGRSpatialReference& wgs84,
+                  const projection::TileId& tile, std::vector<std::uint8_t>& pixels) {
+        pixels.clear();
+        int bands = source->GetRasterCount() >= 3 ? 3 : 1;
+        double degrees = tileDegrees(tile.z);
+
+        GDALDataset* target = memDriver->Create("", TileSize, TileSize, bands + 1, GDT_Float32, nullptr);
+        if (!target) return false;
+        double geoTransform[6] = {-180.0 + tile.x * degrees, degrees / TileSize, 0.0, 90.0 - tile.y * degrees, 0.0, -degrees / TileSize};
+        target->SetGeoTransform(geoTransform);
+        target->SetSpatialRef(&wgs84);
+
+        void* transformer = GDALCreateGenImgProjTransformer2(GDALDataset::ToHandle(source), GDALDataset::ToHandle(target), nullptr);
+        if (!transformer) {
+            GDALClose(GDALDataset::ToHandle(target));
+            return false;
+        }
+
+        GDALWarpOptions* options = GDALCreateWarpOptions();
+        options->hSrcDS = GDALDataset::ToHandle(source);
+        options->hDstDS = GDALDataset::ToHandle(target);
+        options->nBandCount = bands;
+        options->panSrcBands = static_cast<int*>(CPLMalloc(sizeof(int) * bands));
+        options->panDstBands = static_cast<int*>(CPLMalloc(sizeof(int) * bands));
+        for (int b = 0; b < bands; ++b) {
+            options->panSrcBands[b] = b + 1;
+            options->panDstBands[b] = b + 1;
+        }
+        int hasNoData = FALSE;
+        double noData = source->GetRasterBand(1)->GetNoDataValue(&hasNoData);
+        if (hasNoData) {
+            options->padfSrcNoDataReal = static_cast<double*>(CPLMalloc(sizeof(double) * bands));
+            for (int b = 0; b < bands; ++b) {
+                options->padfSrcNoDataReal[b] = noData;
+            }
+        }
+        options->nDstAlphaBand = bands + 1;
+        options->eResampleAlg = GRA_Bilinear;
+        options->eWorkingDataType = GDT_Float32;
+        options->papszWarpOptions = CSLSetNameValue(options->papszWarpOptions, "INIT_DEST", "0");
+        options->pfnTransformer = GDALGenImgProjTransform;
+        options->pTransformerArg = transformer;
+
+        GDALWarpOperation operation;
+        bool ok = operation.Initialize(options) == CE_None &&
+                  operation.ChunkAndWarpImage(0, 0, TileSize, TileSize) == CE_None;
+
+        std::vector<float> data(static_cast<std::size_t>(bands + 1) * TileSize * TileSize);
+        if (ok) {
+            ok = target->RasterIO(GF_Read, 0, 0, TileSize, TileSize, data.data(), TileSize, TileSize, GDT_Float32,
+                                  bands + 1, nullptr, 0, 0, 0) == CE_None;
+        }
+
+        GDALDestroyGenImgProjTransformer(transformer);
+        GDALDestroyWarpOptions(options);
+        GDALClose(GDALDataset::ToHandle(target));
+        if (!ok) return false;
+
+        // Band sequential floats to RGBA; single band rasters keep the old
+        // black-if-positive styling
+        const std::size_t pixelCount = static_cast<std::size_t>(TileSize) * TileSize;
+        const float* alpha = data.data() + bands * pixelCount;
+        if (std::none_of(alpha, alpha + pixelCount, [](float a) { return a > 0.f; })) return true;
+
+        auto toByte = [](float value) {
+            return static_cast<std::uint8_t>(std::max(0.f, std::min(255.f, value)));
+        };
+        pixels.resize(pixelCount * 4);
+        for (std::size_t i = 0; i < pixelCount; ++i) {
+            std::uint8_t* out = &pixels[i * 4];
+            if (bands == 3) {
+                out[0] = toByte(data[i]);
+                out[1] = toByte(data[pixelCount + i]);
+                out[2] = toByte(data[2 * pixelCount + i]);
+            } else {
+                std::uint8_t value = data[i] > 0.f ? 0 : 255;
+                out[0] = out[1] = out[2] = value;
+            }
+            out[3] = toByte(alpha[i]);
+        }
+        return true;
+    }
+}
+
+struct RasterLayer::Warper {
+    std::unique_ptr<GDALDataset> source;
+    GDALDriver* memDriver = nullptr;
+    OGRSpatialReference wgs84;
+};
+
+RasterLayer::RasterLayer()
+    : m_quad(sf::Quads, 4)
+{
+}
+
+RasterLayer::~RasterLayer() {
+    close();
+}
+
+bool RasterLayer::open(const std::string& path) {
+    close();
+
+    std::unique_ptr<GDALDataset> dataset(static_cast<GDALDataset*>(
+        GDALOpenEx(path.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, nullptr, nullptr, nullptr)));
+    if (!dataset || dataset->GetRasterCount() == 0) {
+        std::cerr << "No raster band found in the dataset." << std::endl;
+        return false;
+    }
+
+    double geoTransform[6];
+    if (dataset->GetGeoTransform(geoTransform) != CE_None) {
+        std::cerr << "Raster in " << path << " is not georeferenced, not drawing it" << std::endl;
+        return false;
+    }
+
+    OGRSpatialReference wgs84;
+    initWgs84(wgs84);
+    OGRCoordinateTransformation* coordTransform = nullptr;
+    if (const OGRSpatialReference* sourceSRS = dataset->GetSpatialRef()) {
+        coordTransform = OGRCreateCoordinateTransformation(sourceSRS, &wgs84);
+    } else {
+        std::cout << "Raster in " << path << " has no spatial reference, assuming WGS84" << std::endl;
+    }
+
+    // Sample the raster edges, which is enough for the usual projections
+    const int Samples = 16;
+    int width = dataset->GetRasterXSize();
+    int height = dataset->GetRasterYSize();
+    bool first = true;
+    for (int i = 0; i <= Samples; ++i) {
+        for (int j = 0; j <= Samples; ++j) {
+            if (i != 0 && i != Samples && j != 0 && j != Samples) continue;
+            double px = width * static_cast<double>(i) / Samples;
+            double py = height * static_cast<double>(j) / Samples;
+            double x = geoTransform[0] + px * geoTransform[1] + py * geoTransform[2];
+            double y = geoTransform[3] + px * geoTransform[4] + py * geoTransform[5];
+            if (coordTransform && !coordTransform->Transform(1, &x, &y)) continue;
+            if (first) {
+                m_west = m_east = x;
+                m_south = m_north = y;
+                first = false;
+            }
+            m_west = std::min(m_west, x);
+            m_east = std::max(m_east, x);
+            m_south = std::min(m_south, y);
+            m_north = std::max(m_north, y);
+        }
+    }
+    if (coordTransform) {
+        OCTDestroyCoordinateTransformation(coordTransform);
+    }
+    if (first) {
+        std::cerr << "Could not transform the raster extent of " << path << std::endl;
+        return false;
+    }
+
+    // No point in warping finer than the source resolution
+    double degreesPerPixel = std::max((m_east - m_west) / width, 1e-9);
+    m_maxZoom = static_cast<int>(std::ceil(std::log2(tileDegrees(0) / (TileSize * degreesPerPixel))));
+    m_maxZoom = std::max(0, std::min(m_maxZoom, MaxZoom));
+
+    m_path = path;
+    m_open = true;
+    m_stats = Stats();
+    m_warps = CancellationToken();
+
+    std::cout << "Raster layer " << width << "x" << height << " covering lon " << m_west << ".." << m_east
+              << ", lat " << m_south << ".." << m_north << " (up to zoom " << m_maxZoom << ")" << std::endl;
+    return true;
+}
+
+void RasterLayer::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+    }
+    m_warps.cancel();
+    m_warps.wait();
+    m_open = false;
+    m_cache.clear();
+    m_inProgress.clear();
+    m_finished.clear();
+    m_idleWarpers.clear();
+    m_warpTasks = 0;
+}
+
+void RasterLayer::releaseCache() {
+    std::vector<std::unique_ptr<Warper>> warpers; // closed outside the lock
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+        std::vector<WarpedTile>().swap(m_finished);
+        warpers.swap(m_idleWarpers);
+    }
+    for (auto it = m_cache.begin(); it != m_cache.end();) {
+        if ((it->first >> 58) > KeptZoom) {
+            it = m_cache.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+std::size_t RasterLayer::textureBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : m_cache) {
+        if (!entry.second.empty) bytes += static_cast<std::size_t>(TileSize) * TileSize * 4;
+    }
+    return bytes;
+}
+
+bool RasterLayer::isBusy() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return !m_queue.empty() || !m_inProgress.empty() || !m_finished.empty();
+}
+
+RasterLayer::Stats RasterLayer::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
+
+void RasterLayer::scheduleWarps() {
+    const unsigned int limit = m_warpThreads;
+    const unsigned int maxTasks = limit == 0 ? TaskScheduler::instance().activeWorkers() : limit;
+    unsigned int start = 0;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        while (m_warpTasks + start < maxTasks && m_warpTasks + start < m_queue.size()) ++start;
+        m_warpTasks += start;
+    }
+    for (unsigned int i = 0; i < start; ++i) {
+        TaskScheduler::instance().submit(TaskScheduler::Priority::High, m_warps, [this] { warpNext(); });
+    }
+}
+
+void RasterLayer::warpNext() {
+    projection::TileId tile;
+    std::unique_ptr<Warper> warper;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_queue.empty() || m_warps.isCancelled()) {
+            --m_warpTasks;
+            return;
+        }
+        tile = m_queue.front();
+        m_queue.pop_front();
+        m_inProgress.insert(tile.key());
+        if (!m_idleWarpers.empty()) {
+            warper = std::move(m_idleWarpers.back());
+            m_idleWarpers.pop_back();
+        }
+    }
+
+    if (!warper) {
+        warper = std::make_unique<Warper>();
+        warper->source.reset(static_cast<GDALDataset*>(
+            GDALOpenEx(m_path.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, nullptr, nullptr, nullptr)));
+        warper->memDriver = GetGDALDriverManager()->GetDriverByName("MEM");
+        initWgs84(warper->wgs84);
+    }
+
+    WarpedTile warped;
+    warped.tile = tile;
+    auto start = std::chrono::steady_clock::now();
+    if (!warper->source || !warper->memDriver) {
+        // Left empty, so the tile is not asked for again
+        std::cerr << "Raster warper could not open " << m_path << std::endl;
+        warper.reset();
+    } else if (!warpTile(warper->source.get(), warper->memDriver, warper->wgs84, tile, warped.pixels)) {
+        std::cerr << "Failed to warp raster tile " << tile.z << "/" << tile.x << "/" << tile.y << std::endl;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    bool more;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_inProgress.erase(tile.key());
+        m_finished.push_back(std::move(warped));
+        if (warper) m_idleWarpers.push_back(std::move(warper));
+        ++m_stats.warpedTiles;
+        m_stats.warpSeconds += seconds;
+
+        if (m_stats.warpedTiles % StatsInterval == 0) {
+            double tilesPerSecond = m_stats.warpedTiles / std::max(m_stats.warpSeconds, 1e-9);
+            double hitRate = m_stats.lookups > 0 ? 100.0 * m_stats.hits / m_stats.lookups : 0.0;
+            std::cout << "Raster warp: " << m_stats.warpedTiles << " tiles, " << std::fixed << std::setprecision(1)
+                      << tilesPerSecond << " tiles/s (" << tilesPerSecond * TileSize * TileSize / 1e6 << " Mpx/s), cache hit rate "
+                      << hitRate << "%" << std::defaultfloat << std::endl;
+        }
+        // Keep going as a new task, so queued work of other apps gets a turn in between
+        more = !m_queue.empty();
+        if (!more) --m_warpTasks;
+    }
+    if (more) {
+        TaskScheduler::instance().submit(TaskScheduler::Priority::High, m_warps, [this] { warpNext(); });
+    }
+}
+
+void RasterLayer::collectFinishedTiles() {
+    std::vector<WarpedTile> finished;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        finished.swap(m_finished);
+    }
+
+    // Textures have to be created on the render thread
+    for (WarpedTile& warped : finished) {
+        CachedTile& cached = m_cache[warped.tile.key()];
+        cached.lastUsed = m_frame;
+        cached.empty = warped.pixels.empty() || !cached.texture.create(TileSize, TileSize);
+        if (!cached.empty) {
+            cached.texture.update(warped.pixels.data());
+            cached.texture.setSmooth(true);
+        }
+    }
+}
+
+int RasterLayer::chooseZoom(const sf::View& view, sf::Vector2f worldSize, unsigned int viewportWidth) const {
+    // Pick the level whose tiles are closest to one texel per screen pixel
+    double worldPixels = worldSize.x * viewportWidth / view.getSize().x;
+    int z = static_cast<int>(std::round(std::log2(std::max(worldPixels / (2.0 * TileSize), 1.0)))) - m_detailBias;
+    return std::max(0, std::min(z, m_maxZoom));
+}
+
+void RasterLayer::draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize) {
+    if (!m_open) return;
+    ++m_frame;
+    collectFinishedTiles();
+
+    sf::Vector2f topLeft = view.getCenter() - view.getSize() / 2.f;
+    sf::Vector2f bottomRight = view.getCenter() + view.getSize() / 2.f;
+    double west = std::max(projection::worldXToLon(topLeft.x, worldSize.x), m_west);
+    double east = std::min(projection::worldXToLon(bottomRight.x, worldSize.x), m_east);
+    double north = std::min(projection::worldYToLat(topLeft.y, worldSize.y), m_north);
+    double south = std::max(projection::worldYToLat(bottomRight.y, worldSize.y), m_south);
+    if (west >= east || south >= north) return;
+
+    int z = chooseZoom(view, worldSize, target.getSize().x);
+    double degrees = tileDegrees(z);
+    int lastX = (2 << z) - 1;
+    int lastY = (1 << z) - 1;
+    int x0 = std::max(0, static_cast<int>(std::floor((west + 180.0) / degrees)));
+    int x1 = std::min(lastX, static_cast<int>(std::floor((east + 180.0) / degrees)));
+    int y0 = std::max(0, static_cast<int>(std::floor((90.0 - north) / degrees)));
+    int y1 = std::min(lastY, static_cast<int>(std::floor((90.0 - south) / degrees)));
+
+    // Count cache lookups once per view, not once per frame
+    bool viewChanged = view.getCenter() != m_lastViewCenter || view.getSize() != m_lastViewSize;
+    m_lastViewCenter = view.getCenter();
+    m_lastViewSize = view.getSize();
+    std::size_t lookups = 0;
+    std::size_t hits = 0;
+
+    std::vector<projection::TileId> missing;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            projection::TileId tile{z, x, y};
+            ++lookups;
+            auto it = m_cache.find(tile.key());
+            if (it != m_cache.end()) {
+                ++hits;
+                it->second.lastUsed = m_frame;
+                if (!it->second.empty) drawTile(target, it->second.texture, tile, tile, worldSize);
+                continue;
+            }
+            missing.push_back(tile);
+
+            // Stretch the closest cached ancestor until the tile arrives
+            for (int level = 1; level <= z; ++level) {
+                projection::TileId parent{z - level, x >> level, y >> level};
+                auto ancestor = m_cache.find(parent.key());
+                if (ancestor == m_cache.end()) continue;
+                ancestor->second.lastUsed = m_frame;
+                if (!ancestor->second.empty) drawTile(target, ancestor->second.texture, parent, tile, worldSize);
+                break;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (viewChanged) {
+            m_stats.lookups += lookups;
+            m_stats.hits += hits;
+        }
+        // Only what is visible now is worth warping
+        m_queue.clear();
+        for (const projection::TileId& tile : missing) {
+            if (m_inProgress.count(tile.key()) == 0) {
+                m_queue.push_back(tile);
+            }
+        }
+    }
+    if (!missing.empty()) {
+        scheduleWarps();
+    }
+
+    evictOldTiles();
+}
+
+void RasterLayer::drawTile(sf::RenderTarget& target, const sf::Texture& texture, const projection::TileId& tile,
+                           const projection::TileId& area, sf::Vector2f worldSize) {
+    // `area` is `tile` itself or one of its descendants
+    double degrees = tileDegrees(area.z);
+    double west = -180.0 + area.x * degrees;
+    double north = 90.0 - area.y * degrees;
+    float left = static_cast<float>(projection::lonToWorldX(west, worldSize.x));
+    float right = static_cast<float>(projection::lonToWorldX(west + degrees, worldSize.x));
+    float top = static_cast<float>(projection::latToWorldY(north, worldSize.y));
+    float bottom = static_cast<float>(projection::latToWorldY(north - degrees, worldSize.y));
+
+    int shift = area.z - tile.z;
+    float texelSize = static_cast<float>(TileSize) / static_cast<float>(1 << shift);
+    float texLeft = (area.x - (tile.x << shift)) * texelSize;
+    float texTop = (area.y - (tile.y << shift)) * texelSize;
+
+    m_quad[0] = sf::Vertex(sf::Vector2f(left, top), sf::Vector2f(texLeft, texTop));
+    m_quad[1] = sf::Vertex(sf::Vector2f(right, top), sf::Vector2f(texLeft + texelSize, texTop));
+    m_quad[2] = sf::Vertex(sf::Vector2f(right, bottom), sf::Vector2f(texLeft + texelSize, texTop + texelSize));
+    m_quad[3] = sf::Vertex(sf::Vector2f(left, bottom), sf::Vector2f(texLeft, texTop + texelSize));
+    target.draw(m_quad, sf::RenderStates(&texture));
+}
+
+void RasterLayer::evictOldTiles() {
+    if (m_cache.size() <= MaxCachedTiles) return;
+
+    // Drop the least recently drawn tiles
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> byAge;
+    byAge.reserve(m_cache.size());
+    for (const auto& entry : m_cache) {
+        byAge.emplace_back(entry.second.lastUsed, entry.first);
+    }
+    std::sort(byAge.begin(), byAge.end());
+    std::size_t excess = m_cache.size() - MaxCachedTiles;
+    for (std::size_t i = 0; i < excess; ++i) {
+        m_cache.erase(byAge[i].second);
+    }
+}
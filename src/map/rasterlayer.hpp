@@ -0,0 +1,107 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "projection.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Draws a georeferenced raster in the map's equirectangular world space so
+// it lines up with the vector geometry.
+//
+// Only the tiles covering the visible window are warped, at a level that
+// matches the current zoom. Each tile is warped by a High priority
+// TaskScheduler task with a single-threaded GDAL warp; tasks running at the
+// same time each borrow their own GDAL handle, kept for the next tile.
+// Finished tiles are cached per zoom level and uploaded to textures on the
+// render thread.
+class RasterLayer {
+public:
+    struct Stats {
+        std::size_t lookups = 0;
+        std::size_t hits = 0;
+        std::size_t warpedTiles = 0;
+        double warpSeconds = 0.0;
+    };
+
+    RasterLayer();
+    ~RasterLayer();
+
+    RasterLayer(const RasterLayer&) = delete;
+    RasterLayer& operator=(const RasterLayer&) = delete;
+
+    // Returns false if the file has no georeferenced raster band
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_open; }
+    // True while visible tiles are still being warped
+    bool isBusy() const;
+
+    void draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize);
+
+    // Draws `levels` zoom levels coarser than the screen resolution asks for
+    void setDetailBias(int levels) { m_detailBias = levels; }
+    // Tiles warped at once, 0: one per active scheduler worker
+    void setWarpThreads(unsigned int threads) { m_warpThreads = threads; }
+
+    Stats stats() const;
+    // Drops queued warps and every cached tile but the two coarsest levels,
+    // which are enough to draw something while the rest is warped again
+    void releaseCache();
+    std::size_t textureBytes() const;
+
+private:
+    struct CachedTile {
+        sf::Texture texture;
+        bool empty = false;
+        std::uint64_t lastUsed = 0;
+    };
+
+    struct WarpedTile {
+        projection::TileId tile;
+        std::vector<std::uint8_t> pixels; // RGBA, empty if nothing to show
+    };
+
+    // A GDAL handle on the raster, used by one warp task at a time
+    struct Warper;
+
+    std::string m_path;
+    bool m_open = false;
+    double m_west = 0.0;
+    double m_south = 0.0;
+    double m_east = 0.0;
+    double m_north = 0.0;
+    int m_maxZoom = 0;
+    int m_detailBias = 0;
+    std::atomic<unsigned int> m_warpThreads{0};
+
+    std::unordered_map<std::uint64_t, CachedTile> m_cache;
+    std::uint64_t m_frame = 0;
+    sf::Vector2f m_lastViewCenter;
+    sf::Vector2f m_lastViewSize;
+    sf::VertexArray m_quad;
+
+    // Shared with the warp tasks
+    CancellationToken m_warps;
+    mutable std::mutex m_mutex;
+    std::deque<projection::TileId> m_queue;
+    std::unordered_set<std::uint64_t> m_inProgress;
+    std::vector<WarpedTile> m_finished;
+    std::vector<std::unique_ptr<Warper>> m_idleWarpers;
+    unsigned int m_warpTasks = 0; // queued or running
+    Stats m_stats;
+
+    void scheduleWarps();
+    void warpNext();
+    void collectFinishedTiles();
+    void evictOldTiles();
+    void drawTile(sf::RenderTarget& target, const sf::Texture& texture, const projection::TileId& tile, const projection::TileId& area, sf::Vector2f worldSize);
+    int chooseZoom(const sf::View& view, sf::Vector2f worldSize, unsigned int viewportWidth) const;
+};
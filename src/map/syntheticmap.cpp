@@ -0,0 +1,284 @@
+#include "syntheticmap.hpp"
+#include <gdal_priv.h>
+#include <ogrsf_frmts.h>
+#include <ogr_spatialref.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <vector>
+
+namespace {
+    const double Pi = 3.14159265358979323846;
+    // Features land between these latitudes, where the map's projection is usable
+    const double MinLat = -80.0;
+    const double MaxLat = 80.0;
+    const std::uint64_t FeaturesPerTransaction = 100000;
+    const int RasterStripRows = 256;
+
+    enum class Kind { Points, Lines, Polygons, Curves };
+
+    struct LayerPlan {
+        Kind kind;
+        const char* name;
+        OGRwkbGeometryType type;
+        std::uint64_t features;
+    };
+
+    OGRLinearRing* ring(double lon, double lat, double radius, unsigned int vertices, bool clockwise) {
+        OGRLinearRing* ring = new OGRLinearRing();
+        for (unsigned int i = 0; i <= vertices; ++i) {
+            double angle = 2.0 * Pi * (i % vertices) / vertices * (clockwise ? -1.0 : 1.0);
+            ring->addPoint(lon + radius * std::cos(angle), lat + radius * std::sin(angle));
+        }
+        return ring;
+    }
+
+    OGRGeometry* makeGeometry(Kind kind, std::uint64_t index, double lon, double lat, double radius,
+                              const SyntheticMapOptions& options, std::mt19937_64& random) {
+        std::uniform_real_distribution<double> unit(-1.0, 1.0);
+        const unsigned int vertices = std::max(3u, options.vertices);
+        switch (kind) {
+        case Kind::Points:
+            return new OGRPoint(lon, lat);
+        case Kind::Lines: {
+            // A random walk that stays within the feature's cell
+            OGRLineString* line = new OGRLineString();
+            double x = lon - radius;
+            double y = lat;
+            const double step = 2.0 * radius / (vertices - 1);
+            for (unsigned int i = 0; i < vertices; ++i) {
+                line->addPoint(x, y);
+                x += step;
+                y = std::max(lat - radius, std::min(lat + radius, y + unit(random) * step));
+            }
+            return line;
+        }
+        case Kind::Polygons: {
+            OGRPolygon* polygon = new OGRPolygon();
+            polygon->addRingDirectly(ring(lon, lat, radius, vertices, false));
+            std::uniform_real_distribution<double> chance(0.0, 1.0);
+            if (chance(random) < options.holeFraction) {
+                polygon->addRingDirectly(ring(lon, lat, radius * 0.4, vertices, true));
+            }
+            return polygon;
+        }
+        case Kind::Curves: {
+            // Alternately a circle as a curve polygon and an arc followed by a straight tail
+            if (index % 2 == 0) {
+                OGRCircularString* circle = new OGRCircularString();
+                circle->addPoint(lon + radius, lat);
+                circle->addPoint(lon, lat + radius);
+                circle->addPoint(lon - radius, lat);
+                circle->addPoint(lon, lat - radius);
+                circle->addPoint(lon + radius, lat);
+                OGRCurvePolygon* polygon = new OGRCurvePolygon();
+                polygon->addRingDirectly(circle);
+                return polygon;
+            }
+            OGRCircularString arc;
+            arc.addPoint(lon - radius, lat);
+            arc.addPoint(lon, lat + radius);
+            arc.addPoint(lon + radius, lat);
+            OGRLineString tail;
+            tail.addPoint(lon + radius, lat);
+            tail.addPoint(lon + radius, lat - radius);
+            OGRCompoundCurve* compound = new OGRCompoundCurve();
+            compound->addCurve(&arc);
+            compound->addCurve(&tail);
+            return compound;
+        }
+        }
+        return nullptr;
+    }
+
+    bool writeLayer(GDALDataset* dataset, OGRSpatialReference& wgs84, const LayerPlan& plan, const SyntheticMapOptions& options,
+                    std::uint64_t& written, std::uint64_t total, std::string& error) {
+        OGRLayer* layer = dataset->CreateLayer(plan.name, &wgs84, plan.type, nullptr);
+        if (!layer) {
+            error = std::string("cannot create layer ") + plan.name + ": " + CPLGetLastErrorMsg();
+            return false;
+        }
+        OGRFieldDefn name("name", OFTString);
+        OGRFieldDefn category("category", OFTInteger);
+        OGRFieldDefn value("value", OFTReal);
+        if ((options.names > 0 && layer->CreateField(&name) != OGRERR_NONE) ||
+            layer->CreateField(&category) != OGRERR_NONE || layer->CreateField(&value) != OGRERR_NONE) {
+            error = std::string("cannot create fields in ") + plan.name;
+            return false;
+        }
+
+        // Cells of a grid over the world, one feature each, visited in a
+        // scattered order so every part of the file covers the whole world
+        const double width = 360.0;
+        const double height = MaxLat - MinLat;
+        const std::uint64_t columns = std::max<std::uint64_t>(1, static_cast<std::uint64_t>(std::ceil(std::sqrt(plan.features * width / height))));
+        const std::uint64_t rows = std::max<std::uint64_t>(1, (plan.features + columns - 1) / columns);
+        const double cellWidth = width / columns;
+        const double cellHeight = height / rows;
+        const double radius = 0.4 * std::min(cellWidth, cellHeight);
+
+        std::mt19937_64 random(options.seed * 1000003 + static_cast<std::uint64_t>(plan.kind));
+        std::uniform_real_distribution<double> jitter(-0.05, 0.05);
+        std::uniform_real_distribution<double> values(0.0, 1000.0);
+        const std::uint64_t cells = columns * rows;
+        // Odd stride coprime with the cell count walks every cell once
+        std::uint64_t stride = (cells / 2 + 1) | 1;
+        while (std::gcd(stride, cells) != 1) stride += 2;
+
+        OGRFeature feature(layer->GetLayerDefn());
+        const int nameField = layer->GetLayerDefn()->GetFieldIndex("name");
+        const int categoryField = layer->GetLayerDefn()->GetFieldIndex("category");
+        const int valueField = layer->GetLayerDefn()->GetFieldIndex("value");
+        const std::uint64_t progressStep = std::max<std::uint64_t>(total / 10, 1);
+        bool inTransaction = dataset->StartTransaction() == OGRERR_NONE;
+        for (std::uint64_t i = 0; i < plan.features; ++i) {
+            std::uint64_t cell = (i * stride) % cells;
+            double lon = -180.0 + (cell % columns + 0.5 + jitter(random)) * cellWidth;
+            double lat = MinLat + (cell / columns + 0.5 + jitter(random)) * cellHeight;
+
+            feature.Reset();
+            if (nameField >= 0) {
+                std::string text = "Feature " + std::to_string(random() % options.names);
+                feature.SetField(nameField, text.c_str());
+            }
+            feature.SetField(categoryField, static_cast<int>(random() % std::max(1u, options.categories)));
+            feature.SetField(valueField, values(random));
+            feature.SetGeometryDirectly(makeGeometry(plan.kind, i, lon, lat, radius, options, random));
+            if (layer->CreateFeature(&feature) != OGRERR_NONE) {
+                error = std::string("cannot write to ") + plan.name + ": " + CPLGetLastErrorMsg();
+                if (inTransaction) dataset->CommitTransaction();
+                return false;
+            }
+
+            ++written;
+            if (inTransaction && (i + 1) % FeaturesPerTransaction == 0) {
+                dataset->CommitTransaction();
+                inTransaction = dataset->StartTransaction() == OGRERR_NONE;
+            }
+            if (total >= 1000000 && written % progressStep == 0) {
+                std::cout << "  " << written * 100 / total << "% of features written" << std::endl;
+            }
+        }
+        if (inTransaction) dataset->CommitTransaction();
+        return true;
+    }
+
+    // Smooth hills and valleys, coloured from water to snow
+    void fillRasterStrip(std::vector<std::uint8_t>& pixels, int width, int height, int firstRow, int rows) {
+        for (int y = 0; y < rows; ++y) {
+            double lat = 90.0 - (firstRow + y + 0.5) * 180.0 / height;
+            for (int x = 0; x < width; ++x) {
+                double lon = -180.0 + (x + 0.5) * 360.0 / width;
+                double h = std::sin(lon * Pi / 30.0) * std::cos(lat * Pi / 20.0) + 0.5 * std::sin((lon + lat) * Pi / 7.0) +
+                           0.25 * std::cos(lon * Pi / 2.5) * std::sin(lat * Pi / 3.5);
+                std::uint8_t r, g, b;
+                if (h < -0.3) {
+                    r = 40; g = 90; b = static_cast<std::uint8_t>(170 + 50 * (h + 1.75) / 1.45);
+                } else if (h < 0.8) {
+                    r = static_cast<std::uint8_t>(80 + 60 * h); g = static_cast<std::uint8_t>(150 - 20 * h); b = 70;
+                } else {
+                    r = g = b = static_cast<std::uint8_t>(std::min(255.0, 180 + 50 * h));
+                }
+                std::size_t offset = static_cast<std::size_t>(y) * width + x;
+                std::size_t band = static_cast<std::size_t>(width) * rows;
+                pixels[offset] = r;
+                pixels[band + offset] = g;
+                pixels[2 * band + offset] = b;
+            }
+        }
+    }
+
+    bool writeRaster(const std::string& path, GDALDriver* driver, OGRSpatialReference& wgs84, unsigned int rasterWidth, std::string& error) {
+        const int width = static_cast<int>(rasterWidth);
+        const int height = std::max(1, width / 2);
+        char** createOptions = nullptr;
+        createOptions = CSLSetNameValue(createOptions, "APPEND_SUBDATASET", "YES");
+        createOptions = CSLSetNameValue(createOptions, "RASTER_TABLE", "terrain");
+        createOptions = CSLSetNameValue(createOptions, "TILE_FORMAT", "PNG");
+        std::unique_ptr<GDALDataset> raster(driver->Create(path.c_str(), width, height, 3, GDT_Byte, createOptions));
+        CSLDestroy(createOptions);
+        if (!raster) {
+            error = std::string("cannot create the raster table: ") + CPLGetLastErrorMsg();
+            return false;
+        }
+        double geoTransform[6] = {-180.0, 360.0 / width, 0.0, 90.0, 0.0, -180.0 / height};
+        raster->SetGeoTransform(geoTransform);
+        raster->SetSpatialRef(&wgs84);
+
+        std::vector<std::uint8_t> pixels;
+        for (int row = 0; row < height; row += RasterStripRows) {
+            const int rows = std::min(RasterStripRows, height - row);
+            pixels.resize(static_cast<std::size_t>(width) * rows * 3);
+            fillRasterStrip(pixels, width, height, row, rows);
+            if (raster->RasterIO(GF_Write, 0, row, width, rows, pixels.data(), width, rows, GDT_Byte, 3, nullptr, 0, 0, 0) != CE_None) {
+                error = std::string("cannot write raster rows: ") + CPLGetLastErrorMsg();
+                return false;
+            }
+        }
+        return true;
+    }
+}
+
+bool SyntheticMapOptions::parseTypes(const std::string& types) {
+    points = lines = polygons = curves = false;
+    std::stringstream list(types);
+    std::string type;
+    while (std::getline(list, type, ',')) {
+        if (type == "points") points = true;
+        else if (type == "lines") lines = true;
+        else if (type == "polygons") polygons = true;
+        else if (type == "curves") curves = true;
+        else return false;
+    }
+    return points || lines || polygons || curves;
+}
+
+bool writeSyntheticMap(const std::string& path, const SyntheticMapOptions& options, std::string& error) {
+    GDALAllRegister();
+    GDALDriver* driver = GetGDALDriverManager()->GetDriverByName("GPKG");
+    if (!driver) {
+        error = "GDAL has no GeoPackage driver";
+        return false;
+    }
+    std::error_code removeError;
+    std::filesystem::remove(path, removeError);
+
+    OGRSpatialReference wgs84;
+    wgs84.SetWellKnownGeogCS("WGS84");
+    wgs84.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+
+    // The features are split evenly over the chosen layers
+    std::vector<LayerPlan> plans;
+    if (options.points) plans.push_back({Kind::Points, "points", wkbPoint, 0});
+    if (options.lines) plans.push_back({Kind::Lines, "lines", wkbLineString, 0});
+    if (options.polygons) plans.push_back({Kind::Polygons, "polygons", wkbPolygon, 0});
+    if (options.curves) plans.push_back({Kind::Curves, "curves", wkbUnknown, 0});
+    for (std::size_t i = 0; i < plans.size(); ++i) {
+        plans[i].features = options.features / plans.size() + (i < options.features % plans.size() ? 1 : 0);
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    if (options.features > 0 && !plans.empty()) {
+        std::unique_ptr<GDALDataset> dataset(driver->Create(path.c_str(), 0, 0, 0, GDT_Unknown, nullptr));
+        if (!dataset) {
+            error = "cannot create " + path + ": " + CPLGetLastErrorMsg();
+            return false;
+        }
+        std::uint64_t written = 0;
+        for (const LayerPlan& plan : plans) {
+            if (plan.features > 0 && !writeLayer(dataset.get(), wgs84, plan, options, written, options.features, error)) return false;
+        }
+    }
+    if (options.rasterWidth > 0 && !writeRaster(path, driver, wgs84, options.rasterWidth, error)) return false;
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Wrote " << options.features << " features" << (options.rasterWidth ? " and a raster" : "") << " to " << path
+              << " in " << seconds << " s" << std::endl;
+    return true;
+}
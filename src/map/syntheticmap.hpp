@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Writes GeoPackages of a chosen size for testing how the map scales.
+//
+// Features are spread evenly over the world, each sized to the area it has
+// to itself, in up to four layers: points, lines (random walks), polygons
+// (some with a hole) and curves (circular arcs in compound curves and
+// curve polygons). Each feature has a name drawn from `names` distinct
+// values, a category from `categories` and a random value. An optional
+// RGB raster of `rasterWidth` x rasterWidth / 2 pixels covering the world
+// goes into the same file as a tile table, written in strips so its size
+// is not limited by memory.
+struct SyntheticMapOptions {
+    std::uint64_t features = 100000;
+    bool points = true;
+    bool lines = true;
+    bool polygons = true;
+    bool curves = true;
+    unsigned int vertices = 8;     // per line and ring
+    double holeFraction = 0.3;     // of polygons that get a hole
+    std::uint64_t names = 1000;    // distinct names, 0 for none
+    unsigned int categories = 16;
+    unsigned int rasterWidth = 0;  // 0: no raster
+    std::uint64_t seed = 1;
+
+    // "points,lines,polygons,curves" or a subset; false if a name is unknown
+    bool parseTypes(const std::string& types);
+};
+
+// Replaces `path`. Prints progress for large files. False with `error` set
+// if GDAL could not write it.
+bool writeSyntheticMap(const std::string& path, const SyntheticMapOptions& options, std::string& error);
@@ -0,0 +1,130 @@
+#include "tilelayer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+    const std::size_t MaxCachedTiles = 256;
+    // Loading is synchronous, so spread it over frames to avoid stalls
+    const int MaxTileLoadsPerFrame = 8;
+    // Mercator tiles are drawn as horizontal strips to follow the latitude scale
+    const int StripsPerTile = 8;
+}
+
+bool TileLayer::open(const std::string& path) {
+    close();
+    m_source = openTileSource(path);
+    if (!m_source) return false;
+
+    std::cout << "Using pre-rendered tiles from " << path << " (zoom "
+              << m_source->minZoom() << "-" << m_source->maxZoom() << ")" << std::endl;
+    return true;
+}
+
+void TileLayer::close() {
+    m_source.reset();
+    m_cache.clear();
+}
+
+void TileLayer::releaseCache() {
+    m_cache.clear();
+    std::vector<std::uint8_t>().swap(m_readBuffer);
+    m_quads = sf::VertexArray(m_quads.getPrimitiveType());
+}
+
+std::size_t TileLayer::textureBytes() const {
+    std::size_t bytes = 0;
+    for (const auto& entry : m_cache) {
+        bytes += static_cast<std::size_t>(entry.second.texture.getSize().x) * entry.second.texture.getSize().y * 4;
+    }
+    return bytes;
+}
+
+int TileLayer::chooseZoom(const sf::View& view, sf::Vector2f worldSize, unsigned int viewportWidth) const {
+    // Pick the level whose tiles are closest to one texel per screen pixel
+    double worldPixels = worldSize.x * viewportWidth / view.getSize().x;
+    int z = static_cast<int>(std::round(std::log2(std::max(worldPixels / 256.0, 1.0)))) - m_detailBias;
+    return std::max(m_source->minZoom(), std::min(z, m_source->maxZoom()));
+}
+
+void TileLayer::draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize) {
+    if (!m_source) return;
+    ++m_frame;
+
+    int z = chooseZoom(view, worldSize, target.getSize().x);
+    int last = (1 << z) - 1;
+
+    sf::Vector2f topLeft = view.getCenter() - view.getSize() / 2.f;
+    sf::Vector2f bottomRight = view.getCenter() + view.getSize() / 2.f;
+    double west = projection::worldXToLon(topLeft.x, worldSize.x);
+    double east = projection::worldXToLon(bottomRight.x, worldSize.x);
+    double north = projection::worldYToLat(topLeft.y, worldSize.y);
+    double south = projection::worldYToLat(bottomRight.y, worldSize.y);
+
+    int x0 = std::max(0, static_cast<int>(std::floor(projection::lonToTileX(std::max(west, -180.0), z))));
+    int x1 = std::min(last, static_cast<int>(std::floor(projection::lonToTileX(std::min(east, 180.0), z))));
+    int y0 = std::max(0, static_cast<int>(std::floor(projection::latToTileY(north, z))));
+    int y1 = std::min(last, static_cast<int>(std::floor(projection::latToTileY(south, z))));
+
+    int loads = 0;
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            projection::TileId tile{z, x, y};
+            auto it = m_cache.find(tile.key());
+            if (it == m_cache.end()) {
+                if (loads >= MaxTileLoadsPerFrame) continue;
+                ++loads;
+
+                CachedTile& cached = m_cache[tile.key()];
+                cached.missing = !m_source->read(tile, m_readBuffer) ||
+                                 !cached.texture.loadFromMemory(m_readBuffer.data(), m_readBuffer.size());
+                if (!cached.missing) cached.texture.setSmooth(true);
+                it = m_cache.find(tile.key());
+            }
+
+            CachedTile& cached = it->second;
+            cached.lastUsed = m_frame;
+            if (cached.missing) continue;
+
+            float westX = static_cast<float>(projection::lonToWorldX(projection::tileXToLon(x, z), worldSize.x));
+            float eastX = static_cast<float>(projection::lonToWorldX(projection::tileXToLon(x + 1, z), worldSize.x));
+            float texWidth = static_cast<float>(cached.texture.getSize().x);
+            float texHeight = static_cast<float>(cached.texture.getSize().y);
+
+            m_quads.clear();
+            m_quads.setPrimitiveType(sf::Quads);
+            for (int s = 0; s < StripsPerTile; ++s) {
+                double top = y + static_cast<double>(s) / StripsPerTile;
+                double bottom = y + static_cast<double>(s + 1) / StripsPerTile;
+                float topY = static_cast<float>(projection::latToWorldY(projection::tileYToLat(top, z), worldSize.y));
+                float bottomY = static_cast<float>(projection::latToWorldY(projection::tileYToLat(bottom, z), worldSize.y));
+                float texTop = texHeight * s / StripsPerTile;
+                float texBottom = texHeight * (s + 1) / StripsPerTile;
+
+                m_quads.append(sf::Vertex(sf::Vector2f(westX, topY), sf::Vector2f(0.f, texTop)));
+                m_quads.append(sf::Vertex(sf::Vector2f(eastX, topY), sf::Vector2f(texWidth, texTop)));
+                m_quads.append(sf::Vertex(sf::Vector2f(eastX, bottomY), sf::Vector2f(texWidth, texBottom)));
+                m_quads.append(sf::Vertex(sf::Vector2f(westX, bottomY), sf::Vector2f(0.f, texBottom)));
+            }
+            target.draw(m_quads, sf::RenderStates(&cached.texture));
+        }
+    }
+
+    evictOldTiles();
+}
+
+void TileLayer::evictOldTiles() {
+    if (m_cache.size() <= MaxCachedTiles) return;
+
+    // Drop the least recently drawn tiles
+    std::vector<std::pair<std::uint64_t, std::uint64_t>> byAge;
+    byAge.reserve(m_cache.size());
+    for (const auto& entry : m_cache) {
+        byAge.emplace_back(entry.second.lastUsed, entry.first);
+    }
+    std::sort(byAge.begin(), byAge.end());
+    std::size_t excess = m_cache.size() - MaxCachedTiles;
+    for (std::size_t i = 0; i < excess; ++i) {
+        m_cache.erase(byAge[i].second);
+    }
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "tilestorage.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Base layer that draws a pre-rendered XYZ tile pyramid (see the
+// render-tiles command) into the map's equirectangular world space.
+class TileLayer {
+public:
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_source != nullptr; }
+
+    // Draws the tiles covering `view`. `worldSize` is the extent of the whole
+    // world (360 x 180 degrees) in the map's world coordinates.
+    void draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize);
+    // Draws `levels` zoom levels coarser than the screen resolution asks for
+    void setDetailBias(int levels) { m_detailBias = levels; }
+    // Tiles are local reads, so all of them go; a screenful is back within a few frames
+    void releaseCache();
+    std::size_t textureBytes() const;
+
+private:
+    struct CachedTile {
+        sf::Texture texture;
+        bool missing = false;
+        std::uint64_t lastUsed = 0;
+    };
+
+    std::unique_ptr<TileSource> m_source;
+    std::unordered_map<std::uint64_t, CachedTile> m_cache;
+    std::uint64_t m_frame = 0;
+    int m_detailBias = 0;
+    std::vector<std::uint8_t> m_readBuffer;
+    sf::VertexArray m_quads;
+
+    int chooseZoom(const sf::View& view, sf::Vector2f worldSize, unsigned int viewportWidth) const;
+    void evictOldTiles();
+};
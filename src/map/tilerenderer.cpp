@@ -0,0 +1,163 @@
+#include "tilerenderer.hpp"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+TileRenderer::TileRenderer(const GeometryStore& store, const MapStyle& style, unsigned int tileSize)
+    : m_store(store),
+      m_style(style),
+      m_tileSize(tileSize)
+{
+}
+
+GeometryStore::Bounds TileRenderer::tileBounds(const projection::TileId& tile) {
+    GeometryStore::Bounds bounds;
+    bounds.minLon = projection::tileXToLon(tile.x, tile.z);
+    bounds.maxLon = projection::tileXToLon(tile.x + 1, tile.z);
+    bounds.maxLat = projection::tileYToLat(tile.y, tile.z);
+    bounds.minLat = projection::tileYToLat(tile.y + 1, tile.z);
+    bounds.valid = true;
+    return bounds;
+}
+
+void TileRenderer::tilesForZoom(int z, std::vector<projection::TileId>& tiles) const {
+    const GeometryStore::Bounds& bounds = m_store.bounds();
+    if (!bounds.valid) return;
+
+    int last = (1 << z) - 1;
+    int x0 = std::max(0, static_cast<int>(projection::lonToTileX(bounds.minLon, z)));
+    int x1 = std::min(last, static_cast<int>(projection::lonToTileX(bounds.maxLon, z)));
+    int y0 = std::max(0, static_cast<int>(projection::latToTileY(bounds.maxLat, z)));
+    int y1 = std::min(last, static_cast<int>(projection::latToTileY(bounds.minLat, z)));
+
+    for (int y = y0; y <= y1; ++y) {
+        for (int x = x0; x <= x1; ++x) {
+            tiles.push_back(projection::TileId{z, x, y});
+        }
+    }
+}
+
+bool TileRenderer::render(const projection::TileId& tile, std::vector<std::uint8_t>& pixels) const {
+    pixels.resize(static_cast<std::size_t>(m_tileSize) * m_tileSize * 4);
+    for (std::size_t i = 0; i < pixels.size(); i += 4) {
+        pixels[i] = m_style.background.r;
+        pixels[i + 1] = m_style.background.g;
+        pixels[i + 2] = m_style.background.b;
+        pixels[i + 3] = m_style.background.a;
+    }
+
+    // Grow the query area by a pixel so lines ending on the border are drawn
+    GeometryStore::Bounds area = tileBounds(tile);
+    double marginLon = (area.maxLon - area.minLon) / m_tileSize;
+    double marginLat = (area.maxLat - area.minLat) / m_tileSize;
+    area.minLon -= marginLon;
+    area.maxLon += marginLon;
+    area.minLat -= marginLat;
+    area.maxLat += marginLat;
+
+    std::vector<std::uint32_t> features;
+    m_store.query(area, features);
+    if (features.empty()) return false;
+
+    const auto& parts = m_store.parts();
+    const auto& vertices = m_store.vertices();
+    const double size = m_tileSize;
+
+    for (std::uint32_t index : features) {
+        const GeometryStore::Feature& feature = m_store.features()[index];
+        for (std::uint32_t p = feature.firstPart; p < feature.firstPart + feature.partCount; ++p) {
+            const GeometryStore::Part& part = parts[p];
+            if (part.type == GeometryStore::PartType::Point) continue;
+
+            const sf::Color& color = part.type == GeometryStore::PartType::Ring ? m_style.ringColor : m_style.lineColor;
+            double prevX = 0.0;
+            double prevY = 0.0;
+            for (std::uint32_t v = 0; v < part.vertexCount; ++v) {
+                const GeometryStore::Coordinate& c = vertices[part.firstVertex + v];
+                double x = (projection::lonToTileX(c.lon, tile.z) - tile.x) * size;
+                double y = (projection::latToTileY(c.lat, tile.z) - tile.y) * size;
+                if (v > 0) {
+                    drawLine(pixels, prevX, prevY, x, y, color);
+                }
+                prevX = x;
+                prevY = y;
+            }
+        }
+    }
+    return true;
+}
+
+void TileRenderer::drawLine(std::vector<std::uint8_t>& pixels, double x0, double y0, double x1, double y1, const sf::Color& color) const {
+    // Liang-Barsky clip against the tile (plus one pixel for antialiasing)
+    const double lo = -1.0;
+    const double hi = m_tileSize + 1.0;
+    double t0 = 0.0;
+    double t1 = 1.0;
+    double dx = x1 - x0;
+    double dy = y1 - y0;
+    const double p[4] = {-dx, dx, -dy, dy};
+    const double q[4] = {x0 - lo, hi - x0, y0 - lo, hi - y0};
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            if (q[i] < 0.0) return;
+            continue;
+        }
+        double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > t1) return;
+            t0 = std::max(t0, t);
+        } else {
+            if (t < t0) return;
+            t1 = std::min(t1, t);
+        }
+    }
+    x1 = x0 + t1 * dx;
+    y1 = y0 + t1 * dy;
+    x0 = x0 + t0 * dx;
+    y0 = y0 + t0 * dy;
+
+    // Xiaolin Wu's antialiased line
+    bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+    if (steep) {
+        std::swap(x0, y0);
+        std::swap(x1, y1);
+    }
+    if (x0 > x1) {
+        std::swap(x0, x1);
+        std::swap(y0, y1);
+    }
+
+    dx = x1 - x0;
+    dy = y1 - y0;
+    double gradient = dx == 0.0 ? 1.0 : dy / dx;
+
+    auto plot = [&](int x, int y, double coverage) {
+        if (steep) {
+            blendPixel(pixels, y, x, color, coverage);
+        } else {
+            blendPixel(pixels, x, y, color, coverage);
+        }
+    };
+
+    int xStart = static_cast<int>(std::round(x0));
+    int xEnd = static_cast<int>(std::round(x1));
+    double y = y0 + gradient * (xStart - x0);
+    for (int x = xStart; x <= xEnd; ++x) {
+        double floorY = std::floor(y);
+        double fraction = y - floorY;
+        plot(x, static_cast<int>(floorY), 1.0 - fraction);
+        plot(x, static_cast<int>(floorY) + 1, fraction);
+        y += gradient;
+    }
+}
+
+void TileRenderer::blendPixel(std::vector<std::uint8_t>& pixels, int x, int y, const sf::Color& color, double coverage) const {
+    if (x < 0 || y < 0 || x >= static_cast<int>(m_tileSize) || y >= static_cast<int>(m_tileSize)) return;
+
+    double alpha = coverage * color.a / 255.0;
+    std::uint8_t* pixel = &pixels[(static_cast<std::size_t>(y) * m_tileSize + x) * 4];
+    pixel[0] = static_cast<std::uint8_t>(pixel[0] + (color.r - pixel[0]) * alpha);
+    pixel[1] = static_cast<std::uint8_t>(pixel[1] + (color.g - pixel[1]) * alpha);
+    pixel[2] = static_cast<std::uint8_t>(pixel[2] + (color.b - pixel[2]) * alpha);
+    pixel[3] = static_cast<std::uint8_t>(std::max<double>(pixel[3], pixel[3] + (255 - pixel[3]) * alpha));
+}
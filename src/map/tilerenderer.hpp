@@ -0,0 +1,35 @@
+#pragma once
+
+#include "geometrystore.hpp"
+#include "mapstyle.hpp"
+#include "projection.hpp"
+#include <cstdint>
+#include <vector>
+
+// Software rasterizer for XYZ (Web Mercator) tiles.
+//
+// Works purely on a GeometryStore and CPU memory, so it needs no window or
+// GL context and any number of threads can render from the same store.
+class TileRenderer {
+public:
+    TileRenderer(const GeometryStore& store, const MapStyle& style, unsigned int tileSize = 256);
+
+    // Renders one tile into `pixels` as RGBA (tileSize * tileSize * 4 bytes).
+    // Returns false if no feature touches the tile.
+    bool render(const projection::TileId& tile, std::vector<std::uint8_t>& pixels) const;
+
+    unsigned int tileSize() const { return m_tileSize; }
+
+    // Tiles at zoom level z that intersect the store's data
+    void tilesForZoom(int z, std::vector<projection::TileId>& tiles) const;
+
+    static GeometryStore::Bounds tileBounds(const projection::TileId& tile);
+
+private:
+    const GeometryStore& m_store;
+    MapStyle m_style;
+    unsigned int m_tileSize;
+
+    void drawLine(std::vector<std::uint8_t>& pixels, double x0, double y0, double x1, double y1, const sf::Color& color) const;
+    void blendPixel(std::vector<std::uint8_t>& pixels, int x, int y, const sf::Color& color, double coverage) const;
+};
@@ -0,0 +1,320 @@
+#include "tileservice.hpp"
+#include "../utils/imageencoder.hpp"
+#include <cctype>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace {
+    bool isValidLayerName(const std::string& name) {
+        if (name.empty()) return false;
+        for (char c : name) {
+            if (!std::isalnum(static_cast<unsigned char>(c)) && c != '_' && c != '-') return false;
+        }
+        return true;
+    }
+
+    std::string makeEtag(const std::string& data) {
+        // FNV-1a is plenty to tell tile versions apart
+        std::uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : data) {
+            hash = (hash ^ c) * 1099511628211ull;
+        }
+        char buffer[24];
+        std::snprintf(buffer, sizeof(buffer), "\"%016llx\"", static_cast<unsigned long long>(hash));
+        return buffer;
+    }
+
+    void notFound(HttpResponse& response) {
+        response.status = 404;
+        response.body = "Not found";
+    }
+}
+
+TileService::TileService(const std::string& mapDirectory, std::size_t cacheBytes, unsigned int tileSize)
+    : m_mapDirectory(mapDirectory),
+      m_tileSize(tileSize),
+      m_cache(cacheBytes)
+{
+}
+
+void TileService::handle(const HttpRequest& request, HttpResponse& response) {
+    if (request.method != "GET") {
+        response.status = 405;
+        response.body = "Only GET is supported";
+        return;
+    }
+
+    std::string path = request.target.substr(0, request.target.find('?'));
+    if (path == "/") {
+        serveViewer(response);
+        return;
+    }
+    if (path == "/stats") {
+        serveStats(response);
+        return;
+    }
+
+    const std::string prefix = "/tiles/";
+    if (path.compare(0, prefix.size(), prefix) != 0) {
+        notFound(response);
+        return;
+    }
+    path = path.substr(prefix.size());
+
+    // <layer>.json
+    const std::string jsonSuffix = ".json";
+    if (path.size() > jsonSuffix.size() && path.compare(path.size() - jsonSuffix.size(), jsonSuffix.size(), jsonSuffix) == 0) {
+        serveTileJson(path.substr(0, path.size() - jsonSuffix.size()), response);
+        return;
+    }
+
+    // <layer>/<z>/<x>/<y>.png
+    std::vector<std::string> parts;
+    std::stringstream stream(path);
+    std::string part;
+    while (std::getline(stream, part, '/')) {
+        parts.push_back(part);
+    }
+
+    projection::TileId tile;
+    char extension[8] = {};
+    if (parts.size() != 4 ||
+        std::sscanf(parts[1].c_str(), "%d", &tile.z) != 1 ||
+        std::sscanf(parts[2].c_str(), "%d", &tile.x) != 1 ||
+        std::sscanf(parts[3].c_str(), "%d.%7s", &tile.y, extension) != 2 ||
+        std::string(extension) != "png" ||
+        tile.z < 0 || tile.z > 24 || tile.x < 0 || tile.y < 0 ||
+        tile.x >= (1 << tile.z) || tile.y >= (1 << tile.z)) {
+        notFound(response);
+        return;
+    }
+
+    serveTile(parts[0], tile, request, response);
+}
+
+std::shared_ptr<const TileService::Layer> TileService::layer(const std::string& name) {
+    if (!isValidLayerName(name)) return nullptr;
+
+    // Layers are loaded on first use and never change afterwards
+    std::promise<std::shared_ptr<const Layer>> promise;
+    std::shared_future<std::shared_ptr<const Layer>> future;
+    bool loading = false;
+    {
+        std::lock_guard<std::mutex> lock(m_layersMutex);
+        auto it = m_layers.find(name);
+        if (it != m_layers.end()) {
+            future = it->second;
+        } else {
+            future = promise.get_future().share();
+            m_layers.emplace(name, future);
+            loading = true;
+        }
+    }
+    if (!loading) return future.get();
+
+    std::shared_ptr<const Layer> loaded = loadLayer(name);
+    if (!loaded) {
+        // Not cached, so a GeoPackage added later is picked up
+        std::lock_guard<std::mutex> lock(m_layersMutex);
+        m_layers.erase(name);
+    }
+    promise.set_value(loaded);
+    return loaded;
+}
+
+std::shared_ptr<const TileService::Layer> TileService::loadLayer(const std::string& name) const {
+    std::string filename = m_mapDirectory + "/" + name + ".gpkg";
+    std::unique_ptr<GDALDataset> dataset(static_cast<GDALDataset*>(
+        GDALOpenEx(filename.c_str(), GDAL_OF_VECTOR | GDAL_OF_READONLY, nullptr, nullptr, nullptr)));
+
+    std::shared_ptr<Layer> loaded;
+    if (dataset) {
+        loaded = std::make_shared<Layer>();
+        if (loaded->store.load(dataset.get())) {
+            loaded->renderer = std::make_unique<TileRenderer>(loaded->store, m_style, m_tileSize);
+            std::cout << "Loaded layer " << name << " (" << loaded->store.features().size() << " features)" << std::endl;
+        } else {
+            loaded.reset();
+        }
+    }
+    if (!loaded) {
+        std::cerr << "Failed to load layer " << name << " from " << filename << std::endl;
+    }
+    return loaded;
+}
+
+TileService::TileResult TileService::renderTile(const std::string& layerName, const projection::TileId& tile, const std::string& key) {
+    TileResult result;
+    std::shared_ptr<const Layer> source = layer(layerName);
+    if (!source) {
+        result.status = 404;
+        return result;
+    }
+
+    // Empty tiles are still served (as background) so browsers get an image
+    std::vector<std::uint8_t> pixels;
+    std::vector<std::uint8_t> png;
+    source->renderer->render(tile, pixels);
+    if (!imageencoder::encodePng(pixels.data(), m_tileSize, m_tileSize, png)) {
+        result.status = 500;
+        return result;
+    }
+    ++m_renders;
+
+    auto fresh = std::make_shared<RenderedTile>();
+    fresh->png.assign(png.begin(), png.end());
+    fresh->etag = makeEtag(fresh->png);
+    m_cache.put(key, fresh, fresh->png.size() + key.size());
+    result.tile = fresh;
+    return result;
+}
+
+void TileService::serveTile(const std::string& layerName, const projection::TileId& tile, const HttpRequest& request, HttpResponse& response) {
+    std::string key = layerName + "/" + std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" + std::to_string(tile.y);
+
+    std::shared_ptr<const RenderedTile> rendered = m_cache.get(key);
+    if (!rendered) {
+        // Join a render of the same tile that is already running
+        std::promise<TileResult> promise;
+        std::shared_future<TileResult> future;
+        bool rendering = false;
+        {
+            std::lock_guard<std::mutex> lock(m_inFlightMutex);
+            auto it = m_inFlight.find(key);
+            if (it != m_inFlight.end()) {
+                future = it->second;
+            } else {
+                future = promise.get_future().share();
+                m_inFlight.emplace(key, future);
+                rendering = true;
+            }
+        }
+
+        TileResult result;
+        if (rendering) {
+            result = renderTile(layerName, tile, key);
+            {
+                // The tile is in the cache before it leaves the in-flight list
+                std::lock_guard<std::mutex> lock(m_inFlightMutex);
+                m_inFlight.erase(key);
+            }
+            promise.set_value(result);
+        } else {
+            result = future.get();
+        }
+
+        if (!result.tile) {
+            if (result.status == 404) {
+                notFound(response);
+            } else {
+                response.status = result.status;
+                response.body = "Failed to encode tile";
+            }
+            return;
+        }
+        rendered = result.tile;
+    }
+
+    response.headers.emplace_back("ETag", rendered->etag);
+    response.headers.emplace_back("Cache-Control", "public, max-age=60");
+
+    std::string ifNoneMatch = request.header("If-None-Match");
+    if (!ifNoneMatch.empty() && (ifNoneMatch == "*" || ifNoneMatch.find(rendered->etag) != std::string::npos)) {
+        ++m_notModified;
+        response.status = 304;
+        response.contentType.clear();
+        return;
+    }
+
+    response.contentType = "image/png";
+    response.body = rendered->png;
+}
+
+void TileService::serveTileJson(const std::string& layerName, HttpResponse& response) {
+    std::shared_ptr<const Layer> source = layer(layerName);
+    if (!source) {
+        notFound(response);
+        return;
+    }
+
+    const GeometryStore::Bounds& bounds = source->store.bounds();
+    std::ostringstream json;
+    json.precision(10);
+    json << "{\"tilejson\":\"2.2.0\",\"name\":\"" << layerName << "\","
+         << "\"tiles\":[\"/tiles/" << layerName << "/{z}/{x}/{y}.png\"],"
+         << "\"minzoom\":0,\"maxzoom\":22,"
+         << "\"bounds\":[" << bounds.minLon << "," << bounds.minLat << "," << bounds.maxLon << "," << bounds.maxLat << "]}";
+
+    response.contentType = "application/json";
+    response.body = json.str();
+}
+
+void TileService::serveStats(HttpResponse& response) {
+    std::ostringstream json;
+    json << "{\"cacheHits\":" << m_cache.hits()
+         << ",\"cacheMisses\":" << m_cache.misses()
+         << ",\"cachedTiles\":" << m_cache.count()
+         << ",\"cachedBytes\":" << m_cache.size()
+         << ",\"renders\":" << m_renders
+         << ",\"notModified\":" << m_notModified << "}";
+
+    response.contentType = "application/json";
+    response.body = json.str();
+}
+
+void TileService::serveViewer(HttpResponse& response) {
+    // A few lines of plain script instead of a map library from a CDN, so the
+    // viewer works on a LAN without internet access: drag to pan, wheel or
+    // double click to zoom, XYZ tiles placed as absolutely positioned images
+    response.contentType = "text/html";
+    response.body =
+        "<!DOCTYPE html><html><head><meta charset=\"utf-8\"><title>Map</title>"
+        "<style>html,body{height:100%;margin:0}#map{position:relative;overflow:hidden;height:100%;background:#fff;cursor:grab}"
+        "#map img{position:absolute;user-select:none;-webkit-user-drag:none}</style></head><body><div id=\"map\"></div><script>"
+        "var layer = new URLSearchParams(location.search).get('layer') || 'streetmap';"
+        "var map = document.getElementById('map'), S = " + std::to_string(m_tileSize) + ", z = 2, cx = 2 * S, cy = 2 * S, tiles = {}, drag = null;"
+        "function draw() {"
+        "  var w = map.clientWidth, h = map.clientHeight, n = 1 << z, keep = {};"
+        "  for (var ty = Math.floor((cy - h / 2) / S); ty <= Math.floor((cy + h / 2) / S); ty++) {"
+        "    if (ty < 0 || ty >= n) continue;"
+        "    for (var tx = Math.floor((cx - w / 2) / S); tx <= Math.floor((cx + w / 2) / S); tx++) {"
+        "      var key = z + '/' + tx + '/' + ty, img = tiles[key];"
+        "      if (!img) {"
+        "        img = tiles[key] = document.createElement('img');"
+        "        img.width = img.height = S;"
+        "        img.src = '/tiles/' + layer + '/' + z + '/' + ((tx % n) + n) % n + '/' + ty + '.png';"
+        "        map.appendChild(img);"
+        "      }"
+        "      img.style.left = (tx * S - cx + w / 2) + 'px'; img.style.top = (ty * S - cy + h / 2) + 'px'; keep[key] = 1;"
+        "    }"
+        "  }"
+        "  for (var old in tiles) if (!keep[old]) { map.removeChild(tiles[old]); delete tiles[old]; }"
+        "}"
+        "function zoom(step, x, y) {"
+        "  var next = Math.max(0, Math.min(22, z + step)); if (next == z) return;"
+        "  var f = Math.pow(2, next - z), ox = x - map.clientWidth / 2, oy = y - map.clientHeight / 2;"
+        "  cx = (cx + ox) * f - ox; cy = (cy + oy) * f - oy; z = next; draw();"
+        "}"
+        "function pixel(lon, lat, level) {"
+        "  var n = S * Math.pow(2, level), s = Math.sin(Math.max(-85.05, Math.min(85.05, lat)) * Math.PI / 180);"
+        "  return [(lon + 180) / 360 * n, (0.5 - Math.log((1 + s) / (1 - s)) / (4 * Math.PI)) * n];"
+        "}"
+        "map.onmousedown = function(e) { drag = [e.clientX, e.clientY]; e.preventDefault(); };"
+        "onmouseup = function() { drag = null; };"
+        "onmousemove = function(e) { if (!drag) return; cx -= e.clientX - drag[0]; cy -= e.clientY - drag[1]; drag = [e.clientX, e.clientY]; draw(); };"
+        "map.onwheel = function(e) { e.preventDefault(); zoom(e.deltaY < 0 ? 1 : -1, e.clientX, e.clientY); };"
+        "map.ondblclick = function(e) { zoom(1, e.clientX, e.clientY); };"
+        "onresize = draw;"
+        "fetch('/tiles/' + layer + '.json').then(r => r.json()).then(j => {"
+        "  var b = j.bounds, a, c;"
+        "  for (z = 22; z > 0; z--) {"
+        "    a = pixel(b[0], b[3], z); c = pixel(b[2], b[1], z);"
+        "    if (c[0] - a[0] <= map.clientWidth && c[1] - a[1] <= map.clientHeight) break;"
+        "  }"
+        "  a = pixel(b[0], b[3], z); c = pixel(b[2], b[1], z); cx = (a[0] + c[0]) / 2; cy = (a[1] + c[1]) / 2; draw();"
+        "}).catch(draw);"
+        "draw();"
+        "</script></body></html>";
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "geometrystore.hpp"
+#include "mapstyle.hpp"
+#include "tilerenderer.hpp"
+#include "../net/httpserver.hpp"
+#include "../utils/lrucache.hpp"
+#include <atomic>
+#include <future>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Serves XYZ tiles rendered on demand from the GeoPackages in a map
+// directory, using the same GeometryStore/TileRenderer/MapStyle as the
+// render-tiles command. Routes:
+//   GET /                                  minimal viewer, self-contained so it works offline
+//   GET /tiles/<layer>.json                TileJSON (bounds, zoom range)
+//   GET /tiles/<layer>/<z>/<x>/<y>.png     tile, with ETag / If-None-Match
+//   GET /stats                             cache counters as JSON
+class TileService {
+public:
+    TileService(const std::string& mapDirectory, std::size_t cacheBytes, unsigned int tileSize = 256);
+
+    // Thread-safe HttpServer handler
+    void handle(const HttpRequest& request, HttpResponse& response);
+
+private:
+    struct Layer {
+        GeometryStore store;
+        std::unique_ptr<TileRenderer> renderer;
+    };
+
+    struct RenderedTile {
+        std::string png;
+        std::string etag;
+    };
+
+    std::string m_mapDirectory;
+    MapStyle m_style;
+    unsigned int m_tileSize;
+
+    // What a tile request resolved to: a tile, or the status to answer with
+    struct TileResult {
+        std::shared_ptr<const RenderedTile> tile;
+        int status = 200;
+    };
+
+    // A layer is loaded once, outside the lock; requests arriving meanwhile
+    // wait on its future. Failed loads are dropped so a later request retries.
+    std::mutex m_layersMutex;
+    std::map<std::string, std::shared_future<std::shared_ptr<const Layer>>> m_layers;
+
+    LruCache<std::string, RenderedTile> m_cache;
+    // Tiles being rendered, so concurrent misses on one tile render it once
+    std::mutex m_inFlightMutex;
+    std::unordered_map<std::string, std::shared_future<TileResult>> m_inFlight;
+    std::atomic<std::size_t> m_renders{0};
+    std::atomic<std::size_t> m_notModified{0};
+
+    std::shared_ptr<const Layer> layer(const std::string& name);
+    std::shared_ptr<const Layer> loadLayer(const std::string& name) const;
+    TileResult renderTile(const std::string& layerName, const projection::TileId& tile, const std::string& key);
+    void serveTile(const std::string& layerName, const projection::TileId& tile, const HttpRequest& request, HttpResponse& response);
+    void serveTileJson(const std::string& layerName, HttpResponse& response);
+    void serveStats(HttpResponse& response);
+    void serveViewer(HttpResponse& response);
+};
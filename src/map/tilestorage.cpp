@@ -0,0 +1,211 @@
+#include "tilestorage.hpp"
+#include "../database/connectionpool.hpp"
+#include <sqlite3.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace {
+    // Inserts per transaction when writing MBTiles
+    const int TilesPerTransaction = 1000;
+    const char* SelectTile = "SELECT tile_data FROM tiles WHERE zoom_level = ? AND tile_column = ? AND tile_row = ?";
+
+    bool endsWith(const std::string& value, const std::string& suffix) {
+        return value.size() >= suffix.size() &&
+               value.compare(value.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+
+    std::string tilePath(const std::string& root, const projection::TileId& tile) {
+        return root + "/" + std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" + std::to_string(tile.y) + ".png";
+    }
+}
+
+std::unique_ptr<TileSink> createTileSink(const std::string& path, int minZoom, int maxZoom) {
+    if (endsWith(path, ".mbtiles")) {
+        auto sink = std::make_unique<MBTilesSink>();
+        if (!sink->open(path, minZoom, maxZoom)) return nullptr;
+        return sink;
+    }
+    auto sink = std::make_unique<DirectoryTileSink>();
+    if (!sink->open(path)) return nullptr;
+    return sink;
+}
+
+std::unique_ptr<TileSource> openTileSource(const std::string& path) {
+    if (endsWith(path, ".mbtiles")) {
+        auto source = std::make_unique<MBTilesSource>();
+        if (!source->open(path)) return nullptr;
+        return source;
+    }
+    auto source = std::make_unique<DirectoryTileSource>();
+    if (!source->open(path)) return nullptr;
+    return source;
+}
+
+MBTilesSink::~MBTilesSink() {
+    close();
+}
+
+bool MBTilesSink::open(const std::string& path, int minZoom, int maxZoom) {
+    std::filesystem::remove(path);
+    if (sqlite3_open(path.c_str(), &m_db) != SQLITE_OK) {
+        std::cerr << "Failed to create " << path << ": " << sqlite3_errmsg(m_db) << std::endl;
+        sqlite3_close(m_db);
+        m_db = nullptr;
+        return false;
+    }
+
+    const char* schema =
+        "PRAGMA journal_mode=OFF;"
+        "PRAGMA synchronous=OFF;"
+        "CREATE TABLE metadata (name TEXT, value TEXT);"
+        "CREATE TABLE tiles (zoom_level INTEGER, tile_column INTEGER, tile_row INTEGER, tile_data BLOB);"
+        "CREATE UNIQUE INDEX tile_index ON tiles (zoom_level, tile_column, tile_row);";
+    if (sqlite3_exec(m_db, schema, nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to create MBTiles schema: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+
+    std::string metadata =
+        "INSERT INTO metadata VALUES ('name', 'MultiAppProgram tiles');"
+        "INSERT INTO metadata VALUES ('format', 'png');"
+        "INSERT INTO metadata VALUES ('type', 'baselayer');"
+        "INSERT INTO metadata VALUES ('minzoom', '" + std::to_string(minZoom) + "');"
+        "INSERT INTO metadata VALUES ('maxzoom', '" + std::to_string(maxZoom) + "');";
+    if (sqlite3_exec(m_db, metadata.c_str(), nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to write MBTiles metadata: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+
+    if (sqlite3_prepare_v2(m_db, "INSERT OR REPLACE INTO tiles VALUES (?, ?, ?, ?)", -1, &m_insert, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to prepare the tile insert: " << sqlite3_errmsg(m_db) << std::endl;
+        return false;
+    }
+    if (sqlite3_exec(m_db, "BEGIN", nullptr, nullptr, nullptr) != SQLITE_OK) {
+        std::cerr << "Failed to start the tile transaction: " << sqlite3_errmsg(m_db) << std::endl;
+        sqlite3_finalize(m_insert);
+        m_insert = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool MBTilesSink::write(const projection::TileId& tile, const std::vector<std::uint8_t>& png) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_insert) return false;
+
+    // MBTiles rows count from the bottom (TMS)
+    int row = (1 << tile.z) - 1 - tile.y;
+    sqlite3_bind_int(m_insert, 1, tile.z);
+    sqlite3_bind_int(m_insert, 2, tile.x);
+    sqlite3_bind_int(m_insert, 3, row);
+    sqlite3_bind_blob(m_insert, 4, png.data(), static_cast<int>(png.size()), SQLITE_STATIC);
+    bool ok = sqlite3_step(m_insert) == SQLITE_DONE;
+    sqlite3_reset(m_insert);
+
+    if (++m_pendingInTransaction >= TilesPerTransaction) {
+        sqlite3_exec(m_db, "COMMIT; BEGIN", nullptr, nullptr, nullptr);
+        m_pendingInTransaction = 0;
+    }
+    return ok;
+}
+
+void MBTilesSink::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_db) return;
+
+    sqlite3_finalize(m_insert);
+    m_insert = nullptr;
+    sqlite3_exec(m_db, "COMMIT", nullptr, nullptr, nullptr);
+    sqlite3_close(m_db);
+    m_db = nullptr;
+}
+
+bool MBTilesSource::open(const std::string& path) {
+    ConnectionPool::Lease connection = ConnectionPool::instance().acquire(path);
+    if (!connection) return false;
+    m_path = path;
+
+    sqlite3_stmt* metadata = connection.statements().acquire("SELECT name, value FROM metadata WHERE name IN ('minzoom', 'maxzoom')");
+    if (metadata) {
+        while (sqlite3_step(metadata) == SQLITE_ROW) {
+            std::string name = reinterpret_cast<const char*>(sqlite3_column_text(metadata, 0));
+            int value = sqlite3_column_int(metadata, 1);
+            if (name == "minzoom") m_minZoom = value;
+            if (name == "maxzoom") m_maxZoom = value;
+        }
+        sqlite3_reset(metadata);
+    }
+
+    if (!connection.statements().acquire(SelectTile)) {
+        std::cerr << "Not an MBTiles file: " << path << ": " << connection.statements().error() << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool MBTilesSource::read(const projection::TileId& tile, std::vector<std::uint8_t>& png) {
+    ConnectionPool::Lease connection = ConnectionPool::instance().acquire(m_path);
+    if (!connection) return false;
+    sqlite3_stmt* select = connection.statements().acquire(SelectTile);
+    if (!select) return false;
+
+    int row = (1 << tile.z) - 1 - tile.y;
+    sqlite3_bind_int(select, 1, tile.z);
+    sqlite3_bind_int(select, 2, tile.x);
+    sqlite3_bind_int(select, 3, row);
+
+    bool found = false;
+    if (sqlite3_step(select) == SQLITE_ROW) {
+        const std::uint8_t* data = static_cast<const std::uint8_t*>(sqlite3_column_blob(select, 0));
+        png.assign(data, data + sqlite3_column_bytes(select, 0));
+        found = true;
+    }
+    sqlite3_reset(select);
+    return found;
+}
+
+bool DirectoryTileSink::open(const std::string& path) {
+    m_root = path;
+    std::error_code error;
+    std::filesystem::create_directories(m_root, error);
+    return !error;
+}
+
+bool DirectoryTileSink::write(const projection::TileId& tile, const std::vector<std::uint8_t>& png) {
+    std::string path = tilePath(m_root, tile);
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(path).parent_path(), error);
+
+    std::ofstream file(path, std::ios::binary);
+    file.write(reinterpret_cast<const char*>(png.data()), static_cast<std::streamsize>(png.size()));
+    return static_cast<bool>(file);
+}
+
+bool DirectoryTileSource::open(const std::string& path) {
+    std::error_code error;
+    if (!std::filesystem::is_directory(path, error)) return false;
+    m_root = path;
+
+    // Zoom levels are the numeric subdirectories
+    bool found = false;
+    for (const auto& entry : std::filesystem::directory_iterator(path, error)) {
+        const std::string name = entry.path().filename().string();
+        if (!entry.is_directory() || name.empty() || name.find_first_not_of("0123456789") != std::string::npos) continue;
+
+        int z = std::stoi(name);
+        m_minZoom = found ? std::min(m_minZoom, z) : z;
+        m_maxZoom = found ? std::max(m_maxZoom, z) : z;
+        found = true;
+    }
+    return found;
+}
+
+bool DirectoryTileSource::read(const projection::TileId& tile, std::vector<std::uint8_t>& png) {
+    std::ifstream file(tilePath(m_root, tile), std::ios::binary);
+    if (!file) return false;
+    png.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    return true;
+}
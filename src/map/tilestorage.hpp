@@ -0,0 +1,82 @@
+#pragma once
+
+#include "projection.hpp"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+struct sqlite3;
+struct sqlite3_stmt;
+
+// Storage for pre-rendered PNG tiles: either an MBTiles file (SQLite, TMS
+// row order) or a plain z/x/y.png directory tree. The backend is chosen by
+// the path: "*.mbtiles" is MBTiles, anything else a directory.
+
+class TileSink {
+public:
+    virtual ~TileSink() = default;
+    // Thread-safe
+    virtual bool write(const projection::TileId& tile, const std::vector<std::uint8_t>& png) = 0;
+    virtual void close() = 0;
+};
+
+class TileSource {
+public:
+    virtual ~TileSource() = default;
+    // Returns false if the tile does not exist
+    virtual bool read(const projection::TileId& tile, std::vector<std::uint8_t>& png) = 0;
+    int minZoom() const { return m_minZoom; }
+    int maxZoom() const { return m_maxZoom; }
+
+protected:
+    int m_minZoom = 0;
+    int m_maxZoom = 0;
+};
+
+std::unique_ptr<TileSink> createTileSink(const std::string& path, int minZoom, int maxZoom);
+std::unique_ptr<TileSource> openTileSource(const std::string& path);
+
+class MBTilesSink : public TileSink {
+public:
+    ~MBTilesSink() override;
+    bool open(const std::string& path, int minZoom, int maxZoom);
+    bool write(const projection::TileId& tile, const std::vector<std::uint8_t>& png) override;
+    void close() override;
+
+private:
+    sqlite3* m_db = nullptr;
+    sqlite3_stmt* m_insert = nullptr;
+    std::mutex m_mutex;
+    int m_pendingInTransaction = 0;
+};
+
+// Reads through the shared ConnectionPool, so concurrent reads each get their own connection
+class MBTilesSource : public TileSource {
+public:
+    bool open(const std::string& path);
+    bool read(const projection::TileId& tile, std::vector<std::uint8_t>& png) override;
+
+private:
+    std::string m_path;
+};
+
+class DirectoryTileSink : public TileSink {
+public:
+    bool open(const std::string& path);
+    bool write(const projection::TileId& tile, const std::vector<std::uint8_t>& png) override;
+    void close() override {}
+
+private:
+    std::string m_root;
+};
+
+class DirectoryTileSource : public TileSource {
+public:
+    bool open(const std::string& path);
+    bool read(const projection::TileId& tile, std::vector<std::uint8_t>& png) override;
+
+private:
+    std::string m_root;
+};
@@ -0,0 +1,29 @@
+#include "vectorshapes.hpp"
+#include "projection.hpp"
+#include "../utils/allocationtracker.hpp"
+
+sf::Vector2f projectToWorld(const GeometryStore::Coordinate& coordinate, sf::Vector2f worldSize) {
+    return sf::Vector2f(static_cast<float>(projection::lonToWorldX(coordinate.lon, worldSize.x)),
+                        static_cast<float>(projection::latToWorldY(coordinate.lat, worldSize.y)));
+}
+
+std::vector<sf::VertexArray> buildVectorShapes(const GeometryStore& geometry, const MapStyle& style, sf::Vector2f worldSize) {
+    AllocationTracker::Scope scope("map.shapes");
+    std::vector<sf::VertexArray> shapes;
+    shapes.reserve(geometry.parts().size());
+    const auto& vertices = geometry.vertices();
+    for (const GeometryStore::Part& part : geometry.parts()) {
+        if (part.type == GeometryStore::PartType::Point) {
+            shapes.emplace_back();
+            continue;
+        }
+
+        const sf::Color& color = part.type == GeometryStore::PartType::Ring ? style.ringColor : style.lineColor;
+        sf::VertexArray shape(sf::LineStrip, part.vertexCount);
+        for (std::uint32_t i = 0; i < part.vertexCount; ++i) {
+            shape[i] = sf::Vertex(projectToWorld(vertices[part.firstVertex + i], worldSize), color);
+        }
+        shapes.push_back(std::move(shape));
+    }
+    return shapes;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "geometrystore.hpp"
+#include "mapstyle.hpp"
+#include <vector>
+
+// Where a coordinate lands in the map's world space, which spans `worldSize`
+sf::Vector2f projectToWorld(const GeometryStore::Coordinate& coordinate, sf::Vector2f worldSize);
+
+// Line strips for every line and ring, as the map draws them; plain vertex
+// data, so any thread may build them. One array per part of the store, in
+// its order and empty for points, so a patch can replace single parts.
+std::vector<sf::VertexArray> buildVectorShapes(const GeometryStore& geometry, const MapStyle& style, sf::Vector2f worldSize);
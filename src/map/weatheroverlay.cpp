@@ -0,0 +1,663 @@
+#include "weatheroverlay.hpp"
+#include "projection.hpp"
+#include <gdal_priv.h>
+#include <gdalwarper.h>
+#include <ogr_spatialref.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <initializer_list>
+#include <iostream>
+#include <limits>
+
+namespace {
+    typedef std::chrono::steady_clock Clock;
+
+    const std::uint8_t OverlayAlpha = 150;
+    // Temperatures always use the same scale, so steps and files compare
+    const float MinTemperature = -40.f;
+    const float MaxTemperature = 45.f;
+
+    struct RampStop {
+        float at; // 0..1 along the ramp
+        std::uint8_t r, g, b, a;
+    };
+
+    const RampStop TemperatureRamp[] = {
+        {0.00f, 120, 0, 160, OverlayAlpha}, {0.18f, 40, 60, 220, OverlayAlpha}, {0.35f, 0, 170, 230, OverlayAlpha},
+        {0.47f, 190, 240, 255, OverlayAlpha}, {0.59f, 60, 200, 80, OverlayAlpha}, {0.71f, 250, 220, 40, OverlayAlpha},
+        {0.82f, 250, 130, 20, OverlayAlpha}, {1.00f, 190, 0, 30, OverlayAlpha},
+    };
+    // No precipitation and no wind are left clear
+    const RampStop PrecipitationRamp[] = {
+        {0.00f, 150, 200, 255, 0}, {0.05f, 150, 200, 255, OverlayAlpha}, {0.35f, 30, 90, 230, OverlayAlpha},
+        {0.70f, 150, 40, 200, OverlayAlpha}, {1.00f, 230, 40, 160, OverlayAlpha},
+    };
+    const RampStop WindRamp[] = {
+        {0.00f, 255, 255, 255, 0}, {0.15f, 120, 200, 120, OverlayAlpha}, {0.45f, 250, 220, 50, OverlayAlpha},
+        {0.75f, 230, 60, 40, OverlayAlpha}, {1.00f, 150, 0, 120, OverlayAlpha},
+    };
+    const RampStop GenericRamp[] = {
+        {0.00f, 68, 1, 84, OverlayAlpha}, {0.25f, 59, 82, 139, OverlayAlpha}, {0.50f, 33, 145, 140, OverlayAlpha},
+        {0.75f, 94, 201, 98, OverlayAlpha}, {1.00f, 253, 231, 37, OverlayAlpha},
+    };
+
+    template <std::size_t Count>
+    void fillRamp(const RampStop (&stops)[Count], imagekernels::ColorRamp& ramp) {
+        std::size_t stop = 0;
+        for (unsigned int i = 0; i < 256; ++i) {
+            float at = (i + 0.5f) / 256.f;
+            while (stop + 2 < Count && at > stops[stop + 1].at) ++stop;
+            const RampStop& a = stops[stop];
+            const RampStop& b = stops[stop + 1];
+            float t = std::min(1.f, std::max(0.f, (at - a.at) / (b.at - a.at)));
+            std::uint8_t color[4] = {
+                static_cast<std::uint8_t>(a.r + (b.r - a.r) * t + 0.5f), static_cast<std::uint8_t>(a.g + (b.g - a.g) * t + 0.5f),
+                static_cast<std::uint8_t>(a.b + (b.b - a.b) * t + 0.5f), static_cast<std::uint8_t>(a.a + (b.a - a.a) * t + 0.5f)};
+            std::memcpy(&ramp.colors[i], color, 4);
+        }
+    }
+
+    const char* valueOr(const char* value, const char* fallback) {
+        return value && *value ? value : fallback;
+    }
+
+    std::string lowercase(std::string text) {
+        std::transform(text.begin(), text.end(), text.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return text;
+    }
+
+    bool containsAny(const std::string& text, std::initializer_list<const char*> words) {
+        return std::any_of(words.begin(), words.end(), [&](const char* word) { return text.find(word) != std::string::npos; });
+    }
+
+    // Days since 1970-01-01 of a proleptic Gregorian date
+    std::int64_t daysFromCivil(std::int64_t year, unsigned int month, unsigned int day) {
+        year -= month <= 2;
+        std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+        unsigned int yearOfEra = static_cast<unsigned int>(year - era * 400);
+        unsigned int dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+        unsigned int dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+        return era * 146097 + static_cast<std::int64_t>(dayOfEra) - 719468;
+    }
+
+    // A CF time coordinate ("hours since 1900-01-01 00:00:00") as Unix
+    // seconds, or 0 if the units are not understood
+    std::int64_t cfTime(std::string units, double value) {
+        std::replace(units.begin(), units.end(), 'T', ' ');
+        char unit[16] = {};
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0;
+        double second = 0.0;
+        if (std::sscanf(units.c_str(), "%15s since %d-%d-%d %d:%d:%lf", unit, &year, &month, &day, &hour, &minute, &second) < 4) return 0;
+
+        std::string name = lowercase(unit);
+        double factor = 0.0;
+        if (name.rfind("second", 0) == 0 || name == "s") factor = 1.0;
+        else if (name.rfind("minute", 0) == 0) factor = 60.0;
+        else if (name.rfind("hour", 0) == 0 || name == "h") factor = 3600.0;
+        else if (name.rfind("day", 0) == 0 || name == "d") factor = 86400.0;
+        if (factor == 0.0 || month < 1 || month > 12 || day < 1 || day > 31) return 0;
+
+        std::int64_t epoch = daysFromCivil(year, static_cast<unsigned int>(month), static_cast<unsigned int>(day)) * 86400 +
+                             hour * 3600 + minute * 60 + static_cast<std::int64_t>(second);
+        return epoch + std::llround(value * factor);
+    }
+
+    std::string formatTime(std::int64_t seconds) {
+        std::time_t time = static_cast<std::time_t>(seconds);
+        char text[32];
+        const std::tm* utc = std::gmtime(&time);
+        if (!utc || std::strftime(text, sizeof(text), "%Y-%m-%d %H:%M UTC", utc) == 0) return std::string();
+        return text;
+    }
+
+    // "[K]" -> "K"
+    std::string cleanUnit(std::string unit) {
+        unit.erase(std::remove_if(unit.begin(), unit.end(), [](char c) { return c == '[' || c == ']'; }), unit.end());
+        while (!unit.empty() && unit.back() == ' ') unit.pop_back();
+        while (!unit.empty() && unit.front() == ' ') unit.erase(unit.begin());
+        return unit;
+    }
+
+    GDALDataset* openRaster(const std::string& name) {
+        return static_cast<GDALDataset*>(GDALOpenEx(name.c_str(), GDAL_OF_RASTER | GDAL_OF_READONLY, nullptr, nullptr, nullptr));
+    }
+
+    // A dataset held open by the decode thread, with a lon/lat view of it if
+    // it is projected
+    struct Source {
+        bool tried = false;
+        std::unique_ptr<GDALDataset> dataset;
+        std::unique_ptr<GDALDataset> warped;
+
+        GDALDataset* get() const { return warped ? warped.get() : dataset.get(); }
+
+        void open(const std::string& name) {
+            tried = true;
+            dataset.reset(openRaster(name));
+            if (!dataset) {
+                std::cerr << "Weather overlay could not open " << name << std::endl;
+                return;
+            }
+            const OGRSpatialReference* srs = dataset->GetSpatialRef();
+            if (!srs || srs->IsGeographic()) return;
+
+            OGRSpatialReference wgs84;
+            wgs84.SetWellKnownGeogCS("WGS84");
+            wgs84.SetAxisMappingStrategy(OAMS_TRADITIONAL_GIS_ORDER);
+            char* wkt = nullptr;
+            wgs84.exportToWkt(&wkt);
+            warped.reset(GDALDataset::FromHandle(
+                GDALAutoCreateWarpedVRT(GDALDataset::ToHandle(dataset.get()), nullptr, wkt, GRA_Bilinear, 0.125, nullptr)));
+            CPLFree(wkt);
+            if (!warped) {
+                std::cerr << "Weather overlay could not reproject " << name << " to lon/lat" << std::endl;
+                dataset.reset();
+            }
+        }
+    };
+}
+
+struct WeatherOverlay::Decoder {
+    std::unordered_map<std::string, Source> sources;
+};
+
+WeatherOverlay::WeatherOverlay()
+    : m_decoder(std::make_unique<Decoder>())
+{
+}
+
+WeatherOverlay::~WeatherOverlay() {
+    close();
+}
+
+bool WeatherOverlay::open(const std::string& path) {
+    close();
+
+    std::unique_ptr<GDALDataset> dataset(openRaster(path));
+    if (!dataset) {
+        std::cerr << "Could not open forecast " << path << std::endl;
+        return false;
+    }
+
+    // NetCDF files with several variables list each as a subdataset
+    const std::string stem = std::filesystem::path(path).stem().string();
+    char** subdatasets = dataset->GetMetadata("SUBDATASETS");
+    for (int i = 1; subdatasets; ++i) {
+        const char* name = CSLFetchNameValue(subdatasets, ("SUBDATASET_" + std::to_string(i) + "_NAME").c_str());
+        if (!name) break;
+        std::unique_ptr<GDALDataset> subdataset(openRaster(name));
+        if (subdataset) addBands(name, subdataset.get(), stem);
+    }
+    if (m_variables.empty()) addBands(path, dataset.get(), stem);
+    if (m_variables.empty()) {
+        std::cerr << "No raster bands in forecast " << path << std::endl;
+        return false;
+    }
+
+    for (Variable& variable : m_variables) {
+        std::stable_sort(variable.steps.begin(), variable.steps.end(), [](const Step& a, const Step& b) { return a.validTime < b.validTime; });
+        std::cout << "Forecast variable " << variable.name << " (" << variable.description << ", "
+                  << (variable.unit.empty() ? "no unit" : variable.unit) << "): " << variable.steps.size() << " steps" << std::endl;
+    }
+
+    m_variable = 0;
+    m_step = 0;
+    m_stalled = false;
+    m_shown.reset();
+    m_lastGrid.reset();
+    m_rampVariable = static_cast<std::size_t>(-1);
+    m_stats = Stats();
+    m_decodes = CancellationToken();
+    requestSteps();
+    return true;
+}
+
+void WeatherOverlay::close() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_queue.clear();
+    }
+    m_decodes.cancel();
+    m_decodes.wait();
+    m_decoder->sources.clear();
+    m_variables.clear();
+    m_grids.clear();
+    m_decoding = NoStep;
+    m_urgent = NoStep;
+    m_decodeQueued = false;
+    m_shown.reset();
+    m_lastGrid.reset();
+    m_playing = false;
+}
+
+void WeatherOverlay::addBands(const std::string& name, GDALDataset* dataset, const std::string& fallbackName) {
+    const char* timeUnits = dataset->GetMetadataItem("time#units");
+    for (int b = 1; b <= dataset->GetRasterCount(); ++b) {
+        GDALRasterBand* band = dataset->GetRasterBand(b);
+        std::string id;
+        std::string description;
+        std::string unit;
+        std::int64_t validTime = 0;
+        if (const char* element = band->GetMetadataItem("GRIB_ELEMENT")) {
+            // One band per element, level and time: "TMP" at "2-HTGL"
+            const char* level = band->GetMetadataItem("GRIB_SHORT_NAME");
+            id = level ? std::string(element) + " " + level : std::string(element);
+            description = valueOr(band->GetMetadataItem("GRIB_COMMENT"), id.c_str());
+            unit = valueOr(band->GetMetadataItem("GRIB_UNIT"), "");
+            validTime = std::atoll(valueOr(band->GetMetadataItem("GRIB_VALID_TIME"), "0"));
+        } else if (const char* variable = band->GetMetadataItem("NETCDF_VARNAME")) {
+            id = variable;
+            description = valueOr(band->GetMetadataItem("long_name"), variable);
+            unit = valueOr(band->GetMetadataItem("units"), "");
+            const char* time = band->GetMetadataItem("NETCDF_DIM_time");
+            if (time && timeUnits) validTime = cfTime(timeUnits, std::atof(time));
+        } else {
+            // Plain multi-band rasters: one variable, a step per band
+            id = fallbackName;
+            description = fallbackName;
+            unit = valueOr(band->GetUnitType(), "");
+        }
+
+        auto existing = std::find_if(m_variables.begin(), m_variables.end(), [&](const Variable& v) { return v.name == id; });
+        if (existing == m_variables.end()) {
+            Variable variable;
+            variable.name = id;
+            // GRIB comments repeat the unit: "Temperature [C]"
+            std::size_t bracket = description.rfind(" [");
+            variable.description = bracket != std::string::npos && description.back() == ']' ? description.substr(0, bracket) : description;
+            variable.unit = cleanUnit(unit);
+            if (variable.unit == "K") variable.kelvin = true;
+            if (variable.kelvin || variable.unit == "C" || variable.unit == "degC") variable.unit = "°C";
+
+            std::string words = lowercase(variable.name + " " + variable.description);
+            if (variable.unit == "°C") {
+                variable.kind = RampKind::Temperature;
+            } else if (containsAny(words, {"apcp", "prate", "precip", "rain", "snow"}) || lowercase(variable.name) == "tp") {
+                variable.kind = RampKind::Precipitation;
+            } else if (containsAny(words, {"wind speed", "wspd", "gust", "si10"})) {
+                variable.kind = RampKind::Wind;
+            }
+            m_variables.push_back(std::move(variable));
+            existing = m_variables.end() - 1;
+        }
+        existing->steps.push_back(Step{name, b, validTime});
+    }
+}
+
+std::shared_ptr<const WeatherOverlay::Grid> WeatherOverlay::decode(GDALDataset* dataset, int bandIndex, bool kelvin) {
+    GDALRasterBand* band = dataset->GetRasterBand(bandIndex);
+    double geoTransform[6];
+    if (!band || dataset->GetGeoTransform(geoTransform) != CE_None || geoTransform[2] != 0.0 || geoTransform[4] != 0.0) {
+        return nullptr;
+    }
+
+    auto grid = std::make_shared<Grid>();
+    grid->width = static_cast<unsigned int>(dataset->GetRasterXSize());
+    grid->height = static_cast<unsigned int>(dataset->GetRasterYSize());
+    grid->west = geoTransform[0];
+    grid->lonStep = geoTransform[1];
+    grid->north = geoTransform[3];
+    grid->latStep = geoTransform[5];
+    grid->wraps = std::abs(grid->width * grid->lonStep - 360.0) < std::abs(grid->lonStep) * 0.5;
+    // Regional grids in 0..360 longitudes
+    if (!grid->wraps && grid->west >= 180.0) grid->west -= 360.0;
+
+    grid->values.resize(static_cast<std::size_t>(grid->width) * grid->height);
+    if (band->RasterIO(GF_Read, 0, 0, grid->width, grid->height, grid->values.data(), grid->width, grid->height, GDT_Float32, 0, 0) != CE_None) {
+        return nullptr;
+    }
+
+    // Packed NetCDF values carry a scale and offset
+    int hasNoData = FALSE;
+    const float noData = static_cast<float>(band->GetNoDataValue(&hasNoData));
+    const double scale = band->GetScale();
+    const double offset = band->GetOffset() - (kelvin ? 273.15 : 0.0);
+    bool first = true;
+    for (float& value : grid->values) {
+        if ((hasNoData && value == noData) || !std::isfinite(value)) {
+            value = std::numeric_limits<float>::quiet_NaN();
+            continue;
+        }
+        value = static_cast<float>(value * scale + offset);
+        grid->minValue = first ? value : std::min(grid->minValue, value);
+        grid->maxValue = first ? value : std::max(grid->maxValue, value);
+        first = false;
+    }
+    return grid;
+}
+
+bool WeatherOverlay::needsDecodeTask(TaskScheduler::Priority& priority) {
+    // A running task queues the next one itself when it is done
+    if (m_queue.empty() || m_decoding != NoStep) return false;
+    priority = m_queue.front() == m_urgent ? TaskScheduler::Priority::High : TaskScheduler::Priority::Low;
+    // One queued at Low for a step that is now shown is overtaken by a High one
+    if (m_decodeQueued && m_decodePriority <= priority) return false;
+    m_decodeQueued = true;
+    m_decodePriority = priority;
+    return true;
+}
+
+void WeatherOverlay::decodeNext() {
+    std::uint64_t next;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decodeQueued = false;
+        // Another task got here first, or the queue was cleared
+        if (m_decoding != NoStep || m_queue.empty()) return;
+        next = m_queue.front();
+        m_queue.pop_front();
+        m_decoding = next;
+    }
+
+    // The variable list does not change while a task runs
+    const Variable& variable = m_variables[static_cast<std::size_t>(next >> 32)];
+    const Step& step = variable.steps[static_cast<std::size_t>(next & 0xFFFFFFFFu)];
+    Source& source = m_decoder->sources[step.dataset];
+    if (!source.tried) source.open(step.dataset);
+
+    Clock::time_point start = Clock::now();
+    std::shared_ptr<const Grid> grid = source.get() ? decode(source.get(), step.band, variable.kelvin) : nullptr;
+    double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    if (source.get() && !grid) {
+        std::cerr << "Weather overlay could not decode band " << step.band << " of " << step.dataset << std::endl;
+    }
+
+    TaskScheduler::Priority priority;
+    bool more;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_decoding = NoStep;
+        m_grids[next] = std::move(grid);
+        m_stats.decodeMilliseconds = (m_stats.decodeMilliseconds * m_stats.decoded + milliseconds) / (m_stats.decoded + 1);
+        ++m_stats.decoded;
+        more = needsDecodeTask(priority);
+    }
+    if (more) {
+        TaskScheduler::instance().submit(priority, m_decodes, [this] { decodeNext(); });
+    }
+}
+
+void WeatherOverlay::requestSteps() {
+    if (!isOpen()) return;
+    const std::uint64_t current = key(m_variable, m_step);
+    const std::uint64_t next = key(m_variable, (m_step + 1) % stepCount());
+    TaskScheduler::Priority priority;
+    bool schedule;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        // Anything still queued was for a step that is no longer wanted
+        m_queue.clear();
+        m_urgent = current;
+        for (std::uint64_t wanted : {current, next}) {
+            if (m_grids.count(wanted) == 0 && wanted != m_decoding &&
+                std::find(m_queue.begin(), m_queue.end(), wanted) == m_queue.end()) {
+                m_queue.push_back(wanted);
+            }
+        }
+        if (m_grids.size() > MaxCachedSteps) {
+            for (auto it = m_grids.begin(); it != m_grids.end();) {
+                it = it->first == current || it->first == next ? std::next(it) : m_grids.erase(it);
+            }
+        }
+        schedule = needsDecodeTask(priority);
+    }
+    if (schedule) {
+        TaskScheduler::instance().submit(priority, m_decodes, [this] { decodeNext(); });
+    }
+}
+
+void WeatherOverlay::releaseCache() {
+    if (isOpen()) {
+        const std::uint64_t current = key(m_variable, m_step);
+        const std::uint64_t next = key(m_variable, (m_step + 1) % stepCount());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        for (auto it = m_grids.begin(); it != m_grids.end();) {
+            it = it->first == current || it->first == next ? std::next(it) : m_grids.erase(it);
+        }
+    }
+    m_lastGrid.reset();
+    std::vector<std::uint8_t>().swap(m_pixels);
+    m_pixelSize = sf::Vector2u(0, 0);
+    m_texture = sf::Texture();
+}
+
+std::size_t WeatherOverlay::cpuBytes() const {
+    std::size_t bytes = m_pixels.capacity();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto& entry : m_grids) {
+        if (entry.second) bytes += entry.second->values.capacity() * sizeof(float);
+    }
+    return bytes;
+}
+
+std::size_t WeatherOverlay::textureBytes() const {
+    return static_cast<std::size_t>(m_texture.getSize().x) * m_texture.getSize().y * 4;
+}
+
+bool WeatherOverlay::isDecoded(std::size_t step) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_grids.count(key(m_variable, step)) != 0;
+}
+
+std::shared_ptr<const WeatherOverlay::Grid> WeatherOverlay::findGrid(std::size_t step) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_grids.find(key(m_variable, step));
+    return it != m_grids.end() ? it->second : nullptr;
+}
+
+std::size_t WeatherOverlay::stepCount() const {
+    return isOpen() ? m_variables[m_variable].steps.size() : 0;
+}
+
+void WeatherOverlay::nextVariable() {
+    if (m_variables.size() < 2) return;
+    m_variable = (m_variable + 1) % m_variables.size();
+    m_step = std::min(m_step, stepCount() - 1);
+    // Nothing until the new variable is decoded; its ramp may differ
+    m_shown.reset();
+    m_lastGrid.reset();
+    m_stalled = false;
+    requestSteps();
+}
+
+void WeatherOverlay::stepBy(int steps) {
+    const std::size_t count = stepCount();
+    if (count == 0) return;
+    long long step = (static_cast<long long>(m_step) + steps) % static_cast<long long>(count);
+    m_step = static_cast<std::size_t>(step < 0 ? step + static_cast<long long>(count) : step);
+    m_nextStepAt = Clock::now() + m_stepInterval;
+    m_stalled = false;
+    requestSteps();
+}
+
+void WeatherOverlay::setPlaying(bool playing) {
+    m_playing = playing && stepCount() > 1;
+    m_nextStepAt = Clock::now() + m_stepInterval;
+    m_stalled = false;
+}
+
+void WeatherOverlay::update() {
+    if (!m_playing || !m_visible) return;
+    Clock::time_point now = Clock::now();
+    if (now < m_nextStepAt) return;
+
+    // Hold the current step rather than show a blank or half-loaded one
+    const std::size_t next = (m_step + 1) % stepCount();
+    if (!isDecoded(next)) {
+        if (!m_stalled) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            ++m_stats.stalls;
+        }
+        m_stalled = true;
+        return;
+    }
+    m_stalled = false;
+    m_step = next;
+    m_nextStepAt = now + m_stepInterval;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        ++m_stats.advanced;
+    }
+    requestSteps();
+}
+
+bool WeatherOverlay::isBusy() const {
+    if (!isOpen() || !m_visible) return false;
+    return m_playing || !isDecoded(m_step);
+}
+
+bool WeatherOverlay::resample(const sf::View& view, sf::Vector2f worldSize, sf::Vector2u targetSize) {
+    // Until a step is decoded the previous one stays up
+    if (std::shared_ptr<const Grid> grid = findGrid(m_step)) m_shown = std::move(grid);
+    if (!m_shown) return false;
+
+    sf::Vector2u size(std::max(1u, targetSize.x / m_resampleDivisor), std::max(1u, targetSize.y / m_resampleDivisor));
+    if (m_shown == m_lastGrid && size == m_pixelSize && view.getCenter() == m_lastViewCenter && view.getSize() == m_lastViewSize) {
+        return false;
+    }
+    if (m_rampVariable != m_variable) {
+        buildRamp(*m_shown);
+        m_rampVariable = m_variable;
+    }
+
+    // Equirectangular world space maps linearly to lon/lat, so so does
+    // every row and column of the output
+    const Grid& grid = *m_shown;
+    const sf::Vector2f topLeft = view.getCenter() - view.getSize() / 2.f;
+    const double pixelWidth = view.getSize().x / size.x;
+    const double pixelHeight = view.getSize().y / size.y;
+    imagekernels::GridPlacement placement;
+    placement.column = (projection::worldXToLon(topLeft.x + 0.5 * pixelWidth, worldSize.x) - grid.west) / grid.lonStep - 0.5;
+    placement.columnStep = pixelWidth * (360.0 / worldSize.x) / grid.lonStep;
+    placement.row = (projection::worldYToLat(topLeft.y + 0.5 * pixelHeight, worldSize.y) - grid.north) / grid.latStep - 0.5;
+    placement.rowStep = -pixelHeight * (180.0 / worldSize.y) / grid.latStep;
+
+    Clock::time_point start = Clock::now();
+    m_pixels.resize(static_cast<std::size_t>(size.x) * size.y * 4);
+    imagekernels::sampleGrid(grid.values.data(), grid.width * sizeof(float), grid.width, grid.height, grid.wraps, placement, m_ramp,
+                             m_pixels.data(), size.x * 4, size.x, size.y);
+    double milliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+    m_pixelSize = size;
+    m_lastGrid = m_shown;
+    m_lastViewCenter = view.getCenter();
+    m_lastViewSize = view.getSize();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stats.resampleMilliseconds = (m_stats.resampleMilliseconds * m_stats.resampled + milliseconds) / (m_stats.resampled + 1);
+    m_stats.maxResampleMilliseconds = std::max(m_stats.maxResampleMilliseconds, milliseconds);
+    ++m_stats.resampled;
+    return true;
+}
+
+void WeatherOverlay::buildRamp(const Grid& grid) {
+    const Variable& variable = m_variables[m_variable];
+    switch (variable.kind) {
+    case RampKind::Temperature:
+        fillRamp(TemperatureRamp, m_ramp);
+        m_ramp.minValue = MinTemperature;
+        m_ramp.maxValue = MaxTemperature;
+        return;
+    case RampKind::Precipitation:
+        fillRamp(PrecipitationRamp, m_ramp);
+        break;
+    case RampKind::Wind:
+        fillRamp(WindRamp, m_ramp);
+        break;
+    case RampKind::Generic:
+        fillRamp(GenericRamp, m_ramp);
+        break;
+    }
+    // Other variables keep the range of the first step shown, so the
+    // colours mean the same while the forecast plays
+    m_ramp.minValue = variable.kind == RampKind::Generic ? grid.minValue : std::min(0.f, grid.minValue);
+    m_ramp.maxValue = std::max(grid.maxValue, m_ramp.minValue + 1e-3f);
+}
+
+void WeatherOverlay::draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize) {
+    if (!isOpen() || !m_visible) return;
+    if (resample(view, worldSize, target.getSize())) {
+        if (m_texture.getSize() != m_pixelSize) {
+            if (!m_texture.create(m_pixelSize.x, m_pixelSize.y)) return;
+            m_texture.setSmooth(true);
+        }
+        m_texture.update(m_pixels.data());
+    }
+    if (!m_lastGrid) return;
+
+    // Stretched over the view it was sampled for, which is the current one
+    sf::Sprite sprite(m_texture);
+    sprite.setPosition(m_lastViewCenter - m_lastViewSize / 2.f);
+    sprite.setScale(m_lastViewSize.x / m_pixelSize.x, m_lastViewSize.y / m_pixelSize.y);
+    target.draw(sprite);
+}
+
+std::string WeatherOverlay::describe() const {
+    if (!isOpen()) return std::string();
+    const Variable& variable = m_variables[m_variable];
+    std::string text = variable.description;
+    if (!variable.unit.empty()) text += " (" + variable.unit + ")";
+    const Step& step = variable.steps[m_step];
+    if (step.validTime != 0) text += ", " + formatTime(step.validTime);
+    text += ", step " + std::to_string(m_step + 1) + "/" + std::to_string(variable.steps.size());
+    if (m_playing) text += m_stalled ? ", loading" : ", playing";
+    return text;
+}
+
+void WeatherOverlay::drawLegend(sf::RenderTarget& target, const sf::Font& font) {
+    if (!isOpen() || !m_visible) return;
+    const float width = 420.f;
+    const float barWidth = 400.f;
+    const sf::Vector2f origin((target.getSize().x - width) / 2.f, target.getSize().y - 130.f);
+
+    sf::RectangleShape background(sf::Vector2f(width, 56.f));
+    background.setPosition(origin);
+    background.setFillColor(sf::Color(255, 255, 255, 200));
+    target.draw(background);
+
+    const std::string description = describe();
+    sf::Text title(sf::String::fromUtf8(description.begin(), description.end()), font, 14);
+    title.setFillColor(sf::Color::Black);
+    title.setPosition(origin.x + 10.f, origin.y + 4.f);
+    target.draw(title);
+
+    // The ramp only exists once a step of this variable has been shown
+    if (m_rampVariable != m_variable) return;
+    const unsigned int Segments = 64;
+    sf::VertexArray bar(sf::Quads, Segments * 4);
+    for (unsigned int i = 0; i < Segments; ++i) {
+        std::uint8_t rgba[4];
+        std::memcpy(rgba, &m_ramp.colors[(i * 256 + 128) / Segments], 4);
+        // Opaque, so the scale reads clearly on the white box
+        sf::Color color(rgba[0], rgba[1], rgba[2], rgba[3] == 0 ? 0 : 255);
+        float left = origin.x + 10.f + barWidth * i / Segments;
+        float right = origin.x + 10.f + barWidth * (i + 1) / Segments;
+        bar[i * 4] = sf::Vertex(sf::Vector2f(left, origin.y + 24.f), color);
+        bar[i * 4 + 1] = sf::Vertex(sf::Vector2f(right, origin.y + 24.f), color);
+        bar[i * 4 + 2] = sf::Vertex(sf::Vector2f(right, origin.y + 36.f), color);
+        bar[i * 4 + 3] = sf::Vertex(sf::Vector2f(left, origin.y + 36.f), color);
+    }
+    target.draw(bar);
+
+    auto label = [&](float value, float x, bool alignRight) {
+        char text[32];
+        std::snprintf(text, sizeof(text), "%.4g", value);
+        sf::Text number(text, font, 11);
+        number.setFillColor(sf::Color::Black);
+        number.setPosition(alignRight ? x - number.getLocalBounds().width : x, origin.y + 38.f);
+        target.draw(number);
+    };
+    label(m_ramp.minValue, origin.x + 10.f, false);
+    label(m_ramp.maxValue, origin.x + 10.f + barWidth, true);
+}
+
+WeatherOverlay::Stats WeatherOverlay::stats() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+}
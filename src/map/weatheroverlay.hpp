@@ -0,0 +1,182 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include "../camera/imagekernels.hpp"
+#include "../utils/taskscheduler.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class GDALDataset;
+
+// Gridded forecast fields (GRIB2, NetCDF or any other raster GDAL reads)
+// drawn over the map through a colour ramp.
+//
+// A file is split into variables, each a series of time steps: GRIB bands
+// are grouped by element and level and ordered by valid time, and NetCDF
+// subdatasets are variables whose bands are the time steps. Fields on a
+// lon/lat grid are read as they are; other projections go through a warped
+// VRT to WGS84.
+//
+// Steps are decoded to float grids by TaskScheduler tasks, one at a time
+// since they share the GDAL handles: the shown step at High priority, the
+// next one ahead of time at Low. Playback only moves on once a step is
+// ready, so a frame never waits on GDAL. Drawing resamples the grid to half the window resolution (see
+// setResampleDivisor()) with imagekernels::sampleGrid, only when the view,
+// step or window changed.
+class WeatherOverlay {
+public:
+    struct Stats {
+        std::size_t decoded = 0;
+        double decodeMilliseconds = 0.0;   // average per step
+        std::size_t advanced = 0;          // steps moved on by playback
+        std::size_t stalls = 0;            // times playback had to wait for a decode
+        std::size_t resampled = 0;
+        double resampleMilliseconds = 0.0; // average
+        double maxResampleMilliseconds = 0.0;
+    };
+
+    WeatherOverlay();
+    ~WeatherOverlay();
+
+    WeatherOverlay(const WeatherOverlay&) = delete;
+    WeatherOverlay& operator=(const WeatherOverlay&) = delete;
+
+    // Returns false if the file holds no raster bands
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return !m_variables.empty(); }
+
+    void setVisible(bool visible) { m_visible = visible; }
+    bool isVisible() const { return m_visible; }
+    void nextVariable();
+    // Moves by `steps` time steps, wrapping around at either end
+    void stepBy(int steps);
+    void setPlaying(bool playing);
+    bool isPlaying() const { return m_playing; }
+    void setStepInterval(std::chrono::milliseconds interval) { m_stepInterval = interval; }
+    // Overlay pixels per window pixel is 1 / divisor on each axis; forecast
+    // fields are smooth enough that filtering the texture hides it
+    void setResampleDivisor(unsigned int divisor) { m_resampleDivisor = std::max(1u, divisor); }
+
+    // Advances playback; call once per frame
+    void update();
+    // True while playing or waiting for the shown step to be decoded
+    bool isBusy() const;
+
+    void draw(sf::RenderTarget& target, const sf::View& view, sf::Vector2f worldSize);
+    // Variable, valid time and colour scale along the bottom of the window
+    void drawLegend(sf::RenderTarget& target, const sf::Font& font);
+
+    // Resamples the shown step for `view` on a target of `targetSize`
+    // pixels unless nothing changed since the last call. draw() does this
+    // itself; public for the benchmark.
+    bool resample(const sf::View& view, sf::Vector2f worldSize, sf::Vector2u targetSize);
+
+    std::size_t stepCount() const;
+    std::size_t currentStep() const { return m_step; }
+    std::string describe() const;
+    Stats stats() const;
+
+    // Keeps the decoded grids of the shown and the next step, drops the
+    // other steps, the resampled pixels and the texture; the next draw()
+    // resamples again
+    void releaseCache();
+    std::size_t cpuBytes() const;
+    std::size_t textureBytes() const;
+
+private:
+    enum class RampKind { Temperature, Precipitation, Wind, Generic };
+
+    struct Step {
+        std::string dataset;        // what GDAL opens, a NetCDF subdataset for example
+        int band = 1;
+        std::int64_t validTime = 0; // Unix seconds, 0 if unknown
+    };
+
+    struct Variable {
+        std::string name;
+        std::string description;
+        std::string unit;
+        bool kelvin = false;        // converted to degrees Celsius when decoded
+        RampKind kind = RampKind::Generic;
+        std::vector<Step> steps;
+    };
+
+    // One decoded step on a regular lon/lat grid, rows from north to south
+    // or the other way round as the file has them
+    struct Grid {
+        std::vector<float> values;  // NaN where there is no data
+        unsigned int width = 0;
+        unsigned int height = 0;
+        double west = 0.0;          // edge of the first column
+        double north = 0.0;         // edge of the first row
+        double lonStep = 1.0;
+        double latStep = -1.0;
+        bool wraps = false;         // covers all longitudes
+        float minValue = 0.f;
+        float maxValue = 0.f;
+    };
+
+    std::vector<Variable> m_variables;
+    std::size_t m_variable = 0;
+    std::size_t m_step = 0;
+    bool m_visible = true;
+    bool m_playing = false;
+    bool m_stalled = false;
+    std::chrono::milliseconds m_stepInterval{500};
+    unsigned int m_resampleDivisor = 2;
+    std::chrono::steady_clock::time_point m_nextStepAt;
+
+    // Render thread: what is on screen
+    std::shared_ptr<const Grid> m_shown;
+    imagekernels::ColorRamp m_ramp;
+    std::size_t m_rampVariable = static_cast<std::size_t>(-1);
+    std::vector<std::uint8_t> m_pixels;
+    sf::Vector2u m_pixelSize;
+    sf::Texture m_texture;
+    std::shared_ptr<const Grid> m_lastGrid; // what the texture holds
+    sf::Vector2f m_lastViewCenter;
+    sf::Vector2f m_lastViewSize;
+
+    // GDAL handles, used by one decode task at a time
+    struct Decoder;
+    std::unique_ptr<Decoder> m_decoder;
+
+    // Shared with the decode tasks
+    CancellationToken m_decodes;
+    mutable std::mutex m_mutex;
+    std::deque<std::uint64_t> m_queue;
+    std::uint64_t m_decoding = NoStep;
+    std::uint64_t m_urgent = NoStep; // the shown step, decoded at High priority
+    bool m_decodeQueued = false;
+    TaskScheduler::Priority m_decodePriority = TaskScheduler::Priority::Low;
+    std::unordered_map<std::uint64_t, std::shared_ptr<const Grid>> m_grids; // null if decoding failed
+    Stats m_stats;
+
+    static const std::uint64_t NoStep = ~static_cast<std::uint64_t>(0);
+    static const std::size_t MaxCachedSteps = 4;
+
+    static std::uint64_t key(std::size_t variable, std::size_t step) {
+        return (static_cast<std::uint64_t>(variable) << 32) | step;
+    }
+
+    void addBands(const std::string& name, GDALDataset* dataset, const std::string& fallbackName);
+    void decodeNext();
+    // m_mutex held. True if a task has to be submitted at `priority` for
+    // the front of the queue.
+    bool needsDecodeTask(TaskScheduler::Priority& priority);
+    // Null if the band cannot be read or is not on a north-up grid
+    static std::shared_ptr<const Grid> decode(GDALDataset* dataset, int band, bool kelvin);
+    // Queues the shown step first and the one after it behind it
+    void requestSteps();
+    bool isDecoded(std::size_t step) const;
+    std::shared_ptr<const Grid> findGrid(std::size_t step) const;
+    void buildRamp(const Grid& grid);
+};
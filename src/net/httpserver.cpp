@@ -0,0 +1,251 @@
+#include "httpserver.hpp"
+#include <boost/asio.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <iostream>
+#include <thread>
+
+namespace beast = boost::beast;
+namespace http = boost::beast::http;
+namespace net = boost::asio;
+using tcp = boost::asio::ip::tcp;
+
+namespace {
+    const std::chrono::seconds IdleTimeout(30);
+
+    std::string toLower(std::string value) {
+        std::transform(value.begin(), value.end(), value.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return value;
+    }
+
+    class Session : public std::enable_shared_from_this<Session> {
+    public:
+        Session(tcp::socket&& socket, const HttpServer::Handler& handler)
+            : m_stream(std::move(socket)),
+              m_handler(handler)
+        {
+        }
+
+        void run() {
+            net::dispatch(m_stream.get_executor(), beast::bind_front_handler(&Session::read, shared_from_this()));
+        }
+
+    private:
+        beast::tcp_stream m_stream;
+        beast::flat_buffer m_buffer;
+        http::request<http::string_body> m_request;
+        http::response<http::string_body> m_response;
+        const HttpServer::Handler& m_handler;
+
+        // Chunked responses
+        http::response<http::empty_body> m_streamHeader;
+        std::unique_ptr<http::response_serializer<http::empty_body>> m_streamSerializer;
+        std::function<bool(std::string&)> m_producer;
+        std::string m_chunk;
+        bool m_streamFinished = false;
+
+        void read() {
+            m_request = {};
+            m_stream.expires_after(IdleTimeout);
+            http::async_read(m_stream, m_buffer, m_request, beast::bind_front_handler(&Session::onRead, shared_from_this()));
+        }
+
+        void onRead(beast::error_code ec, std::size_t) {
+            if (ec == http::error::end_of_stream) {
+                m_stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+                return;
+            }
+            if (ec) return;
+
+            HttpRequest request;
+            request.method = std::string(m_request.method_string());
+            request.target = std::string(m_request.target());
+            request.body = m_request.body();
+            for (const auto& field : m_request) {
+                request.headers[toLower(std::string(field.name_string()))] = std::string(field.value());
+            }
+
+            HttpResponse response;
+            try {
+                m_handler(request, response);
+            } catch (const std::exception& e) {
+                response = HttpResponse();
+                response.status = 500;
+                response.body = e.what();
+            }
+
+            if (response.stream) {
+                startStream(response);
+                return;
+            }
+
+            m_response = {};
+            m_response.version(m_request.version());
+            m_response.result(static_cast<http::status>(response.status));
+            m_response.set(http::field::server, "MultiAppProgram");
+            if (!response.contentType.empty()) {
+                m_response.set(http::field::content_type, response.contentType);
+            }
+            for (const auto& header : response.headers) {
+                m_response.set(header.first, header.second);
+            }
+            m_response.body() = std::move(response.body);
+            m_response.keep_alive(m_request.keep_alive());
+            m_response.prepare_payload();
+
+            http::async_write(m_stream, m_response, beast::bind_front_handler(&Session::onWrite, shared_from_this()));
+        }
+
+        void startStream(HttpResponse& response) {
+            m_streamHeader = {};
+            m_streamHeader.version(m_request.version());
+            m_streamHeader.result(static_cast<http::status>(response.status));
+            m_streamHeader.set(http::field::server, "MultiAppProgram");
+            if (!response.contentType.empty()) {
+                m_streamHeader.set(http::field::content_type, response.contentType);
+            }
+            for (const auto& header : response.headers) {
+                m_streamHeader.set(header.first, header.second);
+            }
+            m_streamHeader.keep_alive(m_request.keep_alive());
+            m_streamHeader.chunked(true);
+
+            m_producer = std::move(response.stream);
+            m_streamFinished = false;
+            m_streamSerializer = std::make_unique<http::response_serializer<http::empty_body>>(m_streamHeader);
+            http::async_write_header(m_stream, *m_streamSerializer, beast::bind_front_handler(&Session::writeNextChunk, shared_from_this()));
+        }
+
+        void writeNextChunk(beast::error_code ec, std::size_t) {
+            if (ec) return;
+
+            if (m_streamFinished) {
+                m_producer = nullptr;
+                m_streamSerializer.reset();
+                net::async_write(m_stream, http::make_chunk_last(), beast::bind_front_handler(&Session::onStreamWritten, shared_from_this()));
+                return;
+            }
+
+            // Empty chunks are skipped, an empty chunk on the wire ends the body
+            bool more = true;
+            m_chunk.clear();
+            while (more && m_chunk.empty()) {
+                try {
+                    more = m_producer(m_chunk);
+                } catch (const std::exception& e) {
+                    std::cerr << "HTTP stream failed: " << e.what() << std::endl;
+                    more = false;
+                }
+            }
+            m_streamFinished = !more;
+            if (m_chunk.empty()) {
+                writeNextChunk(ec, 0);
+                return;
+            }
+            net::async_write(m_stream, http::make_chunk(net::buffer(m_chunk)), beast::bind_front_handler(&Session::writeNextChunk, shared_from_this()));
+        }
+
+        void onStreamWritten(beast::error_code ec, std::size_t) {
+            if (ec) return;
+            if (!m_streamHeader.keep_alive()) {
+                m_stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+                return;
+            }
+            read();
+        }
+
+        void onWrite(beast::error_code ec, std::size_t) {
+            if (ec) return;
+            if (!m_response.keep_alive()) {
+                m_stream.socket().shutdown(tcp::socket::shutdown_send, ec);
+                return;
+            }
+            read();
+        }
+    };
+}
+
+struct HttpServer::Impl {
+    net::io_context context;
+    tcp::acceptor acceptor{context};
+    std::vector<std::thread> threads;
+
+    void accept(const Handler& handler) {
+        acceptor.async_accept(net::make_strand(context), [this, &handler](beast::error_code ec, tcp::socket socket) {
+            if (ec) {
+                if (ec != net::error::operation_aborted) {
+                    std::cerr << "HTTP accept failed: " << ec.message() << std::endl;
+                }
+                if (!acceptor.is_open()) return;
+            } else {
+                std::make_shared<Session>(std::move(socket), handler)->run();
+            }
+            accept(handler);
+        });
+    }
+};
+
+std::string HttpRequest::header(const std::string& name) const {
+    auto it = headers.find(toLower(name));
+    return it != headers.end() ? it->second : std::string();
+}
+
+HttpServer::HttpServer(Handler handler)
+    : m_handler(std::move(handler))
+{
+}
+
+HttpServer::~HttpServer() {
+    stop();
+}
+
+bool HttpServer::start(const std::string& address, unsigned short port, unsigned int threads) {
+    stop();
+    m_impl = std::make_unique<Impl>();
+
+    beast::error_code ec;
+    tcp::endpoint endpoint(net::ip::make_address(address, ec), port);
+    if (ec) {
+        std::cerr << "Invalid listen address " << address << ": " << ec.message() << std::endl;
+        return false;
+    }
+
+    m_impl->acceptor.open(endpoint.protocol(), ec);
+    if (!ec) m_impl->acceptor.set_option(net::socket_base::reuse_address(true), ec);
+    if (!ec) m_impl->acceptor.bind(endpoint, ec);
+    if (!ec) m_impl->acceptor.listen(net::socket_base::max_listen_connections, ec);
+    if (ec) {
+        std::cerr << "Failed to listen on " << address << ":" << port << ": " << ec.message() << std::endl;
+        m_impl.reset();
+        return false;
+    }
+
+    m_impl->accept(m_handler);
+
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned int i = 0; i < threads; ++i) {
+        m_impl->threads.emplace_back([this] { m_impl->context.run(); });
+    }
+    return true;
+}
+
+void HttpServer::stop() {
+    if (!m_impl) return;
+
+    m_impl->context.stop();
+    for (auto& thread : m_impl->threads) {
+        thread.join();
+    }
+    m_impl.reset();
+}
+
+unsigned short HttpServer::port() const {
+    if (!m_impl) return 0;
+    beast::error_code ec;
+    return m_impl->acceptor.local_endpoint(ec).port();
+}
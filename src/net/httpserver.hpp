@@ -0,0 +1,57 @@
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct HttpRequest {
+    std::string method;
+    std::string target;
+    std::map<std::string, std::string> headers; // lower-case names
+    std::string body;
+
+    std::string header(const std::string& name) const;
+};
+
+struct HttpResponse {
+    int status = 200;
+    std::string contentType = "text/plain";
+    std::vector<std::pair<std::string, std::string>> headers;
+    std::string body;
+
+    // If set, `body` is ignored and the response is sent with chunked
+    // encoding instead: the producer is called repeatedly on the server
+    // thread to fill the next chunk and returns false after the last one.
+    std::function<bool(std::string& chunk)> stream;
+};
+
+// Small asynchronous HTTP/1.1 server (Boost.Beast) with keep-alive.
+//
+// Connections are served by a fixed set of threads running one io_context;
+// the handler is called on those threads and must be thread-safe. Handlers
+// and stream producers may block (e.g. render a tile, wait for the next
+// token), which simply occupies one worker.
+class HttpServer {
+public:
+    typedef std::function<void(const HttpRequest&, HttpResponse&)> Handler;
+
+    explicit HttpServer(Handler handler);
+    ~HttpServer();
+
+    HttpServer(const HttpServer&) = delete;
+    HttpServer& operator=(const HttpServer&) = delete;
+
+    // Port 0 picks a free port, see port(). threads == 0 uses all cores.
+    bool start(const std::string& address, unsigned short port, unsigned int threads = 0);
+    void stop();
+
+    unsigned short port() const;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+    Handler m_handler;
+};
@@ -3,8 +3,16 @@
 #include <iomanip>
 #include <sstream>
 
+namespace {
+    // Rows start this far down the window and are spaced by the same amount
+    const float RowSpacing = 0.13f;
+    const float RowHeight = 50.f;
+    const float LabelX = 0.1f;
+}
+
 Settings::Settings(sf::RenderWindow& window)
     : m_window(window),
+      m_ui(m_font),
       m_isMetricSystem(true),
       m_isLowPowerMode(false),
       m_password("")
@@ -13,112 +21,53 @@ Settings::Settings(sf::RenderWindow& window)
        // Handle font loading error
        std::cerr << "Failed to load font" << std::endl;
 	}
+    m_ui.setSize(sf::Vector2f(static_cast<float>(window.getSize().x), static_cast<float>(window.getSize().y)));
 
-    m_exitButton = sf::RectangleShape(sf::Vector2f(50, 50));
-    m_exitButton.setPosition(10, 10);
-    m_exitButton.setFillColor(sf::Color::White);
-    m_exitButton.setOutlineThickness(2);
-    m_exitButton.setOutlineColor(sf::Color::Black);
+    WidgetLayer::Style button;
+    button.fill = sf::Color::White;
+    button.outline = sf::Color::Black;
+    button.outlineThickness = 2.f;
+    m_ui.addButton(WidgetLayer::Root, WidgetLayer::Layout::fixed(10, 10, 50, 50), button, "", WidgetLayer::TextStyle(),
+                   [this] { m_shouldExit = true; });
 
     // Initialize text and buttons for each setting
-    m_timeText.setFont(m_font);
-    m_timeText.setCharacterSize(24);
-    m_timeText.setFillColor(sf::Color::Black);
-    m_timeText.setPosition(100, 100);
-    m_timeText.setString("Adjust Time");
-
-    m_timeButton = sf::RectangleShape(sf::Vector2f(200, 50));
-    m_timeButton.setPosition(300, 100);
-    m_timeButton.setFillColor(sf::Color::White);
-    m_timeButton.setOutlineThickness(2);
-    m_timeButton.setOutlineColor(sf::Color::Black);
-
-    m_dateText.setFont(m_font);
-    m_dateText.setCharacterSize(24);
-    m_dateText.setFillColor(sf::Color::Black);
-    m_dateText.setPosition(100, 200);
-    m_dateText.setString("Adjust Date");
-
-    m_dateButton = sf::RectangleShape(sf::Vector2f(200, 50));
-    m_dateButton.setPosition(300, 200);
-    m_dateButton.setFillColor(sf::Color::White);
-    m_dateButton.setOutlineThickness(2);
-    m_dateButton.setOutlineColor(sf::Color::Black);
-
-    m_metricSystemText.setFont(m_font);
-    m_metricSystemText.setCharacterSize(24);
-    m_metricSystemText.setFillColor(sf::Color::Black);
-    m_metricSystemText.setPosition(100, 300);
-    m_metricSystemText.setString("Metric System: ON");
-
-    m_metricSystemToggle = sf::RectangleShape(sf::Vector2f(100, 50));
-    m_metricSystemToggle.setPosition(400, 300);
-    m_metricSystemToggle.setFillColor(sf::Color::Green);
-
-    m_lowPowerModeText.setFont(m_font);
-    m_lowPowerModeText.setCharacterSize(24);
-    m_lowPowerModeText.setFillColor(sf::Color::Black);
-    m_lowPowerModeText.setPosition(100, 400);
-    m_lowPowerModeText.setString("Low Power Mode: OFF");
-
-    m_lowPowerModeToggle = sf::RectangleShape(sf::Vector2f(100, 50));
-    m_lowPowerModeToggle.setPosition(400, 400);
-    m_lowPowerModeToggle.setFillColor(sf::Color::Red);
-
-    m_passwordText.setFont(m_font);
-    m_passwordText.setCharacterSize(24);
-    m_passwordText.setFillColor(sf::Color::Black);
-    m_passwordText.setPosition(100, 500);
-    m_passwordText.setString("Change Password");
+    WidgetLayer::Style toggle;
+    toggle.fill = sf::Color::Green;
+    addRow(0, "Adjust Time", 0.3f, 200, button, [this] { adjustTime(); });
+    addRow(1, "Adjust Date", 0.3f, 200, button, [this] { adjustDate(); });
+    m_metricSystemToggle = addRow(2, "Metric System: ON", 0.39f, 100, toggle, [this] { toggleMetricSystem(); }, &m_metricSystemLabel);
+    toggle.fill = sf::Color::Red;
+    m_lowPowerModeToggle = addRow(3, "Low Power Mode: OFF", 0.39f, 100, toggle, [this] { toggleLowPowerMode(); }, &m_lowPowerModeLabel);
+    addRow(4, "Change Password", 0.3f, 200, button, [this] { changePassword(); });
+}
 
-    m_passwordButton = sf::RectangleShape(sf::Vector2f(200, 50));
-    m_passwordButton.setPosition(300, 500);
-    m_passwordButton.setFillColor(sf::Color::White);
-    m_passwordButton.setOutlineThickness(2);
-    m_passwordButton.setOutlineColor(sf::Color::Black);
+WidgetLayer::Id Settings::addRow(int row, const std::string& text, float controlX, float controlWidth,
+                                 const WidgetLayer::Style& style, std::function<void()> onClick, WidgetLayer::Id* label) {
+    WidgetLayer::Layout layout;
+    layout.relative = sf::FloatRect(0.f, RowSpacing * (row + 1), 1.f, 0.f);
+    layout.pixels = sf::FloatRect(0.f, 0.f, 0.f, RowHeight);
+    WidgetLayer::Id panel = m_ui.addPanel(WidgetLayer::Root, layout, WidgetLayer::Style());
+
+    WidgetLayer::TextStyle textStyle;
+    textStyle.padding = 0.f;
+    WidgetLayer::Id labelId = m_ui.addLabel(panel, WidgetLayer::Layout::anchored(LabelX, 0.f, 0.f, 0.f, 300.f, RowHeight), text, textStyle);
+    if (label) *label = labelId;
+    return m_ui.addButton(panel, WidgetLayer::Layout::anchored(controlX, 0.f, 0.f, 0.f, controlWidth, RowHeight), style, "",
+                          textStyle, std::move(onClick));
 }
 
 void Settings::handleEvent(const sf::Event& event) {
-    if (event.type == sf::Event::MouseButtonPressed) {
-        if (event.mouseButton.button == sf::Mouse::Left) {
-            sf::Vector2f mousePos = m_window.mapPixelToCoords(sf::Mouse::getPosition(m_window));
-
-            if (m_exitButton.getGlobalBounds().contains(mousePos)) {
-                // Exit settings app
-                m_shouldExit = true;
-            } else if (m_timeButton.getGlobalBounds().contains(mousePos)) {
-                adjustTime();
-            } else if (m_dateButton.getGlobalBounds().contains(mousePos)) {
-                adjustDate();
-            } else if (m_metricSystemToggle.getGlobalBounds().contains(mousePos)) {
-                toggleMetricSystem();
-            } else if (m_lowPowerModeToggle.getGlobalBounds().contains(mousePos)) {
-                toggleLowPowerMode();
-            } else if (m_passwordButton.getGlobalBounds().contains(mousePos)) {
-                changePassword();
-            }
-        }
-    }
+    m_ui.handleEvent(event);
 }
 
 void Settings::draw(sf::RenderWindow& window) {
-    m_window.draw(m_exitButton);
-    m_window.draw(m_timeText);
-    m_window.draw(m_timeButton);
-    m_window.draw(m_dateText);
-    m_window.draw(m_dateButton);
-    m_window.draw(m_metricSystemText);
-    m_window.draw(m_metricSystemToggle);
-    m_window.draw(m_lowPowerModeText);
-    m_window.draw(m_lowPowerModeToggle);
-    m_window.draw(m_passwordText);
-    m_window.draw(m_passwordButton);
+    m_ui.draw(window);
 }
 
 void Settings::toggleMetricSystem() {
     m_isMetricSystem = !m_isMetricSystem;
-    m_metricSystemText.setString("Metric System: " + std::string(m_isMetricSystem ? "ON" : "OFF"));
-    m_metricSystemToggle.setFillColor(m_isMetricSystem ? sf::Color::Green : sf::Color::Red);
+    m_ui.setText(m_metricSystemLabel, "Metric System: " + std::string(m_isMetricSystem ? "ON" : "OFF"));
+    m_ui.setFill(m_metricSystemToggle, m_isMetricSystem ? sf::Color::Green : sf::Color::Red);
     if (onMetricSystemChanged) {
         onMetricSystemChanged(m_isMetricSystem);
     }
@@ -126,8 +75,8 @@ void Settings::toggleMetricSystem() {
 
 void Settings::toggleLowPowerMode() {
     m_isLowPowerMode = !m_isLowPowerMode;
-    m_lowPowerModeText.setString("Low Power Mode: " + std::string(m_isLowPowerMode ? "ON" : "OFF"));
-    m_lowPowerModeToggle.setFillColor(m_isLowPowerMode ? sf::Color::Green : sf::Color::Red);
+    m_ui.setText(m_lowPowerModeLabel, "Low Power Mode: " + std::string(m_isLowPowerMode ? "ON" : "OFF"));
+    m_ui.setFill(m_lowPowerModeToggle, m_isLowPowerMode ? sf::Color::Green : sf::Color::Red);
     if (onLowPowerModeChanged) {
         onLowPowerModeChanged(m_isLowPowerMode);
     }
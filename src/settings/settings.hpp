@@ -1,15 +1,21 @@
 #pragma once
 
 #include <SFML/Graphics.hpp>
+#include "../ui/app.hpp"
+#include "../ui/widgetlayer.hpp"
 #include <string>
 #include <functional>
 
-class Settings {
+// Holds nothing worth suspending, so it keeps App's defaults
+class Settings : public App {
 public:
     Settings(sf::RenderWindow& window);
-    void handleEvent(const sf::Event& event);
-    void draw(sf::RenderWindow& window);
-    void resetShouldExit() { m_shouldExit = false; }
+    const char* name() const override { return "Settings"; }
+    void handleEvent(const sf::Event& event) override;
+    void draw(sf::RenderWindow& window) override;
+    void resetShouldExit() override { m_shouldExit = false; }
+    // Window size in pixels, which the rows are laid out against
+    void setSize(sf::Vector2f size) { m_ui.setSize(size); }
 
     // Callback functions for main window
     std::function<void(const sf::Time&)> onTimeChanged;
@@ -17,24 +23,17 @@ public:
     std::function<void(bool)> onMetricSystemChanged;
     std::function<void(bool)> onLowPowerModeChanged;
     std::function<void(const std::string&)> onPasswordChanged;
-    bool shouldReturnToMain() const { return m_shouldExit; }
+    bool shouldReturnToMain() const override { return m_shouldExit; }
 
 private:
     sf::RenderWindow& m_window;
     sf::Font m_font;
-    sf::RectangleShape m_exitButton;
-
-    sf::Text m_timeText;
-    sf::Text m_dateText;
-    sf::Text m_metricSystemText;
-    sf::Text m_lowPowerModeText;
-    sf::Text m_passwordText;
-
-    sf::RectangleShape m_timeButton;
-    sf::RectangleShape m_dateButton;
-    sf::RectangleShape m_metricSystemToggle;
-    sf::RectangleShape m_lowPowerModeToggle;
-    sf::RectangleShape m_passwordButton;
+    // Every label, button and toggle; a frame is two draw calls
+    WidgetLayer m_ui;
+    WidgetLayer::Id m_metricSystemLabel = WidgetLayer::None;
+    WidgetLayer::Id m_metricSystemToggle = WidgetLayer::None;
+    WidgetLayer::Id m_lowPowerModeLabel = WidgetLayer::None;
+    WidgetLayer::Id m_lowPowerModeToggle = WidgetLayer::None;
 
     bool m_isMetricSystem;
     bool m_isLowPowerMode;
@@ -45,5 +44,8 @@ private:
     void changePassword();
     void adjustTime();
     void adjustDate();
+    // A row of the list: a label and a control to its right
+    WidgetLayer::Id addRow(int row, const std::string& text, float controlX, float controlWidth,
+                           const WidgetLayer::Style& style, std::function<void()> onClick, WidgetLayer::Id* label = nullptr);
     bool m_shouldExit = false;
 };
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <vector>
+
+// What an app holds, estimated from the sizes of its own buffers
+struct AppMemory {
+    std::size_t cpuBytes = 0;
+    std::size_t gpuBytes = 0; // textures
+};
+
+// One of the apps MainWindow switches between.
+//
+// Apps stay alive for the whole process. When MainWindow needs memory back
+// (see AppLifecycle) it suspends inactive apps: onSuspend() drops whatever
+// can be rebuilt, such as textures, vertex arrays, layouts and decoded
+// caches, and keeps the data they are rebuilt from. onResume() is called
+// before the app is shown again and restores what the first frame needs;
+// the rest may come back lazily.
+class App {
+public:
+    virtual ~App() = default;
+
+    virtual const char* name() const = 0;
+    virtual void handleEvent(const sf::Event& event) = 0;
+    virtual void draw(sf::RenderWindow& window) = 0;
+    virtual void resetShouldExit() = 0;
+    virtual bool shouldReturnToMain() const = 0;
+
+    virtual void onSuspend() {}
+    virtual void onResume() {}
+    virtual AppMemory memoryUsage() const { return AppMemory(); }
+};
+
+namespace appmemory {
+    template <typename T>
+    std::size_t vectorBytes(const std::vector<T>& values) {
+        return values.capacity() * sizeof(T);
+    }
+
+    // An sf::Text keeps six vertices per glyph besides its string
+    inline std::size_t textBytes(const sf::Text& text) {
+        return sizeof(sf::Text) + text.getString().getSize() * (6 * sizeof(sf::Vertex) + sizeof(sf::Uint32));
+    }
+
+    inline std::size_t textureBytes(const sf::Texture& texture) {
+        return static_cast<std::size_t>(texture.getSize().x) * texture.getSize().y * 4;
+    }
+}
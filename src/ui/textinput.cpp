@@ -0,0 +1,419 @@
+#include "textinput.hpp"
+#include <algorithm>
+#include <iterator>
+
+namespace {
+    // Chunks are split above MaxChunkSize into ChunkSize pieces and merged below MinChunkSize
+    const std::size_t ChunkSize = 256;
+    const std::size_t MaxChunkSize = 512;
+    const std::size_t MinChunkSize = 64;
+
+    const sf::Uint32 MaskCharacter = 0x2022; // bullet
+    const float CaretWidth = 2.f;
+    const sf::Color SelectionColor(170, 200, 255);
+}
+
+TextInput::TextInput(const sf::Font& font, unsigned int characterSize)
+    : m_font(font),
+      m_characterSize(characterSize),
+      m_chunks(1)
+{
+    m_caret.setFillColor(sf::Color::Black);
+    m_selection.setFillColor(SelectionColor);
+}
+
+void TextInput::setArea(const sf::FloatRect& area) {
+    m_area = area;
+}
+
+void TextInput::setColor(const sf::Color& color) {
+    m_color = color;
+    m_caret.setFillColor(color);
+    for (Chunk& chunk : m_chunks) {
+        chunk.verticesDirty = true;
+    }
+}
+
+void TextInput::setMasked(bool masked) {
+    m_masked = masked;
+    for (Chunk& chunk : m_chunks) {
+        measure(chunk);
+        chunk.verticesDirty = true;
+    }
+}
+
+sf::Uint32 TextInput::displayed(char32_t c) const {
+    return m_masked ? MaskCharacter : static_cast<sf::Uint32>(c);
+}
+
+// Kerning across chunk boundaries is ignored; it is at most a pixel
+void TextInput::measure(Chunk& chunk) const {
+    float x = 0.f;
+    sf::Uint32 previous = 0;
+    for (char32_t c : chunk.text) {
+        sf::Uint32 current = displayed(c);
+        if (previous) x += m_font.getKerning(previous, current, m_characterSize);
+        x += m_font.getGlyph(current, m_characterSize, false).advance;
+        previous = current;
+    }
+    chunk.width = x;
+}
+
+void TextInput::buildVertices(Chunk& chunk) {
+    chunk.vertices.setPrimitiveType(sf::Triangles);
+    chunk.vertices.clear();
+
+    const float baseline = static_cast<float>(m_characterSize);
+    float x = 0.f;
+    sf::Uint32 previous = 0;
+    for (char32_t c : chunk.text) {
+        sf::Uint32 current = displayed(c);
+        if (previous) x += m_font.getKerning(previous, current, m_characterSize);
+        const sf::Glyph& glyph = m_font.getGlyph(current, m_characterSize, false);
+
+        float left = x + glyph.bounds.left;
+        float top = baseline + glyph.bounds.top;
+        float right = left + glyph.bounds.width;
+        float bottom = top + glyph.bounds.height;
+        float u1 = static_cast<float>(glyph.textureRect.left);
+        float v1 = static_cast<float>(glyph.textureRect.top);
+        float u2 = u1 + glyph.textureRect.width;
+        float v2 = v1 + glyph.textureRect.height;
+
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(left, top), m_color, sf::Vector2f(u1, v1)));
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(right, top), m_color, sf::Vector2f(u2, v1)));
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(left, bottom), m_color, sf::Vector2f(u1, v2)));
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(left, bottom), m_color, sf::Vector2f(u1, v2)));
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(right, top), m_color, sf::Vector2f(u2, v1)));
+        chunk.vertices.append(sf::Vertex(sf::Vector2f(right, bottom), m_color, sf::Vector2f(u2, v2)));
+
+        x += glyph.advance;
+        previous = current;
+    }
+    chunk.width = x;
+    chunk.verticesDirty = false;
+    ++m_layoutCount;
+}
+
+std::size_t TextInput::locate(std::size_t position, std::size_t& offset) const {
+    for (std::size_t i = 0; i < m_chunks.size(); ++i) {
+        if (position <= m_chunks[i].text.size()) {
+            offset = position;
+            return i;
+        }
+        position -= m_chunks[i].text.size();
+    }
+    offset = m_chunks.back().text.size();
+    return m_chunks.size() - 1;
+}
+
+float TextInput::xOf(std::size_t position) const {
+    float x = 0.f;
+    std::size_t offset;
+    std::size_t index = locate(position, offset);
+    for (std::size_t i = 0; i < index; ++i) {
+        x += m_chunks[i].width;
+    }
+
+    sf::Uint32 previous = 0;
+    for (std::size_t i = 0; i < offset; ++i) {
+        sf::Uint32 current = displayed(m_chunks[index].text[i]);
+        if (previous) x += m_font.getKerning(previous, current, m_characterSize);
+        x += m_font.getGlyph(current, m_characterSize, false).advance;
+        previous = current;
+    }
+    return x;
+}
+
+std::size_t TextInput::positionAt(float x) const {
+    std::size_t position = 0;
+    float chunkX = 0.f;
+    for (const Chunk& chunk : m_chunks) {
+        if (x >= chunkX + chunk.width) {
+            chunkX += chunk.width;
+            position += chunk.text.size();
+            continue;
+        }
+        // Nearest character boundary within the chunk
+        for (char32_t c : chunk.text) {
+            float advance = m_font.getGlyph(displayed(c), m_characterSize, false).advance;
+            if (x < chunkX + advance / 2) return position;
+            chunkX += advance;
+            ++position;
+        }
+        return position;
+    }
+    return m_size;
+}
+
+void TextInput::split(std::size_t index) {
+    Chunk& chunk = m_chunks[index];
+    chunk.verticesDirty = true;
+    if (chunk.text.size() <= MaxChunkSize) {
+        measure(chunk);
+        return;
+    }
+
+    std::u32string text = std::move(chunk.text);
+    std::vector<Chunk> pieces((text.size() + ChunkSize - 1) / ChunkSize);
+    for (std::size_t i = 0; i < pieces.size(); ++i) {
+        pieces[i].text = text.substr(i * ChunkSize, ChunkSize);
+        measure(pieces[i]);
+    }
+    m_chunks.erase(m_chunks.begin() + index);
+    m_chunks.insert(m_chunks.begin() + index, std::make_move_iterator(pieces.begin()), std::make_move_iterator(pieces.end()));
+}
+
+void TextInput::mergeSmall(std::size_t index) {
+    if (m_chunks.size() < 2 || index >= m_chunks.size() || m_chunks[index].text.size() >= MinChunkSize) return;
+
+    // Fold into whichever neighbour keeps the result within bounds
+    std::size_t into = index > 0 ? index - 1 : index;
+    std::size_t from = into + 1;
+    if (m_chunks[into].text.size() + m_chunks[from].text.size() > MaxChunkSize) {
+        if (index + 1 >= m_chunks.size()) return;
+        into = index;
+        from = index + 1;
+        if (m_chunks[into].text.size() + m_chunks[from].text.size() > MaxChunkSize) return;
+    }
+    m_chunks[into].text += m_chunks[from].text;
+    m_chunks.erase(m_chunks.begin() + from);
+    measure(m_chunks[into]);
+    m_chunks[into].verticesDirty = true;
+}
+
+void TextInput::erase(std::size_t begin, std::size_t end) {
+    end = std::min(end, m_size);
+    if (begin >= end) return;
+
+    std::size_t offset;
+    std::size_t index = locate(begin, offset);
+    std::size_t first = index;
+    std::size_t remaining = end - begin;
+    while (remaining > 0 && index < m_chunks.size()) {
+        Chunk& chunk = m_chunks[index];
+        std::size_t count = std::min(remaining, chunk.text.size() - offset);
+        if (count > 0) {
+            chunk.text.erase(offset, count);
+            measure(chunk);
+            chunk.verticesDirty = true;
+            remaining -= count;
+        }
+        ++index;
+        offset = 0;
+    }
+    m_size -= end - begin;
+
+    // Only a deletion spanning whole chunks leaves empty ones behind
+    if (index - first > 1 || m_chunks[first].text.empty()) {
+        m_chunks.erase(std::remove_if(m_chunks.begin() + first, m_chunks.begin() + index,
+                                      [](const Chunk& chunk) { return chunk.text.empty(); }),
+                       m_chunks.begin() + index);
+        if (m_chunks.empty()) m_chunks.emplace_back();
+    }
+    mergeSmall(std::min(first, m_chunks.size() - 1));
+}
+
+void TextInput::eraseSelection() {
+    if (!hasSelection()) return;
+    std::size_t begin = std::min(m_cursor, m_anchor);
+    erase(begin, std::max(m_cursor, m_anchor));
+    m_cursor = m_anchor = begin;
+}
+
+void TextInput::insert(const std::u32string& text) {
+    eraseSelection();
+    if (text.empty()) return;
+
+    std::size_t offset;
+    std::size_t index = locate(m_cursor, offset);
+    m_chunks[index].text.insert(offset, text);
+    m_size += text.size();
+    m_cursor = m_anchor = m_cursor + text.size();
+    split(index);
+}
+
+void TextInput::setCursor(std::size_t position, bool extendSelection) {
+    m_cursor = std::min(position, m_size);
+    if (!extendSelection) m_anchor = m_cursor;
+}
+
+std::u32string TextInput::substring(std::size_t begin, std::size_t end) const {
+    std::u32string text;
+    text.reserve(end - begin);
+    std::size_t chunkStart = 0;
+    for (const Chunk& chunk : m_chunks) {
+        std::size_t chunkEnd = chunkStart + chunk.text.size();
+        if (chunkEnd > begin && chunkStart < end) {
+            std::size_t from = std::max(begin, chunkStart) - chunkStart;
+            std::size_t to = std::min(end, chunkEnd) - chunkStart;
+            text.append(chunk.text, from, to - from);
+        }
+        chunkStart = chunkEnd;
+    }
+    return text;
+}
+
+sf::String TextInput::getString() const {
+    std::u32string text = substring(0, m_size);
+    return sf::String::fromUtf32(text.begin(), text.end());
+}
+
+std::string TextInput::toUtf8() const {
+    std::basic_string<sf::Uint8> utf8 = getString().toUtf8();
+    return std::string(utf8.begin(), utf8.end());
+}
+
+void TextInput::setString(const sf::String& text) {
+    m_chunks.assign(1, Chunk());
+    m_size = 0;
+    m_cursor = m_anchor = 0;
+    m_scroll = 0.f;
+    insert(std::u32string(text.begin(), text.end()));
+}
+
+void TextInput::clear() {
+    setString(sf::String());
+}
+
+bool TextInput::handleEvent(const sf::Event& event) {
+    if (event.type == sf::Event::TextEntered) {
+        sf::Uint32 c = event.text.unicode;
+        if (c == 8) { // Backspace
+            if (hasSelection()) {
+                eraseSelection();
+            } else if (m_cursor > 0) {
+                erase(m_cursor - 1, m_cursor);
+                m_cursor = m_anchor = m_cursor - 1;
+            }
+            return true;
+        }
+        // Enter, Escape and the characters produced by Ctrl shortcuts
+        if (c < 32 || c == 127) return false;
+        insert(std::u32string(1, static_cast<char32_t>(c)));
+        return true;
+    }
+
+    if (event.type == sf::Event::KeyPressed) {
+        const bool shortcut = event.key.control || event.key.system;
+        const bool shift = event.key.shift;
+        switch (event.key.code) {
+            case sf::Keyboard::Left:
+                if (hasSelection() && !shift) {
+                    setCursor(std::min(m_cursor, m_anchor));
+                } else {
+                    setCursor(m_cursor > 0 ? m_cursor - 1 : 0, shift);
+                }
+                return true;
+            case sf::Keyboard::Right:
+                if (hasSelection() && !shift) {
+                    setCursor(std::max(m_cursor, m_anchor));
+                } else {
+                    setCursor(m_cursor + 1, shift);
+                }
+                return true;
+            case sf::Keyboard::Home:
+                setCursor(0, shift);
+                return true;
+            case sf::Keyboard::End:
+                setCursor(m_size, shift);
+                return true;
+            case sf::Keyboard::Delete:
+                if (hasSelection()) {
+                    eraseSelection();
+                } else {
+                    erase(m_cursor, m_cursor + 1);
+                }
+                return true;
+            case sf::Keyboard::A:
+                if (!shortcut) break;
+                m_anchor = 0;
+                m_cursor = m_size;
+                return true;
+            case sf::Keyboard::C:
+            case sf::Keyboard::X:
+                if (!shortcut) break;
+                if (hasSelection() && !m_masked) {
+                    std::u32string selected = substring(std::min(m_cursor, m_anchor), std::max(m_cursor, m_anchor));
+                    sf::Clipboard::setString(sf::String::fromUtf32(selected.begin(), selected.end()));
+                    if (event.key.code == sf::Keyboard::X) eraseSelection();
+                }
+                return true;
+            case sf::Keyboard::V: {
+                if (!shortcut) break;
+                // Single line: line breaks and tabs become spaces, other control characters are dropped
+                sf::String clipboard = sf::Clipboard::getString();
+                std::u32string text;
+                text.reserve(clipboard.getSize());
+                for (sf::Uint32 c : clipboard) {
+                    if (c == '\n' || c == '\t') {
+                        text += U' ';
+                    } else if (c >= 32 && c != 127) {
+                        text += static_cast<char32_t>(c);
+                    }
+                }
+                insert(text);
+                return true;
+            }
+            default:
+                break;
+        }
+        return false;
+    }
+
+    if (event.type == sf::Event::MouseButtonPressed && event.mouseButton.button == sf::Mouse::Left &&
+        m_area.contains(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y))) {
+        bool shift = sf::Keyboard::isKeyPressed(sf::Keyboard::LShift) || sf::Keyboard::isKeyPressed(sf::Keyboard::RShift);
+        setCursor(positionAt(event.mouseButton.x - m_area.left + m_scroll), shift);
+        return true;
+    }
+    return false;
+}
+
+// Expects the target's default view, like the rest of the UI
+void TextInput::draw(sf::RenderTarget& target) {
+    // Scroll just enough to keep the caret visible
+    const float caretX = xOf(m_cursor);
+    const float visibleWidth = m_area.width - CaretWidth;
+    if (caretX - m_scroll > visibleWidth) {
+        m_scroll = caretX - visibleWidth;
+    } else if (caretX < m_scroll) {
+        m_scroll = std::max(0.f, caretX - m_area.width / 3);
+    }
+
+    // Clip to the area with a view whose viewport covers just that area
+    const sf::View previousView = target.getView();
+    const sf::Vector2f targetSize(static_cast<float>(target.getSize().x), static_cast<float>(target.getSize().y));
+    sf::View clip(sf::FloatRect(m_scroll, 0.f, m_area.width, m_area.height));
+    clip.setViewport(sf::FloatRect(m_area.left / targetSize.x, m_area.top / targetSize.y,
+                                   m_area.width / targetSize.x, m_area.height / targetSize.y));
+    target.setView(clip);
+
+    if (hasSelection()) {
+        float from = xOf(std::min(m_cursor, m_anchor));
+        float to = xOf(std::max(m_cursor, m_anchor));
+        m_selection.setPosition(from, 0.f);
+        m_selection.setSize(sf::Vector2f(to - from, m_area.height));
+        target.draw(m_selection);
+    }
+
+    sf::RenderStates states;
+    states.texture = &m_font.getTexture(m_characterSize);
+    float x = 0.f;
+    for (Chunk& chunk : m_chunks) {
+        if (x > m_scroll + m_area.width) break;
+        if (x + chunk.width >= m_scroll) {
+            if (chunk.verticesDirty) buildVertices(chunk);
+            sf::RenderStates chunkStates(states);
+            chunkStates.transform.translate(x, 0.f);
+            target.draw(chunk.vertices, chunkStates);
+        }
+        x += chunk.width;
+    }
+
+    m_caret.setPosition(caretX, 2.f);
+    m_caret.setSize(sf::Vector2f(CaretWidth, m_area.height - 4.f));
+    target.draw(m_caret);
+
+    target.setView(previousView);
+}
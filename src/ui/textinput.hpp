@@ -0,0 +1,86 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Single-line text field shared by the chat input, the map search bar and
+// the password prompt.
+//
+// The text is kept as a list of UTF-32 chunks of a few hundred characters
+// (a flat rope). An edit touches one or two chunks, and only those are
+// measured and laid out again; glyph geometry is built lazily and only for
+// chunks inside the visible window, so typing into or pasting a very long
+// value costs about the same as a short one.
+//
+// Supports a cursor, shift-selection, Ctrl+A/C/X/V, Home/End and a masked
+// mode for passwords. Enter is left to the owner.
+class TextInput {
+public:
+    TextInput(const sf::Font& font, unsigned int characterSize);
+
+    // Where the text is drawn; the text is clipped and scrolled horizontally within it
+    void setArea(const sf::FloatRect& area);
+    const sf::FloatRect& getArea() const { return m_area; }
+    void setColor(const sf::Color& color);
+    // Shows every character as a bullet and disables copying
+    void setMasked(bool masked);
+
+    // Returns true if the event was used
+    bool handleEvent(const sf::Event& event);
+    void draw(sf::RenderTarget& target);
+
+    sf::String getString() const;
+    std::string toUtf8() const;
+    void setString(const sf::String& text);
+    void clear();
+    bool isEmpty() const { return m_size == 0; }
+    std::size_t size() const { return m_size; }
+
+    // Replaces the selection (if any) at the cursor
+    void insert(const std::u32string& text);
+    void setCursor(std::size_t position, bool extendSelection = false);
+    std::size_t cursor() const { return m_cursor; }
+    bool hasSelection() const { return m_anchor != m_cursor; }
+
+    // Chunks whose geometry was rebuilt so far, for benchmarks
+    std::size_t layoutCount() const { return m_layoutCount; }
+
+private:
+    struct Chunk {
+        std::u32string text;
+        float width = 0.f;
+        sf::VertexArray vertices;
+        bool verticesDirty = true;
+    };
+
+    const sf::Font& m_font;
+    unsigned int m_characterSize;
+    sf::Color m_color = sf::Color::Black;
+    bool m_masked = false;
+    sf::FloatRect m_area;
+
+    std::vector<Chunk> m_chunks; // never empty
+    std::size_t m_size = 0;
+    std::size_t m_cursor = 0;
+    std::size_t m_anchor = 0;    // other end of the selection
+    float m_scroll = 0.f;
+    std::size_t m_layoutCount = 0;
+
+    sf::RectangleShape m_caret;
+    sf::RectangleShape m_selection;
+
+    sf::Uint32 displayed(char32_t c) const;
+    void measure(Chunk& chunk) const;
+    void buildVertices(Chunk& chunk);
+    // Chunk holding `position`, and the offset into it
+    std::size_t locate(std::size_t position, std::size_t& offset) const;
+    float xOf(std::size_t position) const;
+    std::size_t positionAt(float x) const;
+    void erase(std::size_t begin, std::size_t end);
+    void eraseSelection();
+    void split(std::size_t chunkIndex);
+    void mergeSmall(std::size_t chunkIndex);
+    std::u32string substring(std::size_t begin, std::size_t end) const;
+};
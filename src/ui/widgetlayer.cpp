@@ -0,0 +1,283 @@
+#include "widgetlayer.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+    const float CellSize = 64.f;
+
+    sf::FloatRect place(const WidgetLayer::Layout& layout, const sf::FloatRect& parent) {
+        return sf::FloatRect(parent.left + layout.relative.left * parent.width + layout.pixels.left,
+                             parent.top + layout.relative.top * parent.height + layout.pixels.top,
+                             layout.relative.width * parent.width + layout.pixels.width,
+                             layout.relative.height * parent.height + layout.pixels.height);
+    }
+
+    // What a click may hit, the outline included
+    sf::FloatRect hitBounds(const sf::FloatRect& bounds, float outline) {
+        return sf::FloatRect(bounds.left - outline, bounds.top - outline, bounds.width + 2 * outline, bounds.height + 2 * outline);
+    }
+}
+
+WidgetLayer::Layout WidgetLayer::Layout::fixed(float left, float top, float width, float height) {
+    Layout layout;
+    layout.pixels = sf::FloatRect(left, top, width, height);
+    return layout;
+}
+
+WidgetLayer::Layout WidgetLayer::Layout::anchored(float anchorX, float anchorY, float left, float top, float width, float height) {
+    Layout layout;
+    layout.relative = sf::FloatRect(anchorX, anchorY, 0.f, 0.f);
+    layout.pixels = sf::FloatRect(left, top, width, height);
+    return layout;
+}
+
+WidgetLayer::Layout WidgetLayer::Layout::fill(float margin) {
+    Layout layout;
+    layout.relative = sf::FloatRect(0.f, 0.f, 1.f, 1.f);
+    layout.pixels = sf::FloatRect(margin, margin, -2 * margin, -2 * margin);
+    return layout;
+}
+
+WidgetLayer::WidgetLayer(const sf::Font& font)
+    : m_font(font),
+      m_quads(sf::Triangles)
+{
+    Widget root;
+    root.kind = Kind::Root;
+    m_widgets.push_back(root);
+}
+
+WidgetLayer::Id WidgetLayer::add(Id parent, Widget widget) {
+    widget.parent = parent < m_widgets.size() ? parent : Root;
+    m_widgets.push_back(std::move(widget));
+    m_layoutDirty = true;
+    return m_widgets.size() - 1;
+}
+
+WidgetLayer::Id WidgetLayer::addPanel(Id parent, const Layout& layout, const Style& style) {
+    Widget widget;
+    widget.kind = Kind::Panel;
+    widget.layout = layout;
+    widget.style = style;
+    return add(parent, std::move(widget));
+}
+
+WidgetLayer::Id WidgetLayer::addLabel(Id parent, const Layout& layout, const sf::String& text, const TextStyle& textStyle) {
+    Widget widget;
+    widget.kind = Kind::Label;
+    widget.layout = layout;
+    widget.text = text;
+    widget.textStyle = textStyle;
+    return add(parent, std::move(widget));
+}
+
+WidgetLayer::Id WidgetLayer::addButton(Id parent, const Layout& layout, const Style& style, const sf::String& text,
+                                       const TextStyle& textStyle, std::function<void()> onClick) {
+    Widget widget;
+    widget.kind = Kind::Button;
+    widget.layout = layout;
+    widget.style = style;
+    widget.text = text;
+    widget.textStyle = textStyle;
+    widget.onClick = std::move(onClick);
+    return add(parent, std::move(widget));
+}
+
+void WidgetLayer::setText(Id id, const sf::String& text) {
+    if (id >= m_widgets.size() || m_widgets[id].text == text) return;
+    m_widgets[id].text = text;
+    m_geometryDirty = true;
+}
+
+void WidgetLayer::setFill(Id id, sf::Color color) {
+    if (id >= m_widgets.size() || m_widgets[id].style.fill == color) return;
+    m_widgets[id].style.fill = color;
+    m_geometryDirty = true;
+}
+
+void WidgetLayer::setVisible(Id id, bool visible) {
+    if (id >= m_widgets.size() || m_widgets[id].visible == visible) return;
+    m_widgets[id].visible = visible;
+    m_layoutDirty = true;
+}
+
+void WidgetLayer::setOnClick(Id id, std::function<void()> onClick) {
+    if (id < m_widgets.size()) m_widgets[id].onClick = std::move(onClick);
+}
+
+void WidgetLayer::setSize(sf::Vector2f size) {
+    if (size == m_size) return;
+    m_size = size;
+    m_layoutDirty = true;
+}
+
+sf::FloatRect WidgetLayer::bounds(Id id) {
+    if (m_layoutDirty) layout();
+    return id < m_widgets.size() ? m_widgets[id].bounds : sf::FloatRect();
+}
+
+void WidgetLayer::layout() {
+    m_cells.clear();
+    m_widgets[Root].bounds = sf::FloatRect(0.f, 0.f, m_size.x, m_size.y);
+    m_widgets[Root].shown = true;
+    for (Id id = 1; id < m_widgets.size(); ++id) {
+        Widget& widget = m_widgets[id];
+        const Widget& parent = m_widgets[widget.parent];
+        widget.bounds = place(widget.layout, parent.bounds);
+        widget.shown = widget.visible && parent.shown;
+        if (!widget.shown || widget.kind != Kind::Button) continue;
+
+        sf::FloatRect area = hitBounds(widget.bounds, widget.style.outlineThickness);
+        int x0 = static_cast<int>(std::floor(area.left / CellSize));
+        int y0 = static_cast<int>(std::floor(area.top / CellSize));
+        int x1 = static_cast<int>(std::floor((area.left + area.width) / CellSize));
+        int y1 = static_cast<int>(std::floor((area.top + area.height) / CellSize));
+        for (int y = y0; y <= y1; ++y) {
+            for (int x = x0; x <= x1; ++x) {
+                m_cells[cellKey(x, y)].push_back(id);
+            }
+        }
+    }
+    m_layoutDirty = false;
+    m_geometryDirty = true;
+}
+
+WidgetLayer::Id WidgetLayer::hitTest(sf::Vector2f point) {
+    if (m_layoutDirty) layout();
+    auto cell = m_cells.find(cellKey(static_cast<int>(std::floor(point.x / CellSize)),
+                                     static_cast<int>(std::floor(point.y / CellSize))));
+    if (cell == m_cells.end()) return None;
+    // Later widgets are drawn over earlier ones
+    for (auto it = cell->second.rbegin(); it != cell->second.rend(); ++it) {
+        const Widget& widget = m_widgets[*it];
+        if (hitBounds(widget.bounds, widget.style.outlineThickness).contains(point)) return *it;
+    }
+    return None;
+}
+
+bool WidgetLayer::handleEvent(const sf::Event& event) {
+    if (event.type == sf::Event::Resized) {
+        setSize(sf::Vector2f(static_cast<float>(event.size.width), static_cast<float>(event.size.height)));
+        return false;
+    }
+    if (event.type != sf::Event::MouseButtonPressed || event.mouseButton.button != sf::Mouse::Left) return false;
+
+    // The layer's view maps one unit to one pixel
+    Id id = hitTest(sf::Vector2f(static_cast<float>(event.mouseButton.x), static_cast<float>(event.mouseButton.y)));
+    if (id == None) return false;
+    // The callback may change the tree, so it runs from a copy
+    std::function<void()> onClick = m_widgets[id].onClick;
+    if (onClick) onClick();
+    return true;
+}
+
+void WidgetLayer::rebuild() {
+    m_quads.clear();
+    for (auto& entry : m_glyphs) {
+        entry.second.clear();
+    }
+    for (const Widget& widget : m_widgets) {
+        if (!widget.shown || widget.kind == Kind::Root) continue;
+        const sf::FloatRect& b = widget.bounds;
+        const float t = widget.style.outlineThickness;
+        if (t > 0.f && widget.style.outline.a > 0) {
+            appendRect(sf::FloatRect(b.left - t, b.top - t, b.width + 2 * t, t), widget.style.outline);
+            appendRect(sf::FloatRect(b.left - t, b.top + b.height, b.width + 2 * t, t), widget.style.outline);
+            appendRect(sf::FloatRect(b.left - t, b.top, t, b.height), widget.style.outline);
+            appendRect(sf::FloatRect(b.left + b.width, b.top, t, b.height), widget.style.outline);
+        }
+        if (widget.style.fill.a > 0) appendRect(b, widget.style.fill);
+        if (!widget.text.isEmpty()) appendText(widget);
+    }
+    m_geometryDirty = false;
+    ++m_rebuilds;
+}
+
+void WidgetLayer::appendRect(const sf::FloatRect& rect, sf::Color color) {
+    const sf::Vector2f topLeft(rect.left, rect.top);
+    const sf::Vector2f topRight(rect.left + rect.width, rect.top);
+    const sf::Vector2f bottomLeft(rect.left, rect.top + rect.height);
+    const sf::Vector2f bottomRight(rect.left + rect.width, rect.top + rect.height);
+    m_quads.append(sf::Vertex(topLeft, color));
+    m_quads.append(sf::Vertex(topRight, color));
+    m_quads.append(sf::Vertex(bottomLeft, color));
+    m_quads.append(sf::Vertex(bottomLeft, color));
+    m_quads.append(sf::Vertex(topRight, color));
+    m_quads.append(sf::Vertex(bottomRight, color));
+}
+
+float WidgetLayer::textWidth(const sf::String& text, unsigned int characterSize) const {
+    float x = 0.f;
+    sf::Uint32 previous = 0;
+    for (sf::Uint32 c : text) {
+        if (previous) x += m_font.getKerning(previous, c, characterSize);
+        x += m_font.getGlyph(c, characterSize, false).advance;
+        previous = c;
+    }
+    return x;
+}
+
+void WidgetLayer::appendText(const Widget& widget) {
+    const TextStyle& style = widget.textStyle;
+    const unsigned int size = style.characterSize;
+    sf::VertexArray& vertices = m_glyphs[size];
+    vertices.setPrimitiveType(sf::Triangles);
+
+    // Whole pixels keep the glyphs sharp
+    const sf::FloatRect& b = widget.bounds;
+    float x = style.align == Align::Center ? b.left + (b.width - textWidth(widget.text, size)) / 2.f : b.left + style.padding;
+    const float baseline = std::round(b.top + (b.height - size) / 2.f) + size;
+    x = std::round(x);
+
+    sf::Uint32 previous = 0;
+    for (sf::Uint32 c : widget.text) {
+        if (previous) x += m_font.getKerning(previous, c, size);
+        const sf::Glyph& glyph = m_font.getGlyph(c, size, false);
+
+        float left = x + glyph.bounds.left;
+        float top = baseline + glyph.bounds.top;
+        float right = left + glyph.bounds.width;
+        float bottom = top + glyph.bounds.height;
+        float u1 = static_cast<float>(glyph.textureRect.left);
+        float v1 = static_cast<float>(glyph.textureRect.top);
+        float u2 = u1 + glyph.textureRect.width;
+        float v2 = v1 + glyph.textureRect.height;
+
+        vertices.append(sf::Vertex(sf::Vector2f(left, top), style.color, sf::Vector2f(u1, v1)));
+        vertices.append(sf::Vertex(sf::Vector2f(right, top), style.color, sf::Vector2f(u2, v1)));
+        vertices.append(sf::Vertex(sf::Vector2f(left, bottom), style.color, sf::Vector2f(u1, v2)));
+        vertices.append(sf::Vertex(sf::Vector2f(left, bottom), style.color, sf::Vector2f(u1, v2)));
+        vertices.append(sf::Vertex(sf::Vector2f(right, top), style.color, sf::Vector2f(u2, v1)));
+        vertices.append(sf::Vertex(sf::Vector2f(right, bottom), style.color, sf::Vector2f(u2, v2)));
+
+        x += glyph.advance;
+        previous = c;
+    }
+}
+
+void WidgetLayer::draw(sf::RenderTarget& target) {
+    if (m_size.x <= 0.f || m_size.y <= 0.f) {
+        setSize(sf::Vector2f(static_cast<float>(target.getSize().x), static_cast<float>(target.getSize().y)));
+    }
+    if (m_layoutDirty) layout();
+    if (m_geometryDirty) rebuild();
+
+    const sf::View previous = target.getView();
+    target.setView(sf::View(sf::FloatRect(0.f, 0.f, m_size.x, m_size.y)));
+    m_drawCalls = 0;
+    if (m_quads.getVertexCount() > 0) {
+        target.draw(m_quads);
+        ++m_drawCalls;
+    }
+    // Every glyph was requested in rebuild(), so the atlases are complete
+    for (const auto& entry : m_glyphs) {
+        if (entry.second.getVertexCount() == 0) continue;
+        target.draw(entry.second, sf::RenderStates(&m_font.getTexture(entry.first)));
+        ++m_drawCalls;
+    }
+    target.setView(previous);
+}
+
+std::uint64_t WidgetLayer::cellKey(int x, int y) {
+    return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <SFML/Graphics.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+// Retained tree of panels, labels and buttons drawn as a few batches.
+//
+// Widgets are placed relative to their parent (the root is the window), so
+// a layout follows the window size instead of fixed pixel positions. All
+// rectangles and outlines go into one vertex array and all glyphs into one
+// per character size, drawn with the font's atlas, so a screen of widgets
+// takes a handful of draw calls. The arrays are rebuilt only after a widget
+// changed; labels are always drawn above rectangles.
+//
+// Clicks are dispatched through a spatial hash of the clickable widgets'
+// bounds, rebuilt with the layout.
+class WidgetLayer {
+public:
+    typedef std::size_t Id;
+    static const Id Root = 0;
+    static const Id None = static_cast<Id>(-1);
+
+    // A rectangle as fractions of the parent's size plus pixels:
+    // left = parent.left + relative.left * parent.width + pixels.left, and
+    // the same for the other edges and sizes
+    struct Layout {
+        sf::FloatRect relative;
+        sf::FloatRect pixels;
+
+        static Layout fixed(float left, float top, float width, float height);
+        // Fixed size, with the top-left corner at a fraction of the parent plus an offset
+        static Layout anchored(float anchorX, float anchorY, float left, float top, float width, float height);
+        static Layout fill(float margin = 0.f);
+    };
+
+    struct Style {
+        sf::Color fill = sf::Color::Transparent;
+        sf::Color outline = sf::Color::Transparent;
+        float outlineThickness = 0.f; // drawn outside the bounds, as sf::Shape does
+    };
+
+    enum class Align { Left, Center };
+
+    struct TextStyle {
+        unsigned int characterSize = 24;
+        sf::Color color = sf::Color::Black;
+        Align align = Align::Left;
+        float padding = 5.f;          // from the left edge when aligned left
+    };
+
+    explicit WidgetLayer(const sf::Font& font);
+
+    Id addPanel(Id parent, const Layout& layout, const Style& style);
+    // Vertically centred in its rectangle
+    Id addLabel(Id parent, const Layout& layout, const sf::String& text, const TextStyle& textStyle);
+    Id addButton(Id parent, const Layout& layout, const Style& style, const sf::String& text,
+                 const TextStyle& textStyle, std::function<void()> onClick);
+
+    void setText(Id id, const sf::String& text);
+    void setFill(Id id, sf::Color color);
+    // Hidden widgets hide their children and take no clicks
+    void setVisible(Id id, bool visible);
+    void setOnClick(Id id, std::function<void()> onClick);
+
+    // Window size in pixels; the layer draws through its own view of that size
+    void setSize(sf::Vector2f size);
+    sf::FloatRect bounds(Id id);
+
+    // The topmost visible clickable widget at `point`, None if there is none
+    Id hitTest(sf::Vector2f point);
+    // Left clicks on a button run its callback, Resized events lay the tree
+    // out again. Returns true if a click hit a button.
+    bool handleEvent(const sf::Event& event);
+    void draw(sf::RenderTarget& target);
+
+    // Of the last draw()
+    std::size_t drawCalls() const { return m_drawCalls; }
+    // Vertex batches built so far, for diagnostics
+    std::size_t rebuilds() const { return m_rebuilds; }
+
+private:
+    enum class Kind { Root, Panel, Label, Button };
+
+    struct Widget {
+        Kind kind = Kind::Panel;
+        Id parent = Root;
+        Layout layout;
+        Style style;
+        sf::String text;
+        TextStyle textStyle;
+        std::function<void()> onClick;
+        bool visible = true;
+
+        // Computed by layout()
+        sf::FloatRect bounds;
+        bool shown = true; // this and every ancestor visible
+    };
+
+    const sf::Font& m_font;
+    sf::Vector2f m_size;
+    std::vector<Widget> m_widgets; // parents before their children
+
+    bool m_layoutDirty = true;
+    bool m_geometryDirty = true;
+
+    // Clickable widgets per CellSize x CellSize cell
+    std::unordered_map<std::uint64_t, std::vector<Id>> m_cells;
+
+    sf::VertexArray m_quads;
+    std::map<unsigned int, sf::VertexArray> m_glyphs; // by character size
+    std::size_t m_drawCalls = 0;
+    std::size_t m_rebuilds = 0;
+
+    Id add(Id parent, Widget widget);
+    void layout();
+    void rebuild();
+    void appendRect(const sf::FloatRect& rect, sf::Color color);
+    void appendText(const Widget& widget);
+    float textWidth(const sf::String& text, unsigned int characterSize) const;
+    static std::uint64_t cellKey(int x, int y);
+};
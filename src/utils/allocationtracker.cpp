@@ -0,0 +1,255 @@
+#include "allocationtracker.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#elif defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+// Updates a sink from operator new, which runs on the sink's own thread
+struct AllocationSinkRecorder {
+    // A negative size records a free
+    static void record(AllocationTracker::Sink& sink, int phase, std::int64_t size) {
+        AllocationTracker::Sink::Counters& counters = sink.m_phases[phase];
+        if (size >= 0) {
+            ++counters.stats.allocations;
+            counters.stats.bytes += static_cast<std::uint64_t>(size);
+        } else {
+            ++counters.stats.frees;
+        }
+        counters.liveBytes += size;
+        counters.stats.peakBytes = std::max(counters.stats.peakBytes, counters.liveBytes);
+    }
+};
+
+namespace {
+    const int MaxPhases = AllocationTracker::MaxPhases;
+
+    struct Phase {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<std::uint64_t> allocations{0};
+        std::atomic<std::uint64_t> frees{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::int64_t> liveBytes{0};
+        std::atomic<std::int64_t> peakBytes{0};
+    };
+
+    // Plain arrays and a constant-initialised index, so operator new never
+    // depends on anything that has to be constructed first
+    Phase g_phases[MaxPhases];
+    std::atomic<int> g_phaseCount{0};
+    std::mutex g_registerMutex;
+    thread_local int t_phase = -1;
+    thread_local AllocationTracker::Sink* t_sink = nullptr;
+
+    std::size_t usableSize(void* pointer) {
+#if defined(_WIN32)
+        return _msize(pointer);
+#elif defined(__APPLE__)
+        return malloc_size(pointer);
+#else
+        return malloc_usable_size(pointer);
+#endif
+    }
+
+    void recordAllocation(void* pointer) {
+        Phase& phase = g_phases[t_phase];
+        const std::int64_t size = static_cast<std::int64_t>(usableSize(pointer));
+        phase.allocations.fetch_add(1, std::memory_order_relaxed);
+        phase.bytes.fetch_add(static_cast<std::uint64_t>(size), std::memory_order_relaxed);
+        std::int64_t live = phase.liveBytes.fetch_add(size, std::memory_order_relaxed) + size;
+        std::int64_t peak = phase.peakBytes.load(std::memory_order_relaxed);
+        while (live > peak && !phase.peakBytes.compare_exchange_weak(peak, live, std::memory_order_relaxed)) {
+        }
+    }
+
+    // Frees of memory allocated before the phase began make liveBytes go
+    // negative, which only lowers the peak that can be reached
+    void recordFree(void* pointer) {
+        Phase& phase = g_phases[t_phase];
+        phase.frees.fetch_add(1, std::memory_order_relaxed);
+        phase.liveBytes.fetch_sub(static_cast<std::int64_t>(usableSize(pointer)), std::memory_order_relaxed);
+    }
+
+    int findPhase(const char* name) {
+        const int count = g_phaseCount.load(std::memory_order_acquire);
+        for (int i = 0; i < count; ++i) {
+            if (std::strcmp(g_phases[i].name.load(std::memory_order_relaxed), name) == 0) return i;
+        }
+        return -1;
+    }
+
+    int registerPhase(const char* name) {
+        int index = findPhase(name);
+        if (index >= 0) return index;
+
+        std::lock_guard<std::mutex> lock(g_registerMutex);
+        index = findPhase(name);
+        if (index >= 0) return index;
+        index = g_phaseCount.load(std::memory_order_relaxed);
+        if (index >= MaxPhases) return -1;
+        g_phases[index].name.store(name, std::memory_order_relaxed);
+        g_phaseCount.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    void formatLine(std::ostream& out, const char* name, const AllocationTracker::Stats& s) {
+        out << name << ": " << s.allocations << " allocations, " << s.frees << " frees, "
+            << s.bytes / (1024.0 * 1024.0) << " MB, peak " << s.peakBytes / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+
+    bool startsWith(const char* name, const std::string& prefix) {
+        return std::strncmp(name, prefix.c_str(), prefix.size()) == 0;
+    }
+
+    void* allocate(std::size_t size) {
+        void* pointer = std::malloc(size ? size : 1);
+        if (pointer && t_phase >= 0) {
+            recordAllocation(pointer);
+            if (t_sink) AllocationSinkRecorder::record(*t_sink, t_phase, static_cast<std::int64_t>(usableSize(pointer)));
+        }
+        return pointer;
+    }
+
+    void release(void* pointer) {
+        if (!pointer) return;
+        if (t_phase >= 0) {
+            recordFree(pointer);
+            if (t_sink) AllocationSinkRecorder::record(*t_sink, t_phase, -static_cast<std::int64_t>(usableSize(pointer)));
+        }
+        std::free(pointer);
+    }
+}
+
+AllocationTracker::Scope::Scope(const char* phase)
+    : m_previous(t_phase),
+      m_previousSink(t_sink)
+{
+    // Phase names are expected to be string literals; the table keeps the pointer
+    t_phase = registerPhase(phase);
+}
+
+AllocationTracker::Scope::Scope(Sink& sink)
+    : m_previous(t_phase),
+      m_previousSink(t_sink)
+{
+    t_sink = &sink;
+}
+
+AllocationTracker::Scope::~Scope() {
+    t_phase = m_previous;
+    t_sink = m_previousSink;
+}
+
+AllocationTracker::Stats AllocationTracker::Sink::stats(const std::string& phase) const {
+    int index = findPhase(phase.c_str());
+    return index < 0 ? Stats() : m_phases[index].stats;
+}
+
+std::string AllocationTracker::Sink::report(const std::string& prefix) const {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    const int count = g_phaseCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        const char* name = g_phases[i].name.load(std::memory_order_relaxed);
+        const Stats& s = m_phases[i].stats;
+        if (!startsWith(name, prefix) || (s.allocations == 0 && s.frees == 0)) continue;
+        formatLine(out, name, s);
+    }
+    return out.str();
+}
+
+AllocationTracker::Stats AllocationTracker::stats(const std::string& phase) {
+    Stats stats;
+    int index = findPhase(phase.c_str());
+    if (index < 0) return stats;
+    const Phase& p = g_phases[index];
+    stats.allocations = p.allocations.load(std::memory_order_relaxed);
+    stats.frees = p.frees.load(std::memory_order_relaxed);
+    stats.bytes = p.bytes.load(std::memory_order_relaxed);
+    stats.peakBytes = p.peakBytes.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AllocationTracker::reset(const std::string& prefix) {
+    const int count = g_phaseCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        Phase& phase = g_phases[i];
+        if (!startsWith(phase.name.load(std::memory_order_relaxed), prefix)) continue;
+        phase.allocations.store(0, std::memory_order_relaxed);
+        phase.frees.store(0, std::memory_order_relaxed);
+        phase.bytes.store(0, std::memory_order_relaxed);
+        phase.liveBytes.store(0, std::memory_order_relaxed);
+        phase.peakBytes.store(0, std::memory_order_relaxed);
+    }
+}
+
+std::string AllocationTracker::report(const std::string& prefix) {
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2);
+    const int count = g_phaseCount.load(std::memory_order_acquire);
+    for (int i = 0; i < count; ++i) {
+        const char* name = g_phases[i].name.load(std::memory_order_relaxed);
+        if (!startsWith(name, prefix)) continue;
+        Stats s = stats(name);
+        if (s.allocations == 0 && s.frees == 0) continue;
+        formatLine(out, name, s);
+    }
+    return out.str();
+}
+
+// Replacing the global allocation functions is what lets the tracker see
+// every container and string; the unscoped path is malloc plus one check
+void* operator new(std::size_t size) {
+    void* pointer = allocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new[](std::size_t size) {
+    void* pointer = allocate(size);
+    if (!pointer) throw std::bad_alloc();
+    return pointer;
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size);
+}
+
+void operator delete(void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, std::size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept {
+    release(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    release(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    release(pointer);
+}
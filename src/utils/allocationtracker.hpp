@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+// Counts heap allocations made through operator new, per named phase.
+//
+// A Scope marks the work of the current thread as belonging to a phase
+// ("map.ingest") until it ends; scopes nest, and the innermost one is
+// charged. Allocations outside any scope are not counted, so everything
+// else pays only for a thread-local check. Memory that C libraries such as
+// GDAL get from malloc() directly is not seen.
+//
+// Phases are shared by all threads, so workers running the same phase add
+// up. To count one piece of work on its own (one map load while another
+// runs), bind a caller-owned Sink to the thread doing it: the thread's
+// allocations then also go to the sink, per phase. Bytes are what the
+// allocator handed out, rounding included.
+class AllocationTracker {
+public:
+    static const int MaxPhases = 64;
+
+    struct Stats {
+        std::uint64_t allocations = 0;
+        std::uint64_t frees = 0;
+        std::uint64_t bytes = 0;     // allocated in total
+        std::int64_t peakBytes = 0;  // most allocated and not yet freed at once
+    };
+
+    // Counters of one piece of work. Plain fields, so only the thread it is
+    // bound to may touch it until the binding Scope ends.
+    class Sink {
+    public:
+        Stats stats(const std::string& phase) const;
+        // Like AllocationTracker::report(), for what this sink saw
+        std::string report(const std::string& prefix = std::string()) const;
+
+    private:
+        friend class AllocationTracker;
+        friend struct AllocationSinkRecorder; // operator new's side, in the .cpp
+        struct Counters {
+            Stats stats;
+            std::int64_t liveBytes = 0;
+        };
+        Counters m_phases[MaxPhases]; // by the phase's index in the global table
+    };
+
+    class Scope {
+    public:
+        explicit Scope(const char* phase);
+        // Counts this thread's allocations into `sink` as well, in whatever
+        // phases nested scopes enter, until the scope ends
+        explicit Scope(Sink& sink);
+        ~Scope();
+        Scope(const Scope&) = delete;
+        Scope& operator=(const Scope&) = delete;
+
+    private:
+        int m_previous;
+        Sink* m_previousSink;
+    };
+
+    static Stats stats(const std::string& phase);
+    // Zeroes the phases whose names start with `prefix`, all of them by default
+    static void reset(const std::string& prefix = std::string());
+    // A line per phase that allocated, for phases starting with `prefix`
+    static std::string report(const std::string& prefix = std::string());
+};
@@ -0,0 +1,150 @@
+#include "filewatcher.hpp"
+#include <iostream>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    // Polling fallback interval
+    const std::chrono::seconds ScanInterval(1);
+
+    const char* const SqliteSuffixes[] = {"", "-wal", "-journal"};
+}
+
+FileWatcher::FileWatcher() {
+#ifdef __linux__
+    m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (m_inotify < 0) {
+        std::cerr << "inotify unavailable, falling back to polling file times" << std::endl;
+    }
+#endif
+}
+
+FileWatcher::~FileWatcher() {
+    unwatchAll();
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        close(m_inotify);
+    }
+#endif
+}
+
+void FileWatcher::watch(const std::string& path) {
+    std::filesystem::path absolute = std::filesystem::absolute(path).lexically_normal();
+    std::string key = absolute.string();
+
+    std::error_code ec;
+    WatchedFile file;
+    file.modified = std::filesystem::last_write_time(absolute, ec);
+    file.size = std::filesystem::file_size(absolute, ec);
+    m_files[key] = file;
+
+#ifdef __linux__
+    if (m_inotify >= 0) {
+        std::string directory = absolute.parent_path().string();
+        for (const auto& entry : m_directories) {
+            if (entry.second == directory) return;
+        }
+        int descriptor = inotify_add_watch(m_inotify, directory.c_str(), IN_CLOSE_WRITE | IN_MODIFY | IN_MOVED_TO | IN_CREATE | IN_DELETE);
+        if (descriptor < 0) {
+            std::cerr << "Failed to watch " << directory << std::endl;
+            return;
+        }
+        m_directories[descriptor] = directory;
+    }
+#endif
+}
+
+void FileWatcher::unwatchAll() {
+#ifdef __linux__
+    for (const auto& entry : m_directories) {
+        inotify_rm_watch(m_inotify, entry.first);
+    }
+#endif
+    m_directories.clear();
+    m_files.clear();
+    m_pending.clear();
+}
+
+void FileWatcher::retry(const std::string& path) {
+    std::string key = std::filesystem::absolute(path).lexically_normal().string();
+    if (m_files.count(key) > 0) {
+        m_pending[key] = Clock::now();
+    }
+}
+
+std::vector<std::string> FileWatcher::poll(std::chrono::milliseconds settle) {
+    if (m_inotify >= 0) {
+        readEvents();
+    } else {
+        scanModificationTimes();
+    }
+
+    std::vector<std::string> changed;
+    Clock::time_point now = Clock::now();
+    for (auto it = m_pending.begin(); it != m_pending.end();) {
+        if (now - it->second >= settle) {
+            changed.push_back(it->first);
+            it = m_pending.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return changed;
+}
+
+void FileWatcher::readEvents() {
+#ifdef __linux__
+    alignas(inotify_event) char buffer[4096];
+    for (;;) {
+        ssize_t length = read(m_inotify, buffer, sizeof(buffer));
+        if (length <= 0) break;
+
+        for (char* p = buffer; p < buffer + length;) {
+            const inotify_event* event = reinterpret_cast<const inotify_event*>(p);
+            auto directory = m_directories.find(event->wd);
+            if (directory != m_directories.end() && event->len > 0) {
+                markChanged(directory->second, event->name);
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+#endif
+}
+
+void FileWatcher::scanModificationTimes() {
+    Clock::time_point now = Clock::now();
+    if (now - m_lastScan < ScanInterval) return;
+    m_lastScan = now;
+
+    for (auto& entry : m_files) {
+        std::error_code ec;
+        WatchedFile current;
+        current.modified = std::filesystem::last_write_time(entry.first, ec);
+        current.size = std::filesystem::file_size(entry.first, ec);
+        // A WAL file growing means committed writes that are not in the main file yet
+        std::uintmax_t walSize = std::filesystem::file_size(entry.first + "-wal", ec);
+        if (!ec) current.size += walSize;
+
+        if (current.modified != entry.second.modified || current.size != entry.second.size) {
+            entry.second = current;
+            m_pending[entry.first] = now;
+        }
+    }
+}
+
+void FileWatcher::markChanged(const std::string& directory, const std::string& name) {
+    for (const char* suffix : SqliteSuffixes) {
+        std::string suffixText = suffix;
+        if (name.size() < suffixText.size() || name.compare(name.size() - suffixText.size(), suffixText.size(), suffixText) != 0) continue;
+
+        std::string path = (std::filesystem::path(directory) / name.substr(0, name.size() - suffixText.size())).string();
+        if (m_files.count(path) > 0) {
+            // Every event pushes the deadline back until the writer is done
+            m_pending[path] = Clock::now();
+            return;
+        }
+    }
+}
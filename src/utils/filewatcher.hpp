@@ -0,0 +1,52 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+
+// Notices when watched files are modified or replaced on disk.
+//
+// On Linux this uses inotify on the containing directories, so atomic
+// replace-by-rename and SQLite -wal/-journal writes are seen as well. Other
+// platforms fall back to polling modification times. Changes are reported
+// only once a file has been quiet for the settle time, so a writer that is
+// still busy does not trigger a reload halfway through.
+class FileWatcher {
+public:
+    FileWatcher();
+    ~FileWatcher();
+
+    FileWatcher(const FileWatcher&) = delete;
+    FileWatcher& operator=(const FileWatcher&) = delete;
+
+    void watch(const std::string& path);
+    void unwatchAll();
+    // Reports a watched file as changed again once it has been quiet for
+    // the settle time, for a reader that found it still being written
+    void retry(const std::string& path);
+
+    // Non-blocking; returns the watched files that changed and have settled
+    std::vector<std::string> poll(std::chrono::milliseconds settle = std::chrono::milliseconds(300));
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct WatchedFile {
+        std::filesystem::file_time_type modified;
+        std::uintmax_t size = 0;
+    };
+
+    std::map<std::string, WatchedFile> m_files;
+    std::map<std::string, Clock::time_point> m_pending; // path -> time of the last event
+    Clock::time_point m_lastScan;
+
+    int m_inotify = -1;
+    std::map<int, std::string> m_directories; // watch descriptor -> directory
+
+    void readEvents();
+    void scanModificationTimes();
+    void markChanged(const std::string& directory, const std::string& name);
+};
@@ -0,0 +1,72 @@
+#include "imageencoder.hpp"
+#include <gdal_priv.h>
+#include <cpl_vsi.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <memory>
+
+namespace {
+    std::atomic<unsigned int> s_fileCounter(0);
+
+    struct DatasetCloser {
+        void operator()(GDALDataset* dataset) const { GDALClose(dataset); }
+    };
+    typedef std::unique_ptr<GDALDataset, DatasetCloser> DatasetPtr;
+}
+
+namespace {
+    // Copies the first `bandCount` channels of the RGBA buffer into a MEM
+    // dataset and encodes that with `driverName` into a /vsimem file
+    bool encode(const char* driverName, const char* extension, const std::uint8_t* rgba, unsigned int width, unsigned int height,
+                int bandCount, char** options, std::vector<std::uint8_t>& output) {
+        GDALDriver* memDriver = GetGDALDriverManager()->GetDriverByName("MEM");
+        GDALDriver* driver = GetGDALDriverManager()->GetDriverByName(driverName);
+        if (!memDriver || !driver) return false;
+
+        DatasetPtr source(memDriver->Create("", width, height, bandCount, GDT_Byte, nullptr));
+        if (!source) return false;
+
+        // Pixel-interleaved RGBA in, one band per channel out
+        int bands[4] = {1, 2, 3, 4};
+        if (source->RasterIO(GF_Write, 0, 0, width, height, const_cast<std::uint8_t*>(rgba),
+                             width, height, GDT_Byte, bandCount, bands, 4, 4 * static_cast<GIntBig>(width), 1) != CE_None) {
+            return false;
+        }
+
+        // Every call gets its own in-memory file so threads do not collide
+        std::string path = "/vsimem/imageencoder_" + std::to_string(s_fileCounter++) + extension;
+        DatasetPtr encoded(driver->CreateCopy(path.c_str(), source.get(), FALSE, options, nullptr, nullptr));
+        if (!encoded) {
+            VSIUnlink(path.c_str());
+            return false;
+        }
+        encoded.reset();
+
+        vsi_l_offset length = 0;
+        GByte* buffer = VSIGetMemFileBuffer(path.c_str(), &length, TRUE);
+        if (!buffer) return false;
+
+        output.resize(static_cast<std::size_t>(length));
+        std::memcpy(output.data(), buffer, output.size());
+        VSIFree(buffer);
+        return true;
+    }
+}
+
+namespace imageencoder {
+
+bool encodePng(const std::uint8_t* rgba, unsigned int width, unsigned int height, std::vector<std::uint8_t>& output,
+               int compressionLevel) {
+    std::string level = "ZLEVEL=" + std::to_string(std::max(1, std::min(9, compressionLevel)));
+    char* options[] = {const_cast<char*>(level.c_str()), nullptr};
+    return encode("PNG", ".png", rgba, width, height, 4, options, output);
+}
+
+bool encodeJpeg(const std::uint8_t* rgba, unsigned int width, unsigned int height, int quality, std::vector<std::uint8_t>& output) {
+    std::string level = "QUALITY=" + std::to_string(std::max(1, std::min(100, quality)));
+    char* options[] = {const_cast<char*>(level.c_str()), nullptr};
+    return encode("JPEG", ".jpg", rgba, width, height, 3, options, output);
+}
+
+}
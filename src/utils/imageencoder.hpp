@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Encodes RGBA pixel buffers into image files in memory through GDAL's
+// PNG and JPEG drivers. Safe to call from several threads at once.
+namespace imageencoder {
+
+    // compressionLevel is zlib's 1 (fastest) to 9 (smallest)
+    bool encodePng(const std::uint8_t* rgba, unsigned int width, unsigned int height, std::vector<std::uint8_t>& output,
+                   int compressionLevel = 6);
+
+    // Alpha is dropped; quality is 1 to 100
+    bool encodeJpeg(const std::uint8_t* rgba, unsigned int width, unsigned int height, int quality, std::vector<std::uint8_t>& output);
+
+}
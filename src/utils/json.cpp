@@ -0,0 +1,131 @@
+#include "json.hpp"
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+
+namespace {
+    // Position just after `"key":` (and any whitespace), or npos
+    std::size_t findValue(const std::string& text, const std::string& key) {
+        std::string quoted = "\"" + key + "\"";
+        std::size_t position = 0;
+        while ((position = text.find(quoted, position)) != std::string::npos) {
+            std::size_t colon = position + quoted.size();
+            while (colon < text.size() && std::isspace(static_cast<unsigned char>(text[colon]))) ++colon;
+            if (colon < text.size() && text[colon] == ':') {
+                std::size_t value = colon + 1;
+                while (value < text.size() && std::isspace(static_cast<unsigned char>(text[value]))) ++value;
+                return value;
+            }
+            position = colon;
+        }
+        return std::string::npos;
+    }
+
+    void appendUtf8(std::string& out, unsigned int codepoint) {
+        if (codepoint < 0x80) {
+            out += static_cast<char>(codepoint);
+        } else if (codepoint < 0x800) {
+            out += static_cast<char>(0xC0 | (codepoint >> 6));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else if (codepoint < 0x10000) {
+            out += static_cast<char>(0xE0 | (codepoint >> 12));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        } else {
+            out += static_cast<char>(0xF0 | (codepoint >> 18));
+            out += static_cast<char>(0x80 | ((codepoint >> 12) & 0x3F));
+            out += static_cast<char>(0x80 | ((codepoint >> 6) & 0x3F));
+            out += static_cast<char>(0x80 | (codepoint & 0x3F));
+        }
+    }
+}
+
+namespace json {
+
+    std::string escape(const std::string& value) {
+        std::string out;
+        out.reserve(value.size() + 8);
+        for (unsigned char c : value) {
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                default:
+                    if (c < 0x20) {
+                        char buffer[8];
+                        std::snprintf(buffer, sizeof(buffer), "\\u%04x", c);
+                        out += buffer;
+                    } else {
+                        out += static_cast<char>(c);
+                    }
+            }
+        }
+        return out;
+    }
+
+    bool findString(const std::string& text, const std::string& key, std::string& value) {
+        std::size_t position = findValue(text, key);
+        if (position == std::string::npos || position >= text.size() || text[position] != '"') return false;
+
+        value.clear();
+        for (std::size_t i = position + 1; i < text.size(); ++i) {
+            char c = text[i];
+            if (c == '"') return true;
+            if (c != '\\') {
+                value += c;
+                continue;
+            }
+            if (++i >= text.size()) return false;
+            switch (text[i]) {
+                case 'n': value += '\n'; break;
+                case 'r': value += '\r'; break;
+                case 't': value += '\t'; break;
+                case 'b': value += '\b'; break;
+                case 'f': value += '\f'; break;
+                case 'u': {
+                    if (i + 4 >= text.size()) return false;
+                    unsigned int codepoint = static_cast<unsigned int>(std::strtoul(text.substr(i + 1, 4).c_str(), nullptr, 16));
+                    i += 4;
+                    // Surrogate pair
+                    if (codepoint >= 0xD800 && codepoint < 0xDC00 && i + 6 < text.size() && text[i + 1] == '\\' && text[i + 2] == 'u') {
+                        unsigned int low = static_cast<unsigned int>(std::strtoul(text.substr(i + 3, 4).c_str(), nullptr, 16));
+                        codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                        i += 6;
+                    }
+                    appendUtf8(value, codepoint);
+                    break;
+                }
+                default: value += text[i]; break;
+            }
+        }
+        return false;
+    }
+
+    bool findNumber(const std::string& text, const std::string& key, double& value) {
+        std::size_t position = findValue(text, key);
+        if (position == std::string::npos) return false;
+        const char* start = text.c_str() + position;
+        char* end = nullptr;
+        double parsed = std::strtod(start, &end);
+        if (end == start) return false;
+        value = parsed;
+        return true;
+    }
+
+    bool findBool(const std::string& text, const std::string& key, bool& value) {
+        std::size_t position = findValue(text, key);
+        if (position == std::string::npos) return false;
+        if (text.compare(position, 4, "true") == 0) {
+            value = true;
+            return true;
+        }
+        if (text.compare(position, 5, "false") == 0) {
+            value = false;
+            return true;
+        }
+        return false;
+    }
+
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+
+// Just enough JSON for the small request/response bodies we exchange with
+// local services; not a general parser.
+namespace json {
+
+    // Escapes `value` for use inside a JSON string literal (without quotes)
+    std::string escape(const std::string& value);
+
+    // Finds the first "key": "<string>" in `text` and unescapes the value.
+    // Nesting is ignored, so the first occurrence anywhere wins.
+    bool findString(const std::string& text, const std::string& key, std::string& value);
+
+    // Same for numbers and booleans
+    bool findNumber(const std::string& text, const std::string& key, double& value);
+    bool findBool(const std::string& text, const std::string& key, bool& value);
+
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+// Thread-safe least-recently-used cache bounded by a total cost (e.g. bytes).
+// Values are handed out as shared_ptr so an evicted entry stays valid for
+// whoever is still using it.
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class LruCache {
+public:
+    explicit LruCache(std::size_t capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    std::shared_ptr<const Value> get(const Key& key) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it == m_index.end()) {
+            ++m_misses;
+            return nullptr;
+        }
+        // Move to the front (most recently used)
+        m_entries.splice(m_entries.begin(), m_entries, it->second);
+        ++m_hits;
+        return it->second->value;
+    }
+
+    void put(const Key& key, std::shared_ptr<const Value> value, std::size_t cost) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_size -= it->second->cost;
+            m_entries.erase(it->second);
+            m_index.erase(it);
+        }
+        if (cost > m_capacity) return;
+
+        m_entries.push_front(Entry{key, std::move(value), cost});
+        m_index[key] = m_entries.begin();
+        m_size += cost;
+
+        while (m_size > m_capacity) {
+            const Entry& oldest = m_entries.back();
+            m_size -= oldest.cost;
+            m_index.erase(oldest.key);
+            m_entries.pop_back();
+        }
+    }
+
+    void clear() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.clear();
+        m_index.clear();
+        m_size = 0;
+    }
+
+    void setCapacity(std::size_t capacity) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_capacity = capacity;
+        while (m_size > m_capacity && !m_entries.empty()) {
+            m_size -= m_entries.back().cost;
+            m_index.erase(m_entries.back().key);
+            m_entries.pop_back();
+        }
+    }
+
+    std::size_t size() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_size;
+    }
+
+    std::size_t count() const {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_entries.size();
+    }
+
+    std::size_t hits() const { return m_hits; }
+    std::size_t misses() const { return m_misses; }
+
+private:
+    struct Entry {
+        Key key;
+        std::shared_ptr<const Value> value;
+        std::size_t cost;
+    };
+
+    std::size_t m_capacity;
+    std::size_t m_size = 0;
+    std::list<Entry> m_entries;
+    std::unordered_map<Key, typename std::list<Entry>::iterator, Hash> m_index;
+    mutable std::mutex m_mutex;
+    std::atomic<std::size_t> m_hits{0};
+    std::atomic<std::size_t> m_misses{0};
+};
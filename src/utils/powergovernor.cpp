@@ -0,0 +1,124 @@
+#include "powergovernor.hpp"
+#include <cstdio>
+#include <iostream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+namespace {
+    const std::chrono::seconds MeasurementWindow(1);
+
+    std::size_t index(PowerGovernor::Mode mode) {
+        return mode == PowerGovernor::Mode::LowPower ? 1 : 0;
+    }
+}
+
+PowerGovernor::PowerGovernor()
+    : m_profile(profileFor(Mode::Normal)),
+      m_windowStart(Clock::now()),
+      m_windowCpu(processCpuSeconds())
+{
+}
+
+PowerProfile PowerGovernor::profileFor(Mode mode) {
+    PowerProfile profile;
+    if (mode == Mode::LowPower) {
+        // A third of the frames, no label placement, a level coarser map,
+        // a slow camera, one worker per job and two scheduler workers in
+        // all, so a long background task cannot hold up visible work
+        profile.frameRateLimit = 20;
+        profile.mapLabels = false;
+        profile.mapDetailBias = 1;
+        profile.overlayDivisor = 4;
+        profile.cameraFrameRate = 10;
+        profile.motionFrameRate = 5;
+        profile.weatherInterval = std::chrono::minutes(30);
+        profile.workerThreads = 1;
+        profile.schedulerWorkers = 2;
+    }
+    return profile;
+}
+
+const char* PowerGovernor::name(Mode mode) {
+    return mode == Mode::LowPower ? "Low power" : "Normal";
+}
+
+void PowerGovernor::setMode(Mode mode) {
+    if (mode == m_mode) return;
+    closeWindow();
+    Measurement left = average(m_mode);
+    char text[128];
+    std::snprintf(text, sizeof(text), "%s mode averaged %.1f fps at %.1f%% CPU over %.0f s",
+                  name(m_mode), left.framesPerSecond, left.cpuPercent, left.seconds);
+    std::cout << "Power: " << text << "; switching to " << name(mode) << " mode" << std::endl;
+
+    m_mode = mode;
+    m_profile = profileFor(mode);
+    m_current = Measurement();
+}
+
+bool PowerGovernor::frame() {
+    ++m_windowFrames;
+    if (Clock::now() - m_windowStart < MeasurementWindow) return false;
+    closeWindow();
+    return true;
+}
+
+void PowerGovernor::closeWindow() {
+    Clock::time_point now = Clock::now();
+    double cpu = processCpuSeconds();
+    double seconds = std::chrono::duration<double>(now - m_windowStart).count();
+    if (seconds > 0.0) {
+        m_current.framesPerSecond = m_windowFrames / seconds;
+        m_current.cpuPercent = 100.0 * (cpu - m_windowCpu) / seconds;
+        m_current.seconds = seconds;
+
+        Totals& totals = m_totals[index(m_mode)];
+        totals.frames += m_windowFrames;
+        totals.seconds += seconds;
+        totals.cpuSeconds += cpu - m_windowCpu;
+    }
+    m_windowStart = now;
+    m_windowCpu = cpu;
+    m_windowFrames = 0;
+}
+
+PowerGovernor::Measurement PowerGovernor::average(Mode mode) const {
+    const Totals& totals = m_totals[index(mode)];
+    Measurement measurement;
+    if (totals.seconds <= 0.0) return measurement;
+    measurement.framesPerSecond = totals.frames / totals.seconds;
+    measurement.cpuPercent = 100.0 * totals.cpuSeconds / totals.seconds;
+    measurement.seconds = totals.seconds;
+    return measurement;
+}
+
+std::string PowerGovernor::describe() const {
+    char text[192];
+    int length = std::snprintf(text, sizeof(text), "%s: %.1f fps, CPU %.1f%%", name(m_mode), m_current.framesPerSecond, m_current.cpuPercent);
+    // The other mode's average, once it has been measured
+    const Mode other = m_mode == Mode::Normal ? Mode::LowPower : Mode::Normal;
+    Measurement average = this->average(other);
+    if (average.seconds > 0.0 && length > 0 && static_cast<std::size_t>(length) < sizeof(text)) {
+        std::snprintf(text + length, sizeof(text) - length, " | %s avg %.1f fps, CPU %.1f%%", name(other), average.framesPerSecond, average.cpuPercent);
+    }
+    return text;
+}
+
+double PowerGovernor::processCpuSeconds() {
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) return 0.0;
+    auto seconds = [](const FILETIME& time) {
+        return ((static_cast<std::uint64_t>(time.dwHighDateTime) << 32) | time.dwLowDateTime) * 1e-7;
+    };
+    return seconds(kernel) + seconds(user);
+#else
+    rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0.0;
+    return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec * 1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec * 1e-6;
+#endif
+}
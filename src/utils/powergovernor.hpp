@@ -0,0 +1,79 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+// What the apps may spend in one power mode. MainWindow hands the profile
+// of the current mode to every app when the mode changes.
+struct PowerProfile {
+    unsigned int frameRateLimit = 60;        // window frame cap
+    bool mapLabels = true;                   // place and draw map labels
+    int mapDetailBias = 0;                   // map zoom levels below the one matching the screen
+    unsigned int overlayDivisor = 2;         // weather overlay sampled at 1/n of the window size
+    unsigned int cameraFrameRate = 0;        // capture cap, 0: as fast as the source delivers
+    unsigned int motionFrameRate = 0;        // motion analysis cap, 0: all the detector keeps up with
+    std::chrono::seconds weatherInterval{0}; // shortest wait between weather fetches
+    unsigned int workerThreads = 0;          // workers one job spreads over, 0: every active one
+    unsigned int schedulerWorkers = 0;       // TaskScheduler workers taking tasks, 0: all
+};
+
+// Holds the power mode and its profile, and measures the frame rate and
+// process CPU time in each mode so they can be compared.
+//
+// frame() is called once per presented frame. Every second it closes a
+// measurement window (frames and CPU seconds over wall time) and adds it to
+// the totals of the current mode; a mode change closes the open window
+// early and logs the totals of the mode being left.
+class PowerGovernor {
+public:
+    enum class Mode { Normal, LowPower };
+
+    struct Measurement {
+        double framesPerSecond = 0.0;
+        double cpuPercent = 0.0;  // of one core, so above 100 when several are busy
+        double seconds = 0.0;     // measured time
+    };
+
+    PowerGovernor();
+
+    void setMode(Mode mode);
+    Mode mode() const { return m_mode; }
+    const PowerProfile& profile() const { return m_profile; }
+    static PowerProfile profileFor(Mode mode);
+    static const char* name(Mode mode);
+
+    // Returns true when a new one second measurement is available
+    bool frame();
+    // The last full second
+    Measurement current() const { return m_current; }
+    // All time spent in `mode` so far
+    Measurement average(Mode mode) const;
+    // One line for the diagnostics overlay
+    std::string describe() const;
+
+    // User plus system time of the whole process
+    static double processCpuSeconds();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Totals {
+        std::uint64_t frames = 0;
+        double seconds = 0.0;
+        double cpuSeconds = 0.0;
+    };
+
+    Mode m_mode = Mode::Normal;
+    PowerProfile m_profile;
+    Measurement m_current;
+    std::array<Totals, 2> m_totals;
+
+    // Open measurement window
+    Clock::time_point m_windowStart;
+    double m_windowCpu = 0.0;
+    std::uint64_t m_windowFrames = 0;
+
+    void closeWindow();
+};
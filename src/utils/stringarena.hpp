@@ -0,0 +1,55 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <vector>
+
+// Monotonic storage for many small strings that live and die together.
+//
+// store() copies a string into the current block and returns a view of the
+// copy; blocks are never moved or reused, so views stay valid until clear()
+// or the arena is destroyed, and moving the arena keeps them valid too.
+// One allocation serves a block's worth of strings instead of one each.
+class StringArena {
+public:
+    static const std::size_t BlockSize = 64 * 1024;
+
+    std::string_view store(std::string_view text) {
+        if (text.empty()) return std::string_view();
+        if (text.size() > BlockSize / 4) {
+            // Long strings get an allocation of their own and leave the block open
+            m_large.emplace_back(new char[text.size()]);
+            m_bytes += text.size();
+            std::memcpy(m_large.back().get(), text.data(), text.size());
+            return std::string_view(m_large.back().get(), text.size());
+        }
+        if (m_blocks.empty() || m_used + text.size() > BlockSize) {
+            m_blocks.emplace_back(new char[BlockSize]);
+            m_bytes += BlockSize;
+            m_used = 0;
+        }
+        char* copy = m_blocks.back().get() + m_used;
+        std::memcpy(copy, text.data(), text.size());
+        m_used += text.size();
+        return std::string_view(copy, text.size());
+    }
+
+    void clear() {
+        m_blocks.clear();
+        m_large.clear();
+        m_used = 0;
+        m_bytes = 0;
+    }
+
+    std::size_t memoryBytes() const {
+        return m_bytes + (m_blocks.capacity() + m_large.capacity()) * sizeof(std::unique_ptr<char[]>);
+    }
+
+private:
+    std::vector<std::unique_ptr<char[]>> m_blocks; // the last one is being filled
+    std::vector<std::unique_ptr<char[]>> m_large;
+    std::size_t m_used = 0;                        // of the last block
+    std::size_t m_bytes = 0;
+};
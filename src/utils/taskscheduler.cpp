@@ -0,0 +1,342 @@
+#include "taskscheduler.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
+namespace {
+    // The worker the current thread is, if any
+    thread_local const TaskScheduler* t_scheduler = nullptr;
+    thread_local std::size_t t_worker = 0;
+
+    std::string formatBound(double microseconds) {
+        char text[32];
+        if (microseconds < 1000.0) {
+            std::snprintf(text, sizeof(text), "<%.0f us", microseconds);
+        } else if (microseconds < 1000000.0) {
+            std::snprintf(text, sizeof(text), "<%.0f ms", microseconds / 1000.0);
+        } else {
+            std::snprintf(text, sizeof(text), "<%.0f s", microseconds / 1000000.0);
+        }
+        return text;
+    }
+
+    // Shared by a parallelFor() call and its helper tasks, which may only
+    // start after the call has returned; they touch `body` only after
+    // claiming an index, and by then the call is still waiting for it
+    struct ParallelFor {
+        std::atomic<std::size_t> next{0};
+        std::size_t count = 0;
+        const std::function<void(std::size_t)>* body = nullptr;
+        std::mutex mutex;
+        std::condition_variable finished;
+        std::size_t done = 0;
+    };
+
+    void runIndices(ParallelFor& loop) {
+        for (;;) {
+            const std::size_t index = loop.next++;
+            if (index >= loop.count) return;
+            (*loop.body)(index);
+            std::lock_guard<std::mutex> lock(loop.mutex);
+            if (++loop.done == loop.count) loop.finished.notify_all();
+        }
+    }
+}
+
+CancellationToken::CancellationToken()
+    : m_state(std::make_shared<State>())
+{
+}
+
+void CancellationToken::cancel() {
+    m_state->cancelled = true;
+}
+
+bool CancellationToken::isCancelled() const {
+    return m_state->cancelled;
+}
+
+void CancellationToken::wait() const {
+    std::unique_lock<std::mutex> lock(m_state->mutex);
+    m_state->idle.wait(lock, [this] { return m_state->pending == 0; });
+}
+
+void CancellationToken::acquire(State& state) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    ++state.pending;
+}
+
+void CancellationToken::release(State& state) {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (--state.pending == 0) state.idle.notify_all();
+}
+
+TaskScheduler& TaskScheduler::instance() {
+    static TaskScheduler scheduler;
+    return scheduler;
+}
+
+TaskScheduler::TaskScheduler(unsigned int threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        m_workers.push_back(std::make_unique<Worker>());
+    }
+    m_activeWorkers = threadCount;
+    // Only once every deque exists, since workers steal from all of them
+    m_threads.reserve(threadCount);
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back([this, i] { workerLoop(i); });
+    }
+}
+
+TaskScheduler::~TaskScheduler() {
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+
+    // Release the tokens of whatever never ran
+    auto drop = [](std::deque<Task>& queue) {
+        for (Task& task : queue) {
+            if (task.token) CancellationToken::release(*task.token);
+        }
+        queue.clear();
+    };
+    for (auto& worker : m_workers) {
+        for (auto& queue : worker->queues) drop(queue);
+    }
+    for (auto& queue : m_shared) drop(queue);
+}
+
+void TaskScheduler::submit(Priority priority, std::function<void()> task) {
+    enqueue(static_cast<std::size_t>(priority), Task{std::move(task), nullptr, Clock::now()});
+}
+
+void TaskScheduler::submit(Priority priority, const CancellationToken& token, std::function<void()> task) {
+    CancellationToken::acquire(*token.m_state);
+    enqueue(static_cast<std::size_t>(priority), Task{std::move(task), token.m_state, Clock::now()});
+}
+
+void TaskScheduler::enqueue(std::size_t priority, Task task) {
+    if (t_scheduler == this) {
+        Worker& worker = *m_workers[t_worker];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.queues[priority].push_back(std::move(task));
+    } else {
+        std::lock_guard<std::mutex> lock(m_sharedMutex);
+        m_shared[priority].push_back(std::move(task));
+    }
+    ++m_queued[priority];
+    ++m_pending;
+    {
+        // Taking the lock orders this with a worker checking m_pending before it sleeps
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+    }
+    // A single wakeup could go to an inactive worker, which would swallow it
+    if (m_activeWorkers < threadCount()) {
+        m_wake.notify_all();
+    } else {
+        m_wake.notify_one();
+    }
+}
+
+void TaskScheduler::parallelFor(Priority priority, std::size_t count, const std::function<void(std::size_t)>& body) {
+    if (count == 0) return;
+    auto loop = std::make_shared<ParallelFor>();
+    loop->count = count;
+    loop->body = &body;
+    const std::size_t helpers = std::min<std::size_t>(count - 1, activeWorkers());
+    for (std::size_t i = 0; i < helpers; ++i) {
+        submit(priority, [loop] { runIndices(*loop); });
+    }
+    runIndices(*loop);
+    std::unique_lock<std::mutex> lock(loop->mutex);
+    loop->finished.wait(lock, [&] { return loop->done == count; });
+}
+
+void TaskScheduler::post(std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(m_mainMutex);
+    m_main.push_back(Task{std::move(task), nullptr, Clock::now()});
+}
+
+void TaskScheduler::post(const CancellationToken& token, std::function<void()> task) {
+    std::lock_guard<std::mutex> lock(m_mainMutex);
+    m_main.push_back(Task{std::move(task), token.m_state, Clock::now()});
+}
+
+std::size_t TaskScheduler::runMainThreadTasks(std::chrono::microseconds budget) {
+    const Clock::time_point start = Clock::now();
+    std::size_t ran = 0;
+    for (;;) {
+        Task task;
+        {
+            std::lock_guard<std::mutex> lock(m_mainMutex);
+            if (m_main.empty()) break;
+            task = std::move(m_main.front());
+            m_main.pop_front();
+        }
+        ++m_mainLatency[bucket(Clock::now() - task.queued)];
+        if (isCancelled(task)) {
+            ++m_cancelled;
+        } else {
+            task.run();
+            ++m_mainExecuted;
+        }
+        ++ran;
+        if (Clock::now() - start >= budget) break;
+    }
+    return ran;
+}
+
+void TaskScheduler::discardCancelled() {
+    std::deque<Task> discarded;
+    {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        auto keep = std::stable_partition(m_main.begin(), m_main.end(), [](const Task& task) { return !isCancelled(task); });
+        std::move(keep, m_main.end(), std::back_inserter(discarded));
+        m_main.erase(keep, m_main.end());
+    }
+    m_cancelled += discarded.size();
+    // What the tasks captured is destroyed here, outside the lock
+}
+
+void TaskScheduler::setActiveWorkers(unsigned int count) {
+    if (count == 0 || count > threadCount()) count = threadCount();
+    {
+        std::lock_guard<std::mutex> lock(m_sleepMutex);
+        m_activeWorkers = count;
+    }
+    // Woken workers above the cap go back to sleep; ones below it pick up queued work
+    m_wake.notify_all();
+}
+
+void TaskScheduler::workerLoop(std::size_t index) {
+    t_scheduler = this;
+    t_worker = index;
+    for (;;) {
+        Task task;
+        std::size_t priority = 0;
+        // Tasks queued on an inactive worker's own deque are stolen by the others
+        if (index < m_activeWorkers && findTask(index, task, priority)) {
+            runTask(task, priority);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(m_sleepMutex);
+        m_wake.wait(lock, [this, index] { return m_stopping || (m_pending > 0 && index < m_activeWorkers); });
+        if (m_stopping) return;
+    }
+}
+
+bool TaskScheduler::findTask(std::size_t index, Task& task, std::size_t& priority) {
+    const std::size_t workers = m_workers.size();
+    for (priority = 0; priority < PriorityCount; ++priority) {
+        {
+            Worker& own = *m_workers[index];
+            std::lock_guard<std::mutex> lock(own.mutex);
+            std::deque<Task>& queue = own.queues[priority];
+            if (!queue.empty()) {
+                task = std::move(queue.back());
+                queue.pop_back();
+                return true;
+            }
+        }
+        {
+            std::lock_guard<std::mutex> lock(m_sharedMutex);
+            std::deque<Task>& queue = m_shared[priority];
+            if (!queue.empty()) {
+                task = std::move(queue.front());
+                queue.pop_front();
+                return true;
+            }
+        }
+        for (std::size_t offset = 1; offset < workers; ++offset) {
+            Worker& victim = *m_workers[(index + offset) % workers];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            std::deque<Task>& queue = victim.queues[priority];
+            if (!queue.empty()) {
+                task = std::move(queue.front());
+                queue.pop_front();
+                ++m_steals;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::runTask(Task& task, std::size_t priority) {
+    --m_pending;
+    --m_queued[priority];
+    ++m_latency[priority][bucket(Clock::now() - task.queued)];
+    if (isCancelled(task)) {
+        ++m_cancelled;
+    } else {
+        task.run();
+        ++m_executed[priority];
+    }
+    // Let go of the captures before the owner's wait() returns
+    task.run = nullptr;
+    if (task.token) CancellationToken::release(*task.token);
+}
+
+bool TaskScheduler::isCancelled(const Task& task) {
+    return task.token && task.token->cancelled;
+}
+
+std::size_t TaskScheduler::bucket(Clock::duration wait) {
+    const auto microseconds = std::chrono::duration_cast<std::chrono::microseconds>(wait).count();
+    std::size_t index = 0;
+    while (index + 1 < LatencyBuckets && (std::int64_t(1) << index) <= microseconds) ++index;
+    return index;
+}
+
+TaskScheduler::Stats TaskScheduler::stats() const {
+    Stats stats;
+    stats.threads = threadCount();
+    stats.activeThreads = activeWorkers();
+    for (std::size_t p = 0; p < PriorityCount; ++p) {
+        stats.queued[p] = m_queued[p];
+        stats.executed[p] = m_executed[p];
+        for (std::size_t b = 0; b < LatencyBuckets; ++b) stats.latency[p][b] = m_latency[p][b];
+    }
+    stats.steals = m_steals;
+    stats.cancelled = m_cancelled;
+    {
+        std::lock_guard<std::mutex> lock(m_mainMutex);
+        stats.mainThreadQueued = m_main.size();
+    }
+    stats.mainThreadExecuted = m_mainExecuted;
+    for (std::size_t b = 0; b < LatencyBuckets; ++b) stats.mainThreadLatency[b] = m_mainLatency[b];
+    return stats;
+}
+
+double TaskScheduler::percentile(const Histogram& histogram, double fraction) {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : histogram) total += count;
+    if (total == 0) return 0.0;
+    const double target = fraction * total;
+    std::uint64_t seen = 0;
+    for (std::size_t b = 0; b < LatencyBuckets; ++b) {
+        seen += histogram[b];
+        if (seen >= target) return static_cast<double>(std::int64_t(1) << b);
+    }
+    return static_cast<double>(std::int64_t(1) << (LatencyBuckets - 1));
+}
+
+std::string TaskScheduler::describe() const {
+    Stats stats = this->stats();
+    char text[256];
+    std::snprintf(text, sizeof(text), "Tasks on %u/%u threads: queued %zu/%zu/%zu, %llu stolen, %llu cancelled | wait p99 high %s, low %s | main %zu queued, p99 %s",
+                  stats.activeThreads, stats.threads, stats.queued[0], stats.queued[1], stats.queued[2],
+                  static_cast<unsigned long long>(stats.steals), static_cast<unsigned long long>(stats.cancelled),
+                  formatBound(percentile(stats.latency[0], 0.99)).c_str(), formatBound(percentile(stats.latency[2], 0.99)).c_str(),
+                  stats.mainThreadQueued, formatBound(percentile(stats.mainThreadLatency, 0.99)).c_str());
+    return text;
+}
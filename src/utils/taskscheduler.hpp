@@ -0,0 +1,181 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Lets the owner of queued tasks call them off. Copies share one state;
+// tasks and main thread continuations submitted with a token are skipped
+// once it is cancelled, and wait() blocks until none of its worker tasks is
+// queued or running any more.
+class CancellationToken {
+public:
+    CancellationToken();
+
+    void cancel();
+    bool isCancelled() const;
+    // Must not be called from one of the token's own tasks
+    void wait() const;
+
+private:
+    friend class TaskScheduler;
+
+    struct State {
+        std::atomic<bool> cancelled{false};
+        std::mutex mutex;
+        std::condition_variable idle;
+        std::size_t pending = 0; // queued or running
+    };
+
+    std::shared_ptr<State> m_state;
+
+    static void acquire(State& state);
+    static void release(State& state);
+};
+
+// The process-wide pool for CPU work, with a queue of continuations for the
+// main thread.
+//
+// Each worker has a deque per priority. A task submitted from a worker goes
+// to the back of that worker's own deque and is taken from the back again
+// (the newest, still cache-warm work first); tasks from other threads go to
+// a shared FIFO. An idle worker looks for High, then Normal, then Low work:
+// its own deque, the shared queue, then the front of the other workers'
+// deques, which counts as a steal. So a UI-visible task never waits behind
+// queued prefetch, only behind tasks already running.
+//
+// Results must not touch SFML objects or app state from a worker. post()
+// queues a function for the main thread instead, which MainWindow runs with
+// runMainThreadTasks() once per frame; submitThen() chains the two.
+class TaskScheduler {
+public:
+    enum class Priority { High, Normal, Low }; // UI-visible work, background, prefetch
+    static const std::size_t PriorityCount = 3;
+    // Queue wait histogram: bucket i counts waits below 2^i microseconds,
+    // the last one everything longer
+    static const std::size_t LatencyBuckets = 24;
+
+    typedef std::array<std::uint64_t, LatencyBuckets> Histogram;
+
+    struct Stats {
+        unsigned int threads = 0;
+        unsigned int activeThreads = 0;                    // see setActiveWorkers()
+        std::array<std::size_t, PriorityCount> queued{};    // waiting now
+        std::array<std::uint64_t, PriorityCount> executed{};
+        std::array<Histogram, PriorityCount> latency{};     // submit to start
+        std::uint64_t steals = 0;
+        std::uint64_t cancelled = 0;                       // skipped, workers and main thread
+        std::size_t mainThreadQueued = 0;
+        std::uint64_t mainThreadExecuted = 0;
+        Histogram mainThreadLatency{};                     // post to run
+    };
+
+    // The scheduler shared by every app
+    static TaskScheduler& instance();
+
+    // threadCount == 0 uses one thread per hardware core but one, which is
+    // left to the main thread
+    explicit TaskScheduler(unsigned int threadCount = 0);
+    // Queued tasks are dropped, running ones finish
+    ~TaskScheduler();
+
+    TaskScheduler(const TaskScheduler&) = delete;
+    TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+    void submit(Priority priority, std::function<void()> task);
+    void submit(Priority priority, const CancellationToken& token, std::function<void()> task);
+
+    // Queues `task` for the next runMainThreadTasks()
+    void post(std::function<void()> task);
+    void post(const CancellationToken& token, std::function<void()> task);
+
+    // Runs `work` on a worker and then `then(result)` on the main thread,
+    // unless `token` is cancelled before either starts. `work` returns a
+    // copyable value, a shared_ptr for anything large.
+    template <typename Work, typename Then>
+    void submitThen(Priority priority, const CancellationToken& token, Work work, Then then) {
+        submit(priority, token, [this, token, work, then] {
+            auto result = work();
+            post(token, [then, result] { then(result); });
+        });
+    }
+
+    // Calls body(0) .. body(count - 1) spread over the workers and returns
+    // once all calls are done. The calling thread takes indices as well, so
+    // this is safe from inside a task: whatever no worker got to runs there.
+    void parallelFor(Priority priority, std::size_t count, const std::function<void(std::size_t)>& body);
+
+    // Runs queued main thread tasks until the queue is empty or `budget` is
+    // used up, always at least one. Returns how many ran.
+    std::size_t runMainThreadTasks(std::chrono::microseconds budget);
+    // Drops queued main thread tasks whose token is cancelled, so what they
+    // hold is released now. Owners call it after cancelling in a destructor.
+    void discardCancelled();
+
+    unsigned int threadCount() const { return static_cast<unsigned int>(m_threads.size()); }
+    // Lets only the first `count` workers take tasks (0 or more than there
+    // are: all of them); the others sleep once their current task is done.
+    // parallelFor() spreads over the active workers only.
+    void setActiveWorkers(unsigned int count);
+    unsigned int activeWorkers() const { return m_activeWorkers; }
+    Stats stats() const;
+    // Upper bound of the bucket holding the given fraction of the samples, in microseconds
+    static double percentile(const Histogram& histogram, double fraction);
+    // One line for the diagnostics overlay
+    std::string describe() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Task {
+        std::function<void()> run;
+        std::shared_ptr<CancellationToken::State> token; // null if it cannot be cancelled
+        Clock::time_point queued;
+    };
+
+    struct Worker {
+        std::mutex mutex;
+        std::array<std::deque<Task>, PriorityCount> queues;
+    };
+
+    std::vector<std::unique_ptr<Worker>> m_workers;
+    std::vector<std::thread> m_threads;
+
+    std::mutex m_sharedMutex;
+    std::array<std::deque<Task>, PriorityCount> m_shared;
+
+    // Workers sleep here while nothing is queued anywhere
+    std::mutex m_sleepMutex;
+    std::condition_variable m_wake;
+    std::atomic<std::size_t> m_pending{0};
+    std::atomic<bool> m_stopping{false};
+    std::atomic<unsigned int> m_activeWorkers{0};
+
+    mutable std::mutex m_mainMutex;
+    std::deque<Task> m_main;
+
+    std::array<std::atomic<std::size_t>, PriorityCount> m_queued{};
+    std::array<std::atomic<std::uint64_t>, PriorityCount> m_executed{};
+    std::array<std::array<std::atomic<std::uint64_t>, LatencyBuckets>, PriorityCount> m_latency{};
+    std::atomic<std::uint64_t> m_steals{0};
+    std::atomic<std::uint64_t> m_cancelled{0};
+    std::atomic<std::uint64_t> m_mainExecuted{0};
+    std::array<std::atomic<std::uint64_t>, LatencyBuckets> m_mainLatency{};
+
+    void enqueue(std::size_t priority, Task task);
+    void workerLoop(std::size_t index);
+    bool findTask(std::size_t index, Task& task, std::size_t& priority);
+    void runTask(Task& task, std::size_t priority);
+    static bool isCancelled(const Task& task);
+    static std::size_t bucket(Clock::duration wait);
+};
@@ -1,22 +1,233 @@
 #include "weather.hpp"
+#include "json.hpp"
+#include <curl/curl.h>
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <cstdlib>
-#include <ctime>
+#include <iostream>
+#include <random>
 
-Weather::Weather() {
-    std::srand(std::time(nullptr));
-    updateWeather();
+namespace {
+    const char* const DefaultEndpoint = "http://127.0.0.1:8082/weather";
+    const long ConnectTimeoutMs = 3000;
+    const std::size_t MaxBodySize = 64 * 1024;
+    // Even "max-age=0" waits this long before asking again
+    const std::chrono::seconds MinTtl(1);
+
+    // Reply headers and body of one request
+    struct Reply {
+        std::string body;
+        std::string etag;
+        long maxAge = -1;
+        const std::atomic<bool>* stopping = nullptr;
+
+        static std::size_t onWrite(char* data, std::size_t size, std::size_t count, void* user) {
+            Reply* reply = static_cast<Reply*>(user);
+            if (reply->body.size() + size * count > MaxBodySize) return 0;
+            reply->body.append(data, size * count);
+            return size * count;
+        }
+
+        static std::size_t onHeader(char* data, std::size_t size, std::size_t count, void* user) {
+            Reply* reply = static_cast<Reply*>(user);
+            std::string line(data, size * count);
+            while (!line.empty() && std::isspace(static_cast<unsigned char>(line.back()))) line.pop_back();
+            std::size_t colon = line.find(':');
+            if (colon == std::string::npos) return size * count;
+
+            std::string name = line.substr(0, colon);
+            std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            std::string value = line.substr(std::min(line.size(), line.find_first_not_of(' ', colon + 1)));
+            if (name == "etag") {
+                reply->etag = value;
+            } else if (name == "cache-control") {
+                std::size_t maxAge = value.find("max-age=");
+                if (maxAge != std::string::npos) reply->maxAge = std::atol(value.c_str() + maxAge + 8);
+                if (value.find("no-cache") != std::string::npos || value.find("no-store") != std::string::npos) reply->maxAge = 0;
+            }
+            return size * count;
+        }
+
+        static int onProgress(void* user, curl_off_t, curl_off_t, curl_off_t, curl_off_t) {
+            return static_cast<Reply*>(user)->stopping->load() ? 1 : 0;
+        }
+    };
+
+    std::string describe(const Weather::Snapshot& snapshot) {
+        if (!snapshot.valid) return snapshot.error.empty() ? "Loading weather..." : "Weather unavailable";
+        std::string text = std::to_string(static_cast<long>(std::lround(snapshot.temperature))) + "°C";
+        if (!snapshot.condition.empty()) text = snapshot.condition + ", " + text;
+        if (snapshot.stale) text += " (offline)";
+        return text;
+    }
 }
 
-std::string Weather::getCurrentWeather() {
-    return m_currentWeather;
+Weather::Weather()
+    : Weather(Options{defaultEndpoint()})
+{
 }
 
-void Weather::updateWeather() {
-    const std::string weatherConditions[] = {
-        "Sunny", "Cloudy", "Rainy", "Snowy", "Windy"
-    };
-    int temperature = std::rand() % 41 - 10; // -10 to 30 degrees Celsius
-    int conditionIndex = std::rand() % (sizeof(weatherConditions) / sizeof(weatherConditions[0]));
-    
-    m_currentWeather = weatherConditions[conditionIndex] + ", " + std::to_string(temperature) + "°C";
-}
\ No newline at end of file
+Weather::Weather(const Options& options)
+    : m_options(options)
+{
+    auto initial = std::make_shared<Snapshot>();
+    initial->text = describe(*initial);
+    std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(std::move(initial)));
+
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+    m_worker = std::thread(&Weather::workerLoop, this);
+}
+
+Weather::~Weather() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    m_worker.join();
+    curl_global_cleanup();
+}
+
+std::string Weather::defaultEndpoint() {
+    const char* endpoint = std::getenv("WEATHER_ENDPOINT");
+    return endpoint && *endpoint ? endpoint : DefaultEndpoint;
+}
+
+std::shared_ptr<const Weather::Snapshot> Weather::snapshot() const {
+    return std::atomic_load(&m_snapshot);
+}
+
+Weather::Stats Weather::stats() const {
+    Stats stats;
+    stats.requests = m_requests;
+    stats.updated = m_updated;
+    stats.notModified = m_notModified;
+    stats.failures = m_failures;
+    stats.consecutiveFailures = m_consecutiveFailures;
+    return stats;
+}
+
+void Weather::refresh() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_refresh = true;
+    }
+    m_wake.notify_one();
+}
+
+void Weather::setMinimumInterval(std::chrono::seconds interval) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_minimumInterval = interval;
+        m_rescheduled = true;
+    }
+    m_wake.notify_one();
+}
+
+void Weather::workerLoop() {
+    while (!m_stopping) {
+        Clock::duration wait = fetch();
+        Clock::time_point fetched = Clock::now();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        // A new minimum interval moves the next fetch, counted from this one
+        do {
+            m_rescheduled = false;
+            m_wake.wait_until(lock, fetched + std::max(wait, m_minimumInterval),
+                              [this] { return m_stopping || m_refresh || m_rescheduled; });
+        } while (m_rescheduled && !m_stopping && !m_refresh);
+        m_refresh = false;
+    }
+}
+
+void Weather::publish(const Snapshot& snapshot) {
+    auto next = std::make_shared<Snapshot>(snapshot);
+    next->version = std::atomic_load(&m_snapshot)->version + 1;
+    next->text = describe(*next);
+    std::atomic_store(&m_snapshot, std::shared_ptr<const Snapshot>(std::move(next)));
+}
+
+Weather::Clock::duration Weather::fetch() {
+    ++m_requests;
+    Reply reply;
+    reply.stopping = &m_stopping;
+
+    CURL* curl = curl_easy_init();
+    curl_slist* headers = nullptr;
+    CURLcode code = CURLE_FAILED_INIT;
+    long status = 0;
+    if (curl) {
+        if (!m_etag.empty()) headers = curl_slist_append(headers, ("If-None-Match: " + m_etag).c_str());
+        curl_easy_setopt(curl, CURLOPT_URL, m_options.endpoint.c_str());
+        curl_easy_setopt(curl, CURLOPT_HTTPGET, 1L);
+        curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, &Reply::onWrite);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &reply);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, &Reply::onHeader);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &reply);
+        curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+        curl_easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, &Reply::onProgress);
+        curl_easy_setopt(curl, CURLOPT_XFERINFODATA, &reply);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, std::min(ConnectTimeoutMs, static_cast<long>(m_options.timeout.count())));
+        curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, static_cast<long>(m_options.timeout.count()));
+        curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+        code = curl_easy_perform(curl);
+        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &status);
+        curl_slist_free_all(headers);
+        curl_easy_cleanup(curl);
+    }
+    if (m_stopping) return Clock::duration::zero();
+
+    Snapshot current = *snapshot();
+    const Clock::time_point now = Clock::now();
+    const Clock::duration ttl = std::max<Clock::duration>(MinTtl, reply.maxAge >= 0 ? std::chrono::seconds(reply.maxAge) : m_options.ttl);
+
+    std::string error;
+    if (code != CURLE_OK) {
+        error = curl_easy_strerror(code);
+    } else if (status == 304 && current.valid) {
+        ++m_notModified;
+        m_consecutiveFailures = 0;
+        m_expires = now + ttl;
+        if (current.stale || !current.error.empty()) {
+            current.stale = false;
+            current.error.clear();
+            publish(current);
+        }
+        return ttl;
+    } else if (status != 200) {
+        error = "HTTP " + std::to_string(status);
+    } else {
+        Snapshot updated;
+        updated.valid = json::findNumber(reply.body, "temperature", updated.temperature);
+        if (updated.valid) {
+            json::findString(reply.body, "condition", updated.condition);
+            updated.fetched = std::chrono::system_clock::now();
+            ++m_updated;
+            m_consecutiveFailures = 0;
+            m_etag = reply.etag;
+            m_expires = now + ttl;
+            publish(updated);
+            return ttl;
+        }
+        error = "no temperature in the response";
+    }
+
+    // Keep showing the last reading and retry after 1, 2, 4, ... times the
+    // initial backoff, each wait randomised between half and all of it
+    ++m_failures;
+    unsigned int failures = ++m_consecutiveFailures;
+    double backoff = std::min(static_cast<double>(m_options.maxBackoff.count()),
+                              m_options.initialBackoff.count() * std::pow(2.0, std::min(failures - 1, 30u)));
+    thread_local std::mt19937 random(std::random_device{}());
+    double wait = std::uniform_real_distribution<double>(backoff / 2, backoff)(random);
+
+    bool stale = current.valid && now >= m_expires;
+    if (error != current.error || stale != current.stale) {
+        if (current.error.empty()) std::cerr << "Weather: " << m_options.endpoint << ": " << error << std::endl;
+        current.error = error;
+        current.stale = stale;
+        publish(current);
+    }
+    return std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double, std::milli>(wait));
+}
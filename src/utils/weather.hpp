@@ -1,13 +1,102 @@
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 
+// Current weather from an HTTP endpoint, fetched in the background.
+//
+// A worker thread fetches the endpoint through libcurl and keeps the reply
+// for its time to live (the response's Cache-Control max-age, else
+// Options::ttl). When that runs out the request is repeated with the ETag
+// it came with, so an unchanged answer costs a 304. Failures are retried
+// after an exponentially growing, jittered delay while the last good
+// reading stays on screen, marked stale once it has expired.
+//
+// Each result is published as an immutable Snapshot behind a shared_ptr
+// that is swapped atomically. snapshot() never waits for the network, so a
+// slow or dead endpoint cannot hold up a frame.
+//
+// The endpoint answers GET with JSON holding a "temperature" number in
+// degrees Celsius and an optional "condition" string.
 class Weather {
 public:
+    struct Options {
+        std::string endpoint;
+        std::chrono::seconds ttl{600};
+        std::chrono::milliseconds initialBackoff{1000};
+        std::chrono::milliseconds maxBackoff{300000};
+        std::chrono::milliseconds timeout{5000};
+    };
+
+    struct Snapshot {
+        std::uint64_t version = 0; // bumped on every change, so callers can skip unchanged ones
+        bool valid = false;        // holds a reading
+        bool stale = false;        // the reading expired and could not be refreshed
+        double temperature = 0.0;
+        std::string condition;
+        std::string text;          // ready to display
+        std::string error;         // last failure, empty once a fetch succeeds
+        std::chrono::system_clock::time_point fetched;
+    };
+
+    struct Stats {
+        std::uint64_t requests = 0;
+        std::uint64_t updated = 0;     // 200 with a reading
+        std::uint64_t notModified = 0; // 304
+        std::uint64_t failures = 0;
+        unsigned int consecutiveFailures = 0;
+    };
+
     Weather();
-    std::string getCurrentWeather();
-    void updateWeather();
+    explicit Weather(const Options& options);
+    ~Weather();
+
+    Weather(const Weather&) = delete;
+    Weather& operator=(const Weather&) = delete;
+
+    std::shared_ptr<const Snapshot> snapshot() const;
+    Stats stats() const;
+    // Fetches now instead of when the reading expires
+    void refresh();
+    // Waits at least this long between fetches, retries included, whatever
+    // the endpoint allows. Low power mode raises it; zero lifts it.
+    void setMinimumInterval(std::chrono::seconds interval);
+
+    // Endpoint from $WEATHER_ENDPOINT, or a local default
+    static std::string defaultEndpoint();
 
 private:
-    std::string m_currentWeather;
-};
\ No newline at end of file
+    typedef std::chrono::steady_clock Clock;
+
+    Options m_options;
+    std::shared_ptr<const Snapshot> m_snapshot; // only through std::atomic_load/atomic_store
+
+    std::thread m_worker;
+    std::mutex m_mutex;
+    std::condition_variable m_wake;
+    bool m_refresh = false;
+    bool m_rescheduled = false;
+    Clock::duration m_minimumInterval{0};
+    std::atomic<bool> m_stopping{false};
+
+    // Worker thread only
+    std::string m_etag;
+    Clock::time_point m_expires;
+
+    std::atomic<std::uint64_t> m_requests{0};
+    std::atomic<std::uint64_t> m_updated{0};
+    std::atomic<std::uint64_t> m_notModified{0};
+    std::atomic<std::uint64_t> m_failures{0};
+    std::atomic<unsigned int> m_consecutiveFailures{0};
+
+    void workerLoop();
+    // Returns how long to wait before the next fetch
+    Clock::duration fetch();
+    void publish(const Snapshot& snapshot);
+};
@@ -0,0 +1,48 @@
+#include "weatherstub.hpp"
+#include "json.hpp"
+#include <sstream>
+#include <thread>
+
+WeatherStub::WeatherStub(int maxAgeSeconds)
+    : m_maxAgeSeconds(maxAgeSeconds)
+{
+}
+
+void WeatherStub::setReading(double temperature, const std::string& condition) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_temperature = temperature;
+    m_condition = condition;
+    ++m_version;
+}
+
+void WeatherStub::handle(const HttpRequest& request, HttpResponse& response) {
+    ++m_requests;
+    if (m_delayMs > 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(m_delayMs.load()));
+    }
+    if (request.method != "GET") {
+        response.status = 405;
+        response.body = "GET only";
+        return;
+    }
+    if (m_failing) {
+        response.status = 503;
+        response.body = "failing on purpose";
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    const std::string etag = "\"w" + std::to_string(m_version) + "\"";
+    response.headers.emplace_back("ETag", etag);
+    response.headers.emplace_back("Cache-Control", "max-age=" + std::to_string(m_maxAgeSeconds));
+    if (request.header("if-none-match") == etag) {
+        ++m_notModified;
+        response.status = 304;
+        response.contentType.clear();
+        return;
+    }
+    std::ostringstream body;
+    body << "{\"temperature\":" << m_temperature << ",\"condition\":\"" << json::escape(m_condition) << "\"}";
+    response.contentType = "application/json";
+    response.body = body.str();
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "../net/httpserver.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+// Stand-in for a weather service, used to exercise the Weather client
+// without network access. Answers GET with {"temperature": ..., "condition":
+// ...}, an ETag that changes with the reading and Cache-Control max-age,
+// and 304 when If-None-Match still matches. It can be told to fail or to
+// answer slowly.
+class WeatherStub {
+public:
+    explicit WeatherStub(int maxAgeSeconds);
+
+    // HttpServer handler; blocks a server thread while delaying
+    void handle(const HttpRequest& request, HttpResponse& response);
+
+    void setReading(double temperature, const std::string& condition);
+    // Answers 503 while set
+    void setFailing(bool failing) { m_failing = failing; }
+    void setDelay(std::chrono::milliseconds delay) { m_delayMs = delay.count(); }
+
+    std::uint64_t requests() const { return m_requests; }
+    std::uint64_t notModified() const { return m_notModified; }
+
+private:
+    int m_maxAgeSeconds;
+    std::atomic<bool> m_failing{false};
+    std::atomic<long long> m_delayMs{0};
+    std::atomic<std::uint64_t> m_requests{0};
+    std::atomic<std::uint64_t> m_notModified{0};
+
+    std::mutex m_mutex;
+    double m_temperature = 18.0;
+    std::string m_condition = "Cloudy";
+    std::uint64_t m_version = 1;
+};